@@ -0,0 +1,98 @@
+// Dynamic instruction counts before and after the -O1 IR passes (ir::CSE
+// and ir::LoopOpt) on the loop kernels in bench/loops, or the files given.
+// Every function is lowered, run in the IR interpreter, optimized and run
+// again; both runs must agree on the result and on the memory they leave
+// behind.
+//
+// usage: bench_loops [n=64] [file.cmini...]
+//   int parameters receive n, pointer parameters a fresh 2*n*n int buffer
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "source.h"
+#include "lexer.h"
+#include "parser.h"
+#include "semantic.h"
+#include "irgen.h"
+#include "interp.h"
+
+using namespace cmini;
+
+static ir::Interpreter::Result runKernel(const ir::Function& fn, int n, std::vector<uint8_t>& memOut) {
+    ir::Interpreter in;
+    std::vector<int64_t> args;
+    for (auto& p : fn.params) {
+        if (!p.ty.ptr) { args.push_back(n); continue; }
+        size_t count = 2 * (size_t)n * n;
+        uint64_t buf = in.allocate(count * 4);
+        for (size_t k = 0; k < count; ++k) in.store32(buf + 4 * k, (int32_t)(k * 7 % 13) - 3);
+        args.push_back((int64_t)buf);
+    }
+    size_t buffers = in.memory.size(); // the kernel's own allocas come after
+    auto r = in.run(fn, args);
+    memOut.assign(in.memory.begin(), in.memory.begin() + (ptrdiff_t)buffers);
+    return r;
+}
+
+int main(int argc, char** argv) {
+    int n = 64;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        if (a.find_first_not_of("0123456789") == std::string::npos) n = std::atoi(a.c_str());
+        else files.push_back(a);
+    }
+    if (files.empty()) {
+        for (auto& e : std::filesystem::directory_iterator(CMINI_LOOP_KERNELS))
+            if (e.path().extension() == ".cmini") files.push_back(e.path().string());
+        std::sort(files.begin(), files.end());
+    }
+
+    std::printf("%-18s %12s %12s %7s %9s %9s\n", "kernel", "before", "after", "saved", "mul", "mul");
+    uint64_t totalBefore = 0, totalAfter = 0;
+    int failures = 0;
+    IRGen gen;
+    for (auto& path : files) {
+        SourceFile src;
+        if (!src.open(path)) { std::fprintf(stderr, "cannot open: %s\n", path.c_str()); return 1; }
+        Lexer lex(src.text());
+        Parser parser(lex);
+        auto prog = parser.parseProgram();
+        Semantic sem;
+        sem.analyze(*prog);
+        if (!sem.diags.ok()) { std::fprintf(stderr, "%s: semantic errors\n", path.c_str()); return 1; }
+
+        for (auto* f : prog->functions) {
+            if (!f->body) continue;
+            ir::Function fn;
+            gen.lower(*f, fn);
+            std::vector<uint8_t> memBefore, memAfter;
+            auto before = runKernel(fn, n, memBefore);
+            gen.optimize(fn);
+            auto after = runKernel(fn, n, memAfter);
+
+            std::string name(symName(f->name));
+            if (!before.ok || !after.ok || before.value != after.value || memBefore != memAfter) {
+                std::printf("%-18s MISMATCH %s%s\n", name.c_str(), before.error.c_str(), after.error.c_str());
+                ++failures;
+                continue;
+            }
+            auto muls = [](const ir::Interpreter::Result& r) { return r.byOp[(size_t)ir::Op::Mul]; };
+            std::printf("%-18s %12llu %12llu %6.1f%% %9llu %9llu\n", name.c_str(), (unsigned long long)before.executed,
+                        (unsigned long long)after.executed, 100.0 * (1.0 - (double)after.executed / (double)before.executed),
+                        (unsigned long long)muls(before), (unsigned long long)muls(after));
+            totalBefore += before.executed;
+            totalAfter += after.executed;
+        }
+    }
+    if (totalBefore)
+        std::printf("%-18s %12llu %12llu %6.1f%%\n", "total", (unsigned long long)totalBefore,
+                    (unsigned long long)totalAfter, 100.0 * (1.0 - (double)totalAfter / (double)totalBefore));
+    const auto& stats = gen.loopStats;
+    std::printf("cse %zu, loops %zu, hoisted %zu, strength-reduced %zu, induction variables %zu, shifts %zu, removed %zu\n",
+                gen.cseRemoved, stats.loops, stats.hoisted, stats.strengthReduced, stats.inductionVars, stats.shifts, stats.removed);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,63 @@
+// Per-node cost of the AST passes (Semantic::analyze, IRGen::gen).
+// Parses one synthetic program and times repeated runs of each pass.
+//
+// usage: bench_passes [functions=2000] [repeats=20]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include "lexer.h"
+#include "parser.h"
+#include "semantic.h"
+#include "irgen.h"
+
+using namespace cmini;
+using Clock = std::chrono::steady_clock;
+
+static std::string makeSource(int functions) {
+    std::string s;
+    for (int f = 0; f < functions; ++f) {
+        s += "int f" + std::to_string(f) + "(int a, int b) {\n";
+        s += "  int x = a + b * 3;\n  int y[4][8];\n";
+        for (int k = 0; k < 8; ++k) {
+            std::string ks = std::to_string(k);
+            s += "  y[" + std::to_string(k % 4) + "][" + ks + "] = x * " + ks + " + (a - b) / 2;\n";
+            s += "  x = x + y[" + std::to_string(k % 4) + "][" + ks + "] - " + ks + ";\n";
+        }
+        s += "  while (x < 100) { x = x * 2 + 1; if (x > 50) break; }\n";
+        s += "  return x;\n}\n";
+    }
+    return s;
+}
+
+template <class F>
+static double bestOf(int repeats, F&& f) {
+    double best = 1e30;
+    for (int r = 0; r < repeats; ++r) {
+        auto t0 = Clock::now();
+        f();
+        double s = std::chrono::duration<double>(Clock::now() - t0).count();
+        if (s < best) best = s;
+    }
+    return best;
+}
+
+int main(int argc, char** argv) {
+    int functions = argc > 1 ? std::atoi(argv[1]) : 2000;
+    int repeats = argc > 2 ? std::atoi(argv[2]) : 20;
+
+    std::string src = makeSource(functions);
+    Lexer lex(src);
+    Parser parser(lex);
+    auto prog = parser.parseProgram();
+    double nodes = (double)prog->arena.objectCount();
+
+    double sem = bestOf(repeats, [&] { Semantic s; s.analyze(*prog); });
+    size_t bytes = 0;
+    double ir = bestOf(repeats, [&] { IRGen g; bytes = g.gen(*prog).size(); });
+
+    std::printf("nodes: %.0f\n", nodes);
+    std::printf("semantic: %8.3f ms  %6.2f ns/node\n", sem * 1e3, sem * 1e9 / nodes);
+    std::printf("irgen:    %8.3f ms  %6.2f ns/node  (%zu bytes)\n", ir * 1e3, ir * 1e9 / nodes, bytes);
+    return 0;
+}
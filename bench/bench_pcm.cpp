@@ -0,0 +1,131 @@
+// Precompiled modules against parsing the source they stand in for.
+// Builds a synthetic library, writes its module to a temporary file, and
+// times (best of repeats): lex+parse+check of the source, writing the
+// module, materializing every function from it, and importing the two
+// functions a small program calls. Also checks that the materialized AST
+// generates the same IR as the parsed one.
+//
+// usage: bench_pcm [functions=5000] [repeats=10]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <unistd.h>
+#include "lexer.h"
+#include "parser.h"
+#include "semantic.h"
+#include "irgen.h"
+#include "outsink.h"
+#include "pcm.h"
+
+using namespace cmini;
+using Clock = std::chrono::steady_clock;
+
+static std::string makeSource(int functions) {
+    std::string s;
+    for (int f = 0; f < functions; ++f) {
+        std::string name = "f";
+        name += std::to_string(f);
+        s += "int " + name + "(int a, int b) {\n";
+        s += "  int x = a + b * 3;\n  int y[4][8];\n  char c = 'q';\n";
+        for (int k = 0; k < 8; ++k) {
+            std::string ks = std::to_string(k);
+            s += "  y[" + std::to_string(k % 4) + "][" + ks + "] = x * " + ks + " + (a - b) / 2;\n";
+            s += "  x = x + y[" + std::to_string(k % 4) + "][" + ks + "] - " + ks + ";\n";
+        }
+        s += "  for (int i = 0; i < 4; i = i + 1) { if (x > 50) break; x = x * 2 + c; }\n";
+        if (f > 0) s += "  x = x + f" + std::to_string(f - 1) + "(a, 1);\n";
+        s += "  return x;\n}\n";
+    }
+    return s;
+}
+
+template <class F>
+static double bestOf(int repeats, F&& f) {
+    double best = 1e30;
+    for (int r = 0; r < repeats; ++r) {
+        auto t0 = Clock::now();
+        f();
+        double s = std::chrono::duration<double>(Clock::now() - t0).count();
+        if (s < best) best = s;
+    }
+    return best;
+}
+
+static std::unique_ptr<Program> parse(const std::string& src) {
+    Lexer lex(src);
+    Parser parser(lex);
+    return parser.parseProgram();
+}
+
+int main(int argc, char** argv) {
+    int functions = argc > 1 ? std::atoi(argv[1]) : 5000;
+    int repeats = argc > 2 ? std::atoi(argv[2]) : 10;
+
+    std::string src = makeSource(functions);
+    std::unique_ptr<Program> prog;
+    double front = bestOf(repeats, [&] {
+        prog = parse(src);
+        Semantic s;
+        s.analyze(*prog);
+    });
+
+    char path[] = "/tmp/bench_pcm.XXXXXX";
+    int fd = ::mkstemp(path);
+    if (fd < 0) { std::perror("mkstemp"); return 1; }
+    OutSink buffer;
+    double write = bestOf(repeats, [&] { buffer.clear(); writeModule(*prog, src, buffer); });
+    size_t moduleBytes = buffer.str().size();
+    {
+        OutSink sink(fd);
+        writeModule(*prog, src, sink);
+    }
+    ::close(fd);
+
+    std::string error;
+    size_t materialized = 0;
+    double load = bestOf(repeats, [&] {
+        ModuleFile m;
+        if (!m.open(path, error)) return;
+        Program p;
+        for (size_t i = 0; i < m.functionCount(); ++i) p.functions.push_back(m.materialize(i, p));
+        materialized = p.functions.size();
+    });
+
+    // the caller reaches f1 and, through it, f0 only
+    std::string user = "int main() { return f1(2, 3); }\n";
+    size_t imported = 0;
+    double import = bestOf(repeats, [&] {
+        ModuleFile m;
+        if (!m.open(path, error)) return;
+        auto p = parse(user);
+        imported = importFunctions(*p, {&m});
+        Semantic s;
+        std::vector<bool> checked(p->functions.size(), false);
+        for (size_t i = 0; i < imported; ++i) checked[i] = true;
+        s.analyze(*p, nullptr, &checked);
+    });
+
+    bool same = false;
+    {
+        ModuleFile m;
+        if (m.open(path, error)) {
+            Program p;
+            for (size_t i = 0; i < m.functionCount(); ++i) p.functions.push_back(m.materialize(i, p));
+            IRGen a, b;
+            same = a.gen(*prog) == b.gen(p);
+        }
+    }
+    ::unlink(path);
+    if (!error.empty()) { std::fprintf(stderr, "%s\n", error.c_str()); return 1; }
+
+    std::printf("source: %zu bytes, %d functions; module: %zu bytes\n", src.size(), functions, moduleBytes);
+    std::printf("parse+check:      %8.3f ms\n", front * 1e3);
+    std::printf("write module:     %8.3f ms\n", write * 1e3);
+    std::printf("materialize all:  %8.3f ms  (%zu functions, %.1fx faster than parse+check)\n", load * 1e3,
+                materialized, front / load);
+    std::printf("import 2 of them: %8.3f ms  (%zu functions, %.0fx faster)\n", import * 1e3, imported, front / import);
+    std::printf("round trip: %s\n", same ? "identical IR" : "IR MISMATCH");
+    return same ? 0 : 1;
+}
@@ -0,0 +1,24 @@
+// Writes a synthetic program (see synth.h) to stdout, to feed the cmini
+// binary or other tools the inputs bench_throughput measures.
+//
+// usage: bench_synth [generator options] > file.cmini
+#include <cstdio>
+#include <string>
+#include "synth.h"
+
+using namespace cmini::bench;
+
+int main(int argc, char** argv) {
+    SynthOptions o;
+    for (int i = 1; i < argc; ++i) {
+        std::string error;
+        if (!setSynthOption(o, argv[i], error)) {
+            std::fprintf(stderr, "%s\nusage: bench_synth [options] > file.cmini\n%s", error.c_str(), synthHelp);
+            return 1;
+        }
+    }
+    SynthProgram p = generate(o);
+    if (std::fwrite(p.source.data(), 1, p.source.size(), stdout) != p.source.size()) return 1;
+    std::fprintf(stderr, "%zu bytes, %zu functions, %zu nodes\n", p.source.size(), p.functions, p.nodes);
+    return 0;
+}
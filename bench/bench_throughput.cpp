@@ -0,0 +1,181 @@
+// Compiler throughput on synthetic programs (see synth.h), in MB of source
+// and AST nodes per second.
+//
+//   micro: Lexer::next, Parser::parseProgram, Semantic::analyze and
+//          IRGen::gen, each timed on its own over one program (best of
+//          repeats; parse includes the lexing it drives)
+//   e2e:   compileFile from a file on disk to /dev/null at inputs growing
+//          16x from 1 KB up to max (1 GB needs tens of GB of memory)
+//
+// usage: bench_throughput [micro|e2e] [exprs] [max=SIZE] [repeats=N] [O=N] [generator options]
+//   defaults: size=4M for micro, max=64M; the generator options are listed
+//   in synth.cpp (synthHelp), and bench_synth writes the same programs out.
+//   exprs is expression-heavy code for the parser: depth=8 mix=1,1,0,0,0
+//   (options after it still apply)
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <memory>
+#include <string>
+#include <unistd.h>
+#include "driver.h"
+#include "irgen.h"
+#include "lexer.h"
+#include "outsink.h"
+#include "parser.h"
+#include "semantic.h"
+#include "synth.h"
+
+using namespace cmini;
+using namespace cmini::bench;
+using Clock = std::chrono::steady_clock;
+
+template <class F>
+static double bestOf(int repeats, F&& f) {
+    double best = 1e30;
+    for (int r = 0; r < repeats; ++r) {
+        auto t0 = Clock::now();
+        f();
+        double s = std::chrono::duration<double>(Clock::now() - t0).count();
+        if (s < best) best = s;
+    }
+    return best;
+}
+
+static std::string humanSize(uint64_t bytes) {
+    const char* units[] = {"B", "KB", "MB", "GB"};
+    int u = 0;
+    double v = (double)bytes;
+    while (v >= 1024 && u < 3) { v /= 1024; ++u; }
+    char buf[32];
+    std::snprintf(buf, sizeof buf, "%.*f %s", v < 10 && u ? 1 : 0, v, units[u]);
+    return buf;
+}
+
+static void row(const char* name, const std::string& input, double secs, size_t bytes, size_t nodes) {
+    std::printf("%-10s %10s %11.3f %10.1f %12.2f\n", name, input.c_str(), secs * 1e3, bytes / secs / 1e6,
+                nodes / secs / 1e6);
+}
+
+static size_t countNodes(const Program& p) {
+    size_t n = 1;
+    for (auto* f : p.functions) {
+        ++n;
+        walk(f->body, [&](Node*) { ++n; });
+    }
+    return n;
+}
+
+static int micro(const SynthOptions& o, int repeats) {
+    SynthProgram prog = generate(o);
+    const std::string& src = prog.source;
+    std::string input = humanSize(src.size());
+
+    size_t tokens = 0;
+    double lex = bestOf(repeats, [&] {
+        Lexer l(src);
+        tokens = 0;
+        while (l.next().kind != TokenKind::End) ++tokens;
+    });
+    std::unique_ptr<Program> ast;
+    double parse = 1e30;
+    for (int r = 0; r < repeats; ++r) {
+        ast.reset(); // freeing the previous tree is not part of parsing
+        auto t0 = Clock::now();
+        Lexer l(src);
+        Parser p(l);
+        ast = p.parseProgram();
+        parse = std::min(parse, std::chrono::duration<double>(Clock::now() - t0).count());
+    }
+    size_t nodes = countNodes(*ast);
+    if (nodes != prog.nodes) {
+        std::fprintf(stderr, "generator predicted %zu nodes, the parser built %zu\n", prog.nodes, nodes);
+        return 1;
+    }
+    bool checked = true;
+    double sem = bestOf(repeats, [&] {
+        Semantic s;
+        s.analyze(*ast);
+        checked = s.diags.ok();
+    });
+    if (!checked) { std::fprintf(stderr, "generated program does not pass Semantic\n"); return 1; }
+    int devnull = ::open("/dev/null", O_WRONLY | O_CLOEXEC);
+    size_t irBytes = 0;
+    double ir = bestOf(repeats, [&] {
+        OutSink sink(devnull);
+        IRGen g;
+        g.gen(*ast, sink);
+        sink.flush();
+        irBytes = sink.bytes();
+    });
+    ::close(devnull);
+
+    std::printf("%zu functions, %zu tokens, %zu nodes, %s of IR\n", prog.functions, tokens, nodes,
+                humanSize(irBytes).c_str());
+    std::printf("%-10s %10s %11s %10s %12s\n", "phase", "input", "ms", "MB/s", "Mnodes/s");
+    row("lex", input, lex, src.size(), nodes);
+    row("parse", input, parse, src.size(), nodes);
+    row("semantic", input, sem, src.size(), nodes);
+    row("irgen", input, ir, src.size(), nodes);
+    return 0;
+}
+
+static int endToEnd(SynthOptions o, uint64_t maxBytes, int repeats, int optLevel) {
+    char path[] = "/tmp/bench_throughput.XXXXXX";
+    int fd = ::mkstemp(path);
+    if (fd < 0) { std::perror("mkstemp"); return 1; }
+    ::close(fd);
+    CompileOptions opts;
+    opts.optLevel = optLevel;
+    std::printf("end-to-end at -O%d\n", optLevel);
+    std::printf("%-10s %10s %11s %10s %12s\n", "phase", "input", "ms", "MB/s", "Mnodes/s");
+    int rc = 0;
+    for (uint64_t size = 1024; size <= maxBytes; size *= 16) {
+        o.targetBytes = size;
+        SynthProgram prog = generate(o);
+        FILE* f = std::fopen(path, "wb");
+        bool ok = f && std::fwrite(prog.source.data(), 1, prog.source.size(), f) == prog.source.size();
+        if (f && std::fclose(f) != 0) ok = false;
+        if (!ok) { std::fprintf(stderr, "cannot write %s\n", path); rc = 1; break; }
+        size_t bytes = prog.source.size(), nodes = prog.nodes;
+        prog = SynthProgram(); // not held while compiling
+        CompileResult r;
+        double secs = bestOf(size <= (4u << 20) ? repeats : 1, [&] { r = compileFile(path, "/dev/null", opts, nullptr); });
+        if (!r.ok) { std::fprintf(stderr, "%s", r.err.c_str()); rc = 1; break; }
+        row("compile", humanSize(size), secs, bytes, nodes);
+    }
+    ::unlink(path);
+    return rc;
+}
+
+int main(int argc, char** argv) {
+    SynthOptions o;
+    o.targetBytes = 4 << 20;
+    bool runMicro = true, runE2E = true;
+    uint64_t maxBytes = 64 << 20;
+    int repeats = 5, optLevel = 0;
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i], error;
+        if (a == "micro") runE2E = false;
+        else if (a == "e2e") runMicro = false;
+        else if (a == "exprs") {
+            o.exprDepth = 8;
+            o.assignWeight = o.arrayWeight = 1;
+            o.ifWeight = o.loopWeight = o.callWeight = 0;
+        }
+        else if (uint64_t v; a.rfind("max=", 0) == 0 && parseSize(a.substr(4), v)) maxBytes = v;
+        else if (uint64_t v; a.rfind("repeats=", 0) == 0 && parseSize(a.substr(8), v) && v > 0) repeats = (int)v;
+        else if (a == "O=0" || a == "O=1" || a == "O=2") optLevel = a[2] - '0';
+        else if (!setSynthOption(o, a, error)) {
+            std::fprintf(stderr, "%s\nusage: bench_throughput [micro|e2e] [exprs] [max=SIZE] [repeats=N] [O=N] [generator options]\n%s",
+                         error.c_str(), synthHelp);
+            return 1;
+        }
+    }
+    if (runMicro && micro(o, repeats) != 0) return 1;
+    if (runMicro && runE2E) std::printf("\n");
+    if (runE2E && endToEnd(o, maxBytes, repeats, optLevel) != 0) return 1;
+    return 0;
+}
@@ -0,0 +1,378 @@
+// Bytecode VM (bc::VM) against a naive AST-walking interpreter on a few
+// small programs: recursive calls, nested loops over local arrays, and
+// branchy scalar code. The tree walker is what an interpreter looks like
+// without a compile step: it recurses over the checked AST, keeps every
+// variable in a scoped hash map and dispatches on the node kind at every
+// node. Both must agree on every result.
+//
+// usage: bench_vm [repeats=5]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "lexer.h"
+#include "parser.h"
+#include "semantic.h"
+#include "bytecode.h"
+#include "vm.h"
+
+using namespace cmini;
+using Clock = std::chrono::steady_clock;
+
+static const struct Kernel {
+    const char* name;
+    const char* source;
+} kernels[] = {
+    {"fib", "int fib(int n) { if (n < 2) return n; return fib(n - 1) + fib(n - 2); }\n"
+            "int main() { return fib(24); }\n"},
+    {"sieve", "int main() {\n"
+              "  int flags[8192]; int count = 0;\n"
+              "  for (int r = 0; r < 8; r = r + 1) {\n"
+              "    count = 0;\n"
+              "    for (int i = 0; i < 8192; i = i + 1) flags[i] = 1;\n"
+              "    for (int i = 2; i < 8192; i = i + 1)\n"
+              "      if (flags[i]) { count = count + 1; for (int k = i + i; k < 8192; k = k + i) flags[k] = 0; }\n"
+              "  }\n"
+              "  return count;\n}\n"},
+    {"matmul", "int mul(int a[48][48], int b[48][48], int c[48][48]) {\n"
+               "  for (int i = 0; i < 48; i = i + 1)\n"
+               "    for (int j = 0; j < 48; j = j + 1) {\n"
+               "      int s = 0;\n"
+               "      for (int k = 0; k < 48; k = k + 1) s = s + a[i][k] * b[k][j];\n"
+               "      c[i][j] = s;\n"
+               "    }\n"
+               "  return c[47][47];\n}\n"
+               "int main() {\n"
+               "  int a[48][48]; int b[48][48]; int c[48][48];\n"
+               "  for (int i = 0; i < 48; i = i + 1)\n"
+               "    for (int j = 0; j < 48; j = j + 1) { a[i][j] = i + j; b[i][j] = i - j; }\n"
+               "  int s = 0;\n"
+               "  for (int r = 0; r < 4; r = r + 1) s = s + mul(a, b, c);\n"
+               "  return s;\n}\n"},
+    {"sort", "int main() {\n"
+             "  int v[400]; int seed = 12345;\n"
+             "  for (int i = 0; i < 400; i = i + 1) { seed = (seed * 1103515245 + 12345) & 2147483647; v[i] = seed % 1000; }\n"
+             "  for (int i = 0; i < 400; i = i + 1)\n"
+             "    for (int j = 0; j + 1 < 400 - i; j = j + 1)\n"
+             "      if (v[j] > v[j + 1]) { int t = v[j]; v[j] = v[j + 1]; v[j + 1] = t; }\n"
+             "  return v[0] + v[199] * 3 + v[399] * 7;\n}\n"},
+    {"collatz", "int steps(int n) { int s = 0; while (n != 1) { if (n % 2 == 0) n = n / 2; else n = 3 * n + 1; s = s + 1; } return s; }\n"
+                "int main() {\n"
+                "  int best = 0; int at = 0;\n"
+                "  for (int i = 1; i < 20000; i = i + 1) { int s = steps(i); if (s > best && (i & 1 || i < 100)) { best = s; at = i; } }\n"
+                "  return best * 100000 + at;\n}\n"},
+};
+
+namespace {
+
+int32_t wrap(int64_t v) { return (int32_t)(uint32_t)(uint64_t)v; }
+
+// The tree walker. Every variable, scalar or not, lives in one flat memory
+// at an address found through a chain of scopes; arrays passed as
+// arguments are their addresses.
+class TreeWalker {
+public:
+    explicit TreeWalker(const Program& p) {
+        for (auto* f : p.functions) functions[f->name] = f;
+        memory.resize(1 << 16);
+    }
+
+    int32_t run(SymId name) { return call(*functions.at(name), {}); }
+
+private:
+    struct Var { uint32_t addr; const Type* type; bool byAddress; };
+    using Scope = std::unordered_map<SymId, Var>;
+    enum class Flow { Normal, Break, Continue, Return };
+
+    std::unordered_map<SymId, const Function*> functions;
+    std::vector<uint8_t> memory;
+    uint32_t sp {8};
+    std::vector<Scope> scopes; // the current call's, innermost last
+    size_t callBase {0};       // first scope of the current call
+    int32_t retval {0};
+
+    static int32_t elemSize(const Type& t) { return t.pointerLevels == 0 && t.base == BaseType::Char ? 1 : 4; }
+    static uint32_t elements(const Type& t) {
+        uint32_t n = 1;
+        for (size_t d : t.arrayDims) n *= (uint32_t)d;
+        return n;
+    }
+
+    uint32_t allocate(uint32_t bytes) {
+        uint32_t at = (sp + 3) & ~3u;
+        sp = at + (bytes ? bytes : 1);
+        if (sp > memory.size()) memory.resize(sp * 2);
+        std::memset(memory.data() + at, 0, sp - at);
+        return at;
+    }
+    void check(int64_t addr, int n) const {
+        if (addr < 8 || addr + n > (int64_t)memory.size()) throw std::runtime_error("out of bounds");
+    }
+    int32_t load(int64_t addr, int n) const {
+        check(addr, n);
+        if (n == 1) return (int8_t)memory[addr];
+        int32_t v;
+        std::memcpy(&v, memory.data() + addr, 4);
+        return v;
+    }
+    void store(int64_t addr, int n, int32_t v) {
+        check(addr, n);
+        if (n == 1) memory[addr] = (uint8_t)v;
+        else std::memcpy(memory.data() + addr, &v, 4);
+    }
+
+    const Var* lookup(SymId name) const {
+        for (size_t i = scopes.size(); i-- > callBase;) {
+            auto f = scopes[i].find(name);
+            if (f != scopes[i].end()) return &f->second;
+        }
+        return nullptr;
+    }
+
+    int32_t call(const Function& f, const std::vector<int32_t>& args) {
+        size_t savedBase = callBase;
+        uint32_t savedSp = sp;
+        callBase = scopes.size();
+        scopes.emplace_back();
+        for (size_t i = 0; i < f.params.size(); ++i) {
+            const Param& p = f.params[i];
+            uint32_t at = allocate(4);
+            store(at, 4, args[i]);
+            scopes.back()[p.name] = {at, &p.type, !p.type.arrayDims.empty()};
+        }
+        retval = 0;
+        if (exec(*f.body) != Flow::Return) retval = 0;
+        int32_t v = retval;
+        if (f.retType.base == BaseType::Void && f.retType.pointerLevels == 0) v = 0;
+        scopes.pop_back();
+        callBase = savedBase;
+        sp = savedSp;
+        return v;
+    }
+
+    Flow exec(const Stmt& s) {
+        switch (s.kind) {
+        case NodeKind::ExprStmt: if (auto* e = cast<ExprStmt>(const_cast<Stmt&>(s)).expr) eval(*e); return Flow::Normal;
+        case NodeKind::ReturnStmt: {
+            auto* e = cast<ReturnStmt>(const_cast<Stmt&>(s)).expr;
+            retval = e ? eval(*e) : 0;
+            return Flow::Return;
+        }
+        case NodeKind::BreakStmt: return Flow::Break;
+        case NodeKind::ContinueStmt: return Flow::Continue;
+        case NodeKind::Decl: {
+            auto& d = cast<Decl>(const_cast<Stmt&>(s));
+            int32_t init = d.init ? eval(*d.init) : 0;
+            uint32_t at = allocate(elements(d.varType) * (uint32_t)elemSize(d.varType));
+            if (d.init || d.varType.arrayDims.empty()) store(at, elemSize(d.varType), init);
+            scopes.back()[d.name] = {at, &d.varType, false};
+            return Flow::Normal;
+        }
+        case NodeKind::Block: {
+            uint32_t savedSp = sp;
+            scopes.emplace_back();
+            Flow fl = Flow::Normal;
+            for (auto* it : cast<Block>(const_cast<Stmt&>(s)).items)
+                if ((fl = exec(*it)) != Flow::Normal) break;
+            scopes.pop_back();
+            sp = savedSp;
+            return fl;
+        }
+        case NodeKind::IfStmt: {
+            auto& i = cast<IfStmt>(const_cast<Stmt&>(s));
+            if (eval(*i.cond)) return exec(*i.thenS);
+            return i.elseS ? exec(*i.elseS) : Flow::Normal;
+        }
+        case NodeKind::WhileStmt: {
+            auto& w = cast<WhileStmt>(const_cast<Stmt&>(s));
+            while (eval(*w.cond)) {
+                Flow fl = exec(*w.body);
+                if (fl == Flow::Break) break;
+                if (fl == Flow::Return) return fl;
+            }
+            return Flow::Normal;
+        }
+        case NodeKind::DoWhileStmt: {
+            auto& d = cast<DoWhileStmt>(const_cast<Stmt&>(s));
+            do {
+                Flow fl = exec(*d.body);
+                if (fl == Flow::Break) break;
+                if (fl == Flow::Return) return fl;
+            } while (eval(*d.cond));
+            return Flow::Normal;
+        }
+        case NodeKind::ForStmt: {
+            auto& l = cast<ForStmt>(const_cast<Stmt&>(s));
+            uint32_t savedSp = sp;
+            scopes.emplace_back();
+            Flow out = Flow::Normal;
+            if (l.init) exec(*l.init);
+            while (!l.cond || eval(*l.cond)) {
+                Flow fl = exec(*l.body);
+                if (fl == Flow::Break) break;
+                if (fl == Flow::Return) { out = fl; break; }
+                if (l.step) eval(*l.step);
+            }
+            scopes.pop_back();
+            sp = savedSp;
+            return out;
+        }
+        default: return Flow::Normal;
+        }
+    }
+
+    // Address of an element or of a row.
+    int64_t address(const ArrayIndex& e) {
+        const Expr& b = *e.base;
+        int64_t base;
+        if (!b.type.arrayDims.empty() && b.kind == NodeKind::ArrayIndex) base = address(cast<ArrayIndex>(const_cast<Expr&>(b)));
+        else base = eval(b);
+        int64_t idx = eval(*e.index);
+        return base + idx * elemSize(e.type) * elements(e.type);
+    }
+
+    int32_t eval(const Expr& e) {
+        switch (e.kind) {
+        case NodeKind::IntegerLiteral: return (int32_t)cast<IntegerLiteral>(const_cast<Expr&>(e)).value;
+        case NodeKind::CharLiteral: return cast<CharLiteral>(const_cast<Expr&>(e)).value;
+        case NodeKind::VarRef: {
+            const Var* v = lookup(cast<VarRef>(const_cast<Expr&>(e)).name);
+            if (!v) return 0;
+            if (!v->type->arrayDims.empty() && !v->byAddress) return (int32_t)v->addr; // decays
+            return load(v->addr, v->byAddress ? 4 : elemSize(*v->type));
+        }
+        case NodeKind::ArrayIndex: {
+            auto& a = cast<ArrayIndex>(const_cast<Expr&>(e));
+            int64_t addr = address(a);
+            return e.type.arrayDims.empty() ? load(addr, elemSize(e.type)) : (int32_t)addr;
+        }
+        case NodeKind::UnaryExpr: {
+            auto& u = cast<UnaryExpr>(const_cast<Expr&>(e));
+            switch (u.op) {
+            case UnaryOp::Plus: return eval(*u.operand);
+            case UnaryOp::Minus: return wrap(-(int64_t)eval(*u.operand));
+            case UnaryOp::Not: return eval(*u.operand) == 0;
+            case UnaryOp::BitNot: return ~eval(*u.operand);
+            case UnaryOp::PreInc: case UnaryOp::PreDec: {
+                int n;
+                int64_t addr = lvalue(*u.operand, n);
+                int32_t v = wrap((int64_t)load(addr, n) + (u.op == UnaryOp::PreInc ? 1 : -1));
+                store(addr, n, v);
+                return v;
+            }
+            case UnaryOp::Addr: { int n; return (int32_t)lvalue(*u.operand, n); }
+            case UnaryOp::Deref: return load(eval(*u.operand), 4);
+            }
+            return 0;
+        }
+        case NodeKind::BinaryExpr: {
+            auto& b = cast<BinaryExpr>(const_cast<Expr&>(e));
+            if (b.op == BinaryOp::And) return eval(*b.lhs) && eval(*b.rhs);
+            if (b.op == BinaryOp::Or) return eval(*b.lhs) || eval(*b.rhs);
+            int32_t x = eval(*b.lhs), y = eval(*b.rhs);
+            switch (b.op) {
+            case BinaryOp::Add: return wrap((int64_t)x + y);
+            case BinaryOp::Sub: return wrap((int64_t)x - y);
+            case BinaryOp::Mul: return wrap((int64_t)x * y);
+            case BinaryOp::Div: case BinaryOp::Mod:
+                if (y == 0 || (x == INT32_MIN && y == -1)) throw std::runtime_error("division overflow");
+                return b.op == BinaryOp::Div ? x / y : x % y;
+            case BinaryOp::LT: return x < y;
+            case BinaryOp::GT: return x > y;
+            case BinaryOp::LE: return x <= y;
+            case BinaryOp::GE: return x >= y;
+            case BinaryOp::EQ: return x == y;
+            case BinaryOp::NE: return x != y;
+            case BinaryOp::BitAnd: return x & y;
+            case BinaryOp::BitOr: return x | y;
+            case BinaryOp::BitXor: return x ^ y;
+            case BinaryOp::Shl: return (int32_t)((uint32_t)x << (y & 31));
+            case BinaryOp::Shr: return x >> (y & 31);
+            default: return 0;
+            }
+        }
+        case NodeKind::AssignExpr: {
+            auto& a = cast<AssignExpr>(const_cast<Expr&>(e));
+            int n;
+            int64_t addr = lvalue(*a.lhs, n);
+            int32_t v = eval(*a.rhs);
+            store(addr, n, v);
+            return v;
+        }
+        case NodeKind::CallExpr: {
+            auto& c = cast<CallExpr>(const_cast<Expr&>(e));
+            std::vector<int32_t> args;
+            for (auto* a : c.args) args.push_back(eval(*a));
+            return call(*functions.at(c.callee), args);
+        }
+        default: return 0;
+        }
+    }
+
+    // Address and size of what an assignment writes.
+    int64_t lvalue(const Expr& e, int& size) {
+        size = 4;
+        if (auto* v = dyn_cast<VarRef>(const_cast<Expr*>(&e))) {
+            const Var* var = lookup(v->name);
+            if (!var) throw std::runtime_error("not assignable");
+            size = var->byAddress ? 4 : elemSize(*var->type);
+            return var->addr;
+        }
+        if (auto* a = dyn_cast<ArrayIndex>(const_cast<Expr*>(&e))) { size = elemSize(e.type); return address(*a); }
+        if (auto* u = dyn_cast<UnaryExpr>(const_cast<Expr*>(&e)); u && u->op == UnaryOp::Deref) return eval(*u->operand);
+        throw std::runtime_error("not assignable");
+    }
+};
+
+template <class F>
+double bestOf(int repeats, F&& f) {
+    double best = 1e30;
+    for (int r = 0; r < repeats; ++r) {
+        auto t0 = Clock::now();
+        f();
+        best = std::min(best, std::chrono::duration<double>(Clock::now() - t0).count());
+    }
+    return best;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int repeats = argc > 1 ? std::atoi(argv[1]) : 5;
+    if (repeats < 1) repeats = 1;
+    std::printf("%-10s %12s %12s %12s %8s\n", "kernel", "result", "ast ms", "vm ms", "speedup");
+    int failures = 0;
+    double totalAst = 0, totalVm = 0;
+    for (auto& k : kernels) {
+        Lexer lex(k.source);
+        Parser parser(lex);
+        auto prog = parser.parseProgram();
+        Semantic sem;
+        sem.analyze(*prog);
+        if (!sem.diags.ok()) { std::fprintf(stderr, "%s: semantic errors\n", k.name); return 1; }
+        SymId mainName = intern("main");
+
+        int32_t astResult = 0;
+        double ast = bestOf(repeats, [&] { astResult = TreeWalker(*prog).run(mainName); });
+
+        bc::Module module = bc::compile(*prog);
+        int entry = module.find(mainName);
+        bc::VM::Result vmResult;
+        double vm = bestOf(repeats, [&] { vmResult = bc::VM().run(module, (size_t)entry, {}); });
+
+        if (!vmResult.ok || vmResult.value != astResult) {
+            std::printf("%-10s MISMATCH ast %d, vm %d %s\n", k.name, astResult, vmResult.value, vmResult.error.c_str());
+            ++failures;
+            continue;
+        }
+        std::printf("%-10s %12d %12.2f %12.2f %7.1fx\n", k.name, astResult, ast * 1e3, vm * 1e3, ast / vm);
+        totalAst += ast;
+        totalVm += vm;
+    }
+    if (totalVm > 0) std::printf("%-10s %12s %12.2f %12.2f %7.1fx\n", "total", "", totalAst * 1e3, totalVm * 1e3, totalAst / totalVm);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,261 @@
+#include "synth.h"
+#include <algorithm>
+#include <iterator>
+#include <string_view>
+#include <vector>
+
+namespace cmini::bench {
+
+namespace {
+
+const char* const BinaryOps[] = {"+", "-", "*", "/", "%", "&", "|", "^", "<<", ">>", "<", "==", "&&"};
+
+class Generator {
+public:
+    explicit Generator(const SynthOptions& o) : o(o), rng(o.seed * 0x9e3779b97f4a7c15ull + 1) {
+        unsigned ids = std::max(o.identifiers, 1u);
+        for (unsigned k = 0; k < ids; ++k) {
+            // spellings of varying length, so the lexer and interner see more than v0..v9
+            std::string name(1, (char)('a' + k % 26));
+            for (unsigned rest = k / 26; rest; rest /= 26) name += (char)('a' + rest % 26);
+            names.push_back(name + "_" + std::to_string(k));
+        }
+    }
+
+    SynthProgram run() {
+        SynthProgram p;
+        nodes = 1; // the Program
+        while (o.targetBytes ? out.size() < o.targetBytes : p.functions < o.functions) function(p.functions++);
+        p.source = std::move(out);
+        p.nodes = nodes;
+        return p;
+    }
+
+private:
+    const SynthOptions& o;
+    uint64_t rng;
+    std::vector<std::string> names;
+    std::vector<const std::string*> vars; // locals of the current function
+    std::string out;
+    size_t nodes {0};
+    size_t fn {0};
+    unsigned loopDepth {0};
+
+    uint32_t rand(uint32_t n) {
+        rng ^= rng >> 12; rng ^= rng << 25; rng ^= rng >> 27; // xorshift64*
+        return (uint32_t)((rng * 0x2545f4914f6cdd1dull) >> 32) % n;
+    }
+    const std::string& var() { return *vars[rand((uint32_t)vars.size())]; }
+
+    void literal(uint32_t limit) { out += std::to_string(rand(limit)); ++nodes; }
+    void varRef(const std::string& name) { out += name; ++nodes; }
+
+    // a[i][j]...: one ArrayIndex per dimension, indices kept in bounds
+    void element() {
+        varRef("arr");
+        for (unsigned d = 0; d < o.arrayDims; ++d) {
+            out += '[';
+            if (rand(2)) literal(4);
+            else { out += '('; varRef(var()); out += " & 3)"; nodes += 2; }
+            out += ']';
+            ++nodes;
+        }
+    }
+
+    void expr(unsigned depth) {
+        if (depth == 0 || rand(10) < 3) {
+            uint32_t k = rand(20);
+            if (k < 12) varRef(var());
+            else if (k < 17 || o.arrayDims == 0) literal(100);
+            else element();
+            return;
+        }
+        uint32_t op = rand((uint32_t)std::size(BinaryOps));
+        std::string_view sym = BinaryOps[op];
+        out += '(';
+        expr(depth - 1);
+        out += ' '; out += sym; out += ' ';
+        if (sym == "/" || sym == "%") { out += std::to_string(1 + rand(9)); ++nodes; }
+        else if (sym == "<<" || sym == ">>") literal(8);
+        else expr(depth - 1);
+        out += ')';
+        ++nodes;
+    }
+
+    void statement(unsigned nesting) {
+        out.append(2 * nesting, ' ');
+        unsigned total = o.assignWeight + o.arrayWeight + o.ifWeight + o.loopWeight + o.callWeight;
+        uint32_t pick = total ? rand(total) : 0;
+        enum { Assign, Array, If, Loop, Call } kind = Assign;
+        if (pick < o.assignWeight) kind = Assign;
+        else if ((pick -= o.assignWeight) < o.arrayWeight) kind = Array;
+        else if ((pick -= o.arrayWeight) < o.ifWeight) kind = If;
+        else if ((pick -= o.ifWeight) < o.loopWeight) kind = Loop;
+        else kind = Call;
+        if ((kind == If || kind == Loop) && nesting >= 3) kind = Assign;
+        if (kind == Array && o.arrayDims == 0) kind = Assign;
+        if (kind == Call && fn == 0) kind = Assign;
+
+        switch (kind) {
+        case Assign:
+            varRef(var());
+            out += " = ";
+            expr(o.exprDepth);
+            out += ";\n";
+            nodes += 2; // AssignExpr, ExprStmt
+            return;
+        case Array:
+            element();
+            out += " = ";
+            expr(o.exprDepth);
+            out += ";\n";
+            nodes += 2;
+            return;
+        case Call:
+            varRef(var());
+            out += " = f" + std::to_string(rand((uint32_t)fn)) + "(";
+            expr(o.exprDepth);
+            out += ", ";
+            expr(o.exprDepth);
+            out += ");\n";
+            nodes += 3; // CallExpr, AssignExpr, ExprStmt
+            return;
+        case If:
+            out += "if (";
+            expr(o.exprDepth);
+            out += ") ";
+            nested(nesting);
+            if (rand(2)) { out += " else "; nested(nesting); }
+            out += "\n";
+            ++nodes;
+            return;
+        case Loop: {
+            std::string i = "i";
+            i += std::to_string(loopDepth++);
+            if (rand(2)) {
+                out += "for (int " + i + " = 0; " + i + " < " + std::to_string(2 + rand(14)) + "; " + i + " = " + i +
+                       " + 1) ";
+                nodes += 10; // Decl + literal, LT + ref + literal, Assign + ref, Add + ref + literal
+            } else {
+                // halves a local each time round
+                const std::string& v = var();
+                out += "while (" + v + " > " + std::to_string(rand(50)) + ") ";
+                nodes += 3;
+                out += "{\n";
+                out.append(2 * nesting + 2, ' ');
+                out += v + " = " + v + " / 2;\n";
+                nodes += 6; // ExprStmt, AssignExpr, ref, Div, ref, literal
+                bodyRest(nesting);
+                out += "\n";
+                --loopDepth;
+                ++nodes; // WhileStmt
+                return;
+            }
+            nested(nesting);
+            out += "\n";
+            --loopDepth;
+            ++nodes; // ForStmt
+            return;
+        }
+        }
+    }
+
+    void nested(unsigned nesting) {
+        out += "{\n";
+        bodyRest(nesting);
+    }
+
+    // the statements and closing brace of a nested block whose "{" is out
+    void bodyRest(unsigned nesting) {
+        ++nodes; // Block
+        unsigned count = 1 + rand(3);
+        for (unsigned i = 0; i < count; ++i) statement(nesting + 1);
+        out.append(2 * nesting, ' ');
+        out += "}";
+    }
+
+    void function(size_t index) {
+        fn = index;
+        ++nodes; // Function
+        out += "int f" + std::to_string(index) + "(int p0, int p1) {\n";
+        ++nodes; // Block
+        vars.clear();
+        unsigned locals = std::clamp(o.locals, 1u, (unsigned)names.size());
+        for (unsigned k = 0; k < locals; ++k) {
+            const std::string& name = names[(index * locals + k) % names.size()];
+            vars.push_back(&name);
+            out += "  int " + name + " = p" + std::to_string(k % 2) + " + " + std::to_string(k) + ";\n";
+            nodes += 4; // Decl, Add, ref, literal
+        }
+        if (o.arrayDims) {
+            out += "  int arr";
+            for (unsigned d = 0; d < o.arrayDims; ++d) out += "[4]";
+            out += ";\n";
+            ++nodes;
+        }
+        for (unsigned i = 0; i < o.statements; ++i) statement(1);
+        out += "  return ";
+        varRef(var());
+        out += ";\n}\n";
+        ++nodes; // ReturnStmt
+    }
+};
+
+} // namespace
+
+bool parseSize(const std::string& s, uint64_t& v) {
+    if (s.empty() || s.find_first_not_of("0123456789") < s.size() - 1) return false;
+    uint64_t scale = 1;
+    std::string digits = s;
+    switch (s.back()) {
+    case 'K': case 'k': scale = 1ull << 10; digits.pop_back(); break;
+    case 'M': case 'm': scale = 1ull << 20; digits.pop_back(); break;
+    case 'G': case 'g': scale = 1ull << 30; digits.pop_back(); break;
+    default: if (s.back() < '0' || s.back() > '9') return false;
+    }
+    if (digits.empty() || digits.size() > 12) return false;
+    v = std::stoull(digits) * scale;
+    return true;
+}
+
+const char* const synthHelp =
+    "  functions=N  size=BYTES (overrides functions)  stmts=N  depth=N  idents=N  locals=N  dims=N  seed=N\n"
+    "  mix=ASSIGN,ARRAY,IF,LOOP,CALL  relative statement weights, e.g. mix=6,3,2,2,1\n";
+
+SynthProgram generate(const SynthOptions& o) { return Generator(o).run(); }
+
+bool setSynthOption(SynthOptions& o, const std::string& arg, std::string& error) {
+    size_t eq = arg.find('=');
+    std::string key = arg.substr(0, eq), value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+    if (key == "mix") {
+        unsigned* weights[] = {&o.assignWeight, &o.arrayWeight, &o.ifWeight, &o.loopWeight, &o.callWeight};
+        size_t at = 0;
+        for (unsigned* w : weights) {
+            size_t comma = value.find(',', at);
+            uint64_t v;
+            if (!parseSize(value.substr(at, comma - at), v) || v > 1000) { error = "invalid mix: " + value; return false; }
+            *w = (unsigned)v;
+            if (comma == std::string::npos) {
+                if (w != weights[4]) { error = "mix takes five weights: " + value; return false; }
+                return true;
+            }
+            at = comma + 1;
+        }
+        error = "mix takes five weights: " + value;
+        return false;
+    }
+    uint64_t v;
+    if (!parseSize(value, v)) { error = "invalid option: " + arg; return false; }
+    if (key == "functions") { o.functions = v; o.targetBytes = 0; }
+    else if (key == "size") o.targetBytes = v;
+    else if (key == "stmts") o.statements = (unsigned)v;
+    else if (key == "depth" && v <= 16) o.exprDepth = (unsigned)v;
+    else if (key == "idents" && v > 0) o.identifiers = (unsigned)v;
+    else if (key == "locals" && v > 0) o.locals = (unsigned)v;
+    else if (key == "dims" && v <= 8) o.arrayDims = (unsigned)v;
+    else if (key == "seed") o.seed = v;
+    else { error = "invalid option: " + arg; return false; }
+    return true;
+}
+
+} // namespace cmini::bench
@@ -0,0 +1,42 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace cmini::bench {
+
+// Scalable synthetic cmini programs for the throughput benchmarks. Every
+// function declares its locals (and optionally one array) up front, then
+// runs a random mix of statements over them; everything generated passes
+// Semantic, so the whole pipeline can be timed on it. Same options, same
+// program.
+struct SynthOptions {
+    size_t functions {1000};
+    size_t targetBytes {0};   // when set, functions are added until the source is at least this long
+    unsigned statements {16}; // per function body, not counting nested ones
+    // relative weights of the statement kinds
+    unsigned assignWeight {6}, arrayWeight {3}, ifWeight {2}, loopWeight {2}, callWeight {1};
+    unsigned exprDepth {3};    // deepest nesting of binary operators
+    unsigned identifiers {64}; // distinct variable spellings across the program
+    unsigned locals {8};       // variables per function, taken from the identifiers in turn
+    unsigned arrayDims {2};    // of each function's array, 4 elements per dimension; 0 = no arrays
+    uint64_t seed {1};
+};
+
+struct SynthProgram {
+    std::string source;
+    size_t functions {0};
+    size_t nodes {0}; // AST nodes the parser builds, counted as walk() visits them plus functions and the program
+};
+
+SynthProgram generate(const SynthOptions& o);
+
+// Applies one key=value argument (see synthHelp). False, with a message in
+// error, for anything else.
+bool setSynthOption(SynthOptions& o, const std::string& arg, std::string& error);
+extern const char* const synthHelp;
+
+// A count with an optional K, M or G suffix (powers of 1024).
+bool parseSize(const std::string& s, uint64_t& v);
+
+} // namespace cmini::bench
@@ -0,0 +1,69 @@
+; ModuleID = 'cmini'
+source_filename = "cmini"
+
+define i32 @classify(i32 %x) {
+entry:
+  %t1 = srem i32 %x, 97
+  %t2 = icmp eq i32 %t1, 0
+  br i1 %t2, label %if.then1, label %if.end2
+
+if.then1:
+  ret i32 3
+
+if.end2:
+  %t3 = srem i32 %x, 2
+  %t4 = icmp eq i32 %t3, 0
+  br i1 %t4, label %if.then3, label %if.end4
+
+if.then3:
+  ret i32 1
+
+if.end4:
+  ret i32 2
+}
+
+define i32 @check(i32 %n) {
+entry:
+  %t1 = icmp slt i32 %n, 0
+  br i1 %t1, label %if.then1, label %if.end2
+
+if.then1:
+  %t2 = sub i32 0, 1
+  ret i32 %t2
+
+if.end2:
+  ret i32 %n
+}
+
+define i32 @main() {
+entry:
+  br label %loop.cond1
+
+loop.cond1:
+  %t1 = phi i32 [0, %entry], [%t5, %loop.step3]
+  %t2 = phi i32 [0, %entry], [%t6, %loop.step3]
+  %t3 = icmp slt i32 %t2, 100000
+  br i1 %t3, label %loop.body2, label %loop.end4
+
+loop.body2:
+  %t4 = call i32 @classify(i32 %t2)
+  %t5 = add i32 %t1, %t4
+  br label %loop.step3
+
+loop.step3:
+  %t6 = add i32 %t2, 1
+  br label %loop.cond1
+
+loop.end4:
+  %t7 = call i32 @check(i32 %t1)
+  %t8 = icmp slt i32 %t7, 0
+  br i1 %t8, label %if.then5, label %if.end6
+
+if.then5:
+  ret i32 1
+
+if.end6:
+  %t9 = srem i32 %t1, 256
+  ret i32 %t9
+}
+
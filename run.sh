@@ -16,10 +16,15 @@ if [[ $# -lt 1 ]]; then
   exit 1
 fi
 
+# One cmini process compiles every input (each x.cmini -> x.ll) in parallel.
+if [[ $# -eq 1 ]]; then
+  "$BIN" "$1" -o "${1%.*}.ll"
+else
+  "$BIN" "$@" -j 0 --summary
+fi
+
 for f in "$@"; do
   out="${f%.*}.ll"
-  "$BIN" "$f" -o "$out"
-  echo "OK: $f -> $out"
   if command -v llc >/dev/null 2>&1; then
     llc -filetype=obj "$out" -o "${f%.*}.o" || true
   fi
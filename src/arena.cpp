@@ -0,0 +1,65 @@
+#include "arena.h"
+#include <cstdint>
+#include <cstdlib>
+#include <mutex>
+#include "timereport.h"
+
+namespace cmini {
+
+// Standard-size blocks released by dead arenas are parked here and handed
+// to the next arena, so a long-lived process (batch or server mode) stops
+// going back to malloc once it is warm. Bounded to keep idle memory small.
+namespace {
+struct BlockCache {
+    static constexpr size_t MaxBlocks = 256;
+    std::mutex mu;
+    std::vector<void*> free;
+    void* take() {
+        std::lock_guard lk(mu);
+        if (free.empty()) return nullptr;
+        void* b = free.back(); free.pop_back();
+        return b;
+    }
+    bool give(void* b) {
+        std::lock_guard lk(mu);
+        if (free.size() >= MaxBlocks) return false;
+        free.push_back(b);
+        return true;
+    }
+};
+// never destroyed: arenas with static storage may die after it would
+BlockCache& blockCache() { static BlockCache* c = new BlockCache; return *c; }
+}
+
+Arena::~Arena() {
+    for (auto it = dtors.rbegin(); it != dtors.rend(); ++it) it->fn(it->obj);
+    for (auto& b : blocks)
+        if (b.size != BlockSize || !blockCache().give(b.ptr)) std::free(b.ptr);
+}
+
+void Arena::newBlock(size_t minSize) {
+    size_t size = minSize > BlockSize ? minSize : BlockSize;
+    void* b = size == BlockSize ? blockCache().take() : nullptr;
+    if (!b) {
+        b = std::malloc(size);
+        if (!b) throw std::bad_alloc();
+        TimeReport::noteAllocation(size);
+    }
+    blocks.push_back({b, size});
+    reserved += size;
+    cur = static_cast<char*>(b);
+    end = cur + size;
+}
+
+void* Arena::allocate(size_t size, size_t align) {
+    uintptr_t p = (reinterpret_cast<uintptr_t>(cur) + align - 1) & ~(uintptr_t)(align - 1);
+    if (!cur || p + size > reinterpret_cast<uintptr_t>(end)) {
+        newBlock(size + align);
+        p = (reinterpret_cast<uintptr_t>(cur) + align - 1) & ~(uintptr_t)(align - 1);
+    }
+    cur = reinterpret_cast<char*>(p + size);
+    used += size;
+    return reinterpret_cast<void*>(p);
+}
+
+} // namespace cmini
@@ -0,0 +1,64 @@
+#pragma once
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace cmini {
+
+// Bump allocator that owns every AST node of one translation unit.
+// Nodes hold plain non-owning pointers to each other; the whole arena is
+// released at once. Objects with non-trivial destructors are recorded and
+// destroyed (in reverse order) just before the blocks are freed.
+class Arena {
+public:
+    Arena() = default;
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+    ~Arena();
+
+    template <class T, class... Args>
+    T* make(Args&&... args) {
+        void* mem = allocate(sizeof(T), alignof(T));
+        T* obj = ::new (mem) T(std::forward<Args>(args)...);
+        if constexpr (!std::is_trivially_destructible_v<T>)
+            dtors.push_back({obj, [](void* p) { static_cast<T*>(p)->~T(); }});
+        ++objects;
+        return obj;
+    }
+
+    // Copies n values that need no destructor, e.g. array sizes.
+    template <class T>
+    T* copy(const T* src, size_t n) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        if (n == 0) return nullptr;
+        T* dst = static_cast<T*>(allocate(n * sizeof(T), alignof(T)));
+        std::memcpy(dst, src, n * sizeof(T));
+        return dst;
+    }
+
+    void* allocate(size_t size, size_t align);
+
+    size_t bytesUsed() const { return used; }         // payload handed out
+    size_t bytesReserved() const { return reserved; } // blocks obtained from malloc
+    size_t objectCount() const { return objects; }
+
+private:
+    struct Dtor { void* obj; void (*fn)(void*); };
+    static constexpr size_t BlockSize = 64 * 1024;
+
+    void newBlock(size_t minSize);
+
+    struct BlockRef { void* ptr; size_t size; };
+    std::vector<BlockRef> blocks;
+    std::vector<Dtor> dtors;
+    char* cur {nullptr};
+    char* end {nullptr};
+    size_t used {0};
+    size_t reserved {0};
+    size_t objects {0};
+};
+
+} // namespace cmini
@@ -19,13 +19,24 @@ std::string Type::toString() const {
     return os.str();
 }
 
-Symbol* Scope::lookupLocal(const std::string& n) {
+const char* kindName(NodeKind k) {
+    static const char* const names[] = {
+        "IntegerLiteral", "CharLiteral", "StringLiteral", "VarRef", "ArrayIndex",
+        "UnaryExpr", "BinaryExpr", "AssignExpr", "CallExpr",
+        "Decl", "ExprStmt", "ReturnStmt", "BreakStmt", "ContinueStmt", "Block",
+        "IfStmt", "WhileStmt", "DoWhileStmt", "ForStmt",
+        "Function", "Program",
+    };
+    return names[(size_t)k];
+}
+
+Symbol* Scope::lookupLocal(SymId n) {
     auto it = table.find(n);
     if (it == table.end()) return nullptr;
     return &it->second;
 }
 
-Symbol* Scope::lookup(const std::string& n) {
+Symbol* Scope::lookup(SymId n) {
     for (Scope* s = this; s != nullptr; s = s->parent) {
         auto it = s->table.find(n);
         if (it != s->table.end()) return &it->second;
@@ -33,8 +44,40 @@ Symbol* Scope::lookup(const std::string& n) {
     return nullptr;
 }
 
-void Scope::insert(const std::string& n, const Symbol& s) {
+void Scope::insert(SymId n, const Symbol& s) {
     table[n] = s;
 }
 
+std::vector<std::vector<size_t>> callGraph(const Program& p) {
+    std::unordered_map<SymId, size_t> index;
+    for (size_t i = 0; i < p.functions.size(); ++i) index[p.functions[i]->name] = i;
+    std::vector<std::vector<size_t>> calls(p.functions.size());
+    std::vector<size_t> lastCaller(p.functions.size(), ~size_t(0));
+    for (size_t i = 0; i < p.functions.size(); ++i) {
+        walk(p.functions[i]->body, [&](Node* n) {
+            auto* c = dyn_cast<CallExpr>(n);
+            if (!c) return;
+            auto it = index.find(c->callee);
+            if (it == index.end() || lastCaller[it->second] == i) return;
+            lastCaller[it->second] = i;
+            calls[i].push_back(it->second);
+        });
+    }
+    return calls;
+}
+
+std::vector<bool> reachableCallees(const std::vector<std::vector<size_t>>& calls, const std::vector<bool>& from) {
+    std::vector<bool> seen(calls.size(), false);
+    std::vector<size_t> work;
+    for (size_t i = 0; i < calls.size(); ++i)
+        if (from[i]) work.push_back(i);
+    while (!work.empty()) {
+        size_t i = work.back();
+        work.pop_back();
+        for (size_t c : calls[i])
+            if (!seen[c]) { seen[c] = true; work.push_back(c); }
+    }
+    return seen;
+}
+
 } // namespace cmini
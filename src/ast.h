@@ -1,11 +1,15 @@
 #pragma once
+#include <algorithm>
 #include <string>
 #include <vector>
 #include <memory>
 #include <optional>
 #include <unordered_map>
+#include "arena.h"
+#include "intern.h"
 
-// A small C-like AST and symbol table
+// A small C-like AST and symbol table. All nodes live in the owning
+// Program's arena; child pointers are non-owning.
 
 namespace cmini {
 
@@ -13,12 +17,27 @@ enum class BaseType { Void, Int, Char, Float };
 
 enum class NamedKind { None, Enum, Union };
 
+// Array sizes outermost-first, stored in the Program's arena so that Type,
+// and with it every Expr and Decl, stays trivially destructible.
+struct ArrayDims {
+    const size_t* data {nullptr};
+    size_t count {0};
+
+    bool empty() const { return count == 0; }
+    size_t size() const { return count; }
+    size_t operator[](size_t i) const { return data[i]; }
+    const size_t* begin() const { return data; }
+    const size_t* end() const { return data + count; }
+    ArrayDims inner() const { return {data + 1, count - 1}; } // the element type's, after one index
+    bool operator==(const ArrayDims& o) const { return std::equal(begin(), end(), o.begin(), o.end()); }
+};
+
 struct Type {
     BaseType base {BaseType::Int};
     int pointerLevels {0};
-    std::vector<size_t> arrayDims; // multi-dimensional array sizes outermost-first
+    ArrayDims arrayDims;
     NamedKind namedKind {NamedKind::None};
-    std::string namedTag; // enum/union tag name if any
+    SymId namedTag {0}; // enum/union tag name if any
 
     static Type voidTy();
     static Type intTy();
@@ -26,50 +45,82 @@ struct Type {
     std::string toString() const;
 };
 
+// Tag stored in every node; passes switch on it instead of probing with
+// dynamic_cast. Keep expressions and statements in contiguous ranges.
+enum class NodeKind : unsigned char {
+    // expressions
+    IntegerLiteral, CharLiteral, StringLiteral, VarRef, ArrayIndex,
+    UnaryExpr, BinaryExpr, AssignExpr, CallExpr,
+    // statements
+    Decl, ExprStmt, ReturnStmt, BreakStmt, ContinueStmt, Block,
+    IfStmt, WhileStmt, DoWhileStmt, ForStmt,
+    // top level
+    Function, Program
+};
+
+// Spelling of a kind, e.g. "BinaryExpr".
+const char* kindName(NodeKind k);
+
+// Nodes are owned by an Arena which destroys them through their concrete
+// type, so there is no virtual destructor (and no vtable) here.
 struct Node {
-    virtual ~Node() = default;
+    NodeKind kind;
+    explicit Node(NodeKind k) : kind(k) {}
 };
 
 struct Expr : Node {
     Type type; // inferred during semantic analysis
+    explicit Expr(NodeKind k) : Node(k) {}
+};
+
+struct Stmt : Node {
+    explicit Stmt(NodeKind k) : Node(k) {}
 };
 
-struct Stmt : Node {};
+// Checked downcasts keyed on Node::kind.
+template <class T> T* dyn_cast(Node* n) { return n && n->kind == T::Kind ? static_cast<T*>(n) : nullptr; }
+template <class T> T& cast(Node& n) { return static_cast<T&>(n); }
 
 // Expressions
 struct IntegerLiteral : Expr {
+    static constexpr NodeKind Kind = NodeKind::IntegerLiteral;
     long value {0};
-    explicit IntegerLiteral(long v) : value(v) {}
+    explicit IntegerLiteral(long v) : Expr(Kind), value(v) {}
 };
 
 struct CharLiteral : Expr {
+    static constexpr NodeKind Kind = NodeKind::CharLiteral;
     char value {0};
-    explicit CharLiteral(char v) : value(v) {}
+    explicit CharLiteral(char v) : Expr(Kind), value(v) {}
 };
 
 struct StringLiteral : Expr {
+    static constexpr NodeKind Kind = NodeKind::StringLiteral;
     std::string value;
-    explicit StringLiteral(std::string v) : value(std::move(v)) {}
+    explicit StringLiteral(std::string v) : Expr(Kind), value(std::move(v)) {}
 };
 
 struct VarRef : Expr {
-    std::string name;
-    explicit VarRef(std::string n) : name(std::move(n)) {}
+    static constexpr NodeKind Kind = NodeKind::VarRef;
+    SymId name;
+    explicit VarRef(SymId n) : Expr(Kind), name(n) {}
 };
 
 struct ArrayIndex : Expr {
-    std::unique_ptr<Expr> base;
-    std::unique_ptr<Expr> index;
-    ArrayIndex(std::unique_ptr<Expr> b, std::unique_ptr<Expr> i)
-        : base(std::move(b)), index(std::move(i)) {}
+    static constexpr NodeKind Kind = NodeKind::ArrayIndex;
+    Expr* base;
+    Expr* index;
+    ArrayIndex(Expr* b, Expr* i)
+        : Expr(Kind), base(b), index(i) {}
 };
 
 enum class UnaryOp { Plus, Minus, Not, BitNot, PreInc, PreDec, Addr, Deref };
 struct UnaryExpr : Expr {
+    static constexpr NodeKind Kind = NodeKind::UnaryExpr;
     UnaryOp op;
-    std::unique_ptr<Expr> operand;
-    UnaryExpr(UnaryOp o, std::unique_ptr<Expr> e)
-        : op(o), operand(std::move(e)) {}
+    Expr* operand;
+    UnaryExpr(UnaryOp o, Expr* e)
+        : Expr(Kind), op(o), operand(e) {}
 };
 
 enum class BinaryOp {
@@ -79,82 +130,137 @@ enum class BinaryOp {
     Shl, Shr
 };
 struct BinaryExpr : Expr {
+    static constexpr NodeKind Kind = NodeKind::BinaryExpr;
     BinaryOp op;
-    std::unique_ptr<Expr> lhs;
-    std::unique_ptr<Expr> rhs;
-    BinaryExpr(BinaryOp o, std::unique_ptr<Expr> l, std::unique_ptr<Expr> r)
-        : op(o), lhs(std::move(l)), rhs(std::move(r)) {}
+    Expr* lhs;
+    Expr* rhs;
+    BinaryExpr(BinaryOp o, Expr* l, Expr* r)
+        : Expr(Kind), op(o), lhs(l), rhs(r) {}
 };
 
 struct AssignExpr : Expr {
-    std::unique_ptr<Expr> lhs;
-    std::unique_ptr<Expr> rhs;
-    AssignExpr(std::unique_ptr<Expr> l, std::unique_ptr<Expr> r)
-        : lhs(std::move(l)), rhs(std::move(r)) {}
+    static constexpr NodeKind Kind = NodeKind::AssignExpr;
+    Expr* lhs;
+    Expr* rhs;
+    AssignExpr(Expr* l, Expr* r)
+        : Expr(Kind), lhs(l), rhs(r) {}
 };
 
 struct CallExpr : Expr {
-    std::string callee;
-    std::vector<std::unique_ptr<Expr>> args;
-    explicit CallExpr(std::string c) : callee(std::move(c)) {}
+    static constexpr NodeKind Kind = NodeKind::CallExpr;
+    SymId callee;
+    std::vector<Expr*> args;
+    explicit CallExpr(SymId c) : Expr(Kind), callee(c) {}
 };
 
 // Statements
 struct Decl : Stmt {
+    static constexpr NodeKind Kind = NodeKind::Decl;
     Type varType;
-    std::string name;
-    std::unique_ptr<Expr> init; // optional, may be null
-    Decl(Type t, std::string n) : varType(t), name(std::move(n)) {}
+    SymId name;
+    Expr* init {nullptr}; // optional, may be null
+    Decl(Type t, SymId n) : Stmt(Kind), varType(t), name(n) {}
 };
 
-struct ExprStmt : Stmt { std::unique_ptr<Expr> expr; explicit ExprStmt(std::unique_ptr<Expr> e) : expr(std::move(e)) {} };
+// The arena skips its destructor list for these; only nodes holding a
+// string or a vector (string literals, calls, blocks, functions) need it.
+static_assert(std::is_trivially_destructible_v<BinaryExpr> && std::is_trivially_destructible_v<Decl>);
 
-struct ReturnStmt : Stmt { std::unique_ptr<Expr> expr; };
+struct ExprStmt : Stmt {
+    static constexpr NodeKind Kind = NodeKind::ExprStmt;
+    Expr* expr;
+    explicit ExprStmt(Expr* e) : Stmt(Kind), expr(e) {}
+};
+
+struct ReturnStmt : Stmt {
+    static constexpr NodeKind Kind = NodeKind::ReturnStmt;
+    Expr* expr {nullptr};
+    ReturnStmt() : Stmt(Kind) {}
+};
 
-struct BreakStmt : Stmt {};
-struct ContinueStmt : Stmt {};
+struct BreakStmt : Stmt { static constexpr NodeKind Kind = NodeKind::BreakStmt; BreakStmt() : Stmt(Kind) {} };
+struct ContinueStmt : Stmt { static constexpr NodeKind Kind = NodeKind::ContinueStmt; ContinueStmt() : Stmt(Kind) {} };
 
-struct Block : Stmt { std::vector<std::unique_ptr<Stmt>> items; };
+struct Block : Stmt {
+    static constexpr NodeKind Kind = NodeKind::Block;
+    std::vector<Stmt*> items;
+    Block() : Stmt(Kind) {}
+};
 
 struct IfStmt : Stmt {
-    std::unique_ptr<Expr> cond;
-    std::unique_ptr<Stmt> thenS;
-    std::unique_ptr<Stmt> elseS; // may be null
+    static constexpr NodeKind Kind = NodeKind::IfStmt;
+    Expr* cond {nullptr};
+    Stmt* thenS {nullptr};
+    Stmt* elseS {nullptr}; // may be null
+    IfStmt() : Stmt(Kind) {}
 };
 
 struct WhileStmt : Stmt {
-    std::unique_ptr<Expr> cond;
-    std::unique_ptr<Stmt> body;
+    static constexpr NodeKind Kind = NodeKind::WhileStmt;
+    Expr* cond {nullptr};
+    Stmt* body {nullptr};
+    WhileStmt() : Stmt(Kind) {}
 };
 
 struct DoWhileStmt : Stmt {
-    std::unique_ptr<Stmt> body;
-    std::unique_ptr<Expr> cond;
+    static constexpr NodeKind Kind = NodeKind::DoWhileStmt;
+    Stmt* body {nullptr};
+    Expr* cond {nullptr};
+    DoWhileStmt() : Stmt(Kind) {}
 };
 
 struct ForStmt : Stmt {
-    std::unique_ptr<Stmt> init; // decl or expr or null
-    std::unique_ptr<Expr> cond; // may be null
-    std::unique_ptr<Expr> step; // may be null
-    std::unique_ptr<Stmt> body;
+    static constexpr NodeKind Kind = NodeKind::ForStmt;
+    Stmt* init {nullptr}; // decl or expr or null
+    Expr* cond {nullptr}; // may be null
+    Expr* step {nullptr}; // may be null
+    Stmt* body {nullptr};
+    ForStmt() : Stmt(Kind) {}
 };
 
 struct Param {
     Type type;
-    std::string name;
+    SymId name {0};
 };
 
 struct Function : Node {
+    static constexpr NodeKind Kind = NodeKind::Function;
     Type retType;
-    std::string name;
+    SymId name {0};
     std::vector<Param> params;
-    std::unique_ptr<Block> body; // null for declaration
+    Block* body {nullptr}; // null for declaration
+    Function() : Node(Kind) {}
 };
 
 struct Program : Node {
-    std::vector<std::unique_ptr<Function>> functions;
+    static constexpr NodeKind Kind = NodeKind::Program;
+    Arena arena; // declared first so it outlives the node pointers below
+    std::vector<Function*> functions;
+    Program() : Node(Kind) {}
 };
 
+// Calls f on n and then on every node below it, in source order.
+template <class F> void walk(Node* n, const F& f) {
+    if (!n) return;
+    f(n);
+    switch (n->kind) {
+    case NodeKind::ArrayIndex: walk(cast<ArrayIndex>(*n).base, f); walk(cast<ArrayIndex>(*n).index, f); return;
+    case NodeKind::UnaryExpr: walk(cast<UnaryExpr>(*n).operand, f); return;
+    case NodeKind::BinaryExpr: walk(cast<BinaryExpr>(*n).lhs, f); walk(cast<BinaryExpr>(*n).rhs, f); return;
+    case NodeKind::AssignExpr: walk(cast<AssignExpr>(*n).lhs, f); walk(cast<AssignExpr>(*n).rhs, f); return;
+    case NodeKind::CallExpr: for (auto* a : cast<CallExpr>(*n).args) walk(a, f); return;
+    case NodeKind::Decl: walk(cast<Decl>(*n).init, f); return;
+    case NodeKind::ExprStmt: walk(cast<ExprStmt>(*n).expr, f); return;
+    case NodeKind::ReturnStmt: walk(cast<ReturnStmt>(*n).expr, f); return;
+    case NodeKind::Block: for (auto* s : cast<Block>(*n).items) walk(s, f); return;
+    case NodeKind::IfStmt: { auto& i = cast<IfStmt>(*n); walk(i.cond, f); walk(i.thenS, f); walk(i.elseS, f); return; }
+    case NodeKind::WhileStmt: walk(cast<WhileStmt>(*n).cond, f); walk(cast<WhileStmt>(*n).body, f); return;
+    case NodeKind::DoWhileStmt: walk(cast<DoWhileStmt>(*n).body, f); walk(cast<DoWhileStmt>(*n).cond, f); return;
+    case NodeKind::ForStmt: { auto& l = cast<ForStmt>(*n); walk(l.init, f); walk(l.cond, f); walk(l.step, f); walk(l.body, f); return; }
+    default: return;
+    }
+}
+
 // Semantic structures
 struct Symbol {
     Type type;
@@ -163,12 +269,19 @@ struct Symbol {
 };
 
 struct Scope {
-    std::unordered_map<std::string, Symbol> table;
+    std::unordered_map<SymId, Symbol> table;
     Scope* parent {nullptr};
     explicit Scope(Scope* p=nullptr): parent(p) {}
-    Symbol* lookupLocal(const std::string& n);
-    Symbol* lookup(const std::string& n);
-    void insert(const std::string& n, const Symbol& s);
+    Symbol* lookupLocal(SymId n);
+    Symbol* lookup(SymId n);
+    void insert(SymId n, const Symbol& s);
 };
 
+// Call graph: for each function, the indices of the functions it calls,
+// once each in order of first call. A name resolves to its last
+// definition, as in Semantic's global scope.
+std::vector<std::vector<size_t>> callGraph(const Program& p);
+// Functions reached through one or more calls from those marked in `from`.
+std::vector<bool> reachableCallees(const std::vector<std::vector<size_t>>& calls, const std::vector<bool>& from);
+
 } // namespace cmini
@@ -0,0 +1,642 @@
+#include "bytecode.h"
+#include <algorithm>
+#include <unordered_map>
+
+namespace cmini::bc {
+
+const char* opName(Op op) {
+    static const char* const names[] = {
+#define CMINI_BC_NAME(name) #name,
+        CMINI_BC_OPS(CMINI_BC_NAME)
+#undef CMINI_BC_NAME
+    };
+    return names[(size_t)op];
+}
+
+int Module::find(SymId name) const {
+    for (size_t i = functions.size(); i-- > 0;)
+        if (functions[i].name == name) return (int)i;
+    return -1;
+}
+
+namespace {
+
+// Bytes per element of t (ignoring its array dimensions); pointers are
+// 32-bit offsets here.
+int32_t elemSize(const Type& t) { return t.pointerLevels == 0 && t.base == BaseType::Char ? 1 : 4; }
+
+size_t elements(ArrayDims dims) {
+    size_t n = 1;
+    for (size_t d : dims) n *= d;
+    return n;
+}
+
+// Whether evaluating e may assign a variable, which an operand evaluated
+// before it must not observe.
+bool hasEffects(Expr* e) {
+    bool found = false;
+    walk(e, [&](Node* n) {
+        if (n->kind == NodeKind::AssignExpr) found = true;
+        else if (auto* u = dyn_cast<UnaryExpr>(n); u && (u->op == UnaryOp::PreInc || u->op == UnaryOp::PreDec)) found = true;
+    });
+    return found;
+}
+
+bool constant(Expr& e, int32_t& k) {
+    if (auto* i = dyn_cast<IntegerLiteral>(&e)) { k = (int32_t)i->value; return true; }
+    if (auto* c = dyn_cast<CharLiteral>(&e)) { k = c->value; return true; }
+    return false;
+}
+
+// Comparison ops in one order, so that the Lt..Ne, LtK..NeK, JLt..JNe and
+// JLtK..JNeK families can be indexed alike.
+enum Cmp { Lt, Le, Gt, Ge, Eq, Ne };
+
+bool comparison(BinaryOp op, Cmp& c) {
+    switch (op) {
+    case BinaryOp::LT: c = Lt; return true; case BinaryOp::LE: c = Le; return true;
+    case BinaryOp::GT: c = Gt; return true; case BinaryOp::GE: c = Ge; return true;
+    case BinaryOp::EQ: c = Eq; return true; case BinaryOp::NE: c = Ne; return true;
+    default: return false;
+    }
+}
+
+Cmp inverse(Cmp c) { static const Cmp t[] = {Ge, Gt, Le, Lt, Ne, Eq}; return t[c]; }
+Cmp mirror(Cmp c) { static const Cmp t[] = {Gt, Ge, Lt, Le, Eq, Ne}; return t[c]; }
+Op plus(Op base, int n) { return (Op)((int)base + n); }
+
+struct Var {
+    enum Kind { Reg, Frame } kind;
+    int32_t at; // register, or frame offset
+    Type type;
+};
+
+// Where an indexed element lives: a frame offset or a base register, plus
+// a flattened element index that is a constant or a register.
+struct Path {
+    bool frame {false};
+    int32_t base {0};
+    int32_t limit {0}; // bytes of a frame array
+    bool constIdx {true};
+    int64_t k {0};
+    int32_t idx {0};
+    int32_t size {4}; // stride
+};
+
+class Compiler {
+public:
+    Compiler(const std::unordered_map<SymId, int>& index, Function& out) : index(index), out(out) {}
+
+    void function(const cmini::Function& f) {
+        out.name = f.name;
+        out.params = (uint32_t)f.params.size();
+        isVoid = f.retType.base == BaseType::Void && f.retType.pointerLevels == 0;
+        walk(f.body, [&](Node* n) {
+            if (auto* u = dyn_cast<UnaryExpr>(n); u && u->op == UnaryOp::Addr)
+                if (auto* v = dyn_cast<VarRef>(u->operand)) addrTaken.push_back(v->name);
+        });
+        vars = top = (int32_t)f.params.size();
+        note();
+        pushScope();
+        for (size_t i = 0; i < f.params.size(); ++i) {
+            const Param& p = f.params[i];
+            // an array parameter is a pointer, kept in its register even
+            // when its address is taken
+            if (!taken(p.name) || !p.type.arrayDims.empty()) {
+                scopes.back()[p.name] = {Var::Reg, (int32_t)i, p.type};
+                continue;
+            }
+            int32_t off = slot(4);
+            emit(Op::SetF4, off, (int32_t)i);
+            scopes.back()[p.name] = {Var::Frame, off, p.type};
+        }
+        if (f.body) stmt(*f.body);
+        popScope();
+        int32_t zero = temp(); // falling off the end
+        emit(Op::Const, zero, 0);
+        emit(Op::Ret, zero);
+        for (auto& l : labels)
+            for (size_t use : l.uses) out.code[use].c = l.at;
+    }
+
+private:
+    const std::unordered_map<SymId, int>& index;
+    Function& out;
+    std::vector<std::unordered_map<SymId, Var>> scopes;
+    std::vector<int32_t> scopeVars;
+    std::vector<SymId> addrTaken;
+    int32_t vars {0}; // registers below this hold variables
+    int32_t top {0};  // first free register
+    bool isVoid {false};
+    struct Label { int32_t at {-1}; std::vector<size_t> uses; };
+    std::vector<Label> labels;
+    struct Loop { int cont, exit; };
+    std::vector<Loop> loops;
+
+    void emit(Op op, int32_t a = 0, int32_t b = 0, int32_t c = 0) { out.code.push_back({op, a, b, c}); }
+    void note() { out.registers = std::max(out.registers, (uint32_t)top); }
+    int32_t temp() { int32_t r = top++; note(); return r; }
+    int32_t dest(int32_t want) { return want >= 0 ? want : temp(); }
+
+    int label() { labels.emplace_back(); return (int)labels.size() - 1; }
+    void bind(int l) { labels[l].at = (int32_t)out.code.size(); }
+    void jump(Op op, int l, int32_t a = 0, int32_t b = 0) { // the target goes into c
+        labels[l].uses.push_back(out.code.size());
+        emit(op, a, b);
+    }
+
+    int32_t slot(size_t bytes) {
+        int32_t off = (int32_t)((out.frameBytes + 3) & ~3u);
+        out.frameBytes = off + (uint32_t)std::max<size_t>(bytes, 1);
+        return off;
+    }
+
+    bool taken(SymId name) const { return std::find(addrTaken.begin(), addrTaken.end(), name) != addrTaken.end(); }
+
+    void pushScope() { scopes.emplace_back(); scopeVars.push_back(vars); }
+    void popScope() {
+        scopes.pop_back();
+        vars = top = scopeVars.back();
+        scopeVars.pop_back();
+    }
+
+    const Var* lookup(SymId name) const {
+        for (auto it = scopes.rbegin(); it != scopes.rend(); ++it) {
+            auto f = it->find(name);
+            if (f != it->end()) return &f->second;
+        }
+        return nullptr;
+    }
+
+    // Statements
+
+    void stmt(Stmt& s) {
+        switch (s.kind) {
+        case NodeKind::ExprStmt: if (auto* e = cast<ExprStmt>(s).expr) expr(*e); break;
+        case NodeKind::ReturnStmt: {
+            auto* r = &cast<ReturnStmt>(s);
+            int32_t v = r->expr ? expr(*r->expr) : -1;
+            if (v < 0 || isVoid) { v = temp(); emit(Op::Const, v, 0); }
+            emit(Op::Ret, v);
+            break;
+        }
+        case NodeKind::Block: {
+            pushScope();
+            for (auto* it : cast<Block>(s).items) stmt(*it);
+            popScope();
+            break;
+        }
+        case NodeKind::BreakStmt: if (!loops.empty()) jump(Op::Jmp, loops.back().exit); break;
+        case NodeKind::ContinueStmt: if (!loops.empty()) jump(Op::Jmp, loops.back().cont); break;
+        case NodeKind::Decl: decl(cast<Decl>(s)); break;
+        case NodeKind::IfStmt: {
+            auto* i = &cast<IfStmt>(s);
+            int elseL = label();
+            branch(*i->cond, false, elseL);
+            top = vars;
+            stmt(*i->thenS);
+            if (i->elseS) {
+                int endL = label();
+                jump(Op::Jmp, endL);
+                bind(elseL);
+                stmt(*i->elseS);
+                bind(endL);
+            } else {
+                bind(elseL);
+            }
+            break;
+        }
+        case NodeKind::WhileStmt: { auto* w = &cast<WhileStmt>(s); loop(w->cond, w->body, nullptr, true); break; }
+        case NodeKind::DoWhileStmt: { auto* d = &cast<DoWhileStmt>(s); loop(d->cond, d->body, nullptr, false); break; }
+        case NodeKind::ForStmt: {
+            auto* l = &cast<ForStmt>(s);
+            pushScope();
+            if (l->init) stmt(*l->init);
+            loop(l->cond, l->body, l->step, true);
+            popScope();
+            break;
+        }
+        default: break;
+        }
+        top = vars; // temporaries die with their statement
+    }
+
+    void decl(Decl& d) {
+        const Type& t = d.varType;
+        Var v;
+        if (!t.arrayDims.empty() || taken(d.name)) {
+            // arrays and address-taken variables live in the frame, which
+            // starts out zeroed
+            v = {Var::Frame, slot(elements(t.arrayDims) * (size_t)elemSize(t)), t};
+            if (d.init) emit(elemSize(t) == 1 ? Op::SetF1 : Op::SetF4, v.at, expr(*d.init));
+        } else {
+            // the variable is not in scope in its own initializer
+            v = {Var::Reg, top, t};
+            vars = ++top;
+            note();
+            if (d.init) expr(*d.init, v.at);
+            else emit(Op::Const, v.at, 0);
+        }
+        scopes.back()[d.name] = v;
+    }
+
+    // Loops test their condition at the bottom, so one branch per
+    // iteration both tests and jumps back.
+    void loop(Expr* cond, Stmt* body, Expr* step, bool condFirst) {
+        int bodyL = label(), contL = label(), condL = label(), exitL = label();
+        if (condFirst) jump(Op::Jmp, condL);
+        bind(bodyL);
+        loops.push_back({contL, exitL});
+        stmt(*body);
+        loops.pop_back();
+        bind(contL);
+        if (step) { expr(*step); top = vars; }
+        bind(condL);
+        if (cond) branch(*cond, true, bodyL);
+        else jump(Op::Jmp, bodyL);
+        top = vars;
+        bind(exitL);
+    }
+
+    // Jumps to target when e is nonzero == when, and falls through otherwise.
+    void branch(Expr& e, bool when, int target) {
+        if (auto* b = dyn_cast<BinaryExpr>(&e)) {
+            if (b->op == BinaryOp::And || b->op == BinaryOp::Or) {
+                bool isAnd = b->op == BinaryOp::And;
+                if (isAnd != when) { // both sides can jump straight to target
+                    branch(*b->lhs, when, target);
+                    branch(*b->rhs, when, target);
+                    return;
+                }
+                int skip = label();
+                branch(*b->lhs, !when, skip);
+                branch(*b->rhs, when, target);
+                bind(skip);
+                return;
+            }
+            Cmp c = Lt;
+            if (comparison(b->op, c)) {
+                if (!when) c = inverse(c);
+                int32_t kl, kr;
+                bool cl = constant(*b->lhs, kl), cr = constant(*b->rhs, kr);
+                if (cl && !cr) {
+                    int32_t r = expr(*b->rhs);
+                    jump(plus(Op::JLtK, mirror(c)), target, r, kl);
+                    return;
+                }
+                int32_t l = operand(*b->lhs, hasEffects(b->rhs));
+                if (cr) { jump(plus(Op::JLtK, c), target, l, kr); return; }
+                int32_t r = expr(*b->rhs);
+                jump(plus(Op::JLt, c), target, l, r);
+                return;
+            }
+        }
+        if (auto* u = dyn_cast<UnaryExpr>(&e); u && u->op == UnaryOp::Not) { branch(*u->operand, !when, target); return; }
+        if (auto* k = dyn_cast<IntegerLiteral>(&e)) {
+            if ((k->value != 0) == when) jump(Op::Jmp, target);
+            return;
+        }
+        jump(when ? Op::Jnz : Op::Jz, target, expr(e));
+    }
+
+    // Expressions. The result ends up in `want` if it is set (and is then
+    // written by the last instruction only), otherwise in any register,
+    // which may be a variable's own.
+
+    int32_t expr(Expr& e, int32_t want = -1) {
+        switch (e.kind) {
+        case NodeKind::IntegerLiteral: case NodeKind::CharLiteral: case NodeKind::StringLiteral: {
+            int32_t k = 0;
+            constant(e, k); // a string has no storage here and evaluates to 0, as in IRGen
+            int32_t d = dest(want);
+            emit(Op::Const, d, k);
+            return d;
+        }
+        case NodeKind::VarRef: {
+            const Var* v = lookup(cast<VarRef>(e).name);
+            if (!v) { int32_t d = dest(want); emit(Op::Const, d, 0); return d; }
+            if (v->kind != Var::Frame) return move(v->at, want);
+            int32_t d = dest(want);
+            if (!v->type.arrayDims.empty()) emit(Op::FrameAddr, d, v->at); // an array decays to its address
+            else emit(elemSize(v->type) == 1 ? Op::GetF1 : Op::GetF4, d, v->at);
+            return d;
+        }
+        case NodeKind::ArrayIndex: {
+            Path p = path(cast<ArrayIndex>(e), false);
+            if (e.type.arrayDims.empty()) return load(p, elemSize(e.type), want);
+            scale(p, elements(e.type.arrayDims)); // a row decays to the address of its first element
+            return lea(p, want);
+        }
+        case NodeKind::BinaryExpr: return binary(cast<BinaryExpr>(e), want);
+        case NodeKind::UnaryExpr: {
+            auto* u = &cast<UnaryExpr>(e);
+            switch (u->op) {
+            case UnaryOp::Plus: return expr(*u->operand, want);
+            case UnaryOp::Minus: case UnaryOp::Not: case UnaryOp::BitNot: case UnaryOp::Deref: {
+                int32_t v = expr(*u->operand), d = dest(want);
+                Op op = u->op == UnaryOp::Minus ? Op::Neg : u->op == UnaryOp::Not ? Op::Not
+                      : u->op == UnaryOp::BitNot ? Op::BitNot : elemSize(e.type) == 1 ? Op::Load1 : Op::Load4;
+                emit(op, d, v);
+                return d;
+            }
+            case UnaryOp::PreInc: return assign(*u->operand, nullptr, 1, want);
+            case UnaryOp::PreDec: return assign(*u->operand, nullptr, -1, want);
+            case UnaryOp::Addr: return address(*u->operand, want);
+            }
+            return move(0, want);
+        }
+        case NodeKind::AssignExpr: { auto* a = &cast<AssignExpr>(e); return assign(*a->lhs, a->rhs, 0, want); }
+        case NodeKind::CallExpr: return call(cast<CallExpr>(e), want);
+        default: { int32_t d = dest(want); emit(Op::Const, d, 0); return d; }
+        }
+    }
+
+    int32_t move(int32_t r, int32_t want) {
+        if (want < 0 || want == r) return r;
+        emit(Op::Move, want, r);
+        return want;
+    }
+
+    // Like expr, but copies a variable's register when something evaluated
+    // later may assign it.
+    int32_t operand(Expr& e, bool protect) {
+        int32_t r = expr(e);
+        if (!protect || r >= vars) return r;
+        int32_t t = temp();
+        emit(Op::Move, t, r);
+        return t;
+    }
+
+    int32_t binary(BinaryExpr& b, int32_t want) {
+        if (b.op == BinaryOp::And || b.op == BinaryOp::Or) {
+            int falseL = label(), endL = label();
+            branch(b, false, falseL);
+            int32_t d = dest(want);
+            emit(Op::Const, d, 1);
+            jump(Op::Jmp, endL);
+            bind(falseL);
+            emit(Op::Const, d, 0);
+            bind(endL);
+            return d;
+        }
+        Op op = Op::Add;
+        bool commutes = false;
+        Cmp c = Lt;
+        if (comparison(b.op, c)) {
+            op = plus(Op::Lt, c);
+        } else {
+            switch (b.op) {
+            case BinaryOp::Add: op = Op::Add; commutes = true; break;
+            case BinaryOp::Sub: op = Op::Sub; break;
+            case BinaryOp::Mul: op = Op::Mul; commutes = true; break;
+            case BinaryOp::Div: op = Op::Div; break;
+            case BinaryOp::Mod: op = Op::Mod; break;
+            case BinaryOp::BitAnd: op = Op::And; commutes = true; break;
+            case BinaryOp::BitOr: op = Op::Or; commutes = true; break;
+            case BinaryOp::BitXor: op = Op::Xor; commutes = true; break;
+            case BinaryOp::Shl: op = Op::Shl; break;
+            case BinaryOp::Shr: op = Op::Shr; break;
+            default: break;
+            }
+        }
+        auto immediate = [&](Op o) { return (Op)((int)o + (o >= Op::Lt ? (int)Op::LtK - (int)Op::Lt : (int)Op::AddK - (int)Op::Add)); };
+        int32_t kl, kr;
+        bool cl = constant(*b.lhs, kl), cr = constant(*b.rhs, kr);
+        if (cl && !cr && (commutes || op >= Op::Lt)) {
+            int32_t r = expr(*b.rhs), d = dest(want);
+            emit(immediate(op >= Op::Lt ? plus(Op::Lt, mirror(c)) : op), d, r, kl);
+            return d;
+        }
+        int32_t l = operand(*b.lhs, hasEffects(b.rhs));
+        if (cr) {
+            int32_t d = dest(want);
+            emit(immediate(op), d, l, kr);
+            return d;
+        }
+        int32_t r = expr(*b.rhs), d = dest(want);
+        emit(op, d, l, r);
+        return d;
+    }
+
+    int32_t call(CallExpr& c, int32_t want) {
+        // arguments go to consecutive registers at the top, where the
+        // callee's window will start
+        int32_t base = top;
+        top += (int32_t)c.args.size();
+        note();
+        for (size_t k = 0; k < c.args.size(); ++k) expr(*c.args[k], base + (int32_t)k);
+        auto f = index.find(c.callee);
+        int32_t d = want >= 0 ? want : base;
+        top = std::max(top, base + 1);
+        note();
+        if (f == index.end()) emit(Op::Const, d, 0);
+        else emit(Op::Call, d, f->second, base);
+        top = std::max(d, base) + 1; // the arguments are dead
+        return d;
+    }
+
+    int32_t assign(Expr& lhs, Expr* rhs, int32_t delta, int32_t want) {
+        if (auto* v = dyn_cast<VarRef>(&lhs)) {
+            const Var* var = lookup(v->name);
+            if (var && var->kind == Var::Reg) {
+                // the operator computing the value writes the variable itself
+                if (rhs) expr(*rhs, var->at);
+                else emit(Op::AddK, var->at, var->at, delta);
+                return move(var->at, want);
+            }
+            if (var && var->kind == Var::Frame) {
+                int32_t val = rhs ? expr(*rhs) : step(expr(lhs), delta);
+                emit(elemSize(var->type) == 1 ? Op::SetF1 : Op::SetF4, var->at, val);
+                return move(val, want);
+            }
+            return rhs ? expr(*rhs, want) : expr(lhs, want); // not a variable
+        }
+        // the element's address is taken before the value is computed
+        if (lhs.kind == NodeKind::ArrayIndex) {
+            Path p = path(cast<ArrayIndex>(lhs), rhs && hasEffects(rhs));
+            int32_t size = elemSize(lhs.type);
+            int32_t val = rhs ? expr(*rhs) : step(load(p, size, -1), delta);
+            store(p, size, val);
+            return move(val, want);
+        }
+        if (auto* u = dyn_cast<UnaryExpr>(&lhs); u && u->op == UnaryOp::Deref) {
+            int32_t addr = operand(*u->operand, rhs && hasEffects(rhs));
+            bool one = elemSize(lhs.type) == 1;
+            int32_t val;
+            if (rhs) {
+                val = expr(*rhs);
+            } else {
+                val = temp();
+                emit(one ? Op::Load1 : Op::Load4, val, addr);
+                emit(Op::AddK, val, val, delta);
+            }
+            emit(one ? Op::Store1 : Op::Store4, addr, val);
+            return move(val, want);
+        }
+        return rhs ? expr(*rhs, want) : expr(lhs, want);
+    }
+
+    int32_t step(int32_t old, int32_t delta) {
+        int32_t d = temp();
+        emit(Op::AddK, d, old, delta);
+        return d;
+    }
+
+    int32_t address(Expr& e, int32_t want) {
+        if (auto* v = dyn_cast<VarRef>(&e)) {
+            const Var* var = lookup(v->name);
+            if (!var) return expr(e, want);
+            if (var->kind != Var::Frame) return move(var->at, want); // an array parameter: its value is the address
+            int32_t d = dest(want);
+            emit(Op::FrameAddr, d, var->at);
+            return d;
+        }
+        if (auto* i = dyn_cast<ArrayIndex>(&e)) { Path p = path(*i, false); return lea(p, want); }
+        // anything else is computed into a fresh slot
+        int32_t v = expr(e), off = slot(4), d = dest(want);
+        emit(Op::SetF4, off, v);
+        emit(Op::FrameAddr, d, off);
+        return d;
+    }
+
+    // x[i][j] on an array becomes one flattened index i * d1 + j; indexing
+    // through a pointer starts a new path at the pointer's value. With
+    // protect set, no register of the path may belong to a variable.
+    Path path(ArrayIndex& e, bool protect) {
+        Expr& b = *e.base;
+        bool later = protect || hasEffects(e.index);
+        Path p;
+        if (!b.type.arrayDims.empty() && b.kind == NodeKind::ArrayIndex) {
+            p = path(cast<ArrayIndex>(b), later);
+            scale(p, b.type.arrayDims[0]);
+        } else if (auto* v = dyn_cast<VarRef>(&b); v && !b.type.arrayDims.empty()) {
+            const Var* var = lookup(v->name);
+            p.size = elemSize(b.type);
+            if (var && var->kind == Var::Frame) {
+                p.frame = true;
+                p.base = var->at;
+                p.limit = (int32_t)(elements(var->type.arrayDims) * (size_t)p.size);
+            } else {
+                p.base = operand(b, later); // an array parameter: the address of its first row
+            }
+        } else {
+            p.base = operand(b, later);
+            p.size = b.type.pointerLevels == 1 && b.type.base == BaseType::Char ? 1 : 4;
+        }
+        int32_t k;
+        if (constant(*e.index, k)) {
+            if (p.constIdx) { p.k += k; return p; }
+            int32_t t = p.idx >= vars ? p.idx : temp();
+            emit(Op::AddK, t, p.idx, k);
+            p.idx = t;
+            return p;
+        }
+        int32_t r = operand(*e.index, protect);
+        if (p.constIdx && p.k == 0) {
+            p.constIdx = false;
+            p.idx = r;
+        } else if (p.constIdx) {
+            p.constIdx = false;
+            p.idx = temp();
+            emit(Op::AddK, p.idx, r, (int32_t)p.k);
+        } else {
+            int32_t t = p.idx >= vars ? p.idx : temp();
+            emit(Op::Add, t, p.idx, r);
+            p.idx = t;
+        }
+        return p;
+    }
+
+    void scale(Path& p, size_t n) {
+        if (n == 1) return;
+        if (p.constIdx) { p.k *= (int64_t)n; return; }
+        int32_t t = p.idx >= vars ? p.idx : temp();
+        emit(Op::MulK, t, p.idx, (int32_t)n);
+        p.idx = t;
+    }
+
+    // A constant index within its frame array needs no bounds check.
+    bool inFrame(const Path& p, int32_t size) const {
+        return p.frame && p.constIdx && p.k >= 0 && p.k * p.size + size <= p.limit;
+    }
+
+    // Register holding a path's index, materializing a constant one.
+    int32_t indexReg(const Path& p) {
+        if (!p.constIdx) return p.idx;
+        int32_t t = temp();
+        emit(Op::Const, t, (int32_t)p.k);
+        return t;
+    }
+
+    int32_t load(const Path& p, int32_t size, int32_t want) {
+        bool one = size == 1;
+        if (size != p.size) { // e.g. a char read through an int-sized stride
+            int32_t a = lea(p, -1), d = dest(want);
+            emit(one ? Op::Load1 : Op::Load4, d, a);
+            return d;
+        }
+        if (inFrame(p, size)) {
+            int32_t d = dest(want);
+            emit(one ? Op::GetF1 : Op::GetF4, d, p.base + (int32_t)(p.k * size));
+            return d;
+        }
+        int32_t i = indexReg(p), d = dest(want);
+        emit(p.frame ? (one ? Op::LoadF1 : Op::LoadF4) : (one ? Op::LoadX1 : Op::LoadX4), d, p.base, i);
+        return d;
+    }
+
+    void store(const Path& p, int32_t size, int32_t val) {
+        bool one = size == 1;
+        if (size != p.size) {
+            emit(one ? Op::Store1 : Op::Store4, lea(p, -1), val);
+            return;
+        }
+        if (inFrame(p, size)) {
+            emit(one ? Op::SetF1 : Op::SetF4, p.base + (int32_t)(p.k * size), val);
+            return;
+        }
+        int32_t i = indexReg(p);
+        emit(p.frame ? (one ? Op::StoreF1 : Op::StoreF4) : (one ? Op::StoreX1 : Op::StoreX4), p.base, i, val);
+    }
+
+    int32_t lea(const Path& p, int32_t want) {
+        Op op = p.size == 1 ? Op::Lea1 : Op::Lea4;
+        if (p.frame && p.constIdx) {
+            int32_t d = dest(want);
+            emit(Op::FrameAddr, d, p.base + (int32_t)(p.k * p.size));
+            return d;
+        }
+        int32_t base = p.base;
+        if (p.frame) { base = temp(); emit(Op::FrameAddr, base, p.base); }
+        if (p.constIdx) {
+            if (p.k == 0) return move(base, want);
+            int32_t d = dest(want);
+            emit(Op::AddK, d, base, (int32_t)(p.k * p.size));
+            return d;
+        }
+        int32_t d = dest(want);
+        emit(op, d, base, p.idx);
+        return d;
+    }
+};
+
+} // namespace
+
+Module compile(const Program& p) {
+    std::unordered_map<SymId, int> index; // later definitions win, as in Semantic
+    for (size_t i = 0; i < p.functions.size(); ++i) index[p.functions[i]->name] = (int)i;
+    Module m;
+    m.functions.resize(p.functions.size());
+    for (size_t i = 0; i < p.functions.size(); ++i) {
+        const cmini::Function& f = *p.functions[i];
+        if (!f.body) { // a declaration: calling it is a runtime error
+            m.functions[i].name = f.name;
+            m.functions[i].params = (uint32_t)f.params.size();
+            continue;
+        }
+        Compiler(index, m.functions[i]).function(f);
+    }
+    return m;
+}
+
+} // namespace cmini::bc
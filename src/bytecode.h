@@ -0,0 +1,81 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "ast.h"
+
+// Register bytecode for running checked programs without a native
+// toolchain (see vm.h). Every function gets a window of 32-bit registers:
+// its parameters first, then its register-resident locals, then
+// temporaries. Arrays and locals whose address is taken live in the
+// function's frame, a block of bytes carved from one contiguous VM memory;
+// pointers are byte offsets into that memory.
+
+namespace cmini::bc {
+
+// Operands are a, b, c below; "r" is a register of the current window,
+// "k" an immediate, "L" an instruction index and "off" a frame offset.
+// Ops with a K suffix take their right operand as an immediate; a 4 or 1
+// suffix is the size in bytes of the element accessed.
+#define CMINI_BC_OPS(X)                                                                     \
+    X(Const)   /* ra = k(b) */                                                              \
+    X(Move)    /* ra = rb */                                                                \
+    X(Add) X(Sub) X(Mul) X(Div) X(Mod) X(And) X(Or) X(Xor) X(Shl) X(Shr) /* ra = rb op rc */ \
+    X(AddK) X(SubK) X(MulK) X(DivK) X(ModK) X(AndK) X(OrK) X(XorK) X(ShlK) X(ShrK)         \
+    X(Lt) X(Le) X(Gt) X(Ge) X(Eq) X(Ne)       /* ra = rb cmp rc, 0 or 1 */                  \
+    X(LtK) X(LeK) X(GtK) X(GeK) X(EqK) X(NeK)                                               \
+    X(Neg) X(Not) X(BitNot)                   /* ra = op rb */                              \
+    X(Jmp)                                    /* goto L(c) */                               \
+    X(Jz) X(Jnz)                              /* if (ra ==/!= 0) goto L(c) */               \
+    X(JLt) X(JLe) X(JGt) X(JGe) X(JEq) X(JNe) /* if (ra cmp rb) goto L(c) */                \
+    X(JLtK) X(JLeK) X(JGtK) X(JGeK) X(JEqK) X(JNeK)                                         \
+    X(FrameAddr)                              /* ra = frame + off(b) */                     \
+    X(Lea4) X(Lea1)                           /* ra = rb + rc * size */                     \
+    X(Load4) X(Load1)                         /* ra = mem[rb] */                            \
+    X(Store4) X(Store1)                       /* mem[ra] = rb */                            \
+    X(LoadX4) X(LoadX1)                       /* ra = mem[rb + rc * size] */                \
+    X(StoreX4) X(StoreX1)                     /* mem[ra + rb * size] = rc */                \
+    X(LoadF4) X(LoadF1)                       /* ra = frame[off(b) + rc * size] */          \
+    X(StoreF4) X(StoreF1)                     /* frame[off(a) + rb * size] = rc */          \
+    X(GetF4) X(GetF1)                         /* ra = frame[off(b)] */                      \
+    X(SetF4) X(SetF1)                         /* frame[off(a)] = rb */                      \
+    X(Call)   /* ra = function b, arguments in rc, rc+1, ...; the callee's window starts at rc */ \
+    X(Ret)    /* return ra */
+
+enum class Op : uint8_t {
+#define CMINI_BC_ENUM(name) name,
+    CMINI_BC_OPS(CMINI_BC_ENUM)
+#undef CMINI_BC_ENUM
+};
+
+const char* opName(Op op);
+
+struct Insn {
+    Op op;
+    int32_t a {0}, b {0}, c {0};
+};
+
+struct Function {
+    SymId name {0};
+    uint32_t params {0};
+    uint32_t registers {0};  // window size, parameters included
+    uint32_t frameBytes {0}; // arrays and address-taken locals
+    std::vector<Insn> code;
+};
+
+struct Module {
+    std::vector<Function> functions; // same order as Program::functions
+    // Index of the function a call to `name` reaches (the last definition,
+    // as in Semantic), or -1.
+    int find(SymId name) const;
+};
+
+// Compiles a program that passed Semantic::analyze (and optionally
+// ConstFold). The superinstructions come from common shapes: a binary
+// operator with a constant operand becomes one K instruction, a comparison
+// that only steers control flow becomes a compare-and-branch, an
+// assignment to a register local writes the local directly from the
+// operator that computes it, and an index into a local array reads or
+// writes the frame in one instruction.
+Module compile(const Program& p);
+
+} // namespace cmini::bc
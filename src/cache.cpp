@@ -0,0 +1,206 @@
+#include "cache.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <dirent.h>
+#include <fcntl.h>
+#include <functional>
+#include <limits.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "hash.h"
+
+namespace cmini {
+
+const std::string& compilerBuildId() {
+    static const std::string id = [] {
+        Hasher h;
+        h.str("cmini-cache-v1");
+        char exe[PATH_MAX];
+        ssize_t n = ::readlink("/proc/self/exe", exe, sizeof exe - 1);
+        if (n > 0) {
+            exe[n] = '\0';
+            h.str(std::string_view(exe, (size_t)n));
+            struct stat st;
+            if (::stat(exe, &st) == 0) {
+                h.u64((uint64_t)st.st_size).u64((uint64_t)st.st_mtim.tv_sec).u64((uint64_t)st.st_mtim.tv_nsec);
+            }
+        }
+        h.str(__DATE__ " " __TIME__);
+        return h.digest().hex();
+    }();
+    return id;
+}
+
+static bool copyFile(const std::string& from, const std::string& to) {
+    int in = ::open(from.c_str(), O_RDONLY | O_CLOEXEC);
+    if (in < 0) return false;
+    int out = ::open(to.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (out < 0) { ::close(in); return false; }
+    bool ok = true;
+    for (;;) {
+        ssize_t n = ::copy_file_range(in, nullptr, out, nullptr, 1 << 30, 0);
+        if (n == 0) break;
+        if (n > 0) continue;
+        if (errno == EINTR) continue;
+        // not supported between these file systems: plain read/write
+        char buf[1 << 16];
+        for (;;) {
+            ssize_t r = ::read(in, buf, sizeof buf);
+            if (r < 0 && errno == EINTR) continue;
+            if (r <= 0) { ok = r == 0; break; }
+            for (ssize_t off = 0; off < r; ) {
+                ssize_t w = ::write(out, buf + off, (size_t)(r - off));
+                if (w < 0 && errno == EINTR) continue;
+                if (w <= 0) { ok = false; break; }
+                off += w;
+            }
+            if (!ok) break;
+        }
+        break;
+    }
+    ::close(in);
+    if (::close(out) != 0) ok = false;
+    return ok;
+}
+
+static void makeDir(const std::string& d) { ::mkdir(d.c_str(), 0755); }
+
+CompileCache::CompileCache(std::string d, uint64_t maxBytes) : dir(std::move(d)), maxBytes(maxBytes) {
+    // create every missing component of dir, then the fixed subdirectories
+    for (size_t i = 1; i <= dir.size(); ++i)
+        if (i == dir.size() || dir[i] == '/') makeDir(dir.substr(0, i));
+    makeDir(dir + "/objects");
+    makeDir(dir + "/tmp");
+}
+
+std::string CompileCache::defaultDir() {
+    if (const char* e = std::getenv("CMINI_CACHE_DIR"); e && *e) return e;
+    if (const char* x = std::getenv("XDG_CACHE_HOME"); x && *x) return std::string(x) + "/cmini";
+    if (const char* h = std::getenv("HOME"); h && *h) return std::string(h) + "/.cache/cmini";
+    return "/tmp/cmini-cache";
+}
+
+std::string CompileCache::key(std::string_view source, std::string_view options) const {
+    Hasher h;
+    h.str(compilerBuildId()).str(options).str(source);
+    return h.digest().hex();
+}
+
+std::string CompileCache::entryPath(const std::string& key) const {
+    return dir + "/objects/" + key.substr(0, 2) + "/" + key.substr(2) + ".ll";
+}
+
+bool CompileCache::fetch(const std::string& key, const std::string& outPath) {
+    std::string entry = entryPath(key);
+    if (!copyFile(entry, outPath)) { bumpStats(0, 1, 0); return false; }
+    ::utimensat(AT_FDCWD, entry.c_str(), nullptr, 0); // LRU: mark as recently used
+    bumpStats(1, 0, 0);
+    return true;
+}
+
+void CompileCache::store(const std::string& key, const std::string& outPath) {
+    static std::atomic<unsigned> seq {0};
+    std::string tmp = dir + "/tmp/" + std::to_string(::getpid()) + "." +
+                      std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()) % 100000) + "." +
+                      std::to_string(seq++);
+    if (!copyFile(outPath, tmp)) { ::unlink(tmp.c_str()); return; }
+    std::string entry = entryPath(key);
+    makeDir(dir + "/objects/" + key.substr(0, 2));
+    // another process may have published the same key since our miss: the
+    // rename replaces its entry, whose bytes stop counting
+    struct stat st, old;
+    int64_t replaced = ::stat(entry.c_str(), &old) == 0 ? (int64_t)old.st_size : 0;
+    if (::stat(tmp.c_str(), &st) != 0 || ::rename(tmp.c_str(), entry.c_str()) != 0) { ::unlink(tmp.c_str()); return; }
+    bumpStats(0, 0, (int64_t)st.st_size - replaced);
+}
+
+// Reads, updates and rewrites DIR/stats while holding an exclusive flock.
+static bool updateStatsFile(const std::string& path, const std::function<void(uint64_t&, uint64_t&, uint64_t&)>& fn) {
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) return false;
+    ::flock(fd, LOCK_EX);
+    char buf[128] = {0};
+    ssize_t n = ::pread(fd, buf, sizeof buf - 1, 0);
+    unsigned long long h = 0, m = 0, b = 0;
+    if (n > 0) std::sscanf(buf, "%llu %llu %llu", &h, &m, &b);
+    uint64_t hits = h, misses = m, bytes = b;
+    fn(hits, misses, bytes);
+    int len = std::snprintf(buf, sizeof buf, "%llu %llu %llu\n",
+                            (unsigned long long)hits, (unsigned long long)misses, (unsigned long long)bytes);
+    bool ok = ::ftruncate(fd, 0) == 0 && ::pwrite(fd, buf, (size_t)len, 0) == len;
+    ::flock(fd, LOCK_UN);
+    ::close(fd);
+    return ok;
+}
+
+void CompileCache::bumpStats(uint64_t hits, uint64_t misses, int64_t bytes) {
+    uint64_t total = 0;
+    updateStatsFile(dir + "/stats", [&](uint64_t& h, uint64_t& m, uint64_t& b) {
+        h += hits; m += misses;
+        b = bytes < 0 && (uint64_t)-bytes > b ? 0 : b + bytes;
+        total = b;
+    });
+    if (total > maxBytes) evict();
+}
+
+namespace {
+struct Entry { int64_t mtime; uint64_t size; std::string path; };
+
+std::vector<Entry> scanEntries(const std::string& objects) {
+    std::vector<Entry> out;
+    DIR* top = ::opendir(objects.c_str());
+    if (!top) return out;
+    while (dirent* d = ::readdir(top)) {
+        if (d->d_name[0] == '.') continue;
+        std::string sub = objects + "/" + d->d_name;
+        DIR* dd = ::opendir(sub.c_str());
+        if (!dd) continue;
+        while (dirent* e = ::readdir(dd)) {
+            if (e->d_name[0] == '.') continue;
+            std::string p = sub + "/" + e->d_name;
+            struct stat st;
+            if (::stat(p.c_str(), &st) == 0 && S_ISREG(st.st_mode))
+                out.push_back({(int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec, (uint64_t)st.st_size, p});
+        }
+        ::closedir(dd);
+    }
+    ::closedir(top);
+    return out;
+}
+}
+
+void CompileCache::evict() {
+    // only one process evicts at a time; the others just carry on
+    int lock = ::open((dir + "/lock").c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (lock < 0) return;
+    if (::flock(lock, LOCK_EX | LOCK_NB) != 0) { ::close(lock); return; }
+
+    auto entries = scanEntries(dir + "/objects");
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.mtime < b.mtime; });
+    uint64_t total = 0;
+    for (auto& e : entries) total += e.size;
+    uint64_t target = maxBytes - maxBytes / 10; // leave headroom so we do not evict on every insert
+    for (auto& e : entries) {
+        if (total <= target) break;
+        if (::unlink(e.path.c_str()) == 0) total -= e.size;
+    }
+    updateStatsFile(dir + "/stats", [&](uint64_t&, uint64_t&, uint64_t& b) { b = total; });
+
+    ::flock(lock, LOCK_UN);
+    ::close(lock);
+}
+
+CompileCache::Stats CompileCache::stats() const {
+    Stats s;
+    updateStatsFile(dir + "/stats", [&](uint64_t& h, uint64_t& m, uint64_t&) { s.hits = h; s.misses = m; });
+    for (auto& e : scanEntries(dir + "/objects")) { s.bytes += e.size; ++s.entries; }
+    return s;
+}
+
+} // namespace cmini
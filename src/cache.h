@@ -0,0 +1,52 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace cmini {
+
+// Identifies the running compiler binary (path, size, mtime, build time).
+// Anything persisted across runs is tagged with it, so a rebuilt cmini
+// never trusts output produced by a different build.
+const std::string& compilerBuildId();
+
+// Content-addressed on-disk cache of emitted .ll files, shared by every
+// cmini process that points at the same directory.
+//
+//   DIR/objects/ab/cdef...ll  one entry per key (first two hex digits fan out)
+//   DIR/tmp/                  staging area; entries appear via rename()
+//   DIR/stats                 "hits misses bytes", updated under flock
+//   DIR/lock                  serializes eviction
+//
+// Keys hash the input bytes, the options that change the output and the
+// compiler build, so a new cmini binary never sees an old entry. Hits bump
+// the entry's mtime; when the tracked size passes the limit the oldest
+// entries are evicted (LRU by mtime).
+class CompileCache {
+public:
+    CompileCache(std::string dir, uint64_t maxBytes);
+
+    static std::string defaultDir(); // $CMINI_CACHE_DIR, else ~/.cache/cmini
+
+    std::string key(std::string_view source, std::string_view options) const;
+
+    // Copies the entry for key to outPath; false on a miss.
+    bool fetch(const std::string& key, const std::string& outPath);
+    // Publishes the finished file at outPath under key.
+    void store(const std::string& key, const std::string& outPath);
+
+    struct Stats { uint64_t hits {0}, misses {0}, bytes {0}, entries {0}; };
+    Stats stats() const; // counters plus a fresh scan of the entries
+
+    const std::string& directory() const { return dir; }
+
+private:
+    std::string entryPath(const std::string& key) const;
+    void bumpStats(uint64_t hits, uint64_t misses, int64_t bytes);
+    void evict();
+
+    std::string dir;
+    uint64_t maxBytes;
+};
+
+} // namespace cmini
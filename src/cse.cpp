@@ -0,0 +1,77 @@
+#include "cse.h"
+#include <unordered_map>
+#include <utility>
+
+namespace cmini::ir {
+
+namespace {
+
+struct Key {
+    Op op;
+    Pred pred;
+    Ty ty;
+    std::vector<Value> ops;
+    bool operator==(const Key&) const = default;
+};
+
+struct KeyHash {
+    size_t operator()(const Key& k) const {
+        uint64_t h = (uint64_t)k.op * 0x9e3779b97f4a7c15ull ^ (uint64_t)k.pred << 8 ^ (uint64_t)k.ty.base << 16 ^
+                     (uint64_t)k.ty.ptr << 24 ^ (uint64_t)k.ty.array << 32;
+        for (const Value& v : k.ops) h = (h ^ ((uint64_t)v.num << 3 | v.kind)) * 0x100000001b3ull;
+        return (size_t)h;
+    }
+};
+
+bool pure(Op o) { return (o >= Op::Add && o <= Op::Trunc) || o == Op::Gep; }
+
+bool commutative(const Inst& in) {
+    switch (in.op) {
+    case Op::Add: case Op::Mul: case Op::And: case Op::Or: case Op::Xor: return true;
+    case Op::ICmp: return in.pred == Pred::EQ || in.pred == Pred::NE;
+    default: return false;
+    }
+}
+
+} // namespace
+
+void CSE::run(Function& f) {
+    DomTree dom;
+    dom.build(f);
+    std::vector<std::vector<Id>> children(f.blocks.size());
+    for (Id b : dom.rpo)
+        if (b != 0) children[dom.idom[b]].push_back(b);
+
+    std::unordered_map<Key, Id, KeyHash> avail;
+    std::vector<Key> added; // undo log, popped when leaving a subtree
+    // (block, undo mark); a block is entered when pushed and left when
+    // popped the second time
+    std::vector<std::pair<Id, size_t>> stack {{0, None}};
+    while (!stack.empty()) {
+        auto [b, mark] = stack.back();
+        if (mark != None) {
+            while (added.size() > mark) { avail.erase(added.back()); added.pop_back(); }
+            stack.pop_back();
+            continue;
+        }
+        stack.back().second = added.size();
+        std::vector<Id> list = f.blocks[b].insts;
+        for (Id i : list) {
+            const Inst& in = f.insts[i];
+            if (!pure(in.op)) continue;
+            Key k {in.op, in.pred, in.ty, {}};
+            for (uint32_t n = 0; n < in.opCount; ++n) k.ops.push_back(f.operand(i, n));
+            if (commutative(in) && (k.ops[1].kind < k.ops[0].kind ||
+                                    (k.ops[1].kind == k.ops[0].kind && k.ops[1].num < k.ops[0].num)))
+                std::swap(k.ops[0], k.ops[1]);
+            auto [it, fresh] = avail.emplace(k, i);
+            if (fresh) { added.push_back(std::move(k)); continue; }
+            f.replaceAllUses(i, Value::inst(it->second));
+            f.erase(i);
+            ++removed;
+        }
+        for (auto c = children[b].rbegin(); c != children[b].rend(); ++c) stack.push_back({*c, None});
+    }
+}
+
+} // namespace cmini::ir
@@ -0,0 +1,17 @@
+#pragma once
+#include <cstddef>
+#include "ir.h"
+
+namespace cmini::ir {
+
+// Common subexpression elimination over the dominator tree: a pure
+// instruction (arithmetic, compare, zext, getelementptr) that repeats one
+// in a dominating position is replaced by it. Commutative operands are
+// put in a canonical order first, so a + b also matches b + a. Memory is
+// not modelled, so loads are left alone.
+struct CSE {
+    size_t removed {0};
+    void run(Function& f);
+};
+
+} // namespace cmini::ir
@@ -0,0 +1,527 @@
+#include "driver.h"
+#include <chrono>
+#include <cstdio>
+#include <fcntl.h>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <unistd.h>
+#include "source.h"
+#include "lexer.h"
+#include "parser.h"
+#include "semantic.h"
+#include "irgen.h"
+#include "threadpool.h"
+#include "cache.h"
+#include "incremental.h"
+#include "fold.h"
+#include "jit.h"
+#include "vm.h"
+#include "object.h"
+#include "pcm.h"
+#include "profile.h"
+#include "timereport.h"
+#include "x86.h"
+
+namespace cmini {
+
+using Clock = std::chrono::steady_clock;
+
+static const char* usage =
+    "usage: cmini <file|@respfile>... [ -o out.ll ] [ --out-dir DIR ] [ -j N ] [ --summary ]\n"
+    "             [ --ast-stats ] [ --time-report[=json] ] [ --no-mmap ] [ --lex-only ]\n"
+    "             [ --cache ] [ --cache-dir DIR ] [ --cache-max-size BYTES ] [ --cache-stats ]\n"
+    "             [ --incremental ] [ -O0 | -O1 | -O2 ] [ --inline-threshold N ] [ --inline-report ]\n"
+    "             [ --emit=llvm | --emit=obj | --emit=pcm ] [ --import FILE.pcm ]...\n"
+    "             [ --instrument ] [ --profile-use=FILE ]\n"
+    "       cmini --run <file> [ --vm ] [ -O0 | -O1 | -O2 ] [ --inline-threshold N ] [ --import FILE.pcm ]...\n"
+    "             [ --profile-use=FILE ]\n"
+    "       cmini --server SOCKET [ -j N ]\n"
+    "       cmini --connect SOCKET <args...> | --shutdown\n";
+
+// The part of the options that changes the emitted IR; it goes into cache
+// keys. Diagnostic and I/O switches (--ast-stats, --time-report,
+// --no-mmap, --inline-report) do not.
+static std::string outputOptions(const CompileOptions& opts) {
+    std::string o = "O";
+    o += std::to_string(opts.optLevel);
+    if (opts.optLevel > 0 && opts.inlineThreshold >= 0) o += " inline=" + std::to_string(opts.inlineThreshold);
+    if (opts.emit == Emit::Object) o += " obj";
+    if (opts.emit == Emit::Module) o += " pcm";
+    for (auto* m : opts.imports) o += " import=" + m->sourceDigest().hex();
+    if (opts.instrument) o += " instrument";
+    if (opts.profile) o += " profile=" + opts.profile->digest().hex();
+    return o;
+}
+
+// Semantic checks, then constant folding from -O1; functions marked in
+// `unchecked` are skipped, and so are the first `imported` by Semantic,
+// which checked them when their module was built. Diagnostics and
+// --ast-stats lines go to err; report, when set, gets the phases.
+static bool analyze(Program& prog, const CompileOptions& opts, ThreadPool* pool, const std::vector<bool>* unchecked,
+                    size_t imported, TimeReport* report, std::ostream& err) {
+    if (report) report->phase("semantic");
+    std::vector<bool> checked;
+    if (imported) {
+        checked.assign(prog.functions.size(), false);
+        for (size_t i = 0; i < checked.size(); ++i) checked[i] = i < imported || (unchecked && (*unchecked)[i]);
+    }
+    Semantic sem; sem.analyze(prog, pool, imported ? &checked : unchecked);
+    if (report) {
+        report->stop();
+        report->counter("lookups", sem.lookups);
+    }
+    if (!sem.diags.ok()) {
+        for (auto& m : sem.diags.messages) err << "error: " << m << "\n";
+        return false;
+    }
+    if (opts.optLevel > 0) {
+        if (report) report->phase("fold");
+        ConstFold fold;
+        fold.run(prog, pool, unchecked);
+        if (report) report->stop();
+        if (opts.astStats) {
+            const auto& s = fold.stats;
+            err << "fold: " << s.nodesRemoved << " nodes removed (" << s.folded << " folded, " << s.propagated
+                << " propagated, " << s.unreachable << " unreachable statements)\n";
+        }
+    }
+    return true;
+}
+
+static CompileResult compileOne(const std::string& inPath, const std::string& outPath,
+                                const CompileOptions& opts, ThreadPool* pool, TimeReport* report) {
+    CompileResult r;
+    std::ostringstream out, err;
+    auto phase = [&](const char* name) { if (report) report->phase(name); };
+    phase("read");
+    SourceFile src;
+    if (!src.open(inPath, opts.useMmap)) { r.err = "cannot open: " + inPath + "\n"; return r; }
+
+    if (opts.lexOnly) {
+        // lexer throughput benchmark: tokenize the whole input and report
+        auto t0 = Clock::now();
+        Lexer lex(src.text());
+        size_t tokens = 0;
+        while (lex.next().kind != TokenKind::End) ++tokens;
+        double secs = std::chrono::duration<double>(Clock::now() - t0).count();
+        out << "lexed " << tokens << " tokens, " << src.text().size() << " bytes in "
+            << secs * 1e3 << " ms (" << src.text().size() / secs / 1e9 << " GB/s)\n";
+        r.out = out.str(); r.ok = true;
+        return r;
+    }
+
+    std::string key;
+    if (opts.cache) {
+        phase("cache");
+        key = opts.cache->key(src.text(), outputOptions(opts));
+        if (opts.cache->fetch(key, outPath)) {
+            FunctionCache(outPath).discard(); // indexes the output just replaced
+            out << "wrote " << outPath << " (cached)\n";
+            r.out = out.str(); r.ok = true;
+            return r;
+        }
+    }
+
+    if (report) {
+        // the parser pulls tokens as it goes, so lexing is timed (and the
+        // tokens counted) in a pass of its own
+        phase("lex");
+        Lexer lex(src.text());
+        size_t tokens = 0;
+        while (lex.next().kind != TokenKind::End) ++tokens;
+        report->stop();
+        report->counter("source_bytes", src.text().size());
+        report->counter("tokens", tokens);
+    }
+    phase("parse");
+    Lexer lex(src.text());
+    Parser parser(lex);
+    auto prog = parser.parseProgram();
+    if (!opts.imports.empty()) phase("import");
+    size_t imported = importFunctions(*prog, opts.imports);
+    if (report) {
+        report->stop();
+        report->countNodes(*prog);
+        report->counter("functions", prog->functions.size());
+        if (!opts.imports.empty()) report->counter("imported", imported);
+    }
+    if (opts.astStats) {
+        const Arena& ar = prog->arena;
+        err << "ast: " << ar.objectCount() << " nodes, " << ar.bytesUsed() << " bytes used, "
+            << ar.bytesReserved() << " bytes reserved\n";
+        if (!opts.imports.empty()) err << "import: " << imported << " functions\n";
+    }
+
+    if (opts.emit == Emit::Module) {
+        // modules hold the checked AST as written; importers fold it themselves
+        CompileOptions checkOnly = opts;
+        checkOnly.optLevel = 0;
+        if (!analyze(*prog, checkOnly, pool, nullptr, imported, report, err)) { r.err = err.str(); return r; }
+        phase("module");
+        FunctionCache(outPath).discard();
+        int fd = ::open(outPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) { r.err = err.str() + "cannot write: " + outPath + "\n"; return r; }
+        bool written;
+        {
+            OutSink sink(fd);
+            writeModule(*prog, src.text(), sink);
+            sink.flush();
+            written = sink.ok();
+        }
+        if (::close(fd) != 0 || !written) { r.err = err.str() + "write failed: " + outPath + "\n"; return r; }
+        phase("write");
+        if (opts.cache) opts.cache->store(key, outPath);
+        out << "wrote " << outPath << "\n";
+        r.out = out.str(); r.err = err.str(); r.ok = true;
+        return r;
+    }
+
+    // Incremental mode: functions whose fingerprint matches the previous
+    // build are neither rechecked nor regenerated; their text is spliced in.
+    std::vector<Hasher::Digest> fps;
+    std::vector<std::string_view> reuse;
+    std::vector<bool> clean, unchecked;
+    size_t reused = 0;
+    FunctionCache fnCache(outPath);
+    if (opts.incremental) {
+        phase("fingerprint");
+        fps = fingerprintFunctions(*prog, outputOptions(opts), pool, opts.optLevel > 0);
+        fnCache.load();
+        reuse.resize(fps.size());
+        clean.resize(fps.size());
+        for (size_t i = 0; i < fps.size(); ++i) {
+            reuse[i] = fnCache.find(fps[i]);
+            clean[i] = !reuse[i].empty();
+            reused += clean[i];
+        }
+        // the inliner reads the bodies of everything a rebuilt function
+        // calls, so those are checked and folded even when reused
+        unchecked = clean;
+        if (opts.optLevel > 0) {
+            std::vector<bool> rebuilt(clean.size());
+            for (size_t i = 0; i < clean.size(); ++i) rebuilt[i] = !clean[i];
+            auto called = reachableCallees(callGraph(*prog), rebuilt);
+            for (size_t i = 0; i < called.size(); ++i)
+                if (called[i]) unchecked[i] = false;
+        }
+    }
+
+    if (!analyze(*prog, opts, pool, opts.incremental ? &unchecked : nullptr, imported, report, err)) { r.err = err.str(); return r; }
+    phase(opts.emit == Emit::Object ? "codegen" : "irgen");
+
+    // the previous output stays mapped while reused text is copied out of
+    // it, so an incremental build writes beside it and renames at the end
+    std::string writePath = opts.incremental ? outPath + ".tmp" : outPath;
+    fnCache.discard();
+    int fd = ::open(writePath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) { r.err = err.str() + "cannot write: " + outPath + "\n"; return r; }
+    bool written;
+    size_t total;
+    {
+        OutSink sink(fd);
+        IRGen ir;
+        ir.optLevel = opts.optLevel;
+        ir.inlineThreshold = opts.inlineThreshold;
+        ir.inlineReport = opts.inlineReport;
+        ir.instrument = opts.instrument;
+        ir.profile = opts.profile;
+        std::vector<size_t> offsets;
+        if (opts.incremental) {
+            ir.reuse = &reuse;
+            ir.onFunction = [&](size_t) { offsets.push_back(sink.bytes()); };
+        }
+        if (opts.emit == Emit::Object) {
+            std::vector<x86::MachineCode> code(prog->functions.size());
+            ir.lowerAll(*prog, [&](size_t i, ir::Function& fn) { x86::compile(fn, code[i]); }, pool);
+            ObjectWriter obj;
+            size_t spilled = 0;
+            for (size_t i : ir.order(*prog)) { obj.add(code[i]); spilled += code[i].spilled; }
+            obj.write(sink);
+            if (opts.astStats)
+                err << "codegen: " << obj.textBytes() << " bytes of x86-64, " << spilled << " values spilled\n";
+        } else {
+            ir.gen(*prog, sink, pool);
+        }
+        sink.flush();
+        written = sink.ok();
+        total = sink.bytes();
+        if (opts.inlineReport) err << ir.report;
+        if (ir.profileStale)
+            err << inPath << ": warning: profile does not match " << ir.profileStale
+                << " functions (changed since it was recorded?); their counts were ignored\n";
+        if (opts.astStats && opts.optLevel > 0) {
+            err << "inline: " << ir.inlineStats.inlined << " of " << ir.inlineStats.sites << " call sites inlined\n";
+            const auto& s = ir.loopStats;
+            err << "cse: " << ir.cseRemoved << " redundant instructions removed\n";
+            err << "loops: " << s.loops << " loops, " << s.hoisted << " hoisted, " << s.strengthReduced
+                << " multiplies strength-reduced (" << s.inductionVars << " induction variables), " << s.shifts
+                << " shifts, " << s.removed << " dead instructions removed\n";
+        }
+        for (size_t i = 0; i < offsets.size(); ++i)
+            fnCache.add(fps[i], offsets[i], (i + 1 < offsets.size() ? offsets[i + 1] : total) - offsets[i]);
+    }
+    phase("write");
+    if (::close(fd) != 0 || !written || (opts.incremental && ::rename(writePath.c_str(), outPath.c_str()) != 0)) {
+        if (opts.incremental) ::unlink(writePath.c_str());
+        r.err = err.str() + "write failed: " + outPath + "\n";
+        return r;
+    }
+    if (opts.cache) opts.cache->store(key, outPath);
+    if (opts.incremental) {
+        fnCache.commit();
+        out << "wrote " << outPath << " (" << reused << " functions reused, " << fps.size() - reused << " rebuilt)\n";
+        r.out = out.str(); r.err = err.str(); r.ok = true;
+        return r;
+    }
+    out << "wrote " << outPath << "\n";
+    r.out = out.str(); r.err = err.str(); r.ok = true;
+    return r;
+}
+
+// --run: compiles inPath with the native backend into memory and calls its
+// main, whose result becomes the exit code. Any parameters main declares
+// receive zeros. With useVM, or on hosts the backend does not target, the
+// program is compiled to bytecode and interpreted instead.
+static int runProgram(const std::string& inPath, const CompileOptions& opts, bool useVM, ThreadPool* pool,
+                      std::ostream& err) {
+#if !defined(__x86_64__)
+    useVM = true;
+#endif
+    try {
+        SourceFile src;
+        if (!src.open(inPath, opts.useMmap)) { err << "cannot open: " << inPath << "\n"; return 1; }
+        Lexer lex(src.text());
+        Parser parser(lex);
+        auto prog = parser.parseProgram();
+        size_t imported = importFunctions(*prog, opts.imports);
+        std::ostringstream diags;
+        if (!analyze(*prog, opts, pool, nullptr, imported, nullptr, diags)) { err << diags.str(); return 1; }
+        if (useVM) {
+            bc::Module module = bc::compile(*prog);
+            int main = module.find(intern("main"));
+            if (main < 0) { err << inPath << ": error: no main function\n"; return 1; }
+            bc::VM vm;
+            auto r = vm.run(module, (size_t)main, std::vector<int32_t>(module.functions[(size_t)main].params, 0));
+            if (!r.ok) { err << inPath << ": runtime error: " << r.error << "\n"; return 1; }
+            return r.value;
+        }
+        IRGen ir;
+        ir.optLevel = opts.optLevel;
+        ir.inlineThreshold = opts.inlineThreshold;
+        ir.profile = opts.profile;
+        std::vector<x86::MachineCode> code(prog->functions.size());
+        ir.lowerAll(*prog, [&](size_t i, ir::Function& fn) { x86::compile(fn, code[i]); }, pool);
+        JitImage image;
+        std::string error;
+        if (!image.load(code, error)) { err << inPath << ": error: " << error << "\n"; return 1; }
+        void* entry = image.find(intern("main"));
+        if (!entry) { err << inPath << ": error: no main function\n"; return 1; }
+        using Main = int (*)(long, long, long, long, long, long);
+        return reinterpret_cast<Main>(entry)(0, 0, 0, 0, 0, 0);
+    } catch (const std::exception& e) {
+        err << inPath << ": error: " << e.what() << "\n";
+        return 1;
+    }
+}
+
+CompileResult compileFile(const std::string& inPath, const std::string& outPath,
+                          const CompileOptions& opts, ThreadPool* pool) {
+    auto t0 = Clock::now();
+    CompileResult r;
+    std::unique_ptr<TimeReport> report;
+    if (opts.timeReport != TimeReportFormat::None) report = std::make_unique<TimeReport>();
+    TimeReport::Scope charged(report.get()); // what this thread does until the report is printed
+    try {
+        r = compileOne(inPath, outPath, opts, pool, report.get());
+    } catch (const std::exception& e) {
+        r = CompileResult();
+        r.err = inPath + ": error: " + e.what() + "\n";
+    }
+    r.seconds = std::chrono::duration<double>(Clock::now() - t0).count();
+    if (report) {
+        report->stop();
+        std::ostringstream os;
+        if (opts.timeReport == TimeReportFormat::Json) report->printJson(os, inPath);
+        else report->printText(os, inPath);
+        r.err += os.str();
+    }
+    return r;
+}
+
+bool parseJobs(const std::vector<std::string>& args, size_t& i, unsigned& jobs, std::ostream& err) {
+    const std::string& a = args[i];
+    std::string n = a.size()>2 ? a.substr(2) : (i+1<args.size() ? args[++i] : "");
+    if (n.empty() || n.size() > 9 || n.find_first_not_of("0123456789") != std::string::npos) { err << "invalid job count: " << a << "\n"; return false; }
+    jobs = (unsigned)std::stoul(n);
+    return true;
+}
+
+static std::string resolvePath(const std::string& p, const std::string& cwd) {
+    if (cwd.empty() || p.empty() || p[0] == '/') return p;
+    return cwd + "/" + p;
+}
+
+// Appends the whitespace-separated arguments of a response file.
+static bool expandResponseFile(const std::string& path, std::vector<std::string>& args, int depth, const std::string& cwd) {
+    std::ifstream in(resolvePath(path, cwd));
+    if (!in || depth > 8) return false;
+    std::string a;
+    while (in >> a) {
+        if (a.size() > 1 && a[0] == '@') {
+            if (!expandResponseFile(a.substr(1), args, depth + 1, cwd)) return false;
+        } else args.push_back(a);
+    }
+    return true;
+}
+
+static std::string defaultOutPath(const std::string& in, const std::string& outDir, const char* ext) {
+    std::string base = in;
+    size_t slash = base.find_last_of('/');
+    size_t dot = base.find_last_of('.');
+    if (dot != std::string::npos && (slash == std::string::npos || dot > slash)) base.erase(dot);
+    base += ext;
+    if (outDir.empty()) return base;
+    std::string file = slash == std::string::npos ? base : base.substr(slash + 1);
+    return outDir + "/" + file;
+}
+
+static void printCacheStats(const CompileCache& cache, std::ostream& out) {
+    auto st = cache.stats();
+    out << "cache " << cache.directory() << ": " << st.entries << " entries, " << st.bytes << " bytes, "
+        << st.hits << " hits, " << st.misses << " misses\n";
+}
+
+int runDriver(const std::vector<std::string>& rawArgs, std::ostream& out, std::ostream& err,
+              ThreadPool* sharedPool, const std::string& cwd) {
+    std::vector<std::string> args;
+    for (auto& a : rawArgs) {
+        if (a.size() > 1 && a[0] == '@') {
+            if (!expandResponseFile(a.substr(1), args, 0, cwd)) { err << "cannot read response file: " << a.substr(1) << "\n"; return 1; }
+        } else args.push_back(a);
+    }
+
+    CompileOptions opts;
+    std::vector<std::string> inputs;
+    std::string outPath, outDir;
+    unsigned jobs = 1; // worker threads; 0 = one per core
+    std::vector<std::string> importPaths;
+    std::string profilePath;
+    bool summary = false, run = false, useVM = false;
+    bool useCache = false, cacheStats = false;
+    std::string cacheDir;
+    uint64_t cacheMax = 1ull << 30;
+    for (size_t i=0;i<args.size();i++) {
+        const std::string& a = args[i];
+        if (a=="-o" && i+1<args.size()) { outPath = args[++i]; }
+        else if (a=="--out-dir" && i+1<args.size()) outDir = args[++i];
+        else if (a=="--ast-stats") opts.astStats = true;
+        else if (a=="--time-report") opts.timeReport = TimeReportFormat::Text;
+        else if (a=="--time-report=json") opts.timeReport = TimeReportFormat::Json;
+        else if (a=="--no-mmap") opts.useMmap = false;
+        else if (a=="--lex-only") opts.lexOnly = true;
+        else if (a=="--summary") summary = true;
+        else if (a=="--cache") useCache = true;
+        else if (a=="--cache-dir" && i+1<args.size()) { useCache = true; cacheDir = args[++i]; }
+        else if (a=="--cache-max-size" && i+1<args.size()) {
+            const std::string& n = args[++i];
+            if (n.empty() || n.find_first_not_of("0123456789") != std::string::npos) { err << "invalid cache size: " << n << "\n"; return 1; }
+            cacheMax = std::stoull(n);
+        }
+        else if (a=="--cache-stats") cacheStats = true;
+        else if (a=="--incremental") opts.incremental = true;
+        else if (a=="-O0" || a=="-O1" || a=="-O2") opts.optLevel = a[2] - '0';
+        else if (a=="--inline-threshold" && i+1<args.size()) {
+            const std::string& n = args[++i];
+            if (n.empty() || n.size() > 9 || n.find_first_not_of("0123456789") != std::string::npos) { err << "invalid inline threshold: " << n << "\n"; return 1; }
+            opts.inlineThreshold = std::stoi(n);
+        }
+        else if (a=="--inline-report") opts.inlineReport = true;
+        else if (a=="--emit=llvm") opts.emit = Emit::LLVM;
+        else if (a=="--emit=obj") opts.emit = Emit::Object;
+        else if (a=="--emit=pcm") opts.emit = Emit::Module;
+        else if (a=="--import" && i+1<args.size()) importPaths.push_back(args[++i]);
+        else if (a=="--instrument") opts.instrument = true;
+        else if (a.rfind("--profile-use=", 0)==0 && a.size() > 14) profilePath = a.substr(14);
+        else if (a=="--run") run = true;
+        else if (a=="--vm") useVM = true;
+        else if (a.rfind("-j", 0)==0) { if (!parseJobs(args, i, jobs, err)) return 1; }
+        else if (!a.empty() && a[0]=='-' && a.size()>1) { err << "unknown option: " << a << "\n" << usage; return 1; }
+        else inputs.push_back(a);
+    }
+    std::unique_ptr<CompileCache> cache;
+    if (useCache || cacheStats) {
+        cache = std::make_unique<CompileCache>(cacheDir.empty() ? CompileCache::defaultDir() : resolvePath(cacheDir, cwd), cacheMax);
+        if (useCache && !opts.lexOnly) opts.cache = cache.get();
+    }
+    if (inputs.empty() && cacheStats) { printCacheStats(*cache, out); return 0; }
+    if (inputs.empty()) { err << usage; return 1; }
+    if (useVM && !run) { err << "--vm works with --run only\n"; return 1; }
+    if (run && opts.timeReport != TimeReportFormat::None) { err << "--time-report does not apply to --run\n"; return 1; }
+    // opened once and shared, read-only, by every compilation
+    std::vector<std::unique_ptr<ModuleFile>> modules;
+    for (auto& path : importPaths) {
+        modules.push_back(std::make_unique<ModuleFile>());
+        std::string error;
+        if (!modules.back()->open(resolvePath(path, cwd), error)) { err << error << "\n"; return 1; }
+        opts.imports.push_back(modules.back().get());
+    }
+    Profile profile;
+    if (!profilePath.empty()) {
+        std::string error;
+        if (!profile.load(resolvePath(profilePath, cwd), error)) { err << error << "\n"; return 1; }
+        opts.profile = &profile;
+    }
+    if (opts.instrument && (run || opts.emit != Emit::LLVM)) { err << "--instrument works on LLVM IR output only\n"; return 1; }
+    if (opts.instrument && opts.incremental) { err << "--instrument does not work with --incremental\n"; return 1; }
+    if (run) {
+        // the program runs inside this process, which must not be a server
+        // that other clients share
+        if (sharedPool) { err << "--run is not available through the compile server\n"; return 1; }
+        if (inputs.size() != 1) { err << "--run takes a single input\n"; return 1; }
+        return runProgram(resolvePath(inputs[0], cwd), opts, useVM, nullptr, err);
+    }
+    if (!outPath.empty() && inputs.size() > 1) { err << "-o needs a single input; use --out-dir for batches\n"; return 1; }
+    if (opts.incremental && opts.emit != Emit::LLVM) { err << "--incremental works on LLVM IR output only\n"; return 1; }
+
+    if (jobs == 0) jobs = ThreadPool::defaultWorkers();
+    std::unique_ptr<ThreadPool> ownPool;
+    if (!sharedPool && jobs > 1) ownPool = std::make_unique<ThreadPool>(jobs - 1); // the calling thread is the last worker
+    ThreadPool* pool = sharedPool ? sharedPool : ownPool.get();
+    if (sharedPool) jobs = sharedPool->size() + 1;
+
+    std::vector<std::string> outputs;
+    std::string ext = opts.emit == Emit::Object ? ".o" : opts.emit == Emit::Module ? ".pcm" : ".ll";
+    for (auto& in : inputs)
+        outputs.push_back(resolvePath(inputs.size() == 1 && outDir.empty() ? (outPath.empty() ? "out" + ext : outPath)
+                                                                           : defaultOutPath(in, outDir, ext.c_str()), cwd));
+    for (auto& in : inputs) in = resolvePath(in, cwd);
+
+    // Files and the functions inside them share one bounded pool.
+    auto t0 = Clock::now();
+    std::vector<CompileResult> results(inputs.size());
+    auto compileAt = [&](size_t i) { results[i] = compileFile(inputs[i], outputs[i], opts, pool); };
+    if (pool) pool->parallelFor(inputs.size(), compileAt);
+    else for (size_t i = 0; i < inputs.size(); ++i) compileAt(i);
+    double wall = std::chrono::duration<double>(Clock::now() - t0).count();
+
+    size_t failed = 0;
+    for (auto& r : results) {
+        out << r.out;
+        err << r.err;
+        if (!r.ok) ++failed;
+    }
+    if (summary) {
+        out << std::fixed << std::setprecision(3);
+        for (size_t i = 0; i < inputs.size(); ++i)
+            out << std::setw(10) << results[i].seconds * 1e3 << " ms  " << (results[i].ok ? "ok    " : "FAILED") << "  " << inputs[i] << "\n";
+        out << inputs.size() << " files, " << failed << " failed, " << wall * 1e3 << " ms wall, "
+            << jobs << (jobs == 1 ? " thread\n" : " threads\n");
+    }
+    if (cacheStats) printCacheStats(*cache, out);
+    return failed ? 1 : 0;
+}
+
+} // namespace cmini
@@ -0,0 +1,58 @@
+#pragma once
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+namespace cmini {
+
+class ThreadPool;
+class CompileCache;
+class ModuleFile;
+class Profile;
+
+enum class Emit { LLVM, Object, Module };
+enum class TimeReportFormat { None, Text, Json };
+
+struct CompileOptions {
+    bool astStats {false};
+    bool useMmap {true};
+    bool lexOnly {false};
+    CompileCache* cache {nullptr}; // reuse and publish outputs when set
+    bool incremental {false};      // reuse unchanged functions via <out>.fncache
+    int optLevel {0};              // -O0 emits the AST as written; -O1 and up fold, inline and optimize loops
+    int inlineThreshold {-1};      // largest callee the inliner takes; -1 = the optLevel's default
+    bool inlineReport {false};     // print the inliner's decision for every call site
+    TimeReportFormat timeReport {TimeReportFormat::None}; // per-phase time, allocations and counters
+    Emit emit {Emit::LLVM};        // LLVM IR, an x86-64 ELF object, or a precompiled module
+    std::vector<const ModuleFile*> imports; // --import, searched last-first for undefined callees
+    bool instrument {false};           // count calls and branch edges, written out when the program exits
+    const Profile* profile {nullptr};  // --profile-use: counts from an instrumented run
+};
+
+// Outcome of compiling one input. Text that the command line prints is
+// captured here so concurrent compilations never interleave their output.
+struct CompileResult {
+    bool ok {false};
+    std::string out;  // normal messages ("wrote x.ll", statistics)
+    std::string err;  // diagnostics
+    double seconds {0};
+};
+
+// Compiles inPath to outPath. Never throws: parse errors and I/O failures
+// end up in the result, so one bad input cannot take down a batch.
+CompileResult compileFile(const std::string& inPath, const std::string& outPath,
+                          const CompileOptions& opts, ThreadPool* pool);
+
+// Command-line entry point: parses args (without argv[0]), compiles every
+// input and returns the process exit code. A long-lived caller (the compile
+// server) passes its warm pool, which then replaces -j, and the client's
+// working directory, against which relative paths are resolved.
+int runDriver(const std::vector<std::string>& args, std::ostream& out, std::ostream& err,
+              ThreadPool* sharedPool = nullptr, const std::string& cwd = "");
+
+// Parses the -j option at args[i], as "-jN" or "-j N" (stepping i past a
+// separate count); 0 means one thread per core. False, with a message in
+// err, when the count is missing or not a number.
+bool parseJobs(const std::vector<std::string>& args, size_t& i, unsigned& jobs, std::ostream& err);
+
+} // namespace cmini
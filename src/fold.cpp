@@ -0,0 +1,406 @@
+#include "fold.h"
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include "threadpool.h"
+
+namespace cmini {
+
+namespace {
+
+size_t countNodes(Node* n) {
+    size_t c = 0;
+    walk(n, [&](Node*) { ++c; });
+    return c;
+}
+
+// Values are i32 in the generated code, so folding wraps the same way.
+long wrap32(long v) { return (long)(int32_t)(uint32_t)(uint64_t)v; }
+
+bool constValue(Expr* e, long& v) {
+    if (auto* i = dyn_cast<IntegerLiteral>(e)) { v = i->value; return true; }
+    if (auto* c = dyn_cast<CharLiteral>(e)) { v = c->value; return true; }
+    return false;
+}
+
+bool isIntScalar(const Type& t) { return t.base == BaseType::Int && t.pointerLevels == 0 && t.arrayDims.empty(); }
+
+bool isBoolean(Expr* e) {
+    if (auto* u = dyn_cast<UnaryExpr>(e)) return u->op == UnaryOp::Not;
+    auto* b = dyn_cast<BinaryExpr>(e);
+    return b && b->op >= BinaryOp::LT && b->op <= BinaryOp::Or;
+}
+
+// Dropping `+ 0` must not change the type IRGen sees (char + 0 is an int).
+bool sameType(const Type& a, const Type& b) {
+    return a.base == b.base && a.pointerLevels == b.pointerLevels && a.arrayDims == b.arrayDims;
+}
+
+// Expressions whose evaluation has no effect besides producing a value.
+bool isPure(Expr* e) {
+    bool pure = true;
+    walk(e, [&](Node* n) {
+        if (n->kind == NodeKind::AssignExpr || n->kind == NodeKind::CallExpr) pure = false;
+        if (auto* u = dyn_cast<UnaryExpr>(n); u && (u->op == UnaryOp::PreInc || u->op == UnaryOp::PreDec)) pure = false;
+    });
+    return pure;
+}
+
+bool evalBinary(BinaryOp op, long a, long b, long& r) {
+    int32_t x = (int32_t)a, y = (int32_t)b;
+    switch (op) {
+    case BinaryOp::Add: r = wrap32((long)x + y); return true;
+    case BinaryOp::Sub: r = wrap32((long)x - y); return true;
+    case BinaryOp::Mul: r = wrap32((long)x * y); return true;
+    case BinaryOp::Div: if (y == 0 || (x == INT32_MIN && y == -1)) return false; r = x / y; return true;
+    case BinaryOp::Mod: if (y == 0 || (x == INT32_MIN && y == -1)) return false; r = x % y; return true;
+    case BinaryOp::LT: r = x < y; return true;
+    case BinaryOp::GT: r = x > y; return true;
+    case BinaryOp::LE: r = x <= y; return true;
+    case BinaryOp::GE: r = x >= y; return true;
+    case BinaryOp::EQ: r = x == y; return true;
+    case BinaryOp::NE: r = x != y; return true;
+    case BinaryOp::And: r = x && y; return true;
+    case BinaryOp::Or: r = x || y; return true;
+    case BinaryOp::BitAnd: r = x & y; return true;
+    case BinaryOp::BitOr: r = x | y; return true;
+    case BinaryOp::BitXor: r = x ^ y; return true;
+    case BinaryOp::Shl: if (y < 0 || y > 31) return false; r = wrap32((long)((uint32_t)x << y)); return true;
+    case BinaryOp::Shr: if (y < 0 || y > 31) return false; r = x >> y; return true;
+    }
+    return false;
+}
+
+// x op c that is just x.
+bool isRightIdentity(BinaryOp op, long c) {
+    switch (op) {
+    case BinaryOp::Add: case BinaryOp::Sub: case BinaryOp::BitOr: case BinaryOp::BitXor:
+    case BinaryOp::Shl: case BinaryOp::Shr: return c == 0;
+    case BinaryOp::Mul: case BinaryOp::Div: return c == 1;
+    default: return false;
+    }
+}
+
+// c op x that is just x.
+bool isLeftIdentity(BinaryOp op, long c) {
+    switch (op) {
+    case BinaryOp::Add: case BinaryOp::BitOr: case BinaryOp::BitXor: return c == 0;
+    case BinaryOp::Mul: return c == 1;
+    default: return false;
+    }
+}
+
+class FunctionFolder {
+public:
+    FunctionFolder(Arena& arena, std::mutex& arenaMu) : arena(arena), arenaMu(arenaMu) {}
+
+    ConstFold::Stats st;
+
+    void run(Function& f) {
+        enterFunction(f);
+        mark(f.body);
+        scopes.clear();
+        enterFunction(f);
+        if (f.body) fold(*f.body);
+        scopes.clear();
+    }
+
+private:
+    Arena& arena;
+    std::mutex& arenaMu; // the Program's arena is shared by all functions
+    std::vector<std::unordered_map<SymId, Decl*>> scopes;
+    std::unordered_set<const Decl*> mutated; // assigned or address-taken after their declaration
+
+    template <class T, class... Args> T* make(Args&&... args) {
+        std::lock_guard<std::mutex> lock(arenaMu);
+        return arena.make<T>(std::forward<Args>(args)...);
+    }
+
+    Expr* literal(long v, Expr* reuse) {
+        if (auto* i = dyn_cast<IntegerLiteral>(reuse)) { i->value = v; i->type = Type::intTy(); return i; }
+        auto* i = make<IntegerLiteral>(v);
+        i->type = Type::intTy();
+        return i;
+    }
+
+    void enterFunction(Function& f) {
+        scopes.emplace_back();
+        for (auto& p : f.params) scopes.back()[p.name] = nullptr; // parameters shadow outer names
+    }
+
+    Decl* resolve(SymId name) {
+        for (auto it = scopes.rbegin(); it != scopes.rend(); ++it) {
+            auto f = it->find(name);
+            if (f != it->end()) return f->second;
+        }
+        return nullptr;
+    }
+
+    bool propagatable(Decl* d) {
+        return d && d->init && d->init->kind == NodeKind::IntegerLiteral && isIntScalar(d->varType) && !mutated.count(d);
+    }
+
+    // Pass 1: find the locals that are ever written, resolving names with
+    // the same scoping rules as Semantic.
+    void markTarget(Expr* lhs) {
+        if (auto* v = dyn_cast<VarRef>(lhs))
+            if (Decl* d = resolve(v->name)) mutated.insert(d);
+    }
+
+    void mark(Node* n) {
+        if (!n) return;
+        switch (n->kind) {
+        case NodeKind::Decl: { auto* d = &cast<Decl>(*n); mark(d->init); scopes.back()[d->name] = d; return; }
+        case NodeKind::Block: {
+            scopes.emplace_back();
+            for (auto* s : cast<Block>(*n).items) mark(s);
+            scopes.pop_back();
+            return;
+        }
+        case NodeKind::ForStmt: {
+            auto* l = &cast<ForStmt>(*n);
+            scopes.emplace_back();
+            mark(l->init); mark(l->cond); mark(l->step); mark(l->body);
+            scopes.pop_back();
+            return;
+        }
+        case NodeKind::IfStmt: { auto* i = &cast<IfStmt>(*n); mark(i->cond); mark(i->thenS); mark(i->elseS); return; }
+        case NodeKind::WhileStmt: { auto* w = &cast<WhileStmt>(*n); mark(w->cond); mark(w->body); return; }
+        case NodeKind::DoWhileStmt: { auto* d = &cast<DoWhileStmt>(*n); mark(d->body); mark(d->cond); return; }
+        case NodeKind::ExprStmt: mark(cast<ExprStmt>(*n).expr); return;
+        case NodeKind::ReturnStmt: mark(cast<ReturnStmt>(*n).expr); return;
+        case NodeKind::AssignExpr: { auto* a = &cast<AssignExpr>(*n); markTarget(a->lhs); mark(a->lhs); mark(a->rhs); return; }
+        case NodeKind::UnaryExpr: {
+            auto* u = &cast<UnaryExpr>(*n);
+            if (u->op == UnaryOp::PreInc || u->op == UnaryOp::PreDec || u->op == UnaryOp::Addr) markTarget(u->operand);
+            mark(u->operand);
+            return;
+        }
+        case NodeKind::BinaryExpr: mark(cast<BinaryExpr>(*n).lhs); mark(cast<BinaryExpr>(*n).rhs); return;
+        case NodeKind::ArrayIndex: mark(cast<ArrayIndex>(*n).base); mark(cast<ArrayIndex>(*n).index); return;
+        case NodeKind::CallExpr: for (auto* a : cast<CallExpr>(*n).args) mark(a); return;
+        default: return;
+        }
+    }
+
+    // Pass 2: rewrite. Expressions return their replacement.
+    Expr* fold(Expr* e) {
+        if (!e) return e;
+        switch (e->kind) {
+        case NodeKind::VarRef: {
+            Decl* d = resolve(cast<VarRef>(*e).name);
+            if (!propagatable(d)) return e;
+            ++st.propagated;
+            return literal(cast<IntegerLiteral>(*d->init).value, nullptr);
+        }
+        case NodeKind::UnaryExpr: {
+            auto* u = &cast<UnaryExpr>(*e);
+            if (u->op == UnaryOp::PreInc || u->op == UnaryOp::PreDec || u->op == UnaryOp::Addr) {
+                if (!dyn_cast<VarRef>(u->operand)) u->operand = fold(u->operand);
+                return e;
+            }
+            u->operand = fold(u->operand);
+            long v;
+            if (!constValue(u->operand, v)) return e;
+            long r;
+            switch (u->op) {
+            case UnaryOp::Plus: r = wrap32(v); break;
+            case UnaryOp::Minus: r = wrap32(-(long)(int32_t)v); break;
+            case UnaryOp::BitNot: r = ~(int32_t)v; break;
+            case UnaryOp::Not: r = (int32_t)v == 0; break;
+            default: return e;
+            }
+            ++st.folded; ++st.nodesRemoved;
+            return literal(r, u->operand);
+        }
+        case NodeKind::BinaryExpr: {
+            auto* b = &cast<BinaryExpr>(*e);
+            b->lhs = fold(b->lhs);
+            long l, r, v;
+            bool lc = constValue(b->lhs, l);
+            if (lc && (b->op == BinaryOp::And || b->op == BinaryOp::Or)) {
+                // the right operand only runs when the left one does not decide
+                bool decided = b->op == BinaryOp::And ? (int32_t)l == 0 : (int32_t)l != 0;
+                if (decided) {
+                    ++st.folded; st.nodesRemoved += 1 + countNodes(b->rhs);
+                    return literal(b->op == BinaryOp::Or, b->lhs);
+                }
+                b->rhs = fold(b->rhs);
+                if (constValue(b->rhs, r)) {
+                    ++st.folded; st.nodesRemoved += 2;
+                    return literal((int32_t)r != 0, b->lhs);
+                }
+                // 1 && x, 0 || x  ->  x != 0, or just x when that is already 0/1
+                if (isBoolean(b->rhs)) { ++st.folded; st.nodesRemoved += 2; return b->rhs; }
+                if (!isIntScalar(b->rhs->type)) return e;
+                ++st.folded;
+                b->op = BinaryOp::NE;
+                Expr* zero = literal(0, b->lhs);
+                b->lhs = b->rhs;
+                b->rhs = zero;
+                return e;
+            }
+            b->rhs = fold(b->rhs);
+            bool rc = constValue(b->rhs, r);
+            if (lc && rc && evalBinary(b->op, l, r, v)) {
+                ++st.folded; st.nodesRemoved += 2;
+                return literal(v, dyn_cast<IntegerLiteral>(b->lhs) ? b->lhs : b->rhs);
+            }
+            if (rc && isRightIdentity(b->op, r) && sameType(b->lhs->type, b->type)) { ++st.folded; st.nodesRemoved += 2; return b->lhs; }
+            if (lc && isLeftIdentity(b->op, l) && sameType(b->rhs->type, b->type)) { ++st.folded; st.nodesRemoved += 2; return b->rhs; }
+            return e;
+        }
+        case NodeKind::AssignExpr: {
+            auto* a = &cast<AssignExpr>(*e);
+            if (!dyn_cast<VarRef>(a->lhs)) a->lhs = fold(a->lhs);
+            a->rhs = fold(a->rhs);
+            return e;
+        }
+        case NodeKind::ArrayIndex: {
+            auto* a = &cast<ArrayIndex>(*e);
+            if (!dyn_cast<VarRef>(a->base)) a->base = fold(a->base);
+            a->index = fold(a->index);
+            return e;
+        }
+        case NodeKind::CallExpr:
+            for (auto*& a : cast<CallExpr>(*e).args) a = fold(a);
+            return e;
+        default: return e;
+        }
+    }
+
+    static bool terminates(Stmt* s) {
+        if (!s) return false;
+        switch (s->kind) {
+        case NodeKind::ReturnStmt: case NodeKind::BreakStmt: case NodeKind::ContinueStmt: return true;
+        case NodeKind::Block: { auto& items = cast<Block>(*s).items; return !items.empty() && terminates(items.back()); }
+        case NodeKind::IfStmt: { auto* i = &cast<IfStmt>(*s); return terminates(i->thenS) && terminates(i->elseS); }
+        default: return false;
+        }
+    }
+
+    void drop(Stmt* s) { ++st.unreachable; st.nodesRemoved += countNodes(s); }
+
+    // A statement that must stay a statement (loop and branch bodies).
+    Stmt* foldBody(Stmt* s) {
+        Stmt* r = fold(s);
+        return r ? r : make<Block>();
+    }
+
+    // A single statement standing in for a construct that had its own
+    // scope: keep declarations from leaking into the enclosing block.
+    Stmt* scoped(Stmt* s) {
+        if (!s || s->kind != NodeKind::Decl) return s;
+        auto* b = make<Block>();
+        b->items.push_back(s);
+        return b;
+    }
+
+    void fold(Block& b) {
+        scopes.emplace_back();
+        size_t out = 0;
+        for (size_t i = 0; i < b.items.size(); ++i) {
+            if (out && terminates(b.items[out - 1])) { drop(b.items[i]); continue; }
+            if (Stmt* s = fold(b.items[i])) b.items[out++] = s;
+        }
+        b.items.resize(out);
+        scopes.pop_back();
+    }
+
+    // Returns the replacement statement, or null when it is removed.
+    Stmt* fold(Stmt* s) {
+        if (!s) return s;
+        switch (s->kind) {
+        case NodeKind::Decl: {
+            auto* d = &cast<Decl>(*s);
+            d->init = fold(d->init);
+            scopes.back()[d->name] = d;
+            // every read of a constant local gets the value instead
+            if (propagatable(d)) { st.nodesRemoved += countNodes(d); return nullptr; }
+            return s;
+        }
+        case NodeKind::ExprStmt: {
+            auto* x = &cast<ExprStmt>(*s);
+            x->expr = fold(x->expr);
+            if (x->expr && !isPure(x->expr)) return s;
+            st.nodesRemoved += countNodes(s);
+            return nullptr;
+        }
+        case NodeKind::ReturnStmt: { auto* r = &cast<ReturnStmt>(*s); r->expr = fold(r->expr); return s; }
+        case NodeKind::Block: fold(cast<Block>(*s)); return s;
+        case NodeKind::IfStmt: {
+            auto* i = &cast<IfStmt>(*s);
+            i->cond = fold(i->cond);
+            long c;
+            if (constValue(i->cond, c)) {
+                Stmt* taken = (int32_t)c ? i->thenS : i->elseS;
+                Stmt* dead = (int32_t)c ? i->elseS : i->thenS;
+                if (dead) drop(dead);
+                st.nodesRemoved += 1 + countNodes(i->cond);
+                return scoped(fold(taken));
+            }
+            i->thenS = foldBody(i->thenS);
+            if (i->elseS) i->elseS = fold(i->elseS);
+            return s;
+        }
+        case NodeKind::WhileStmt: {
+            auto* w = &cast<WhileStmt>(*s);
+            w->cond = fold(w->cond);
+            long c;
+            if (constValue(w->cond, c) && (int32_t)c == 0) { drop(s); return nullptr; }
+            w->body = foldBody(w->body);
+            return s;
+        }
+        case NodeKind::DoWhileStmt: {
+            auto* d = &cast<DoWhileStmt>(*s);
+            d->body = foldBody(d->body);
+            d->cond = fold(d->cond);
+            return s;
+        }
+        case NodeKind::ForStmt: {
+            auto* l = &cast<ForStmt>(*s);
+            scopes.emplace_back();
+            l->init = fold(l->init);
+            l->cond = fold(l->cond);
+            long c;
+            if (l->cond && constValue(l->cond, c) && (int32_t)c == 0) {
+                // only the initializer ever runs
+                Stmt* init = l->init;
+                l->init = nullptr;
+                drop(s);
+                scopes.pop_back();
+                return scoped(init);
+            }
+            l->step = fold(l->step);
+            l->body = foldBody(l->body);
+            scopes.pop_back();
+            return s;
+        }
+        default: return s;
+        }
+    }
+};
+
+} // namespace
+
+void ConstFold::run(Program& p, ThreadPool* pool, const std::vector<bool>* skip) {
+    std::mutex arenaMu;
+    std::vector<Stats> perFn(p.functions.size());
+    auto one = [&](size_t i) {
+        if (skip && (*skip)[i]) return;
+        FunctionFolder f(p.arena, arenaMu);
+        f.run(*p.functions[i]);
+        perFn[i] = f.st;
+    };
+    if (pool && pool->size()) pool->parallelFor(p.functions.size(), one);
+    else for (size_t i = 0; i < p.functions.size(); ++i) one(i);
+    for (auto& s : perFn) {
+        stats.folded += s.folded;
+        stats.propagated += s.propagated;
+        stats.unreachable += s.unreachable;
+        stats.nodesRemoved += s.nodesRemoved;
+    }
+}
+
+} // namespace cmini
@@ -0,0 +1,29 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+#include "ast.h"
+
+namespace cmini {
+
+class ThreadPool;
+
+// AST simplification between Semantic and IRGen: folds constant
+// BinaryExpr/UnaryExpr trees (with i32 wrap-around, leaving division by
+// zero and out-of-range shifts alone), substitutes int locals that are
+// initialized with a constant and never reassigned or address-taken, and
+// drops statements that can never execute (after return/break/continue,
+// constant-false branches and loops).
+struct ConstFold {
+    struct Stats {
+        size_t folded {0};       // operator nodes replaced by a constant
+        size_t propagated {0};   // variable reads replaced by a constant
+        size_t unreachable {0};  // statements dropped
+        size_t nodesRemoved {0}; // net AST nodes no longer reachable
+    };
+    Stats stats;
+
+    // Functions flagged in `skip` are left as they are (see Semantic).
+    void run(Program& p, ThreadPool* pool = nullptr, const std::vector<bool>* skip = nullptr);
+};
+
+} // namespace cmini
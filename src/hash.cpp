@@ -0,0 +1,59 @@
+#include "hash.h"
+#include <cstring>
+
+namespace cmini {
+
+static uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+static uint64_t fmix(uint64_t k) {
+    k ^= k >> 33; k *= 0xff51afd7ed558ccdull;
+    k ^= k >> 33; k *= 0xc4ceb9fe1a85ec53ull;
+    k ^= k >> 33;
+    return k;
+}
+
+void Hasher::mix(uint64_t w) {
+    a = rotl(a ^ (w * 0x87c37b91114253d5ull), 31) * 0x4cf5ad432745937full + b;
+    b = rotl(b ^ (w * 0x4cf5ad432745937full), 27) * 0x87c37b91114253d5ull + a;
+}
+
+Hasher& Hasher::update(const void* data, size_t n) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    total += n;
+    if (tailLen) {
+        while (n && tailLen < 8) { tail[tailLen++] = *p++; --n; }
+        if (tailLen < 8) return *this;
+        uint64_t w; std::memcpy(&w, tail, 8); mix(w);
+        tailLen = 0;
+    }
+    for (; n >= 8; p += 8, n -= 8) {
+        uint64_t w; std::memcpy(&w, p, 8); mix(w);
+    }
+    std::memcpy(tail, p, n);
+    tailLen = n;
+    return *this;
+}
+
+Hasher::Digest Hasher::digest() const {
+    uint64_t x = a, y = b;
+    uint64_t w = 0;
+    std::memcpy(&w, tail, tailLen);
+    x ^= fmix(w ^ total);
+    y ^= fmix(w + 0x9e3779b97f4a7c15ull);
+    x += y; y += x;
+    x = fmix(x); y = fmix(y);
+    x += y; y += x;
+    return {x, y};
+}
+
+std::string Hasher::Digest::hex() const {
+    static const char* digits = "0123456789abcdef";
+    std::string s(32, '0');
+    for (int i = 0; i < 16; ++i) {
+        s[15 - i] = digits[(hi >> (4 * i)) & 15];
+        s[31 - i] = digits[(lo >> (4 * i)) & 15];
+    }
+    return s;
+}
+
+} // namespace cmini
@@ -0,0 +1,36 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace cmini {
+
+// 128-bit non-cryptographic content hash (two independent 64-bit lanes of
+// multiply-xorshift mixing). Used for cache keys and fingerprints, where
+// inputs are trusted and only accidental collisions matter.
+class Hasher {
+public:
+    Hasher& update(const void* data, size_t n);
+    Hasher& update(std::string_view s) { return update(s.data(), s.size()); }
+    Hasher& str(std::string_view s) { u64(s.size()); return update(s); } // length-prefixed
+    Hasher& u64(uint64_t v) { return update(&v, sizeof v); }
+
+    struct Digest {
+        uint64_t lo {0}, hi {0};
+        bool operator==(const Digest&) const = default;
+        std::string hex() const;
+    };
+    Digest digest() const;
+
+private:
+    void mix(uint64_t w);
+
+    uint64_t a {0x9e3779b97f4a7c15ull};
+    uint64_t b {0xc2b2ae3d27d4eb4full};
+    uint64_t total {0};
+    unsigned char tail[8];
+    size_t tailLen {0};
+};
+
+} // namespace cmini
@@ -0,0 +1,231 @@
+#include "incremental.h"
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include "cache.h"
+#include "outsink.h"
+#include "threadpool.h"
+
+namespace cmini {
+
+namespace {
+
+using FunctionTable = std::unordered_map<SymId, const Function*>;
+
+struct Fingerprinter {
+    Hasher h;
+    const FunctionTable& fns;
+
+    void name(SymId s) { h.str(symName(s)); }
+
+    void type(const Type& t) {
+        h.u64((uint64_t)t.base).u64((uint64_t)t.pointerLevels).u64(t.arrayDims.size());
+        for (size_t d : t.arrayDims) h.u64(d);
+        h.u64((uint64_t)t.namedKind);
+        name(t.namedTag);
+    }
+
+    void signature(const Function& f) {
+        type(f.retType);
+        h.u64(f.params.size());
+        for (auto& p : f.params) type(p.type);
+    }
+
+    // A free name may resolve to a global function (in Semantic and in
+    // IRGen's calls), so its signature is part of the input.
+    // Names that resolve to locals cost a lookup and a marker.
+    void global(SymId s) {
+        auto it = fns.find(s);
+        if (it == fns.end()) { h.u64(0); return; }
+        h.u64(1);
+        signature(*it->second);
+    }
+
+    void expr(const Expr* e) {
+        if (!e) { h.u64(~0ull); return; }
+        h.u64((uint64_t)e->kind);
+        switch (e->kind) {
+        case NodeKind::IntegerLiteral: h.u64((uint64_t)static_cast<const IntegerLiteral*>(e)->value); return;
+        case NodeKind::CharLiteral: h.u64((uint64_t)(unsigned char)static_cast<const CharLiteral*>(e)->value); return;
+        case NodeKind::StringLiteral: h.str(static_cast<const StringLiteral*>(e)->value); return;
+        case NodeKind::VarRef: { auto* v = static_cast<const VarRef*>(e); name(v->name); global(v->name); return; }
+        case NodeKind::ArrayIndex: { auto* a = static_cast<const ArrayIndex*>(e); expr(a->base); expr(a->index); return; }
+        case NodeKind::UnaryExpr: { auto* u = static_cast<const UnaryExpr*>(e); h.u64((uint64_t)u->op); expr(u->operand); return; }
+        case NodeKind::BinaryExpr: { auto* b = static_cast<const BinaryExpr*>(e); h.u64((uint64_t)b->op); expr(b->lhs); expr(b->rhs); return; }
+        case NodeKind::AssignExpr: { auto* a = static_cast<const AssignExpr*>(e); expr(a->lhs); expr(a->rhs); return; }
+        case NodeKind::CallExpr: {
+            auto* c = static_cast<const CallExpr*>(e);
+            name(c->callee); global(c->callee);
+            h.u64(c->args.size());
+            for (auto* a : c->args) expr(a);
+            return;
+        }
+        default: return;
+        }
+    }
+
+    void stmt(const Stmt* s) {
+        if (!s) { h.u64(~0ull); return; }
+        h.u64((uint64_t)s->kind);
+        switch (s->kind) {
+        case NodeKind::Decl: { auto* d = static_cast<const Decl*>(s); type(d->varType); name(d->name); expr(d->init); return; }
+        case NodeKind::ExprStmt: expr(static_cast<const ExprStmt*>(s)->expr); return;
+        case NodeKind::ReturnStmt: expr(static_cast<const ReturnStmt*>(s)->expr); return;
+        case NodeKind::Block: {
+            auto* b = static_cast<const Block*>(s);
+            h.u64(b->items.size());
+            for (auto* it : b->items) stmt(it);
+            return;
+        }
+        case NodeKind::IfStmt: { auto* i = static_cast<const IfStmt*>(s); expr(i->cond); stmt(i->thenS); stmt(i->elseS); return; }
+        case NodeKind::WhileStmt: { auto* w = static_cast<const WhileStmt*>(s); expr(w->cond); stmt(w->body); return; }
+        case NodeKind::DoWhileStmt: { auto* d = static_cast<const DoWhileStmt*>(s); stmt(d->body); expr(d->cond); return; }
+        case NodeKind::ForStmt: {
+            auto* f = static_cast<const ForStmt*>(s);
+            stmt(f->init); expr(f->cond); expr(f->step); stmt(f->body);
+            return;
+        }
+        default: return; // break, continue: the kind says it all
+        }
+    }
+
+    void function(const Function& f) {
+        name(f.name);
+        signature(f);
+        for (auto& p : f.params) name(p.name);
+        stmt(f.body);
+    }
+};
+
+} // namespace
+
+// Folds each function's callees into its digest, callees first: the
+// strongly connected components of the call graph (Tarjan, iteratively)
+// come out in reverse topological order, so every component can hash its
+// members together with the finished digests of what they call.
+static void addCallees(const Program& p, std::vector<Hasher::Digest>& fps) {
+    auto calls = callGraph(p);
+    size_t n = fps.size(), next = 0;
+    const size_t none = ~size_t(0);
+    std::vector<size_t> index(n, none), low(n, 0), comp(n, none), stack;
+    std::vector<char> onStack(n, 0);
+    std::vector<std::pair<size_t, size_t>> dfs; // function, next edge
+    std::vector<Hasher::Digest> out(n);
+    size_t comps = 0;
+    for (size_t root = 0; root < n; ++root) {
+        if (index[root] != none) continue;
+        dfs.push_back({root, 0});
+        while (!dfs.empty()) {
+            auto& [v, e] = dfs.back();
+            if (e == 0 && index[v] == none) {
+                index[v] = low[v] = next++;
+                stack.push_back(v); onStack[v] = 1;
+            }
+            if (e < calls[v].size()) {
+                size_t w = calls[v][e++];
+                if (index[w] == none) dfs.push_back({w, 0});
+                else if (onStack[w]) low[v] = std::min(low[v], index[w]);
+                continue;
+            }
+            size_t done = v;
+            dfs.pop_back();
+            if (!dfs.empty()) low[dfs.back().first] = std::min(low[dfs.back().first], low[done]);
+            if (low[done] != index[done]) continue;
+            // done roots a component: pop it and hash it
+            std::vector<size_t> members;
+            size_t w;
+            do { w = stack.back(); stack.pop_back(); onStack[w] = 0; comp[w] = comps; members.push_back(w); } while (w != done);
+            std::sort(members.begin(), members.end());
+            Hasher h;
+            for (size_t m : members) h.u64(fps[m].lo).u64(fps[m].hi);
+            for (size_t m : members)
+                for (size_t c : calls[m])
+                    if (comp[c] != comps) h.u64(out[c].lo).u64(out[c].hi);
+            Hasher::Digest whole = h.digest();
+            for (size_t m : members) out[m] = Hasher().u64(whole.lo).u64(whole.hi).u64(fps[m].lo).u64(fps[m].hi).digest();
+            ++comps;
+        }
+    }
+    fps = std::move(out);
+}
+
+std::vector<Hasher::Digest> fingerprintFunctions(const Program& p, std::string_view options, ThreadPool* pool,
+                                                 bool callees) {
+    // later definitions win, as in Semantic's global scope
+    FunctionTable fns;
+    for (auto* f : p.functions) fns[f->name] = f;
+
+    std::vector<Hasher::Digest> out(p.functions.size());
+    auto one = [&](size_t i) {
+        Fingerprinter fp{{}, fns};
+        fp.h.str(options);
+        fp.function(*p.functions[i]);
+        out[i] = fp.h.digest();
+    };
+    if (pool && pool->size()) pool->parallelFor(out.size(), one);
+    else for (size_t i = 0; i < out.size(); ++i) one(i);
+    if (callees) addCallees(p, out);
+    return out;
+}
+
+// Names the compiler build and the exact output the offsets point into:
+// anything else that writes <out> leaves an index that no longer matches.
+static std::string header(std::string_view output) {
+    std::string h = "cmini-fncache 3 ";
+    h += compilerBuildId();
+    h += ' ';
+    h += std::to_string(output.size());
+    h += ' ';
+    h += Hasher().update(output).digest().hex();
+    h += '\n';
+    return h;
+}
+
+bool FunctionCache::load() {
+    entries.clear();
+    SourceFile index;
+    if (!index.open(outPath + ".fncache") || !old.open(outPath)) return false;
+    std::string_view data = index.text(), text = old.text();
+    std::string head = header(text);
+    if (data.substr(0, head.size()) != head || (data.size() - head.size()) % sizeof(Record)) return false;
+    for (size_t pos = head.size(); pos < data.size(); pos += sizeof(Record)) {
+        Record r;
+        std::memcpy(&r, data.data() + pos, sizeof r);
+        if (r.offset > text.size() || r.length > text.size() - r.offset) { entries.clear(); return false; }
+        entries.emplace(Hasher::Digest{r.lo, r.hi}, text.substr(r.offset, r.length));
+    }
+    return true;
+}
+
+std::string_view FunctionCache::find(const Hasher::Digest& d) const {
+    auto it = entries.find(d);
+    return it == entries.end() ? std::string_view() : it->second;
+}
+
+void FunctionCache::add(const Hasher::Digest& d, uint64_t offset, uint64_t length) {
+    next.push_back({d.lo, d.hi, offset, length});
+}
+
+void FunctionCache::discard() { ::unlink((outPath + ".fncache").c_str()); }
+
+bool FunctionCache::commit() {
+    SourceFile output;
+    if (!output.open(outPath)) return false;
+    std::string path = outPath + ".fncache", tmp = path + ".tmp";
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return false;
+    bool ok;
+    {
+        OutSink sink(fd);
+        sink << header(output.text());
+        sink.write(reinterpret_cast<const char*>(next.data()), next.size() * sizeof(Record));
+        sink.flush();
+        ok = sink.ok();
+    }
+    ok = ::close(fd) == 0 && ok;
+    if (!ok || ::rename(tmp.c_str(), path.c_str()) != 0) { ::unlink(tmp.c_str()); return false; }
+    return true;
+}
+
+} // namespace cmini
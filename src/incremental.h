@@ -0,0 +1,59 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "ast.h"
+#include "hash.h"
+#include "source.h"
+
+namespace cmini {
+
+class ThreadPool;
+
+// Fingerprint of everything that can change a function's IR: its own
+// signature and body, the signatures of the functions it names, and the
+// output-affecting options. Names are hashed by spelling, so fingerprints
+// are stable across processes. With `callees` (when the inliner may copy
+// them in) a fingerprint also covers the bodies of every function reachable
+// through calls.
+std::vector<Hasher::Digest> fingerprintFunctions(const Program& p, std::string_view options,
+                                                 ThreadPool* pool = nullptr, bool callees = false);
+
+// Index next to an output file (<out>.fncache) that records, for every
+// function of the last successful build, its fingerprint and where its IR
+// text sits inside <out>. The text itself is not duplicated: a rebuild maps
+// the previous output and splices unchanged functions out of it, which is
+// why incremental builds write the new output under a temporary name and
+// rename it into place. Layout: a header line naming the compiler build
+// and the size and content hash of <out>, then records of { u64 lo,
+// u64 hi, u64 offset, u64 length }. Whatever else writes <out> should
+// discard() the index first.
+class FunctionCache {
+public:
+    explicit FunctionCache(std::string outPath) : outPath(std::move(outPath)) {}
+
+    // Maps the previous output; false when it or the index is missing,
+    // corrupt or from another compiler build (everything is then rebuilt).
+    bool load();
+    std::string_view find(const Hasher::Digest& d) const; // empty on a miss
+
+    // Records where function text landed in the new output. discard() must
+    // run before the old output is replaced, so a crash in between never
+    // pairs the old index with the new file; commit() then publishes the
+    // new index for the output now in place.
+    void add(const Hasher::Digest& d, uint64_t offset, uint64_t length);
+    void discard();
+    bool commit();
+
+private:
+    struct DigestHash { size_t operator()(const Hasher::Digest& d) const { return (size_t)d.lo; } };
+    struct Record { uint64_t lo, hi, offset, length; };
+
+    std::string outPath;
+    SourceFile old;
+    std::unordered_map<Hasher::Digest, std::string_view, DigestHash> entries;
+    std::vector<Record> next;
+};
+
+} // namespace cmini
@@ -0,0 +1,196 @@
+#include "inliner.h"
+#include <algorithm>
+#include <cmath>
+#include "profile.h"
+
+namespace cmini::ir {
+
+namespace {
+
+// A call waiting to be considered, with the functions inlined on the way
+// to it (outermost first).
+struct Site {
+    Id call;
+    std::vector<SymId> path;
+    uint64_t count {NoCount}; // executions, when the profile tells
+};
+
+// Copies one callee body into f.
+struct Cloner {
+    Function& f;
+    const Function& g;
+    std::vector<Value> args; // bound to g's parameters
+    double scale {-1};       // for the copy's branch weights, if not negative
+    std::vector<Id> blockMap, instMap;
+    std::vector<Id> callBlocks; // g's block of each call inlineAt returns
+
+    Ty type(Ty t) {
+        if (!t.array) return t;
+        const ArrayType& a = g.arrays[t.array - 1];
+        Ty r = f.arrayOf(a.dims, a.elem);
+        r.ptr = t.ptr;
+        return r;
+    }
+
+    Value map(Value v) {
+        switch (v.kind) {
+        case Value::Inst: return Value::inst(instMap[v.id()]);
+        case Value::Arg: return args[v.id()];
+        case Value::Block: return Value::block(blockMap[v.id()]);
+        case Value::Func: {
+            const Callee& c = g.callees[v.id()];
+            std::vector<Ty> params;
+            for (Ty p : c.params) params.push_back(type(p));
+            return Value::func(f.callee(c.name, type(c.ret), params));
+        }
+        default: return v;
+        }
+    }
+
+    // Replaces `call` with the body; returns the calls the copy contains.
+    std::vector<Id> inlineAt(Id call) {
+        Id b = f.insts[call].block;
+        for (uint32_t k = 1; k < f.insts[call].opCount; ++k) args.push_back(f.operand(call, k));
+
+        // split b after the call: the tail moves to a continuation block,
+        // which becomes the predecessor b was in its successors' phis
+        Id cont = f.addBlock("call.end");
+        auto& list = f.blocks[b].insts;
+        size_t at = (size_t)(std::find(list.begin(), list.end(), call) - list.begin());
+        std::vector<Id> tail(list.begin() + (ptrdiff_t)at + 1, list.end());
+        list.resize(at + 1);
+        for (Id i : tail) f.insts[i].block = cont;
+        f.blocks[cont].insts = std::move(tail);
+        for (Id s : f.successors(cont))
+            for (Id i : f.blocks[s].insts) {
+                if (f.insts[i].op != Op::Phi) break;
+                for (uint32_t k = 1; k < f.insts[i].opCount; k += 2)
+                    if (f.operand(i, k) == Value::block(b)) f.setOperand(i, k, Value::block(cont));
+            }
+
+        blockMap.assign(g.blocks.size(), None);
+        instMap.assign(g.insts.size(), None);
+        for (Id cb : g.layout) blockMap[cb] = f.addBlock(cb == g.layout[0] ? "call.body" : g.blocks[cb].hint);
+
+        // instructions first, operands once every result has an id
+        Id entry = f.layout[0];
+        size_t allocas = 0;
+        while (allocas < f.blocks[entry].insts.size() && f.insts[f.blocks[entry].insts[allocas]].op == Op::Alloca) ++allocas;
+        std::vector<std::pair<Value, Id>> rets; // returned value, returning block
+        std::vector<Id> calls;
+        for (Id cb : g.layout)
+            for (Id ci : g.blocks[cb].insts) {
+                const Inst& in = g.insts[ci];
+                Id nb = blockMap[cb];
+                if (in.op == Op::Ret) {
+                    rets.push_back({in.opCount ? g.operand(ci, 0) : Value(), nb});
+                    f.append(nb, Op::Br, Ty::voidTy(), {Value::block(cont)});
+                    continue;
+                }
+                Id ni = f.append(nb, in.op, type(in.ty), {}, in.pred);
+                instMap[ci] = ni;
+                if (in.op == Op::Alloca) f.move(ni, entry, allocas++); // once per caller, not per call
+                if (in.op == Op::Call) { calls.push_back(ni); callBlocks.push_back(cb); }
+            }
+        std::vector<Value> ops;
+        for (Id cb : g.layout)
+            for (Id ci : g.blocks[cb].insts) {
+                if (instMap[ci] == None) continue;
+                ops.clear();
+                for (uint32_t k = 0; k < g.insts[ci].opCount; ++k) ops.push_back(map(g.operand(ci, k)));
+                if (g.insts[ci].op == Op::CondBr && ops.size() == 5 && scale >= 0)
+                    for (size_t k = 3; k < 5; ++k) ops[k] = Value::cst((int64_t)std::llround((double)ops[k].num * scale));
+                f.setOperands(instMap[ci], ops);
+            }
+
+        Ty rt = f.insts[call].ty;
+        if (!(rt == Ty::voidTy())) {
+            Value result = Value::cst(0); // never returns: the continuation is unreachable
+            if (rets.size() == 1) {
+                result = map(rets[0].first);
+            } else if (rets.size() > 1) {
+                Id phi = f.insert(cont, 0, Op::Phi, rt, {});
+                ops.clear();
+                for (auto& [v, from] : rets) { ops.push_back(map(v)); ops.push_back(Value::block(from)); }
+                f.setOperands(phi, ops);
+                result = Value::inst(phi);
+            }
+            f.replaceAllUses(call, result);
+        }
+        f.erase(call);
+        f.append(b, Op::Br, Ty::voidTy(), {Value::block(blockMap[g.layout[0]])});
+
+        auto pos = std::find(f.layout.begin(), f.layout.end(), b) + 1;
+        std::vector<Id> added;
+        for (Id cb : g.layout) added.push_back(blockMap[cb]);
+        added.push_back(cont);
+        f.layout.insert(pos, added.begin(), added.end());
+        return calls;
+    }
+};
+
+} // namespace
+
+size_t Inliner::cost(const Function& f) {
+    size_t n = 0;
+    for (Id b : f.layout)
+        for (Id i : f.blocks[b].insts) {
+            Op o = f.insts[i].op;
+            n += o != Op::Phi && o != Op::Alloca && o != Op::Count; // counters do not change what is worth inlining
+        }
+    return n;
+}
+
+void Inliner::run(Function& f) {
+    size_t size = cost(f), limit = size + threshold * growthFactor;
+    std::vector<Site> work; // a stack, so sites are reported in program order
+    std::vector<uint64_t> counts = hotCount ? blockCounts(f) : std::vector<uint64_t>();
+    for (auto b = f.layout.rbegin(); b != f.layout.rend(); ++b) {
+        auto& list = f.blocks[*b].insts;
+        for (auto i = list.rbegin(); i != list.rend(); ++i)
+            if (f.insts[*i].op == Op::Call) work.push_back({*i, {}, counts.empty() ? NoCount : counts[*b]});
+    }
+    while (!work.empty()) {
+        Site s = std::move(work.back());
+        work.pop_back();
+        SymId name = f.callees[f.operand(s.call, 0).id()].name;
+        const Function* g = body ? body(name) : nullptr;
+        size_t c = g ? cost(*g) : 0;
+        size_t limitHere = threshold;
+        const char* kind = "";
+        if (hotCount && s.count != NoCount && s.count >= hotCount) { limitHere = hotThreshold; kind = "hot "; }
+        else if (hotCount && s.count == 0) { limitHere = coldThreshold; kind = "cold "; }
+        std::string why;
+        if (name == f.name || std::find(s.path.begin(), s.path.end(), name) != s.path.end()) why = "recursive";
+        else if (!g) why = "no body";
+        else if (g->params.size() + 1 != f.insts[s.call].opCount) why = "argument count mismatch";
+        else if (c > limitHere) why = "cost " + std::to_string(c) + " over " + kind + "threshold " + std::to_string(limitHere);
+        else if (size + c > limit) why = "caller would exceed " + std::to_string(limit) + " instructions";
+        ++stats.sites;
+        if (report) {
+            *report += "inline: ";
+            *report += symName(f.name);
+            for (SymId p : s.path) { *report += " -> "; *report += symName(p); }
+            *report += " -> ";
+            *report += symName(name);
+            if (why.empty()) *report += ": inlined (cost " + std::to_string(c) + ", " + kind + "threshold " + std::to_string(limitHere) + ")\n";
+            else *report += ": not inlined, " + why + "\n";
+        }
+        if (!why.empty()) continue;
+
+        Cloner cl {f, *g, {}, -1, {}, {}, {}};
+        bool scaled = s.count != NoCount && g->entryCount != NoCount && g->entryCount > 0;
+        if (scaled) cl.scale = (double)s.count / (double)g->entryCount;
+        auto calls = cl.inlineAt(s.call);
+        size += c;
+        ++stats.inlined;
+        s.path.push_back(name);
+        std::vector<uint64_t> inner = scaled && hotCount ? blockCounts(*g) : std::vector<uint64_t>();
+        for (size_t k = calls.size(); k-- > 0;) {
+            uint64_t n = inner.empty() ? NoCount : (uint64_t)std::llround((double)inner[cl.callBlocks[k]] * cl.scale);
+            work.push_back({calls[k], s.path, n});
+        }
+    }
+}
+
+} // namespace cmini::ir
@@ -0,0 +1,47 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <string>
+#include "ir.h"
+
+namespace cmini::ir {
+
+// Replaces calls to small functions with a copy of the callee's body, run
+// by IRGen at -O1 and up before CSE and LoopOpt. The caller's block is
+// split at the call, the callee's blocks are cloned in between with its
+// arguments bound to the call's operands, its allocas move to the caller's
+// entry block, and every ret becomes a branch to the continuation, where a
+// phi collects the return value when there are several.
+//
+// The cost of a callee is its instruction count without phis and allocas
+// (both free after inlining). A call is inlined when that is at most
+// `threshold` and the caller stays within `threshold * growthFactor`
+// instructions of its original size. Calls that arrive with an inlined
+// body are considered in turn, except those back into a function already
+// being inlined along the way, so recursion is never unrolled.
+//
+// With profile counts (--profile-use), a call site that ran at least
+// hotCount times takes callees up to hotThreshold, one that never ran only
+// up to coldThreshold, and the weights of an inlined body's branches are
+// scaled to the share of the callee's calls made from that site.
+struct Inliner {
+    // The callee's body, or null when it is not available for inlining.
+    std::function<const Function*(SymId)> body;
+    size_t threshold {20};
+    size_t growthFactor {8};
+    std::string* report {nullptr}; // when set, one line per call site
+    uint64_t hotCount {0};         // 0: sites are not told apart by count
+    size_t hotThreshold {0}, coldThreshold {0};
+
+    struct Stats {
+        size_t sites {0};   // call sites considered
+        size_t inlined {0};
+        Stats& operator+=(const Stats& o) { sites += o.sites; inlined += o.inlined; return *this; }
+    };
+    Stats stats;
+
+    static size_t cost(const Function& f);
+    void run(Function& f);
+};
+
+} // namespace cmini::ir
@@ -0,0 +1,45 @@
+#include "intern.h"
+#include <cstring>
+#include <mutex>
+
+namespace cmini {
+
+Interner& Interner::global() {
+    static Interner g;
+    return g;
+}
+
+Interner::Interner() {
+    names.push_back(std::string_view());
+    ids.emplace(std::string_view(), 0);
+}
+
+SymId Interner::intern(std::string_view s) {
+    {
+        std::shared_lock lock(mu);
+        auto it = ids.find(s);
+        if (it != ids.end()) return it->second;
+    }
+    std::unique_lock lock(mu);
+    auto it = ids.find(s);
+    if (it != ids.end()) return it->second;
+    char* p = static_cast<char*>(chars.allocate(s.size(), 1));
+    std::memcpy(p, s.data(), s.size());
+    std::string_view stored(p, s.size());
+    SymId id = (SymId)names.size();
+    names.push_back(stored);
+    ids.emplace(stored, id);
+    return id;
+}
+
+std::string_view Interner::name(SymId id) const {
+    std::shared_lock lock(mu);
+    return names[id];
+}
+
+size_t Interner::size() const {
+    std::shared_lock lock(mu);
+    return names.size();
+}
+
+} // namespace cmini
@@ -0,0 +1,40 @@
+#pragma once
+#include <cstdint>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "arena.h"
+
+namespace cmini {
+
+// 32-bit handle for an interned identifier spelling. 0 is the empty name.
+using SymId = uint32_t;
+
+// Process-wide identifier table. The lexer interns each spelling once;
+// later phases carry SymIds and compare/hash integers. Spellings are kept
+// in an arena and never move, so name() views stay valid for the life of
+// the process. Safe to use from several threads.
+class Interner {
+public:
+    static Interner& global();
+
+    SymId intern(std::string_view s);
+    std::string_view name(SymId id) const;
+    size_t size() const;
+
+private:
+    Interner();
+
+    mutable std::shared_mutex mu;
+    std::unordered_map<std::string_view, SymId> ids;
+    std::vector<std::string_view> names;
+    Arena chars;
+};
+
+inline SymId intern(std::string_view s) { return Interner::global().intern(s); }
+inline std::string_view symName(SymId id) { return Interner::global().name(id); }
+inline std::string symStr(SymId id) { return std::string(symName(id)); }
+
+} // namespace cmini
@@ -0,0 +1,153 @@
+#include "interp.h"
+#include <cstring>
+
+namespace cmini::ir {
+
+namespace {
+
+int64_t wrap32(int64_t v) { return (int32_t)(uint32_t)(uint64_t)v; }
+
+} // namespace
+
+uint64_t Interpreter::allocate(size_t bytes, size_t align) {
+    uint64_t at = (memory.size() + align - 1) / align * align;
+    memory.resize(at + (bytes ? bytes : 1), 0);
+    return at;
+}
+
+int32_t Interpreter::load32(uint64_t addr) const {
+    int32_t v;
+    std::memcpy(&v, memory.data() + addr, 4);
+    return v;
+}
+
+void Interpreter::store32(uint64_t addr, int32_t v) { std::memcpy(memory.data() + addr, &v, 4); }
+
+Interpreter::Result Interpreter::run(const Function& f, const std::vector<int64_t>& args) {
+    Result r;
+    r.ok = call(f, args, r, 0);
+    return r;
+}
+
+bool Interpreter::call(const Function& f, const std::vector<int64_t>& args, Result& r, unsigned depth) {
+    if (args.size() != f.params.size()) {
+        r.error = "expected " + std::to_string(f.params.size()) + " arguments";
+        return false;
+    }
+    if (depth > depthLimit) { r.error = "call depth limit exceeded"; return false; }
+    std::vector<int64_t> vals(f.insts.size(), 0);
+    auto get = [&](Value v) -> int64_t {
+        switch (v.kind) {
+        case Value::Const: case Value::Block: case Value::Func: return v.num;
+        case Value::Inst: return vals[v.id()];
+        case Value::Arg: return args[v.id()];
+        case Value::Empty: return 0;
+        }
+        return 0;
+    };
+    auto inBounds = [&](uint64_t addr, size_t n) { return addr >= 8 && addr <= memory.size() && n <= memory.size() - addr; };
+    auto fail = [&](const std::string& msg) { r.error = msg; return false; };
+
+    std::vector<int64_t> phiVals;
+    Id b = f.layout.empty() ? 0 : f.layout[0], prev = None;
+    for (;;) {
+        const auto& list = f.blocks[b].insts;
+        size_t k = 0;
+        // phis read their inputs all at once, as on the edge from prev
+        phiVals.clear();
+        for (; k < list.size() && f.insts[list[k]].op == Op::Phi; ++k) {
+            Id i = list[k];
+            bool found = false;
+            for (uint32_t n = 0; n + 1 < f.insts[i].opCount; n += 2)
+                if (f.operand(i, n + 1).id() == prev) { phiVals.push_back(get(f.operand(i, n))); found = true; break; }
+            if (!found) return fail("phi without a value for its predecessor");
+            ++r.byOp[(size_t)Op::Phi];
+        }
+        for (size_t n = 0; n < phiVals.size(); ++n) vals[list[n]] = phiVals[n];
+
+        for (; k < list.size(); ++k) {
+            if (++r.executed > stepLimit) return fail("step limit exceeded");
+            Id i = list[k];
+            const Inst& in = f.insts[i];
+            ++r.byOp[(size_t)in.op];
+            auto op = [&](uint32_t n) { return get(f.operand(i, n)); };
+            int32_t x = 0, y = 0;
+            if (in.op <= Op::ICmp) { x = (int32_t)op(0); y = (int32_t)op(1); }
+            switch (in.op) {
+            case Op::Add: vals[i] = wrap32((int64_t)x + y); break;
+            case Op::Sub: vals[i] = wrap32((int64_t)x - y); break;
+            case Op::Mul: vals[i] = wrap32((int64_t)x * y); break;
+            case Op::SDiv: case Op::SRem:
+                if (y == 0 || (x == INT32_MIN && y == -1)) return fail("division overflow");
+                vals[i] = in.op == Op::SDiv ? x / y : x % y;
+                break;
+            case Op::And: vals[i] = x & y; break;
+            case Op::Or: vals[i] = x | y; break;
+            case Op::Xor: vals[i] = x ^ y; break;
+            case Op::Shl: vals[i] = wrap32((int64_t)((uint32_t)x << (y & 31))); break;
+            case Op::AShr: vals[i] = x >> (y & 31); break;
+            case Op::ICmp: {
+                // pointers compare as addresses, everything else as i32
+                int64_t a = in.ty.ptr ? op(0) : x, c = in.ty.ptr ? op(1) : y;
+                switch (in.pred) {
+                case Pred::EQ: vals[i] = a == c; break;
+                case Pred::NE: vals[i] = a != c; break;
+                case Pred::SLT: vals[i] = a < c; break;
+                case Pred::SGT: vals[i] = a > c; break;
+                case Pred::SLE: vals[i] = a <= c; break;
+                case Pred::SGE: vals[i] = a >= c; break;
+                }
+                break;
+            }
+            case Op::ZExt: vals[i] = op(0) & 1; break;
+            case Op::SExt: case Op::Trunc: vals[i] = (int8_t)op(0); break;
+            case Op::Alloca: vals[i] = (int64_t)allocate(f.sizeOf(in.ty)); break;
+            case Op::Load: {
+                uint64_t addr = (uint64_t)op(0);
+                size_t n = f.sizeOf(in.ty);
+                if (!inBounds(addr, n)) return fail("load out of bounds");
+                if (n == 8) { int64_t v; std::memcpy(&v, memory.data() + addr, 8); vals[i] = v; }
+                else if (n == 4) vals[i] = load32(addr);
+                else vals[i] = (int8_t)memory[addr];
+                break;
+            }
+            case Op::Store: {
+                int64_t v = op(0);
+                uint64_t addr = (uint64_t)op(1);
+                size_t n = f.sizeOf(in.ty);
+                if (!inBounds(addr, n)) return fail("store out of bounds");
+                if (n == 8) std::memcpy(memory.data() + addr, &v, 8);
+                else if (n == 4) store32(addr, (int32_t)v);
+                else memory[addr] = (uint8_t)v;
+                break;
+            }
+            case Op::Gep: {
+                int64_t addr = op(0);
+                for (uint32_t n = 1; n < in.opCount; ++n) addr += (int64_t)(int32_t)op(n) * (int64_t)f.strideOf(in.ty, n - 1);
+                vals[i] = addr;
+                break;
+            }
+            case Op::Call: {
+                auto callee = functions.find(f.callees[f.operand(i, 0).id()].name);
+                if (callee == functions.end()) return fail("call to unknown function");
+                std::vector<int64_t> callArgs;
+                for (uint32_t n = 1; n < in.opCount; ++n) callArgs.push_back(op(n));
+                if (!call(*callee->second, callArgs, r, depth + 1)) return false;
+                vals[i] = r.value;
+                break;
+            }
+            case Op::Br: prev = b; b = (Id)op(0); goto next;
+            case Op::CondBr: prev = b; b = (Id)(op(0) ? op(1) : op(2)); goto next;
+            case Op::Ret:
+                r.value = in.opCount ? op(0) : 0;
+                return true;
+            case Op::Count: break; // profile counters live in the compiled module
+            case Op::Phi: case Op::Nop: return fail("unexpected instruction");
+            }
+        }
+        return fail("block without terminator");
+    next:;
+    }
+}
+
+} // namespace cmini::ir
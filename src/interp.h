@@ -0,0 +1,47 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "ir.h"
+
+namespace cmini::ir {
+
+// Reference interpreter for ir::Function. Memory is one flat byte
+// array; pointers are offsets into it (0 is never handed out), allocas and
+// caller buffers are carved from its end, and every access is
+// bounds-checked. It exists to check that passes preserve behaviour and to
+// count what they save in executed instructions, so it favours simplicity
+// over speed. Calls resolve through `functions`; the callee's instructions
+// count towards the caller's result.
+class Interpreter {
+public:
+    std::vector<uint8_t> memory;
+    std::unordered_map<SymId, const Function*> functions;
+    uint64_t stepLimit {1'000'000'000}; // guards against loops that never end
+    unsigned depthLimit {1000};         // and against runaway recursion
+
+    struct Result {
+        bool ok {false};
+        int64_t value {0};
+        std::string error;
+        uint64_t executed {0};                   // instructions run, phis excluded
+        uint64_t byOp[(size_t)Op::Nop + 1] {};   // per opcode, phis included
+    };
+
+    Interpreter() : memory(8, 0) {}
+
+    // Zero-filled block of `bytes`; returns its address.
+    uint64_t allocate(size_t bytes, size_t align = 8);
+    int32_t load32(uint64_t addr) const;
+    void store32(uint64_t addr, int32_t v);
+
+    // Runs f with one value per parameter (pointers are addresses).
+    Result run(const Function& f, const std::vector<int64_t>& args);
+
+private:
+    // Runs f into r.value, or sets r.error and returns false.
+    bool call(const Function& f, const std::vector<int64_t>& args, Result& r, unsigned depth);
+};
+
+} // namespace cmini::ir
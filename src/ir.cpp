@@ -0,0 +1,368 @@
+#include "ir.h"
+#include <algorithm>
+#include "outsink.h"
+
+namespace cmini::ir {
+
+void Function::clear() {
+    name = 0;
+    entryCount = NoCount;
+    params.clear(); insts.clear(); operands.clear(); uses.clear(); blocks.clear(); layout.clear(); arrays.clear(); callees.clear();
+}
+
+Ty Function::arrayOf(const std::vector<uint32_t>& dims, Ty elem) {
+    Ty t = elem;
+    t.ptr = 0;
+    for (size_t k = 0; k < arrays.size() && !t.array; ++k)
+        if (arrays[k].dims == dims && arrays[k].elem == elem) t.array = (uint16_t)(k + 1);
+    if (!t.array) {
+        arrays.push_back({dims, elem});
+        t.array = (uint16_t)arrays.size();
+    }
+    return t;
+}
+
+Id Function::callee(SymId fn, Ty r, const std::vector<Ty>& ps) {
+    for (size_t k = 0; k < callees.size(); ++k)
+        if (callees[k].name == fn && callees[k].ret == r && callees[k].params == ps) return (Id)k;
+    callees.push_back({fn, r, ps});
+    return (Id)callees.size() - 1;
+}
+
+size_t Function::sizeOf(Ty t) const {
+    if (t.ptr) return 8;
+    if (t.array) return strideOf(t, 0);
+    switch (t.base) {
+    case Ty::Void: return 0;
+    case Ty::I1: case Ty::I8: return 1;
+    case Ty::I32: case Ty::F32: return 4;
+    }
+    return 0;
+}
+
+size_t Function::strideOf(Ty t, size_t level) const {
+    if (t.ptr || !t.array) return level ? 0 : sizeOf(t);
+    const ArrayType& a = arrays[t.array - 1];
+    size_t n = sizeOf(a.elem);
+    for (size_t k = level; k < a.dims.size(); ++k) n *= a.dims[k];
+    return n;
+}
+
+Id Function::addBlock(const char* hint) {
+    blocks.push_back({hint, {}});
+    return (Id)blocks.size() - 1;
+}
+
+Id Function::addOperands(Id user, const Value* ops, size_t n) {
+    Id begin = (Id)operands.size();
+    for (size_t k = 0; k < n; ++k) {
+        operands.push_back(ops[k]);
+        uses.push_back({user, None, None});
+        link(begin + (Id)k);
+    }
+    return begin;
+}
+
+void Function::link(Id slot) {
+    const Value& v = operands[slot];
+    if (v.kind != Value::Inst) return;
+    Inst& def = insts[v.id()];
+    uses[slot].prev = None;
+    uses[slot].next = def.firstUse;
+    if (def.firstUse != None) uses[def.firstUse].prev = slot;
+    def.firstUse = slot;
+}
+
+void Function::unlink(Id slot) {
+    const Value& v = operands[slot];
+    if (v.kind != Value::Inst) return;
+    Use& u = uses[slot];
+    if (u.prev != None) uses[u.prev].next = u.next;
+    else insts[v.id()].firstUse = u.next;
+    if (u.next != None) uses[u.next].prev = u.prev;
+    u.prev = u.next = None;
+}
+
+Id Function::append(Id b, Op op, Ty ty, std::initializer_list<Value> ops, Pred pred) {
+    Id id = (Id)insts.size();
+    Inst in; in.op = op; in.pred = pred; in.ty = ty; in.block = b;
+    insts.push_back(in);
+    insts[id].opBegin = addOperands(id, ops.begin(), ops.size());
+    insts[id].opCount = (uint32_t)ops.size();
+    blocks[b].insts.push_back(id);
+    return id;
+}
+
+Id Function::insert(Id b, size_t at, Op op, Ty ty, std::initializer_list<Value> ops) {
+    Id id = append(b, op, ty, ops);
+    auto& list = blocks[b].insts;
+    list.pop_back();
+    list.insert(list.begin() + (ptrdiff_t)at, id);
+    return id;
+}
+
+void Function::setOperand(Id i, uint32_t k, Value v) {
+    Id slot = insts[i].opBegin + k;
+    unlink(slot);
+    operands[slot] = v;
+    link(slot);
+}
+
+void Function::setOperands(Id i, const std::vector<Value>& ops) {
+    Inst& in = insts[i];
+    for (uint32_t k = 0; k < in.opCount; ++k) unlink(in.opBegin + k);
+    if (ops.size() <= in.opCount) {
+        for (size_t k = 0; k < ops.size(); ++k) { operands[in.opBegin + k] = ops[k]; link(in.opBegin + (Id)k); }
+    } else {
+        // the old slots become dead space in the pool
+        in.opBegin = addOperands(i, ops.data(), ops.size());
+    }
+    insts[i].opCount = (uint32_t)ops.size();
+}
+
+void Function::replaceAllUses(Id i, Value v) {
+    while (insts[i].firstUse != None) {
+        Id slot = insts[i].firstUse;
+        unlink(slot);
+        operands[slot] = v;
+        link(slot);
+    }
+}
+
+void Function::erase(Id i) {
+    Inst& in = insts[i];
+    for (uint32_t k = 0; k < in.opCount; ++k) unlink(in.opBegin + k);
+    auto& list = blocks[in.block].insts;
+    for (size_t k = 0; k < list.size(); ++k)
+        if (list[k] == i) { list.erase(list.begin() + (ptrdiff_t)k); break; }
+    in.op = Op::Nop;
+    in.opCount = 0;
+}
+
+void Function::move(Id i, Id b, size_t at) {
+    auto& from = blocks[insts[i].block].insts;
+    for (size_t k = 0; k < from.size(); ++k)
+        if (from[k] == i) { from.erase(from.begin() + (ptrdiff_t)k); break; }
+    auto& to = blocks[b].insts;
+    to.insert(to.begin() + (ptrdiff_t)std::min(at, to.size()), i);
+    insts[i].block = b;
+}
+
+Id Function::terminator(Id b) const {
+    auto& list = blocks[b].insts;
+    return !list.empty() && isTerminator(list.back()) ? list.back() : None;
+}
+
+std::vector<Id> Function::successors(Id b) const {
+    std::vector<Id> out;
+    Id t = terminator(b);
+    if (t == None) return out;
+    for (uint32_t k = 0; k < insts[t].opCount; ++k) {
+        Value v = operand(t, k);
+        if (v.kind == Value::Block) out.push_back(v.id());
+    }
+    return out;
+}
+
+void DomTree::build(const Function& f) {
+    size_t n = f.blocks.size();
+    preds.assign(n, {});
+    order.assign(n, None);
+    idom.assign(n, None);
+    rpo.clear();
+    // iterative DFS from the entry for the postorder
+    std::vector<std::pair<Id, std::vector<Id>>> stack;
+    std::vector<char> seen(n, 0);
+    seen[0] = 1;
+    stack.push_back({0, f.successors(0)});
+    while (!stack.empty()) {
+        auto& [b, succ] = stack.back();
+        if (succ.empty()) { rpo.push_back(b); stack.pop_back(); continue; }
+        Id s = succ.back();
+        succ.pop_back();
+        if (!seen[s]) { seen[s] = 1; stack.push_back({s, f.successors(s)}); }
+    }
+    std::reverse(rpo.begin(), rpo.end());
+    for (size_t k = 0; k < rpo.size(); ++k) order[rpo[k]] = (uint32_t)k;
+    for (Id b : rpo)
+        for (Id s : f.successors(b)) preds[s].push_back(b);
+
+    auto intersect = [&](Id a, Id b) {
+        while (a != b) {
+            while (order[a] > order[b]) a = idom[a];
+            while (order[b] > order[a]) b = idom[b];
+        }
+        return a;
+    };
+    idom[0] = 0;
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (size_t k = 1; k < rpo.size(); ++k) {
+            Id b = rpo[k], d = None;
+            for (Id p : preds[b]) {
+                if (idom[p] == None) continue;
+                d = d == None ? p : intersect(p, d);
+            }
+            if (d != idom[b]) { idom[b] = d; changed = true; }
+        }
+    }
+}
+
+bool DomTree::dominates(Id a, Id b) const {
+    for (;;) {
+        if (a == b) return true;
+        if (b == 0 || b >= idom.size() || idom[b] == None) return false;
+        b = idom[b];
+    }
+}
+
+namespace {
+
+struct Printer {
+    const Function& f;
+    OutSink& out;
+    std::vector<long> number; // print number of each value-producing instruction
+
+    void type(Ty t) {
+        if (t.array) {
+            const ArrayType& a = f.arrays[t.array - 1];
+            for (uint32_t d : a.dims) out << '[' << (long)d << " x ";
+            type(a.elem);
+            for (size_t k = 0; k < a.dims.size(); ++k) out << ']';
+            for (int i = 0; i < t.ptr; ++i) out << '*';
+            return;
+        }
+        switch (t.base) {
+            case Ty::Void: out << "void"; break;
+            case Ty::I1: out << "i1"; break;
+            case Ty::I8: out << "i8"; break;
+            case Ty::I32: out << "i32"; break;
+            case Ty::F32: out << "float"; break;
+        }
+        for (int i = 0; i < t.ptr; ++i) out << '*';
+    }
+
+    void label(Id b) {
+        out << f.blocks[b].hint;
+        if (b) out << (long)b;
+    }
+
+    void value(Value v) {
+        switch (v.kind) {
+        case Value::Const: out << (long)v.num; return;
+        case Value::Inst: out << "%t" << number[v.id()]; return;
+        case Value::Arg: out << '%' << symName(f.params[v.id()].name); return;
+        case Value::Block: out << '%'; label(v.id()); return;
+        case Value::Func: out << '@' << symName(f.callees[v.id()].name); return;
+        case Value::Empty: out << "undef"; return;
+        }
+    }
+
+    void counter(Id i) {
+        long total = (long)f.operand(i, 2).num;
+        out << "getelementptr inbounds ([" << total << " x i64], [" << total << " x i64]* @__cmini_prof."
+            << symName((SymId)f.operand(i, 0).num) << ", i64 0, i64 " << (long)f.operand(i, 1).num << ')';
+    }
+
+    // LLVM takes 32-bit weights; only their ratio matters
+    void weights(uint64_t taken, uint64_t notTaken) {
+        while (taken > UINT32_MAX || notTaken > UINT32_MAX) { taken >>= 1; notTaken >>= 1; }
+        out << ", !prof !{!\"branch_weights\", i32 " << (long)taken << ", i32 " << (long)notTaken << '}';
+    }
+
+    void inst(Id i) {
+        const Inst& in = f.insts[i];
+        auto op = [&](uint32_t k) { value(f.operand(i, k)); };
+        out << "  ";
+        if (number[i]) out << "%t" << number[i] << " = ";
+        switch (in.op) {
+        case Op::Add: case Op::Sub: case Op::Mul: case Op::SDiv: case Op::SRem:
+        case Op::And: case Op::Or: case Op::Xor: case Op::Shl: case Op::AShr: {
+            static const char* names[] = {"add", "sub", "mul", "sdiv", "srem", "and", "or", "xor", "shl", "ashr"};
+            out << names[(int)in.op] << ' '; type(in.ty); out << ' '; op(0); out << ", "; op(1);
+            break;
+        }
+        case Op::ICmp: {
+            static const char* preds[] = {"eq", "ne", "slt", "sgt", "sle", "sge"};
+            out << "icmp " << preds[(int)in.pred] << ' '; type(in.ty); out << ' '; op(0); out << ", "; op(1);
+            break;
+        }
+        case Op::ZExt: out << "zext i1 "; op(0); out << " to "; type(in.ty); break;
+        case Op::SExt: out << "sext i8 "; op(0); out << " to "; type(in.ty); break;
+        case Op::Trunc: out << "trunc i32 "; op(0); out << " to "; type(in.ty); break;
+        case Op::Phi:
+            out << "phi "; type(in.ty); out << ' ';
+            for (uint32_t k = 0; k + 1 < in.opCount; k += 2) {
+                out << (k ? ", [" : "["); op(k); out << ", "; op(k + 1); out << ']';
+            }
+            break;
+        case Op::Alloca: out << "alloca "; type(in.ty); break;
+        case Op::Load: out << "load "; type(in.ty); out << ", "; type(in.ty.pointer()); out << ' '; op(0); break;
+        case Op::Store: out << "store "; type(in.ty); out << ' '; op(0); out << ", "; type(in.ty.pointer()); out << ' '; op(1); break;
+        case Op::Gep:
+            out << "getelementptr "; type(in.ty); out << ", "; type(in.ty.pointer()); out << ' '; op(0);
+            for (uint32_t k = 1; k < in.opCount; ++k) { out << ", i32 "; op(k); }
+            break;
+        case Op::Call: {
+            const Callee& c = f.callees[f.operand(i, 0).id()];
+            out << "call "; type(in.ty); out << ' '; op(0); out << '(';
+            for (uint32_t k = 1; k < in.opCount; ++k) {
+                if (k > 1) out << ", ";
+                type(c.params[k - 1]); out << ' '; op(k);
+            }
+            out << ')';
+            break;
+        }
+        case Op::Br: out << "br label "; op(0); break;
+        case Op::CondBr:
+            out << "br i1 "; op(0); out << ", label "; op(1); out << ", label "; op(2);
+            if (in.opCount == 5) weights((uint64_t)f.operand(i, 3).num, (uint64_t)f.operand(i, 4).num);
+            break;
+        case Op::Ret:
+            if (in.opCount == 0) { out << "ret void"; break; }
+            out << "ret "; type(in.ty); out << ' '; op(0);
+            break;
+        case Op::Count: {
+            // load, add and store of one element of the function's counter array
+            long n = number[i];
+            out << "load i64, i64* "; counter(i);
+            out << "\n  %t" << n << ".1 = add i64 %t" << n << ", 1\n  store i64 %t" << n << ".1, i64* "; counter(i);
+            break;
+        }
+        case Op::Nop: break;
+        }
+        out << '\n';
+    }
+
+    void function() {
+        number.assign(f.insts.size(), 0);
+        long n = 0;
+        for (Id b : f.layout)
+            for (Id i : f.blocks[b].insts) {
+                Op o = f.insts[i].op;
+                if (o == Op::Call && f.insts[i].ty == Ty::voidTy()) continue; // no result
+                if (o != Op::Store && o != Op::Br && o != Op::CondBr && o != Op::Ret) number[i] = ++n;
+            }
+        out << "define "; type(f.ret); out << " @" << symName(f.name) << "(";
+        for (size_t i = 0; i < f.params.size(); ++i) {
+            if (i) out << ", ";
+            type(f.params[i].ty); out << " %" << symName(f.params[i].name);
+        }
+        out << ") ";
+        if (f.entryCount != NoCount) out << "!prof !{!\"function_entry_count\", i64 " << (long)f.entryCount << "} ";
+        out << "{\n";
+        for (size_t k = 0; k < f.layout.size(); ++k) {
+            Id b = f.layout[k];
+            if (k) out << '\n';
+            label(b); out << ":\n";
+            for (Id i : f.blocks[b].insts) inst(i);
+        }
+        out << "}\n\n";
+    }
+};
+
+} // namespace
+
+void print(const Function& f, OutSink& out) { Printer{f, out, {}}.function(); }
+
+} // namespace cmini::ir
@@ -0,0 +1,181 @@
+#pragma once
+#include <cstdint>
+#include <initializer_list>
+#include <vector>
+#include "intern.h"
+
+// In-memory SSA form between the AST and LLVM text. One ir::Function holds
+// everything in flat arrays indexed by 32-bit ids: instructions, their
+// operands, the use chains threaded through those operands, and the basic
+// blocks, which only list instruction ids. Nothing points into another
+// array, so a Function is cheap to build, clear and reuse.
+
+namespace cmini {
+class OutSink;
+}
+
+namespace cmini::ir {
+
+using Id = uint32_t;
+constexpr Id None = ~0u;
+
+enum class Op : uint8_t {
+    // i32 arithmetic: operands (lhs, rhs)
+    Add, Sub, Mul, SDiv, SRem, And, Or, Xor, Shl, AShr,
+    ICmp,   // (lhs, rhs) -> i1; predicate in Inst::pred
+    ZExt,   // (i1) -> i32
+    SExt,   // (i8) -> i32
+    Trunc,  // (i32) -> i8
+    Phi,    // (value, block)*
+    Alloca, // () -> pointer to Inst::ty
+    Load,   // (ptr) -> Inst::ty
+    Store,  // (value, ptr); Inst::ty is the stored type
+    Gep,    // (ptr, index...) with ptr a pointer to Inst::ty, as in LLVM
+    Call,   // (callee, arg...) -> Inst::ty; callee is a Value::Func
+    Br,     // (block)
+    CondBr, // (i1, block, block), plus (taken, not taken) constants with profile counts
+    Ret,    // (value) or () when Inst::ty is void
+    Count,  // (function, counter, counters) constants: bumps a profile counter of
+            // that function (a SymId); only in --instrument builds
+    Nop     // erased; skipped everywhere
+};
+
+enum class Pred : uint8_t { EQ, NE, SLT, SGT, SLE, SGE };
+
+// Scalar, array or pointer type: base type plus indirection levels. Array
+// types are interned per function; `array` is 1 + their index in
+// Function::arrays, and `base` repeats the element's base type.
+struct Ty {
+    enum Base : uint8_t { Void, I1, I8, I32, F32 } base {I32};
+    uint8_t ptr {0};
+    uint16_t array {0};
+    static Ty i32() { return {}; }
+    static Ty i1() { Ty t; t.base = I1; return t; }
+    static Ty voidTy() { Ty t; t.base = Void; return t; }
+    Ty pointer() const { Ty t = *this; ++t.ptr; return t; }
+    Ty pointee() const { Ty t = *this; --t.ptr; return t; }
+    bool operator==(const Ty&) const = default;
+};
+
+// An operand: integer constant, instruction result, function argument,
+// basic block (branch targets, phi predecessors) or called function.
+struct Value {
+    enum Kind : uint8_t { Empty, Const, Inst, Arg, Block, Func } kind {Empty};
+    int64_t num {0}; // constant, or the id of the instruction/argument/block/callee
+    static Value cst(int64_t v) { return {Const, v}; }
+    static Value inst(Id i) { return {Inst, (int64_t)i}; }
+    static Value arg(Id i) { return {Arg, (int64_t)i}; }
+    static Value block(Id b) { return {Block, (int64_t)b}; }
+    static Value func(Id c) { return {Func, (int64_t)c}; }
+    Id id() const { return (Id)num; }
+    bool operator==(const Value&) const = default;
+};
+
+struct Inst {
+    Op op {Op::Nop};
+    Pred pred {Pred::EQ};
+    Ty ty;
+    Id block {None};     // owning block
+    Id opBegin {0};      // operands are Function::operands[opBegin, opBegin + opCount)
+    uint32_t opCount {0};
+    Id firstUse {None};  // head of the chain of operand slots that use this result
+};
+
+// One entry per operand slot; for instruction operands it links the slot
+// into the used instruction's chain.
+struct Use {
+    Id user {None};
+    Id prev {None}, next {None};
+};
+
+struct Block {
+    const char* hint {""}; // label prefix; labels print as hint + id
+    std::vector<Id> insts;
+};
+
+struct Param { Ty ty; SymId name {0}; };
+
+// [dims[0] x [dims[1] x ... elem]]; elem is a scalar or pointer type.
+struct ArrayType {
+    std::vector<uint32_t> dims;
+    Ty elem;
+};
+
+// Signature of a function called from this one, for the call's printed
+// argument types and for the inliner.
+struct Callee {
+    SymId name {0};
+    Ty ret;
+    std::vector<Ty> params;
+};
+
+constexpr uint64_t NoCount = ~0ull;
+
+struct Function {
+    SymId name {0};
+    uint64_t entryCount {NoCount}; // calls recorded by the profile, when there is one
+    Ty ret;
+    std::vector<Param> params;
+    std::vector<Inst> insts;
+    std::vector<Value> operands;
+    std::vector<Use> uses;      // parallel to operands
+    std::vector<Block> blocks;
+    std::vector<Id> layout;     // block order for printing; entry first
+    std::vector<ArrayType> arrays;
+    std::vector<Callee> callees; // indexed by Value::Func
+
+    void clear(); // keeps capacity
+
+    // The array type dims of elem, interned.
+    Ty arrayOf(const std::vector<uint32_t>& dims, Ty elem);
+    size_t sizeOf(Ty t) const;
+    // Index of the callee with this signature, interned.
+    Id callee(SymId name, Ty ret, const std::vector<Ty>& params);
+    // Byte distance between consecutive values of a GEP index at `level`
+    // (0 steps over whole objects of type t, k > 0 over the k-th dimension).
+    size_t strideOf(Ty t, size_t level) const;
+
+    Id addBlock(const char* hint);
+    // Appends a new instruction to block b (or, with at != None, inserts
+    // it before position `at` of the block).
+    Id append(Id b, Op op, Ty ty, std::initializer_list<Value> ops, Pred pred = Pred::EQ);
+    Id insert(Id b, size_t at, Op op, Ty ty, std::initializer_list<Value> ops);
+
+    Value operand(Id i, uint32_t k) const { return operands[insts[i].opBegin + k]; }
+    void setOperand(Id i, uint32_t k, Value v);
+    void setOperands(Id i, const std::vector<Value>& ops); // may relocate the slots
+    void replaceAllUses(Id i, Value v);
+    bool hasUses(Id i) const { return insts[i].firstUse != None; }
+    // Drops the instruction from its block and unlinks its operands.
+    void erase(Id i);
+    // Moves i to position `at` of block b; operands and uses are unchanged.
+    void move(Id i, Id b, size_t at);
+
+    bool isTerminator(Id i) const { Op o = insts[i].op; return o == Op::Br || o == Op::CondBr || o == Op::Ret; }
+    Id terminator(Id b) const;      // None if the block is still open
+    std::vector<Id> successors(Id b) const;
+
+private:
+    Id addOperands(Id user, const Value* ops, size_t n);
+    void link(Id slot);
+    void unlink(Id slot);
+};
+
+// Dominator tree of the blocks reachable from the entry block, built with
+// Cooper, Harvey and Kennedy's iterative algorithm.
+struct DomTree {
+    std::vector<Id> rpo;                // reachable blocks in reverse postorder
+    std::vector<uint32_t> order;        // position in rpo, None if unreachable
+    std::vector<Id> idom;               // immediate dominator; the entry's is itself
+    std::vector<std::vector<Id>> preds; // reachable predecessors
+
+    void build(const Function& f);
+    bool dominates(Id a, Id b) const;
+};
+
+// Prints f as an LLVM IR function definition. Results are numbered %t1,
+// %t2, ... in layout order, so the text does not depend on how the
+// function was built or how many instructions passes removed.
+void print(const Function& f, OutSink& out);
+
+} // namespace cmini::ir
@@ -1,183 +1,740 @@
 #include "irgen.h"
-#include <sstream>
+#include <algorithm>
+#include <mutex>
+#include <numeric>
+#include "threadpool.h"
 
 namespace cmini {
 
-std::string IRGen::typeToIR(const Type& t) {
-    std::string b;
+using ir::Id;
+using ir::Op;
+using ir::Ty;
+
+namespace {
+
+// Target of an assignment or ++/--, if it is a plain variable.
+SymId assignedName(Node* n) {
+    Expr* lhs = nullptr;
+    if (auto* a = dyn_cast<AssignExpr>(n)) lhs = a->lhs;
+    else if (auto* u = dyn_cast<UnaryExpr>(n); u && (u->op == UnaryOp::PreInc || u->op == UnaryOp::PreDec)) lhs = u->operand;
+    auto* v = dyn_cast<VarRef>(lhs);
+    return v ? v->name : 0;
+}
+
+bool isScalar(const Type& t) { return t.pointerLevels == 0 && t.arrayDims.empty() && t.base != BaseType::Void; }
+
+bool icmpPred(BinaryOp op, ir::Pred& p) {
+    switch (op) {
+    case BinaryOp::LT: p = ir::Pred::SLT; return true; case BinaryOp::GT: p = ir::Pred::SGT; return true;
+    case BinaryOp::LE: p = ir::Pred::SLE; return true; case BinaryOp::GE: p = ir::Pred::SGE; return true;
+    case BinaryOp::EQ: p = ir::Pred::EQ; return true;  case BinaryOp::NE: p = ir::Pred::NE; return true;
+    default: return false;
+    }
+}
+
+// Scalar or pointer type; for an array, the type of its elements.
+Ty irType(const Type& t) {
+    Ty r;
     switch (t.base) {
-        case BaseType::Void: b = "void"; break;
-        case BaseType::Int: b = "i32"; break;
-        case BaseType::Char: b = "i8"; break;
-        case BaseType::Float: b = "float"; break;
+        case BaseType::Void: r.base = Ty::Void; break;
+        case BaseType::Int: r.base = Ty::I32; break;
+        case BaseType::Char: r.base = Ty::I8; break;
+        case BaseType::Float: r.base = Ty::F32; break;
     }
-    for (int i=0;i<t.pointerLevels;++i) b += "*";
-    // arrays are lowered as pointers to first element for now
-    if (!t.arrayDims.empty()) b += "*";
-    return b;
-    return "i32";
+    r.ptr = (uint8_t)t.pointerLevels;
+    return r;
 }
 
-std::string IRGen::newTmp() { std::ostringstream os; os << "%t" << (++tmpCounter); return os.str(); }
+bool isByte(Ty t) { return t.base == Ty::I8 && !t.ptr && !t.array; }
+
+// Per-thread function under construction, reused so its arrays keep their
+// capacity from one function to the next.
+ir::Function& scratch() { static thread_local ir::Function f; return f; }
+
+} // namespace
+
+void IRGen::gen(Program& p, OutSink& sink, ThreadPool* pool) {
+    out = &sink;
+    *out << "; ModuleID = 'cmini'\nsource_filename = \"cmini\"\n\n";
+    if (pool && pool->size() == 0) pool = nullptr;
+    declare(p);
+    if (optLevel > 0) prepareInlining(p, pool);
+    counters.clear();
+    if (!pool && !reuse && !onFunction) {
+        for (size_t i : order(p)) { gen(*p.functions[i]); out->flush(); }
+        if (instrument) ir::printProfileRuntime(counters, *out);
+        out->flush();
+        out = nullptr;
+        return;
+    }
+    std::vector<size_t> seq(p.functions.size());
+    if (reuse || onFunction) std::iota(seq.begin(), seq.end(), 0);
+    else seq = order(p);
+    // Work in windows of a few functions per worker so buffered text stays
+    // bounded; each window is emitted in order once it is complete.
+    size_t window = pool ? (size_t)pool->size() * 8 : 1;
+    std::mutex statsMu;
+    std::vector<std::unique_ptr<OutSink>> bufs(window);
+    std::vector<std::string> reports(window);
+    std::vector<ir::Counters> found(window);
+    auto reused = [&](size_t k) { return reuse && !(*reuse)[k].empty(); };
+    for (size_t base = 0; base < seq.size(); base += window) {
+        size_t n = std::min(window, seq.size() - base);
+        auto genAt = [&](size_t i) {
+            if (reused(seq[base + i])) return;
+            if (!bufs[i]) bufs[i] = std::make_unique<OutSink>();
+            IRGen g; g.out = bufs[i].get(); configure(g);
+            g.gen(*p.functions[seq[base + i]]);
+            reports[i] = std::move(g.report);
+            if (!g.counters.empty()) found[i] = g.counters[0];
+            std::lock_guard<std::mutex> lock(statsMu);
+            loopStats += g.loopStats;
+            cseRemoved += g.cseRemoved;
+            inlineStats += g.inlineStats;
+            profileStale += g.profileStale;
+        };
+        if (pool) pool->parallelFor(n, genAt);
+        else genAt(0);
+        for (size_t i = 0; i < n; ++i) {
+            size_t k = seq[base + i];
+            if (reused(k)) {
+                std::string_view text = (*reuse)[k];
+                if (onFunction) onFunction(k);
+                *out << text;
+                continue;
+            }
+            if (onFunction) onFunction(k);
+            out->append(*bufs[i]);
+            bufs[i]->clear();
+            report += reports[i];
+            reports[i].clear();
+            if (instrument) counters.push_back(found[i]);
+        }
+        out->flush();
+    }
+    if (instrument) { ir::printProfileRuntime(counters, *out); out->flush(); }
+    out = nullptr;
+}
 
 std::string IRGen::gen(Program& p) {
-    out.clear(); tmpCounter=0;
-    out += "; ModuleID = 'cmini'\nsource_filename = \"cmini\"\n\n";
-    for (auto& f : p.functions) gen(*f);
-    return out;
+    OutSink sink;
+    gen(p, sink);
+    return sink.str();
+}
+
+std::vector<size_t> IRGen::order(const Program& p) const {
+    std::vector<size_t> seq(p.functions.size());
+    std::iota(seq.begin(), seq.end(), 0);
+    if (!profile) return seq;
+    // hot first, hottest leading; then the rest as written; then the cold
+    std::vector<uint64_t> heat(seq.size());
+    std::vector<int> rank(seq.size(), 1);
+    for (size_t i = 0; i < seq.size(); ++i) {
+        const FunctionProfile* fp = profile->find(p.functions[i]->name);
+        if (!fp) continue;
+        heat[i] = fp->hottest();
+        rank[i] = heat[i] >= profile->hotCount() ? 0 : heat[i] == 0 ? 2 : 1;
+    }
+    std::stable_sort(seq.begin(), seq.end(), [&](size_t a, size_t b) {
+        if (rank[a] != rank[b]) return rank[a] < rank[b];
+        return rank[a] == 0 && heat[a] > heat[b];
+    });
+    return seq;
+}
+
+void IRGen::declare(Program& p) {
+    functions.clear();
+    for (auto* f : p.functions) functions[f->name] = f; // later definitions win, as in Semantic
+}
+
+// Lowers and optimizes, once, every function that the functions about to
+// be generated call, directly or from inside the bodies they inline.
+void IRGen::prepareInlining(Program& p, ThreadPool* pool) {
+    bodies.clear();
+    std::vector<bool> generated(p.functions.size());
+    for (size_t i = 0; i < generated.size(); ++i) generated[i] = !reuse || (*reuse)[i].empty();
+    auto called = reachableCallees(callGraph(p), generated);
+    std::vector<std::pair<Function*, ir::Function*>> work;
+    for (size_t i = 0; i < called.size(); ++i)
+        if (called[i]) work.push_back({p.functions[i], &bodies[p.functions[i]->name]});
+    auto one = [&](size_t k) {
+        IRGen g; g.module = this;
+        g.lower(*work[k].first, *work[k].second);
+        g.optimize(*work[k].second);
+    };
+    if (pool) pool->parallelFor(work.size(), one);
+    else for (size_t k = 0; k < work.size(); ++k) one(k);
+}
+
+void IRGen::lowerAll(Program& p, const std::function<void(size_t, ir::Function&)>& use, ThreadPool* pool) {
+    if (pool && pool->size() == 0) pool = nullptr;
+    declare(p);
+    if (optLevel > 0) prepareInlining(p, pool);
+    std::mutex statsMu;
+    std::vector<std::string> reports(p.functions.size());
+    auto one = [&](size_t i) {
+        IRGen g; configure(g);
+        ir::Function& fn = scratch();
+        g.build(*p.functions[i], fn);
+        use(i, fn);
+        reports[i] = std::move(g.report);
+        std::lock_guard<std::mutex> lock(statsMu);
+        loopStats += g.loopStats;
+        cseRemoved += g.cseRemoved;
+        inlineStats += g.inlineStats;
+        profileStale += g.profileStale;
+    };
+    if (pool) pool->parallelFor(p.functions.size(), one);
+    else for (size_t i = 0; i < p.functions.size(); ++i) one(i);
+    for (auto& r : reports) report += r;
+}
+
+void IRGen::configure(IRGen& g) const {
+    g.module = this;
+    g.optLevel = optLevel;
+    g.inlineThreshold = inlineThreshold;
+    g.inlineReport = inlineReport;
 }
 
 void IRGen::gen(Function& f) {
-    std::ostringstream sig;
-    sig << "define " << typeToIR(f.retType) << " @" << f.name << "(";
-    for (size_t i=0;i<f.params.size();++i) {
-        if (i) sig << ", ";
-        sig << typeToIR(f.params[i].type) << " %" << f.params[i].name;
+    ir::Function& fn = scratch();
+    build(f, fn);
+    ir::print(fn, *out);
+}
+
+void IRGen::build(Function& f, ir::Function& fn) {
+    lower(f, fn);
+    if (optLevel > 0) {
+        ir::Inliner in;
+        in.threshold = inlineThreshold >= 0 ? (size_t)inlineThreshold : defaultInlineThreshold(optLevel);
+        in.body = [&](SymId name) -> const ir::Function* {
+            auto it = module->bodies.find(name);
+            return it == module->bodies.end() ? nullptr : &it->second;
+        };
+        if (inlineReport) in.report = &report;
+        if (module->profile) {
+            in.hotCount = module->profile->hotCount();
+            in.hotThreshold = in.threshold * 4;
+            in.coldThreshold = in.threshold / 4;
+        }
+        in.run(fn);
+        inlineStats += in.stats;
+        optimize(fn);
+    }
+    if (module->profile) ir::layoutByProfile(fn);
+}
+
+void IRGen::optimize(ir::Function& fn) {
+    ir::CSE cse;
+    cse.run(fn);
+    cseRemoved += cse.removed;
+    ir::LoopOpt opt;
+    opt.run(fn);
+    loopStats += opt.stats;
+}
+
+void IRGen::lower(Function& f, ir::Function& target) {
+    fn = &target;
+    fn->clear();
+    scopes.clear(); locals.clear(); cur.clear(); incoming.clear(); loops.clear(); addrTaken.clear(); args.clear();
+    fn->name = f.name;
+    fn->ret = irType(f.retType);
+    for (auto& prm : f.params) {
+        args[prm.name] = (Id)fn->params.size();
+        fn->params.push_back({paramType(prm.type), prm.name});
+    }
+    geps.clear();
+    curBlock = newBlock("entry");
+    fn->layout.push_back(curBlock);
+    allocas = 0;
+    terminated = false;
+    walk(f.body, [&](Node* n) {
+        if (auto* u = dyn_cast<UnaryExpr>(n); u && u->op == UnaryOp::Addr)
+            if (auto* v = dyn_cast<VarRef>(u->operand)) addrTaken.push_back(v->name);
+    });
+
+    pushScope();
+    for (auto& prm : f.params) {
+        // every parameter is a promoted slot, so assigning it makes a new
+        // SSA value; scalars and pointers whose address is taken live in
+        // memory instead (an array parameter is a pointer value either way)
+        bool taken = prm.type.arrayDims.empty() &&
+                     std::find(addrTaken.begin(), addrTaken.end(), prm.name) != addrTaken.end();
+        int slot = newSlot(!taken, prm.type);
+        scopes.back()[prm.name] = slot;
+        if (taken) emit(Op::Store, irType(prm.type), {Value::arg(args[prm.name]), locals[slot].addr});
+        else cur[slot] = widen(paramType(prm.type), Value::arg(args[prm.name]));
+    }
+    if (f.body) gen(*f.body);
+    if (!terminated) { // falling off the end
+        if (fn->ret.base == Ty::Void && !fn->ret.ptr) emit(Op::Ret, fn->ret, {});
+        else emit(Op::Ret, isByte(fn->ret) ? fn->ret : Ty::i32(), {Value::cst(0)});
+    }
+    popScope();
+    // counts and counters are numbered on the function as lowered, before
+    // any pass changes its branches
+    if (module->profile)
+        if (const FunctionProfile* p = module->profile->find(f.name); p && !ir::annotate(*fn, *p)) ++profileStale;
+    if (module->instrument) {
+        uint64_t sum = ir::cfgChecksum(*fn);
+        counters.push_back({f.name, sum, ir::instrument(*fn)});
+    }
+    fn = nullptr;
+}
+
+IRGen::Value IRGen::emit(Op op, Ty ty, std::initializer_list<Value> ops, ir::Pred pred) {
+    return Value::inst(fn->append(curBlock, op, ty, ops, pred));
+}
+
+Ty IRGen::objectType(const Type& t) {
+    if (t.arrayDims.empty()) return irType(t);
+    return fn->arrayOf(std::vector<uint32_t>(t.arrayDims.begin(), t.arrayDims.end()), irType(t));
+}
+
+Ty IRGen::valueType(const Type& t) {
+    // chars compute as i32; pointers and array parameters are pointers
+    return t.pointerLevels || !t.arrayDims.empty() ? paramType(t) : Ty::i32();
+}
+
+Ty IRGen::paramType(const Type& t) {
+    // an array parameter is a pointer to its first element (a row, when
+    // there are several dimensions)
+    if (t.arrayDims.empty()) return irType(t);
+    if (t.arrayDims.size() == 1) return irType(t).pointer();
+    return fn->arrayOf(std::vector<uint32_t>(t.arrayDims.begin() + 1, t.arrayDims.end()), irType(t)).pointer();
+}
+
+IRGen::Value IRGen::emitAlloca(Ty ty) {
+    return Value::inst(fn->insert(fn->layout[0], allocas++, Op::Alloca, ty, {}));
+}
+
+IRGen::Value IRGen::widen(Ty ty, Value v) {
+    return isByte(ty) ? emit(Op::SExt, Ty::i32(), {v}) : v;
+}
+
+IRGen::Value IRGen::narrow(Ty ty, Value v) {
+    if (!isByte(ty)) return v;
+    if (v.kind == Value::Const) return Value::cst((int8_t)v.num);
+    return emit(Op::Trunc, ty, {v});
+}
+
+IRGen::Value IRGen::emitLoad(Ty ty, Value addr) { return widen(ty, emit(Op::Load, ty, {addr})); }
+
+void IRGen::emitStore(Ty ty, Value val, Value addr) { emit(Op::Store, ty, {narrow(ty, val), addr}); }
+
+Id IRGen::newBlock(const char* hint) {
+    incoming.emplace_back();
+    return fn->addBlock(hint);
+}
+
+int IRGen::newSlot(bool promoted, const Type& t) {
+    Local l; l.promoted = promoted; l.type = t;
+    if (!promoted) l.addr = emitAlloca(objectType(t));
+    locals.push_back(l);
+    cur.push_back(Value::cst(0));
+    return (int)locals.size() - 1;
+}
+
+int IRGen::lookupSlot(SymId name) {
+    for (auto it = scopes.rbegin(); it != scopes.rend(); ++it) {
+        auto f = it->find(name);
+        if (f != it->end()) return f->second;
     }
-    sig << ") {\n";
-    out += sig.str();
-    allocaStack.clear(); valueStack.clear(); typeStack.clear();
-    allocaStack.emplace_back(); valueStack.emplace_back(); typeStack.emplace_back();
-    if (f.body) {
-        out += "entry:\n";
-        gen(*f.body);
+    return -1;
+}
+
+void IRGen::pushScope() { scopes.emplace_back(); }
+
+void IRGen::popScope() {
+    // out-of-scope values must not cause phis at later joins
+    for (auto& [name, slot] : scopes.back()) cur[slot] = Value::cst(0);
+    scopes.pop_back();
+}
+
+void IRGen::branch(Id to) {
+    if (terminated) return;
+    incoming[to].push_back({curBlock, cur});
+    emit(Op::Br, Ty::voidTy(), {Value::block(to)});
+    terminated = true;
+}
+
+void IRGen::condBranch(Value c, Id t, Id f) {
+    if (terminated) return;
+    incoming[t].push_back({curBlock, cur});
+    incoming[f].push_back({curBlock, cur});
+    emit(Op::CondBr, Ty::voidTy(), {c, Value::block(t), Value::block(f)});
+    terminated = true;
+}
+
+bool IRGen::startBlock(Id b) {
+    std::vector<Edge> edges = std::move(incoming[b]);
+    incoming[b].clear();
+    if (edges.empty()) { terminated = true; return false; }
+    fn->layout.push_back(b);
+    curBlock = b;
+    terminated = false;
+    auto valueAt = [](const Edge& e, size_t s) { return s < e.vals.size() ? e.vals[s] : Value::cst(0); };
+    std::vector<Value> ops;
+    for (size_t s = 0; s < cur.size(); ++s) {
+        Value v = valueAt(edges[0], s);
+        bool same = true;
+        for (size_t i = 1; i < edges.size() && same; ++i) same = valueAt(edges[i], s) == v;
+        if (same || !locals[s].promoted) { cur[s] = v; continue; }
+        ops.clear();
+        for (auto& e : edges) { ops.push_back(valueAt(e, s)); ops.push_back(Value::block(e.from)); }
+        Value phi = emit(Op::Phi, valueType(locals[s].type), {});
+        fn->setOperands(phi.id(), ops);
+        cur[s] = phi;
     }
-    out += "}\n\n";
+    return true;
 }
 
 void IRGen::gen(Block& b) {
-    for (auto& s : b.items) gen(*s);
+    pushScope();
+    for (auto& s : b.items) {
+        if (terminated) break; // nothing after return/break/continue can run
+        gen(*s);
+    }
+    popScope();
 }
 
 void IRGen::gen(Stmt& s) {
-    if (auto e = dynamic_cast<ExprStmt*>(&s)) { (void)gen(*e->expr); return; }
-    if (auto r = dynamic_cast<ReturnStmt*>(&s)) {
-        if (r->expr) { auto v = gen(*r->expr); out += "  ret i32 " + v + "\n"; }
-        else out += "  ret void\n";
+    if (terminated) return;
+    switch (s.kind) {
+    case NodeKind::ExprStmt: if (auto* e = cast<ExprStmt>(s).expr) (void)gen(*e); return;
+    case NodeKind::ReturnStmt: {
+        auto* r = &cast<ReturnStmt>(s);
+        Value v = r->expr ? gen(*r->expr) : Value::cst(0);
+        if (fn->ret.base == Ty::Void && !fn->ret.ptr) emit(Op::Ret, fn->ret, {});
+        else emit(Op::Ret, isByte(fn->ret) ? fn->ret : Ty::i32(), {narrow(fn->ret, v)});
+        terminated = true;
         return;
     }
-    if (auto b = dynamic_cast<Block*>(&s)) { gen(*b); return; }
-    // for brevity we do not lower control flow yet; placeholder no-ops
-    if (dynamic_cast<BreakStmt*>(&s) || dynamic_cast<ContinueStmt*>(&s)) return;
-    if (auto d = dynamic_cast<Decl*>(&s)) {
-        // allocate alloca + store init if any
-        std::string irTy = typeToIR(d->varType);
-        std::string tmp = newTmp();
-        out += "  " + tmp + " = alloca " + irTy + "\n";
-        if (!allocaStack.empty()) allocaStack.back()[d->name] = tmp;
-        out += "  ; map " + d->name + " -> " + tmp + "\n";
-        if (!valueStack.empty()) valueStack.back()[d->name] = tmp; // ptr alias
-        if (!typeStack.empty()) typeStack.back()[d->name] = d->varType;
-        if (d->init) {
-            std::string val = gen(*d->init);
-            out += "  store " + irTy + " " + val + ", " + irTy + "* " + tmp + "\n";
-        }
+    case NodeKind::Block: gen(cast<Block>(s)); return;
+    case NodeKind::BreakStmt: if (!loops.empty()) branch(loops.back().exit); return;
+    case NodeKind::ContinueStmt: if (!loops.empty()) branch(loops.back().cont); return;
+    case NodeKind::Decl: {
+        auto* d = &cast<Decl>(s);
+        Value init = d->init ? gen(*d->init) : Value::cst(0);
+        bool promote = isScalar(d->varType) &&
+                       std::find(addrTaken.begin(), addrTaken.end(), d->name) == addrTaken.end();
+        int slot = newSlot(promote, d->varType);
+        scopes.back()[d->name] = slot;
+        if (promote) cur[slot] = init;
+        else if (d->init) emitStore(irType(d->varType), init, locals[slot].addr);
         return;
     }
-    // ignore other statements for minimal MVP
+    case NodeKind::IfStmt: {
+        auto* i = &cast<IfStmt>(s);
+        Id thenL = newBlock("if.then");
+        Id elseL = i->elseS ? newBlock("if.else") : ir::None;
+        Id endL = newBlock("if.end");
+        genBranch(*i->cond, thenL, i->elseS ? elseL : endL);
+        if (startBlock(thenL)) { gen(*i->thenS); branch(endL); }
+        if (i->elseS && startBlock(elseL)) { gen(*i->elseS); branch(endL); }
+        startBlock(endL);
+        return;
+    }
+    case NodeKind::WhileStmt: { auto* w = &cast<WhileStmt>(s); genLoop(w->cond, w->body, nullptr, true); return; }
+    case NodeKind::DoWhileStmt: { auto* d = &cast<DoWhileStmt>(s); genLoop(d->cond, d->body, nullptr, false); return; }
+    case NodeKind::ForStmt: {
+        auto* l = &cast<ForStmt>(s);
+        pushScope();
+        if (l->init) gen(*l->init);
+        if (!terminated) genLoop(l->cond, l->body, l->step, true);
+        popScope();
+        return;
+    }
+    default: return;
+    }
 }
 
-std::string IRGen::gen(Expr& e) {
-    if (auto lit = dynamic_cast<IntegerLiteral*>(&e)) { return std::to_string(lit->value); }
-    if (auto v = dynamic_cast<VarRef*>(&e)) {
-        if (auto p = lookupAlloca(v->name)) {
-            std::string t=newTmp();
-            out += "  ; load from alloca of " + v->name + "\n";
-            out += "  " + t + " = load i32, i32* " + *p + "\n";
-            return t;
+// Lowers a loop. Variables assigned anywhere in it get a phi at the header
+// up front; the phis' back-edge operands are filled in once the whole loop
+// has been lowered, and phis that turn out to merge a single value are
+// folded away.
+void IRGen::genLoop(Expr* cond, Stmt* body, Expr* step, bool condFirst) {
+    Id head = newBlock(condFirst ? "loop.cond" : "loop.body");
+    Id bodyL = condFirst ? newBlock("loop.body") : head;
+    Id contL = !condFirst ? newBlock("loop.cond") : step ? newBlock("loop.step") : head;
+    Id exitL = newBlock("loop.end");
+
+    std::vector<std::pair<int, Value>> phis;
+    auto scan = [&](Node* n) {
+        SymId name = assignedName(n);
+        if (!name) return;
+        int slot = lookupSlot(name);
+        if (slot < 0 || !locals[slot].promoted) return;
+        for (auto& p : phis) if (p.first == slot) return;
+        phis.push_back({slot, Value()});
+    };
+    walk(cond, scan); walk(body, scan); walk(step, scan);
+    branch(head);
+    fn->layout.push_back(head);
+    curBlock = head;
+    terminated = false;
+    for (auto& p : phis) { p.second = emit(Op::Phi, valueType(locals[p.first].type), {}); cur[p.first] = p.second; }
+
+    loops.push_back({contL, exitL});
+    if (condFirst) {
+        if (cond) genBranch(*cond, bodyL, exitL);
+        else branch(bodyL);
+        if (startBlock(bodyL)) { gen(*body); branch(contL); }
+        if (step && startBlock(contL)) { (void)gen(*step); branch(head); }
+    } else {
+        gen(*body);
+        branch(contL);
+        if (startBlock(contL)) genBranch(*cond, head, exitL);
+    }
+    loops.pop_back();
+
+    auto& edges = incoming[head];
+    std::vector<Value> ops;
+    for (auto& [slot, phi] : phis) {
+        ops.clear();
+        Value single = phi;
+        bool trivial = true;
+        for (auto& e : edges) {
+            Value v = e.vals[slot];
+            ops.push_back(v); ops.push_back(Value::block(e.from));
+            if (v == phi || v == single) continue;
+            if (single == phi) single = v; else trivial = false;
+        }
+        if (trivial) {
+            fn->replaceAllUses(phi.id(), single);
+            fn->erase(phi.id());
+            for (auto& c : cur) if (c == phi) c = single;
+            for (auto& list : incoming) for (auto& e : list) for (auto& v : e.vals) if (v == phi) v = single;
+        } else {
+            fn->setOperands(phi.id(), ops);
         }
-        if (auto q = lookupValue(v->name)) {
-            std::string t=newTmp();
-            out += "  ; load from value map of " + v->name + "\n";
-            out += "  " + t + " = load i32, i32* " + *q + "\n";
-            return t;
+    }
+    incoming[head].clear();
+    startBlock(exitL);
+}
+
+IRGen::Value IRGen::genCond(Expr& e) {
+    ir::Pred pred;
+    if (auto* b = dyn_cast<BinaryExpr>(&e); b && icmpPred(b->op, pred)) {
+        Value l = gen(*b->lhs); Value r = gen(*b->rhs);
+        return emit(Op::ICmp, Ty::i32(), {l, r}, pred);
+    }
+    Value v = gen(e);
+    return emit(Op::ICmp, Ty::i32(), {v, Value::cst(0)}, ir::Pred::NE);
+}
+
+void IRGen::genBranch(Expr& c, Id t, Id f) {
+    if (terminated) return;
+    if (auto* b = dyn_cast<BinaryExpr>(&c); b && (b->op == BinaryOp::And || b->op == BinaryOp::Or)) {
+        Id mid = newBlock(b->op == BinaryOp::And ? "land.rhs" : "lor.rhs");
+        if (b->op == BinaryOp::And) genBranch(*b->lhs, mid, f);
+        else genBranch(*b->lhs, t, mid);
+        if (startBlock(mid)) genBranch(*b->rhs, t, f);
+        return;
+    }
+    if (auto* u = dyn_cast<UnaryExpr>(&c); u && u->op == UnaryOp::Not) { genBranch(*u->operand, f, t); return; }
+    if (auto* k = dyn_cast<IntegerLiteral>(&c)) { branch(k->value ? t : f); return; }
+    condBranch(genCond(c), t, f);
+}
+
+// a && b / a || b as a value: the result rides along in a hidden slot, so
+// the ordinary merge at the end block turns it into a phi.
+IRGen::Value IRGen::genLogical(BinaryExpr& b) {
+    bool isAnd = b.op == BinaryOp::And;
+    int res = newSlot(true, Type::intTy());
+    Id rhsL = newBlock(isAnd ? "land.rhs" : "lor.rhs");
+    Id endL = newBlock(isAnd ? "land.end" : "lor.end");
+    cur[res] = Value::cst(isAnd ? 0 : 1);
+    genBranch(*b.lhs, isAnd ? rhsL : endL, isAnd ? endL : rhsL);
+    if (startBlock(rhsL)) {
+        cur[res] = emit(Op::ZExt, Ty::i32(), {genCond(*b.rhs)});
+        branch(endL);
+    }
+    if (!startBlock(endL)) return Value::cst(0);
+    Value v = cur[res];
+    cur[res] = Value::cst(0);
+    return v;
+}
+
+IRGen::Value IRGen::gen(Expr& e) {
+    switch (e.kind) {
+    case NodeKind::IntegerLiteral: return Value::cst(cast<IntegerLiteral>(e).value);
+    case NodeKind::CharLiteral: return Value::cst(cast<CharLiteral>(e).value);
+    case NodeKind::VarRef: {
+        auto* v = &cast<VarRef>(e);
+        int slot = lookupSlot(v->name);
+        if (slot < 0) return Value::cst(0);
+        const Local& l = locals[slot];
+        if (l.promoted) return cur[slot]; // array parameters too: the pointer
+        if (!l.type.arrayDims.empty()) { // arrays decay to a pointer to their first element
+            AddrPath p {l.addr, objectType(l.type), std::vector<Value>(l.type.arrayDims.size() + 1, Value::cst(0))};
+            return emitGep(p);
         }
-        // function parameter fallback
-        out += "  ; fallback param " + v->name + "\n";
-        return "%" + v->name;
-    }
-    if (auto idx = dynamic_cast<ArrayIndex*>(&e)) {
-        // compute address: base + index * elementSize; treat as i32 arrays
-        std::string basePtr = genAddress(*idx->base);
-        std::string indexVal = gen(*idx->index);
-        std::string gep = newTmp();
-        out += "  " + gep + " = getelementptr i32, i32* " + basePtr + ", i32 " + indexVal + "\n";
-        std::string loadv = newTmp();
-        out += "  " + loadv + " = load i32, i32* " + gep + "\n";
-        return loadv;
-    }
-    if (auto b = dynamic_cast<BinaryExpr*>(&e)) {
-        std::string l = gen(*b->lhs); std::string r = gen(*b->rhs); std::string t=newTmp();
-        const char* op = nullptr;
+        return emitLoad(irType(l.type), l.addr);
+    }
+    case NodeKind::ArrayIndex: {
+        AddrPath p = genPath(cast<ArrayIndex>(e));
+        if (e.type.arrayDims.empty()) return emitLoad(irType(e.type), emitGep(p));
+        p.idx.resize(p.idx.size() + e.type.arrayDims.size(), Value::cst(0)); // a row decays like an array
+        return emitGep(p);
+    }
+    case NodeKind::BinaryExpr: {
+        auto* b = &cast<BinaryExpr>(e);
+        ir::Pred pred;
+        if (b->op == BinaryOp::And || b->op == BinaryOp::Or) return genLogical(*b);
+        if (icmpPred(b->op, pred)) return emit(Op::ZExt, Ty::i32(), {genCond(e)});
+        Value l = gen(*b->lhs); Value r = gen(*b->rhs);
+        Op op = Op::Add;
         switch (b->op) {
-            case BinaryOp::Add: op="add"; break; case BinaryOp::Sub: op="sub"; break; case BinaryOp::Mul: op="mul"; break; case BinaryOp::Div: op="sdiv"; break; case BinaryOp::Mod: op="srem"; break;
-            default: op="add"; // placeholder
+            case BinaryOp::Add: op=Op::Add; break; case BinaryOp::Sub: op=Op::Sub; break; case BinaryOp::Mul: op=Op::Mul; break;
+            case BinaryOp::Div: op=Op::SDiv; break; case BinaryOp::Mod: op=Op::SRem; break;
+            case BinaryOp::BitAnd: op=Op::And; break; case BinaryOp::BitOr: op=Op::Or; break; case BinaryOp::BitXor: op=Op::Xor; break;
+            case BinaryOp::Shl: op=Op::Shl; break; case BinaryOp::Shr: op=Op::AShr; break;
+            default: break; // comparisons and logic are handled above
         }
-        out += "  " + t + " = " + op + " i32 " + l + ", " + r + "\n"; return t;
-    }
-    if (auto u = dynamic_cast<UnaryExpr*>(&e)) { return gen(*u->operand); }
-    if (auto a = dynamic_cast<AssignExpr*>(&e)) {
-        // try to store into a VarRef backed by alloca
-        if (auto lv = dynamic_cast<VarRef*>(a->lhs.get())) {
-            if (auto p = lookupAlloca(lv->name)) {
-                std::string val = gen(*a->rhs);
-                out += "  store i32 " + val + ", i32* " + *p + "\n";
-                return val;
-            }
+        return emit(op, Ty::i32(), {l, r});
+    }
+    case NodeKind::UnaryExpr: {
+        auto* u = &cast<UnaryExpr>(e);
+        switch (u->op) {
+        case UnaryOp::Plus: return gen(*u->operand);
+        case UnaryOp::Minus: { Value v = gen(*u->operand); return emit(Op::Sub, Ty::i32(), {Value::cst(0), v}); }
+        case UnaryOp::BitNot: { Value v = gen(*u->operand); return emit(Op::Xor, Ty::i32(), {v, Value::cst(-1)}); }
+        case UnaryOp::Not: {
+            Value v = gen(*u->operand);
+            return emit(Op::ZExt, Ty::i32(), {emit(Op::ICmp, Ty::i32(), {v, Value::cst(0)}, ir::Pred::EQ)});
         }
-        if (auto la = dynamic_cast<ArrayIndex*>(a->lhs.get())) {
-            std::string addr = genAddress(*la);
-            std::string val = gen(*a->rhs);
-            out += "  store i32 " + val + ", i32* " + addr + "\n";
-            return val;
+        case UnaryOp::PreInc: return genAssign(*u->operand, nullptr, 1);
+        case UnaryOp::PreDec: return genAssign(*u->operand, nullptr, -1);
+        case UnaryOp::Addr: return genAddress(*u->operand);
+        case UnaryOp::Deref: { Value p = gen(*u->operand); return emitLoad(irType(e.type), p); }
         }
-        std::string rhs = gen(*a->rhs); return rhs;
+        return Value::cst(0);
+    }
+    case NodeKind::AssignExpr: { auto* a = &cast<AssignExpr>(e); return genAssign(*a->lhs, a->rhs, 0); }
+    case NodeKind::CallExpr: return genCall(cast<CallExpr>(e));
+    default: return Value::cst(0);
     }
-    return "0";
 }
 
-std::string IRGen::genAddress(Expr& e) {
-    if (auto v = dynamic_cast<VarRef*>(&e)) {
-        if (auto p = lookupAlloca(v->name)) return *p;
-        if (auto q = lookupValue(v->name)) return *q;
-        return "%" + v->name; // parameter address (already value, not address) – best-effort
-    }
-    if (auto idx = dynamic_cast<ArrayIndex*>(&e)) {
-        std::string base = genAddress(*idx->base);
-        std::string index = gen(*idx->index);
-        std::string gep = newTmp();
-        out += "  " + gep + " = getelementptr i32, i32* " + base + ", i32 " + index + "\n";
-        return gep;
+IRGen::Value IRGen::genCall(CallExpr& c) {
+    auto def = module->functions.find(c.callee);
+    const Function* callee = def != module->functions.end() ? def->second : nullptr;
+    std::vector<Ty> params;
+    std::vector<Value> ops {Value()};
+    for (size_t k = 0; k < c.args.size(); ++k) {
+        Expr& a = *c.args[k];
+        params.push_back(paramType(callee && k < callee->params.size() ? callee->params[k].type : a.type));
+        if (a.type.arrayDims.empty()) { ops.push_back(narrow(params.back(), gen(a))); continue; }
+        // an array argument decays to a pointer to its first element (its
+        // first row, when it has several dimensions), as paramType expects
+        AddrPath p;
+        if (auto* i = dyn_cast<ArrayIndex>(&a)) {
+            p = genPath(*i);
+        } else if (auto* v = dyn_cast<VarRef>(&a); v && lookupSlot(v->name) >= 0 && !locals[lookupSlot(v->name)].promoted) {
+            const Local& l = locals[lookupSlot(v->name)];
+            p = {l.addr, objectType(l.type), {Value::cst(0)}};
+        } else {
+            ops.push_back(gen(a)); // an array parameter already is that pointer
+            continue;
+        }
+        p.idx.push_back(Value::cst(0));
+        ops.push_back(emitGep(p));
     }
-    // fallback: compute and spill
-    std::string val = gen(e);
-    std::string tmp = newTmp();
-    out += "  " + tmp + " = alloca i32\n  store i32 " + val + ", i32* " + tmp + "\n";
-    return tmp;
+    Ty ret = irType(c.type);
+    ops[0] = Value::func(fn->callee(c.callee, ret, params));
+    Id i = fn->append(curBlock, Op::Call, ret, {});
+    fn->setOperands(i, ops);
+    return ret == Ty::voidTy() ? Value::cst(0) : widen(ret, Value::inst(i));
 }
 
-std::string* IRGen::lookupAlloca(const std::string& name) {
-    for (auto it = allocaStack.rbegin(); it != allocaStack.rend(); ++it) {
-        auto f = it->find(name);
-        if (f != it->end()) return &f->second;
+IRGen::Value IRGen::genAssign(Expr& lhs, Expr* rhs, long delta) {
+    auto value = [&](Value old) {
+        if (rhs) return gen(*rhs);
+        return emit(Op::Add, Ty::i32(), {old, Value::cst(delta)});
+    };
+    if (auto* v = dyn_cast<VarRef>(&lhs)) {
+        int slot = lookupSlot(v->name);
+        if (slot >= 0 && locals[slot].promoted) {
+            Value val = value(cur[slot]);
+            cur[slot] = val; // a new SSA value, no store
+            return val;
+        }
+        if (slot < 0) return rhs ? gen(*rhs) : gen(lhs); // not a variable
+        // copies: generating the value can add slots and move locals
+        Ty ty = irType(locals[slot].type);
+        Value addr = locals[slot].addr;
+        Value val = value(rhs ? Value() : gen(lhs));
+        emitStore(ty, val, addr);
+        return val;
     }
-    return nullptr;
+    if (lhs.kind == NodeKind::ArrayIndex || (lhs.kind == NodeKind::UnaryExpr && cast<UnaryExpr>(lhs).op == UnaryOp::Deref)) {
+        bool indexed = lhs.kind == NodeKind::ArrayIndex;
+        Value addr = indexed ? genAddress(lhs) : gen(*cast<UnaryExpr>(lhs).operand);
+        Ty ty = irType(lhs.type);
+        Value old;
+        if (!rhs) old = emitLoad(ty, addr);
+        Value val = value(old);
+        emitStore(ty, val, addr);
+        return val;
+    }
+    return rhs ? gen(*rhs) : gen(lhs);
 }
 
-std::string* IRGen::lookupValue(const std::string& name) {
-    for (auto it = valueStack.rbegin(); it != valueStack.rend(); ++it) {
-        auto f = it->find(name);
-        if (f != it->end()) return &f->second;
+IRGen::Value IRGen::genAddress(Expr& e) {
+    switch (e.kind) {
+    case NodeKind::VarRef: {
+        auto* v = &cast<VarRef>(e);
+        int slot = lookupSlot(v->name);
+        if (slot < 0) return Value::cst(0);
+        if (locals[slot].promoted) return cur[slot]; // array parameter: already an address
+        return locals[slot].addr; // other address-taken names live in memory
     }
-    return nullptr;
+    case NodeKind::ArrayIndex: return emitGep(genPath(cast<ArrayIndex>(e)));
+    default: break;
+    }
+    // fallback: compute and spill
+    Value val = gen(e);
+    Value tmp = emitAlloca(Ty::i32());
+    emit(Op::Store, Ty::i32(), {val, tmp});
+    return tmp;
 }
 
-const Type* IRGen::lookupType(const std::string& name) {
-    for (auto it = typeStack.rbegin(); it != typeStack.rend(); ++it) {
-        auto f = it->find(name);
-        if (f != it->end()) return &f->second;
+// x[i][j] on an array becomes one getelementptr over the whole aggregate,
+// so the strides come from the array type instead of chained steps.
+// Indexing through a pointer starts a new path at the loaded pointer.
+IRGen::AddrPath IRGen::genPath(ArrayIndex& e) {
+    Expr& b = *e.base;
+    AddrPath p;
+    if (!b.type.arrayDims.empty() && b.kind == NodeKind::ArrayIndex) {
+        p = genPath(cast<ArrayIndex>(b));
+    } else if (auto* v = dyn_cast<VarRef>(&b); v && !b.type.arrayDims.empty()) {
+        int slot = lookupSlot(v->name);
+        if (slot >= 0 && !locals[slot].promoted) {
+            p = {locals[slot].addr, objectType(locals[slot].type), {Value::cst(0)}};
+        } else { // array parameter: a pointer to its first row
+            p.base = slot >= 0 ? cur[slot] : Value::cst(0);
+            p.elem = paramType(b.type).pointee();
+        }
+    } else {
+        p.base = gen(b);
+        p.elem = b.type.pointerLevels ? irType(b.type).pointee() : Ty::i32();
     }
-    return nullptr;
+    p.idx.push_back(gen(*e.index));
+    return p;
+}
+
+IRGen::Value IRGen::emitGep(const AddrPath& p) {
+    // addresses are pure, so an identical one earlier in the block is reused
+    if (gepBlock != curBlock) { geps.clear(); gepBlock = curBlock; }
+    for (auto& [key, addr] : geps)
+        if (key == p) return addr;
+    Id i = fn->append(curBlock, Op::Gep, p.elem, {});
+    std::vector<Value> ops {p.base};
+    ops.insert(ops.end(), p.idx.begin(), p.idx.end());
+    fn->setOperands(i, ops);
+    geps.push_back({p, Value::inst(i)});
+    return Value::inst(i);
 }
 
 } // namespace cmini
@@ -1,32 +1,166 @@
 #pragma once
 #include "ast.h"
+#include "ir.h"
+#include "cse.h"
+#include "inliner.h"
+#include "loopopt.h"
+#include "outsink.h"
+#include "profile.h"
+#include <functional>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 
 namespace cmini {
 
-// Minimal textual LLVM IR generator for a subset sufficient to test flow
+class ThreadPool;
+
+// Lowers the AST to ir::Function and prints it as LLVM IR text. Scalar
+// locals whose address is never taken live in SSA values rather than stack
+// slots: the generator tracks the current value of each one while it walks
+// the structured AST and places phis where control flow joins (if/else
+// ends, short-circuit operators, loop exits), plus one phi per loop-carried
+// variable at loop headers. Arrays, pointers and address-taken locals keep
+// an alloca in the entry block; arrays are LLVM aggregates indexed with a
+// single getelementptr per access. Every function is lowered and printed on
+// its own, so functions can be produced independently; at -O1 and up the
+// bodies of called functions are lowered once up front for the inliner.
 struct IRGen {
-    std::string out;
-    int tmpCounter {0};
-    std::vector<std::unordered_map<std::string,std::string>> allocaStack; // name -> alloca ptr
-    std::vector<std::unordered_map<std::string,std::string>> valueStack;  // name -> last SSA value
-    std::vector<std::unordered_map<std::string,Type>> typeStack;           // name -> declared type
+    OutSink* out {nullptr};
+
+    // Incremental builds: reuse[i], when non-empty, is spliced in verbatim
+    // instead of generating function i, and onFunction(i) runs just before
+    // function i's text reaches the sink (so the sink's byte count is its
+    // offset in the module).
+    const std::vector<std::string_view>* reuse {nullptr};
+    std::function<void(size_t)> onFunction;
+
+    // At 1 and up each function goes through ir::Inliner, ir::CSE and
+    // ir::LoopOpt before printing; the counters are summed over the
+    // functions generated.
+    int optLevel {0};
+    size_t cseRemoved {0};
+    ir::LoopOpt::Stats loopStats;
+    ir::Inliner::Stats inlineStats;
+
+    // Largest callee cost the inliner accepts; negative picks the default
+    // for optLevel. With inlineReport, `report` gets one line per call site
+    // of the functions generated, in source order.
+    int inlineThreshold {-1};
+    bool inlineReport {false};
+    std::string report;
+    static size_t defaultInlineThreshold(int optLevel) { return optLevel >= 2 ? 60 : 20; }
+
+    // Profile-guided optimization (profile.h). With instrument, functions
+    // get counters and the module ends with the runtime that writes them
+    // out. With a profile, the functions whose control flow it still
+    // matches get its counts, which become branch weights, pick hot and
+    // cold call sites for the inliner and order blocks; gen() also puts
+    // the hottest functions first and those that never ran last (not when
+    // reusing text). profileStale counts generated functions it no longer
+    // matches.
+    bool instrument {false};
+    const Profile* profile {nullptr};
+    size_t profileStale {0};
+    // Indices of p's functions in the order gen() emits them.
+    std::vector<size_t> order(const Program& p) const;
 
+    // Streams the module into sink, flushing after every function. With a
+    // pool, functions are generated concurrently into private buffers and
+    // stitched back in source order; the output is byte-identical.
+    void gen(Program& p, OutSink& sink, ThreadPool* pool = nullptr);
+    // Convenience: whole module as one string.
     std::string gen(Program& p);
 
+    // Makes p's functions callable from lowered code: a call takes its
+    // parameter types from the callee's definition. gen() does this itself.
+    void declare(Program& p);
+    // Lowers every function of p and hands each one, fully optimized, to
+    // use(index, fn); fn is only valid during the call. With a pool the
+    // calls run concurrently, in any order; counters and the inline report
+    // come out as with gen().
+    void lowerAll(Program& p, const std::function<void(size_t, ir::Function&)>& use, ThreadPool* pool = nullptr);
+    // Lowers one function into fn (cleared first).
+    void lower(Function& f, ir::Function& fn);
+    // The -O1 IR pipeline after inlining, counted in cseRemoved/loopStats.
+    void optimize(ir::Function& fn);
+
 private:
+    using Value = ir::Value;
+    // A local variable: promoted ones are tracked in `cur`, the others
+    // live behind `addr`.
+    struct Local { bool promoted {true}; Type type; Value addr; };
+    // A control-flow edge into a block with the variable values it carries.
+    struct Edge { ir::Id from; std::vector<Value> vals; };
+    struct LoopCtx { ir::Id cont, exit; };
+    // getelementptr elem, elem* base, idx...
+    struct AddrPath {
+        Value base;
+        ir::Ty elem;
+        std::vector<Value> idx;
+        bool operator==(const AddrPath&) const = default;
+    };
+
     void gen(Function& f);
-    std::string gen(Expr& e);
-    std::string genAddress(Expr& e); // for lvalues
+    void build(Function& f, ir::Function& fn); // lower, inline, optimize
+    void configure(IRGen& worker) const;
+    void prepareInlining(Program& p, ThreadPool* pool);
+    Value gen(Expr& e);
+    Value genCall(CallExpr& c);
+    Value genAddress(Expr& e); // for lvalues
+    AddrPath genPath(ArrayIndex& e);
+    Value emitGep(const AddrPath& p);
+    ir::Ty objectType(const Type& t); // arrays as aggregates
+    ir::Ty paramType(const Type& t);  // arrays decay to pointers
+    ir::Ty valueType(const Type& t);  // of a promoted variable
     void gen(Stmt& s);
     void gen(Block& b);
+    void genBranch(Expr& cond, ir::Id t, ir::Id f);
+    Value genLogical(BinaryExpr& b);
+    Value genCond(Expr& e); // i1 value of e != 0
+    Value genAssign(Expr& lhs, Expr* rhs, long delta); // lhs = rhs, or lhs += delta
+    void genLoop(Expr* cond, Stmt* body, Expr* step, bool condFirst);
+
+    Value emit(ir::Op op, ir::Ty ty, std::initializer_list<Value> ops, ir::Pred pred = ir::Pred::EQ);
+    Value emitAlloca(ir::Ty ty);
+    // chars are i8 in memory and i32 in expressions: widened as they are
+    // loaded (or received), narrowed as they are stored (or passed on)
+    Value widen(ir::Ty ty, Value v);
+    Value narrow(ir::Ty ty, Value v);
+    Value emitLoad(ir::Ty ty, Value addr);
+    void emitStore(ir::Ty ty, Value val, Value addr);
+    ir::Id newBlock(const char* hint);
+    int newSlot(bool promoted, const Type& t);
+    int lookupSlot(SymId name);
+    void pushScope();
+    void popScope();
+
+    // Control flow: branches record an edge (with a copy of `cur`) into the
+    // target; startBlock() merges the recorded edges, inserting phis for
+    // values that differ, and returns false if nothing reaches the block.
+    void branch(ir::Id to);
+    void condBranch(Value i1, ir::Id t, ir::Id f);
+    bool startBlock(ir::Id b);
+
+    // Tables built once per module; workers point at their parent's.
+    std::unordered_map<SymId, const Function*> functions;
+    std::unordered_map<SymId, ir::Function> bodies; // optimized callee IR for the inliner
+    const IRGen* module {this};
+    std::vector<ir::Counters> counters; // --instrument: each function lowered, in order
 
-    std::string typeToIR(const Type& t);
-    std::string newTmp();
-    std::string* lookupAlloca(const std::string& name);
-    std::string* lookupValue(const std::string& name);
-    const Type* lookupType(const std::string& name);
+    ir::Function* fn {nullptr};
+    std::vector<std::unordered_map<SymId,int>> scopes; // name -> slot
+    std::vector<Local> locals;                         // by slot
+    std::vector<Value> cur;                            // current value per slot
+    std::vector<std::vector<Edge>> incoming;           // pending edges by block
+    std::vector<LoopCtx> loops;
+    std::vector<SymId> addrTaken;                      // names used with unary &
+    std::unordered_map<SymId,ir::Id> args;             // parameter name -> index
+    ir::Id curBlock {0};
+    std::vector<std::pair<AddrPath, Value>> geps;      // addresses computed in gepBlock
+    ir::Id gepBlock {ir::None};
+    size_t allocas {0};      // allocas at the head of the entry block
+    bool terminated {false}; // the current block already ended
 };
 
 } // namespace cmini
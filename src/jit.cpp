@@ -0,0 +1,53 @@
+#include "jit.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace cmini {
+
+JitImage::~JitImage() {
+    if (base) ::munmap(base, mapped);
+}
+
+bool JitImage::load(const std::vector<x86::MachineCode>& code, std::string& error) {
+    std::vector<size_t> at(code.size());
+    size_t size = 0;
+    for (size_t i = 0; i < code.size(); ++i) {
+        size = (size + 15) & ~size_t(15);
+        at[i] = size;
+        offsets[code[i].name] = size;
+        size += code[i].bytes.size();
+    }
+    for (auto& c : code)
+        for (auto& call : c.calls)
+            if (!offsets.count(call.callee)) { error = "undefined function: " + symStr(call.callee); return false; }
+
+    size_t page = (size_t)::sysconf(_SC_PAGESIZE);
+    mapped = std::max((size + page - 1) / page * page, page);
+    void* p = ::mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) { mapped = 0; error = std::string("mmap: ") + std::strerror(errno); return false; }
+    base = static_cast<uint8_t*>(p);
+    std::memset(base, 0xCC, mapped); // int3 between functions
+    for (size_t i = 0; i < code.size(); ++i) {
+        std::memcpy(base + at[i], code[i].bytes.data(), code[i].bytes.size());
+        for (auto& call : code[i].calls) {
+            size_t field = at[i] + call.offset;
+            int32_t rel = (int32_t)((int64_t)offsets[call.callee] - (int64_t)(field + 4));
+            std::memcpy(base + field, &rel, sizeof rel);
+        }
+    }
+    if (::mprotect(base, mapped, PROT_READ | PROT_EXEC) != 0) {
+        error = std::string("mprotect: ") + std::strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+void* JitImage::find(SymId name) const {
+    auto it = offsets.find(name);
+    return it == offsets.end() ? nullptr : base + it->second;
+}
+
+} // namespace cmini
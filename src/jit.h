@@ -0,0 +1,34 @@
+#pragma once
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "x86.h"
+
+namespace cmini {
+
+// A program's machine code loaded into executable memory of this process,
+// for `cmini --run`. The functions are laid out as in ObjectWriter's .text
+// and every call is patched to its callee directly, so nothing outside the
+// image (no linker, no LLVM) is involved. The pages are written while
+// mapped read-write and then flipped to read-execute; they are never
+// writable and executable at once.
+class JitImage {
+public:
+    JitImage() = default;
+    JitImage(const JitImage&) = delete;
+    JitImage& operator=(const JitImage&) = delete;
+    ~JitImage();
+
+    // False, with a message in error, when a callee has no definition or
+    // the memory cannot be mapped.
+    bool load(const std::vector<x86::MachineCode>& code, std::string& error);
+    // Entry point of a function, or nullptr.
+    void* find(SymId name) const;
+
+private:
+    uint8_t* base {nullptr};
+    size_t mapped {0};
+    std::unordered_map<SymId, size_t> offsets; // later definitions win
+};
+
+} // namespace cmini
@@ -1,13 +1,147 @@
 #include "lexer.h"
-#include <cctype>
-#include <optional>
+#include <cstdint>
+#include <cstring>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
 
 namespace cmini {
 
-static bool isIdentStart(char c) { return std::isalpha((unsigned char)c) || c=='_'; }
-static bool isIdentCont(char c) { return std::isalnum((unsigned char)c) || c=='_'; }
+// Byte classes for the scalar paths; same sets as <cctype> in the C locale.
+enum : unsigned char { ClsSpace = 1, ClsDigit = 2, ClsAlpha = 4 };
+static constexpr auto charClasses = [] {
+    struct { unsigned char c[256]; } t {};
+    for (int ch : {' ', '\t', '\n', '\v', '\f', '\r'}) t.c[ch] = ClsSpace;
+    for (int ch = '0'; ch <= '9'; ++ch) t.c[ch] = ClsDigit;
+    for (int ch = 'a'; ch <= 'z'; ++ch) t.c[ch] = t.c[ch - 'a' + 'A'] = ClsAlpha;
+    t.c['_'] = ClsAlpha;
+    return t;
+}();
+static bool isSpace(char c) { return charClasses.c[(unsigned char)c] & ClsSpace; }
+static bool isDigit(char c) { return charClasses.c[(unsigned char)c] & ClsDigit; }
+static bool isIdentStart(char c) { return charClasses.c[(unsigned char)c] & ClsAlpha; }
+static bool isIdentCont(char c) { return charClasses.c[(unsigned char)c] & (ClsAlpha | ClsDigit); }
 
-Lexer::Lexer(const std::string& input) : src(input) {}
+// Vectorized run scanners. Each returns the first position in [p, end)
+// whose byte is not in the class; the tail shorter than one vector is
+// finished by the scalar loop. AVX2 is used when the build targets it.
+#if defined(__AVX2__)
+using Vec = __m256i;
+static constexpr size_t VecBytes = 32;
+static Vec vload(const char* p) { return _mm256_loadu_si256(reinterpret_cast<const Vec*>(p)); }
+static Vec vset(char c) { return _mm256_set1_epi8(c); }
+static Vec veq(Vec a, Vec b) { return _mm256_cmpeq_epi8(a, b); }
+static Vec vor(Vec a, Vec b) { return _mm256_or_si256(a, b); }
+static Vec vgt(Vec a, Vec b) { return _mm256_cmpgt_epi8(a, b); }
+static Vec vsub(Vec a, Vec b) { return _mm256_sub_epi8(a, b); }
+static uint32_t vmask(Vec v) { return (uint32_t)_mm256_movemask_epi8(v); }
+static constexpr uint32_t FullMask = 0xffffffffu;
+#elif defined(__SSE2__)
+using Vec = __m128i;
+static constexpr size_t VecBytes = 16;
+static Vec vload(const char* p) { return _mm_loadu_si128(reinterpret_cast<const Vec*>(p)); }
+static Vec vset(char c) { return _mm_set1_epi8(c); }
+static Vec veq(Vec a, Vec b) { return _mm_cmpeq_epi8(a, b); }
+static Vec vor(Vec a, Vec b) { return _mm_or_si128(a, b); }
+static Vec vgt(Vec a, Vec b) { return _mm_cmpgt_epi8(a, b); }
+static Vec vsub(Vec a, Vec b) { return _mm_sub_epi8(a, b); }
+static uint32_t vmask(Vec v) { return (uint32_t)_mm_movemask_epi8(v); }
+static constexpr uint32_t FullMask = 0xffffu;
+#endif
+
+#if defined(__SSE2__)
+// lo <= x <= hi for unsigned bytes: bias into the signed domain, one compare.
+static Vec vrange(Vec x, char lo, char hi) {
+    Vec t = vsub(x, vset((char)(lo + 128)));
+    return vgt(vset((char)(hi - lo + 1 - 128)), t);
+}
+static Vec vspace(Vec x) {
+    // ' ' or '\t'..'\r'
+    return vor(veq(x, vset(' ')), vrange(x, '\t', '\r'));
+}
+static Vec vdigit(Vec x) { return vrange(x, '0', '9'); }
+static Vec videnti(Vec x) {
+    Vec lower = vor(x, vset(0x20));
+    return vor(vor(vrange(lower, 'a', 'z'), vdigit(x)), veq(x, vset('_')));
+}
+
+template <Vec (*Cls)(Vec)>
+static const char* skipRun(const char* p, const char* end) {
+    while (end - p >= (ptrdiff_t)VecBytes) {
+        uint32_t m = vmask(Cls(vload(p))) ^ FullMask;
+        if (m) return p + __builtin_ctz(m);
+        p += VecBytes;
+    }
+    return p;
+}
+#endif
+
+static const char* skipSpaces(const char* p, const char* end) {
+#if defined(__SSE2__)
+    p = skipRun<vspace>(p, end);
+#endif
+    while (p < end && isSpace(*p)) ++p;
+    return p;
+}
+static const char* skipDigits(const char* p, const char* end) {
+#if defined(__SSE2__)
+    p = skipRun<vdigit>(p, end);
+#endif
+    while (p < end && isDigit(*p)) ++p;
+    return p;
+}
+static const char* skipIdent(const char* p, const char* end) {
+#if defined(__SSE2__)
+    p = skipRun<videnti>(p, end);
+#endif
+    while (p < end && isIdentCont(*p)) ++p;
+    return p;
+}
+
+// Perfect hash over the keyword set: (first + last + length) & 31 is
+// collision-free for these 14 spellings (checked at compile time).
+struct Keyword { std::string_view text; TokenKind kind; };
+static constexpr Keyword keywords[] = {
+    {"int", TokenKind::KwInt}, {"char", TokenKind::KwChar}, {"float", TokenKind::KwFloat},
+    {"void", TokenKind::KwVoid}, {"enum", TokenKind::KwEnum}, {"union", TokenKind::KwUnion},
+    {"if", TokenKind::KwIf}, {"else", TokenKind::KwElse}, {"for", TokenKind::KwFor},
+    {"while", TokenKind::KwWhile}, {"do", TokenKind::KwDo}, {"return", TokenKind::KwReturn},
+    {"break", TokenKind::KwBreak}, {"continue", TokenKind::KwContinue},
+};
+static constexpr unsigned keywordHash(std::string_view s) {
+    return ((unsigned char)s.front() + (unsigned char)s.back() + (unsigned)s.size()) & 31;
+}
+static constexpr auto keywordTable = [] {
+    struct { Keyword slot[32]; bool collision; } t {};
+    for (const Keyword& k : keywords) {
+        unsigned h = keywordHash(k.text);
+        if (!t.slot[h].text.empty()) t.collision = true;
+        t.slot[h] = k;
+    }
+    return t;
+}();
+static_assert(!keywordTable.collision, "keyword hash must be perfect");
+
+static TokenKind classifyIdent(std::string_view s) {
+    if (s.size() < 2 || s.size() > 8) return TokenKind::Identifier;
+    const Keyword& k = keywordTable.slot[keywordHash(s)];
+    return k.text == s ? k.kind : TokenKind::Identifier;
+}
+
+Lexer::Lexer(std::string_view input) : src(input) {}
+
+std::string unescape(std::string_view raw) {
+    std::string s;
+    s.reserve(raw.size());
+    for (size_t i = 0; i < raw.size(); ++i) {
+        char ch = raw[i];
+        if (ch=='\\' && i+1 < raw.size()) {
+            char n = raw[++i];
+            switch(n){case 'n': s+='\n'; break; case 't': s+='\t'; break; default: s+=n;}
+        } else s.push_back(ch);
+    }
+    return s;
+}
 
 const Token& Lexer::peek() {
     if (!hasLookahead) { lookahead = scan(); hasLookahead = true; }
@@ -25,15 +159,27 @@ char Lexer::advance() { return isAtEnd() ? '\0' : src[pos++]; }
 bool Lexer::match(char c) { if (current()==c) { ++pos; return true; } return false; }
 
 Token Lexer::scan() {
-    // skip whitespace and comments
+    // skip whitespace and comments; comment bodies are searched with memchr
+    const char* base = src.data();
+    const char* end = base + src.size();
     while (!isAtEnd()) {
-        char c = current();
-        if (std::isspace((unsigned char)c)) { ++pos; continue; }
-        if (c=='/' && pos+1 < src.size() && src[pos+1]=='/') {
-            pos+=2; while (!isAtEnd() && current()!='\n') ++pos; continue;
+        pos = skipSpaces(base + pos, end) - base;
+        if (isAtEnd() || src[pos] != '/' || pos+1 >= src.size()) break;
+        if (src[pos+1]=='/') {
+            const void* nl = std::memchr(base + pos + 2, '\n', src.size() - pos - 2);
+            pos = nl ? static_cast<const char*>(nl) - base : src.size();
+            continue;
         }
-        if (c=='/' && pos+1 < src.size() && src[pos+1]=='*') {
-            pos+=2; while (!isAtEnd() && !(current()=='*' && pos+1<src.size() && src[pos+1]=='/')) ++pos; if (pos+1<src.size()) pos+=2; continue;
+        if (src[pos+1]=='*') {
+            const char* p = base + pos + 2;
+            for (;;) {
+                const void* star = std::memchr(p, '*', end - p);
+                if (!star) { p = end; break; }
+                p = static_cast<const char*>(star) + 1;
+                if (p < end && *p == '/') { ++p; break; }
+            }
+            pos = p - base;
+            continue;
         }
         break;
     }
@@ -43,44 +189,32 @@ Token Lexer::scan() {
 
     // identifiers and keywords
     if (isIdentStart(c)) {
-        std::string s(1,c);
-        while (isIdentCont(current())) s.push_back(advance());
-        if (s=="int") return {TokenKind::KwInt, s};
-        if (s=="char") return {TokenKind::KwChar, s};
-        if (s=="float") return {TokenKind::KwFloat, s};
-        if (s=="void") return {TokenKind::KwVoid, s};
-        if (s=="enum") return {TokenKind::KwEnum, s};
-        if (s=="union") return {TokenKind::KwUnion, s};
-        if (s=="if") return {TokenKind::KwIf, s};
-        if (s=="else") return {TokenKind::KwElse, s};
-        if (s=="for") return {TokenKind::KwFor, s};
-        if (s=="while") return {TokenKind::KwWhile, s};
-        if (s=="do") return {TokenKind::KwDo, s};
-        if (s=="return") return {TokenKind::KwReturn, s};
-        if (s=="break") return {TokenKind::KwBreak, s};
-        if (s=="continue") return {TokenKind::KwContinue, s};
-        return {TokenKind::Identifier, s};
+        size_t start = pos-1;
+        pos = skipIdent(base + pos, end) - base;
+        std::string_view s = src.substr(start, pos-start);
+        TokenKind k = classifyIdent(s);
+        if (k != TokenKind::Identifier) return {k, s};
+        Token t; t.kind=TokenKind::Identifier; t.text=s; t.sym=intern(s); return t;
     }
 
     // numbers (decimal only for brevity)
-    if (std::isdigit((unsigned char)c)) {
-        long v = c - '0';
-        while (std::isdigit((unsigned char)current())) v = v*10 + (advance()-'0');
-        return {TokenKind::Integer, "", v};
+    if (isDigit(c)) {
+        size_t start = pos-1;
+        pos = skipDigits(base + pos, end) - base;
+        long v = 0;
+        for (size_t i = start; i < pos; ++i) v = v*10 + (src[i]-'0');
+        return {TokenKind::Integer, src.substr(start, pos-start), v};
     }
 
     // strings and chars
     if (c=='"') {
-        std::string s;
+        size_t start = pos;
         while (!isAtEnd() && current()!='"') {
-            char ch = advance();
-            if (ch=='\\' && !isAtEnd()) {
-                char n = advance();
-                switch(n){case 'n': s+='\n'; break; case 't': s+='\t'; break; default: s+=n;}
-            } else s.push_back(ch);
+            if (advance()=='\\' && !isAtEnd()) ++pos;
         }
+        Token t; t.kind=TokenKind::String; t.text=src.substr(start, pos-start);
         if (current()=='"') ++pos;
-        Token t; t.kind=TokenKind::String; t.text=std::move(s); return t;
+        return t;
     }
     if (c=='\'') {
         char v = advance();
@@ -89,28 +223,17 @@ Token Lexer::scan() {
         Token t; t.kind=TokenKind::Char; t.intVal=v; return t;
     }
 
-    // punctuation and operators
-    auto two = [&](char a,char b, TokenKind k)->std::optional<Token> {
-        if (c==a && current()==b) { ++pos; return Token{k, std::string({a,b})}; }
-        return std::nullopt;
-    };
-    if (auto t=two('&','&',TokenKind::AndAnd)) return *t;
-    if (auto t=two('|','|',TokenKind::OrOr)) return *t;
-    if (auto t=two('=','=',TokenKind::EQ)) return *t;
-    if (auto t=two('!','=',TokenKind::NE)) return *t;
-    if (auto t=two('<','=',TokenKind::LE)) return *t;
-    if (auto t=two('>','=',TokenKind::GE)) return *t;
-    if (auto t=two('<','<',TokenKind::Shl)) return *t;
-    if (auto t=two('>','>',TokenKind::Shr)) return *t;
-
+    // punctuation and operators; two-character forms are checked in the
+    // same switch so each operator costs one branch on its first byte
+    auto two = [&](TokenKind k) { ++pos; return Token{k, src.substr(pos-2, 2)}; };
     switch (c) {
         case '+': return {TokenKind::Plus, "+"};
         case '-': return {TokenKind::Minus, "-"};
         case '*': return {TokenKind::Star, "*"};
         case '/': return {TokenKind::Slash, "/"};
         case '%': return {TokenKind::Percent, "%"};
-        case '&': return {TokenKind::Amp, "&"};
-        case '|': return {TokenKind::Pipe, "|"};
+        case '&': if (current()=='&') return two(TokenKind::AndAnd); return {TokenKind::Amp, "&"};
+        case '|': if (current()=='|') return two(TokenKind::OrOr); return {TokenKind::Pipe, "|"};
         case '^': return {TokenKind::Caret, "^"};
         case '~': return {TokenKind::Tilde, "~"};
         case '(': return {TokenKind::LParen, "("};
@@ -121,9 +244,10 @@ Token Lexer::scan() {
         case ']': return {TokenKind::RBracket, "]"};
         case ';': return {TokenKind::Semicolon, ";"};
         case ',': return {TokenKind::Comma, ","};
-        case '=': return {TokenKind::Assign, "="};
-        case '<': return {TokenKind::LT, "<"};
-        case '>': return {TokenKind::GT, ">"};
+        case '=': if (current()=='=') return two(TokenKind::EQ); return {TokenKind::Assign, "="};
+        case '<': if (current()=='=') return two(TokenKind::LE); if (current()=='<') return two(TokenKind::Shl); return {TokenKind::LT, "<"};
+        case '>': if (current()=='=') return two(TokenKind::GE); if (current()=='>') return two(TokenKind::Shr); return {TokenKind::GT, ">"};
+        case '!': if (current()=='=') return two(TokenKind::NE); return {TokenKind::End, ""};
         default: return {TokenKind::End, ""};
     }
 }
@@ -1,6 +1,8 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include <cstddef>
+#include "intern.h"
 
 namespace cmini {
 
@@ -27,13 +29,19 @@ enum class TokenKind {
 
 struct Token {
     TokenKind kind {TokenKind::End};
-    std::string text;
+    std::string_view text; // spelling, borrowed from the source (strings: raw body between quotes)
     long intVal {0};
+    SymId sym {0};      // interned spelling for identifiers
 };
 
+// Decode the escapes in a raw string-literal body.
+std::string unescape(std::string_view raw);
+
+// The lexer borrows its input; the buffer must outlive the lexer and every
+// token it hands out.
 class Lexer {
 public:
-    explicit Lexer(const std::string& input);
+    explicit Lexer(std::string_view input);
     Token next();
     const Token& peek();
 private:
@@ -43,7 +51,7 @@ private:
     char advance();
     bool match(char c);
 
-    const std::string src;
+    std::string_view src;
     size_t pos {0};
     Token lookahead;
     bool hasLookahead {false};
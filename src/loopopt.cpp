@@ -0,0 +1,346 @@
+#include "loopopt.h"
+#include <algorithm>
+#include <map>
+#include <utility>
+
+namespace cmini::ir {
+
+LoopOpt::Stats& LoopOpt::Stats::operator+=(const Stats& o) {
+    loops += o.loops; hoisted += o.hoisted; inductionVars += o.inductionVars;
+    strengthReduced += o.strengthReduced; shifts += o.shifts; removed += o.removed;
+    return *this;
+}
+
+namespace {
+
+int64_t wrap32(int64_t v) { return (int32_t)(uint32_t)(uint64_t)v; }
+
+struct Loop {
+    Id header {None};
+    Id preheader {None};
+    std::vector<Id> latches; // sources of the back edges
+    std::vector<char> body;  // by block id; grows with blocks added later
+    size_t size {0};
+    bool contains(Id b) const { return b < body.size() && body[b]; }
+};
+
+// An induction variable: a header phi that starts at `init` (from the
+// preheader) and adds `step` on the way back from the single latch.
+struct IndVar { Id phi; Value init, step; };
+
+class LoopPass {
+public:
+    LoopPass(Function& f, LoopOpt::Stats& st) : f(f), st(st) {}
+
+    void run() {
+        computeCfg();
+        findLoops();
+        // innermost first: what they hoist lands in the enclosing loop,
+        // which then gets its chance at it
+        std::stable_sort(loops.begin(), loops.end(), [](const Loop& a, const Loop& b) { return a.size < b.size; });
+        for (size_t k = 0; k < loops.size(); ++k) {
+            if (!ensurePreheader(k)) continue;
+            hoist(loops[k]);
+            reduce(loops[k]);
+        }
+        shifts();
+        removeDead();
+    }
+
+private:
+    Function& f;
+    LoopOpt::Stats& st;
+    DomTree dom;
+    // copies of the CFG that grow with the preheaders added
+    std::vector<std::vector<Id>> preds;
+    std::vector<Id> rpo;
+    std::vector<Loop> loops;
+
+    void computeCfg() {
+        dom.build(f);
+        preds = dom.preds;
+        rpo = dom.rpo;
+    }
+
+    void findLoops() {
+        std::map<Id, size_t> byHeader;
+        for (Id t : rpo)
+            for (Id h : f.successors(t)) {
+                if (!dom.dominates(h, t)) continue;
+                auto [it, fresh] = byHeader.emplace(h, loops.size());
+                if (fresh) {
+                    loops.emplace_back();
+                    loops.back().header = h;
+                    loops.back().body.assign(f.blocks.size(), 0);
+                    loops.back().body[h] = 1;
+                    loops.back().size = 1;
+                }
+                Loop& l = loops[it->second];
+                l.latches.push_back(t);
+                std::vector<Id> work {t};
+                while (!work.empty()) {
+                    Id b = work.back();
+                    work.pop_back();
+                    if (l.body[b]) continue;
+                    l.body[b] = 1;
+                    ++l.size;
+                    for (Id p : preds[b]) work.push_back(p);
+                }
+            }
+        st.loops += loops.size();
+    }
+
+    // Reuses the single outside predecessor when it only branches to the
+    // header, otherwise splits the entering edges through a new block.
+    bool ensurePreheader(size_t k) {
+        Loop& l = loops[k];
+        Id h = l.header;
+        std::vector<Id> outside;
+        for (Id p : preds[h])
+            if (!l.contains(p)) outside.push_back(p);
+        if (outside.empty()) return false;
+        if (outside.size() == 1 && f.successors(outside[0]).size() == 1) {
+            l.preheader = outside[0];
+            return true;
+        }
+
+        Id ph = f.addBlock("loop.ph");
+        f.append(ph, Op::Br, Ty::voidTy(), {Value::block(h)});
+        f.layout.insert(std::find(f.layout.begin(), f.layout.end(), h), ph);
+        rpo.insert(std::find(rpo.begin(), rpo.end(), h), ph);
+        for (Id p : outside) {
+            Id t = f.terminator(p);
+            for (uint32_t i = 0; i < f.insts[t].opCount; ++i)
+                if (f.operand(t, i) == Value::block(h)) f.setOperand(t, i, Value::block(ph));
+        }
+        // header phis take one value from the preheader, merged there if
+        // the entering edges disagree
+        std::vector<Id> phis;
+        for (Id i : f.blocks[h].insts)
+            if (f.insts[i].op == Op::Phi) phis.push_back(i);
+        for (Id phi : phis) {
+            std::vector<Value> in, out;
+            for (uint32_t i = 0; i + 1 < f.insts[phi].opCount; i += 2) {
+                Value v = f.operand(phi, i), b = f.operand(phi, i + 1);
+                auto& side = l.contains(b.id()) ? in : out;
+                side.push_back(v); side.push_back(b);
+            }
+            Value entry = out.empty() ? Value() : out[0];
+            for (size_t i = 0; i < out.size(); i += 2)
+                if (!(out[i] == entry)) {
+                    Id merged = f.insert(ph, 0, Op::Phi, f.insts[phi].ty, {});
+                    f.setOperands(merged, out);
+                    entry = Value::inst(merged);
+                    break;
+                }
+            std::vector<Value> ops {entry, Value::block(ph)};
+            ops.insert(ops.end(), in.begin(), in.end());
+            f.setOperands(phi, ops);
+        }
+
+        preds.emplace_back(outside);
+        std::vector<Id> hp {ph};
+        for (Id p : preds[h])
+            if (l.contains(p)) hp.push_back(p);
+        preds[h] = hp;
+        // the new block sits inside every loop around this one
+        for (auto& other : loops)
+            if (&other != &l && other.contains(h)) {
+                if (other.body.size() <= ph) other.body.resize(ph + 1, 0);
+                other.body[ph] = 1;
+                ++other.size;
+            }
+        l.preheader = ph;
+        return true;
+    }
+
+    bool invariant(const Loop& l, Value v) const {
+        if (v.kind == Value::Block) return false;
+        return v.kind != Value::Inst || !l.contains(f.insts[v.id()].block);
+    }
+
+    // Instructions that may run in the preheader even when the loop body
+    // would not have: no side effects and no way to trap.
+    bool speculatable(Id i, bool loopStores) const {
+        const Inst& in = f.insts[i];
+        switch (in.op) {
+        case Op::Add: case Op::Sub: case Op::Mul: case Op::And: case Op::Or: case Op::Xor:
+        case Op::Shl: case Op::AShr: case Op::ICmp: case Op::ZExt: case Op::SExt: case Op::Trunc:
+        case Op::Gep:
+            return true;
+        case Op::SDiv: case Op::SRem: {
+            Value d = f.operand(i, 1);
+            return d.kind == Value::Const && d.num != 0 && d.num != -1;
+        }
+        case Op::Load: {
+            // stack slots are always valid to read; without stores in the
+            // loop they also hold the same value on every iteration
+            Value p = f.operand(i, 0);
+            return !loopStores && p.kind == Value::Inst && f.insts[p.id()].op == Op::Alloca;
+        }
+        default:
+            return false;
+        }
+    }
+
+    std::vector<Id> blocksOf(const Loop& l) const {
+        std::vector<Id> out;
+        for (Id b : rpo)
+            if (l.contains(b)) out.push_back(b);
+        return out;
+    }
+
+    void hoist(Loop& l) {
+        bool loopStores = false;
+        auto blocks = blocksOf(l);
+        for (Id b : blocks)
+            for (Id i : f.blocks[b].insts) loopStores |= f.insts[i].op == Op::Store || f.insts[i].op == Op::Call;
+        Id ph = l.preheader;
+        // in reverse postorder operands are visited before their users, so
+        // one sweep hoists whole invariant expressions
+        for (Id b : blocks) {
+            std::vector<Id> list = f.blocks[b].insts;
+            for (Id i : list) {
+                if (!speculatable(i, loopStores)) continue;
+                bool inv = true;
+                for (uint32_t k = 0; k < f.insts[i].opCount && inv; ++k) inv = invariant(l, f.operand(i, k));
+                if (!inv) continue;
+                f.move(i, ph, f.blocks[ph].insts.size() - 1);
+                ++st.hoisted;
+            }
+        }
+    }
+
+    // a * b computed in the preheader (or folded when both are constants)
+    Value product(Id ph, Value a, Value b) {
+        if (a.kind == Value::Const && b.kind == Value::Const) return Value::cst(wrap32(a.num * b.num));
+        if ((a.kind == Value::Const && a.num == 0) || (b.kind == Value::Const && b.num == 0)) return Value::cst(0);
+        if (a.kind == Value::Const && a.num == 1) return b;
+        if (b.kind == Value::Const && b.num == 1) return a;
+        return Value::inst(f.insert(ph, f.blocks[ph].insts.size() - 1, Op::Mul, Ty::i32(), {a, b}));
+    }
+
+    void reduce(Loop& l) {
+        if (l.latches.size() != 1) return;
+        Id h = l.header, ph = l.preheader, latch = l.latches[0];
+        std::vector<IndVar> ivs;
+        for (Id phi : f.blocks[h].insts) {
+            const Inst& in = f.insts[phi];
+            if (in.op != Op::Phi) break;
+            if (in.opCount != 4 || !(in.ty == Ty::i32())) continue;
+            Value init, next;
+            for (uint32_t k = 0; k < 4; k += 2) {
+                Id from = f.operand(phi, k + 1).id();
+                if (from == ph) init = f.operand(phi, k);
+                else if (from == latch) next = f.operand(phi, k);
+            }
+            if (init.kind == Value::Empty || next.kind != Value::Inst) continue;
+            Id n = next.id();
+            Value a = f.operand(n, 0), b = f.operand(n, 1), self = Value::inst(phi);
+            Value step;
+            if (f.insts[n].op == Op::Add && a == self && invariant(l, b)) step = b;
+            else if (f.insts[n].op == Op::Add && b == self && invariant(l, a)) step = a;
+            else if (f.insts[n].op == Op::Sub && a == self && b.kind == Value::Const) step = Value::cst(wrap32(-b.num));
+            else continue;
+            ivs.push_back({phi, init, step});
+        }
+        if (ivs.empty()) return;
+
+        auto findIv = [&](Value v) -> const IndVar* {
+            if (v.kind != Value::Inst) return nullptr;
+            for (auto& iv : ivs) if (iv.phi == v.id()) return &iv;
+            return nullptr;
+        };
+        std::map<std::pair<Id, int64_t>, Id> made; // (iv, constant factor) -> reduced iv
+        for (Id b : blocksOf(l)) {
+            std::vector<Id> list = f.blocks[b].insts;
+            for (Id i : list) {
+                const Inst& in = f.insts[i];
+                if (in.op != Op::Mul && in.op != Op::Shl) continue;
+                Value x = f.operand(i, 0), y = f.operand(i, 1);
+                const IndVar* iv = nullptr;
+                Value factor;
+                if (in.op == Op::Shl) {
+                    if (y.kind != Value::Const || y.num <= 0 || y.num > 31) continue;
+                    iv = findIv(x);
+                    factor = Value::cst(wrap32((int64_t)1 << y.num));
+                } else if (findIv(x) && invariant(l, y)) {
+                    iv = findIv(x);
+                    factor = y;
+                } else if (findIv(y) && invariant(l, x)) {
+                    iv = findIv(y);
+                    factor = x;
+                }
+                if (!iv) continue;
+
+                Id j;
+                auto key = std::make_pair(iv->phi, factor.kind == Value::Const ? factor.num : INT64_MIN);
+                auto found = factor.kind == Value::Const ? made.find(key) : made.end();
+                if (found != made.end()) {
+                    j = found->second;
+                } else {
+                    // j = init * factor, then j += step * factor per iteration
+                    IndVar base = *iv; // ivs may grow below
+                    Value init = product(ph, base.init, factor);
+                    Value step = product(ph, base.step, factor);
+                    j = f.insert(h, 0, Op::Phi, Ty::i32(), {init, Value::block(ph), Value(), Value::block(latch)});
+                    Id next = f.insert(latch, f.blocks[latch].insts.size() - 1, Op::Add, Ty::i32(), {Value::inst(j), step});
+                    f.setOperand(j, 2, Value::inst(next));
+                    ivs.push_back({j, init, step});
+                    if (factor.kind == Value::Const) made[key] = j;
+                    ++st.inductionVars;
+                }
+                f.replaceAllUses(i, Value::inst(j));
+                f.erase(i);
+                ++st.strengthReduced;
+            }
+        }
+    }
+
+    void shifts() {
+        for (Id b : rpo)
+            for (Id i : f.blocks[b].insts) {
+                if (f.insts[i].op != Op::Mul) continue;
+                Value x = f.operand(i, 0), c = f.operand(i, 1);
+                if (x.kind == Value::Const) std::swap(x, c);
+                if (c.kind != Value::Const) continue;
+                uint32_t u = (uint32_t)c.num;
+                if (u < 2 || (u & (u - 1))) continue;
+                f.insts[i].op = Op::Shl;
+                f.setOperands(i, {x, Value::cst(__builtin_ctz(u))});
+                ++st.shifts;
+            }
+    }
+
+    // Mark and sweep from the instructions with effects, so dead cycles
+    // through phis (induction variables nobody reads any more) go too.
+    void removeDead() {
+        std::vector<char> live(f.insts.size(), 0);
+        std::vector<Id> work;
+        for (Id b : rpo)
+            for (Id i : f.blocks[b].insts) {
+                Op o = f.insts[i].op;
+                bool pure = (o >= Op::Add && o <= Op::Alloca && o != Op::SDiv && o != Op::SRem) || o == Op::Load || o == Op::Gep;
+                if (!pure) { live[i] = 1; work.push_back(i); }
+            }
+        while (!work.empty()) {
+            Id i = work.back();
+            work.pop_back();
+            for (uint32_t k = 0; k < f.insts[i].opCount; ++k) {
+                Value v = f.operand(i, k);
+                if (v.kind == Value::Inst && !live[v.id()]) { live[v.id()] = 1; work.push_back(v.id()); }
+            }
+        }
+        for (Id b : rpo) {
+            std::vector<Id> list = f.blocks[b].insts;
+            for (Id i : list)
+                if (!live[i]) { f.erase(i); ++st.removed; }
+        }
+    }
+};
+
+} // namespace
+
+void LoopOpt::run(Function& f) { LoopPass(f, stats).run(); }
+
+} // namespace cmini::ir
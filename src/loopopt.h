@@ -0,0 +1,32 @@
+#pragma once
+#include <cstddef>
+#include "ir.h"
+
+namespace cmini::ir {
+
+// Loop optimizations on one function in SSA form, run by IRGen at -O1 and
+// up. Natural loops are found from back edges in the dominator tree and
+// processed innermost first:
+//  - every loop gets a preheader (a block that only branches to the header);
+//  - loop-invariant computations that cannot trap move into the preheader;
+//  - basic induction variables (header phis stepped by an invariant amount
+//    once per iteration) are recognized, and iv * invariant becomes a new
+//    induction variable that is stepped by an add instead of multiplied.
+// Afterwards multiplies by a power of two become shifts and instructions
+// left without uses are deleted.
+struct LoopOpt {
+    struct Stats {
+        size_t loops {0};           // natural loops found
+        size_t hoisted {0};         // instructions moved to a preheader
+        size_t inductionVars {0};   // induction variables created
+        size_t strengthReduced {0}; // multiplies replaced by a per-iteration add
+        size_t shifts {0};          // multiplies by a power of two turned into shl
+        size_t removed {0};         // dead instructions deleted
+        Stats& operator+=(const Stats& o);
+    };
+    Stats stats;
+
+    void run(Function& f);
+};
+
+} // namespace cmini::ir
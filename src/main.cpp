@@ -1,42 +1,60 @@
-#include <fstream>
+#include <cstdlib>
 #include <iostream>
-#include <sstream>
-#include "lexer.h"
-#include "parser.h"
-#include "semantic.h"
-#include "irgen.h"
+#include <new>
+#include <string>
+#include "driver.h"
+#include "server.h"
+#include "timereport.h"
 
-using namespace cmini;
-
-int main(int argc, char** argv) {
-    if (argc < 2) {
-        std::cerr << "usage: cmini <file> [ -o out.ll ]\n";
-        return 1;
-    }
-    std::string inPath = argv[1];
-    std::string outPath = "out.ll";
-    for (int i=2;i<argc;i++) {
-        std::string a = argv[i];
-        if (a=="-o" && i+1<argc) { outPath = argv[++i]; }
+// Counting replacement for the global allocation functions, for
+// --time-report. Every plain, array and nothrow form is replaced, and all
+// of them allocate with malloc and free with free, so none can pair with
+// a library (or sanitizer) version of another. They live in the executable
+// rather than cmini_core so tests and tools linking the library keep
+// their own.
+void* operator new(std::size_t n) {
+    cmini::TimeReport::noteAllocation(n);
+    for (;;) {
+        if (void* p = std::malloc(n ? n : 1)) return p;
+        std::new_handler h = std::get_new_handler();
+        if (!h) throw std::bad_alloc();
+        h();
     }
+}
+void* operator new[](std::size_t n) { return operator new(n); }
+void* operator new(std::size_t n, const std::nothrow_t&) noexcept {
+    try { return operator new(n); } catch (...) { return nullptr; }
+}
+void* operator new[](std::size_t n, const std::nothrow_t&) noexcept {
+    try { return operator new(n); } catch (...) { return nullptr; }
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { std::free(p); }
 
-    std::ifstream in(inPath);
-    if (!in) { std::cerr << "cannot open: " << inPath << "\n"; return 1; }
-    std::ostringstream ss; ss << in.rdbuf();
-
-    Lexer lex(ss.str());
-    Parser parser(lex);
-    auto prog = parser.parseProgram();
+int main(int argc, char** argv) {
+    std::vector<std::string> args(argv + 1, argv + argc);
 
-    Semantic sem; sem.analyze(*prog);
-    if (!sem.diags.ok()) {
-        for (auto& m : sem.diags.messages) std::cerr << "error: " << m << "\n";
-        return 1;
+    // cmini --server SOCKET [-j N]: run the compile daemon
+    if (args.size() >= 2 && args[0] == "--server") {
+        unsigned jobs = 0;
+        for (size_t i = 2; i < args.size(); ++i) {
+            if (args[i].rfind("-j", 0) != 0) { std::cerr << "unknown option: " << args[i] << "\n"; return 1; }
+            if (!cmini::parseJobs(args, i, jobs, std::cerr)) return 1;
+        }
+        return cmini::runServer(args[1], jobs, std::cerr);
     }
-
-    IRGen ir; std::string text = ir.gen(*prog);
-    std::ofstream out(outPath);
-    out << text;
-    std::cout << "wrote " << outPath << "\n";
-    return 0;
+    // cmini --connect SOCKET <args...>: forward to a running daemon, or
+    // compile in-process when none is listening
+    if (args.size() >= 2 && args[0] == "--connect") {
+        std::string sock = args[1];
+        args.erase(args.begin(), args.begin() + 2);
+        int rc = cmini::runClient(sock, args, std::cout, std::cerr);
+        if (rc >= 0) return rc;
+        std::cerr << "cmini: no server on " << sock << ", compiling locally\n";
+    }
+    return cmini::runDriver(args, std::cout, std::cerr);
 }
@@ -0,0 +1,122 @@
+#include "object.h"
+#include <cstring>
+#include <elf.h>
+#include "outsink.h"
+
+namespace cmini {
+
+uint32_t ObjectWriter::symbol(SymId name) {
+    auto [it, fresh] = bySym.emplace(name, (uint32_t)symbols.size());
+    if (fresh) symbols.push_back({std::string(symName(name))});
+    return it->second;
+}
+
+void ObjectWriter::add(const x86::MachineCode& code) {
+    text.resize((text.size() + 15) & ~size_t(15), 0xCC); // int3 padding
+    uint64_t at = text.size();
+    Symbol& s = symbols[symbol(code.name)];
+    s.value = at;
+    s.size = code.bytes.size();
+    s.defined = true;
+    text.insert(text.end(), code.bytes.begin(), code.bytes.end());
+    for (auto& c : code.calls) relocs.push_back({at + c.offset, symbol(c.callee)});
+}
+
+namespace {
+
+struct Buffer {
+    std::vector<uint8_t> bytes;
+    template <class T> void put(const T& v) {
+        size_t at = bytes.size();
+        bytes.resize(at + sizeof v);
+        std::memcpy(bytes.data() + at, &v, sizeof v);
+    }
+    void put(const void* p, size_t n) { bytes.insert(bytes.end(), (const uint8_t*)p, (const uint8_t*)p + n); }
+    void align(size_t a) { bytes.resize((bytes.size() + a - 1) & ~(a - 1), 0); }
+};
+
+// String table: offset 0 is the empty string.
+struct Strings {
+    std::string data {std::string(1, '\0')};
+    uint32_t add(std::string_view s) {
+        uint32_t at = (uint32_t)data.size();
+        data.append(s);
+        data.push_back('\0');
+        return at;
+    }
+};
+
+} // namespace
+
+void ObjectWriter::write(OutSink& out) const {
+    enum { Text = 1, RelaText, SymTab, StrTab, Note, ShStrTab, Sections };
+
+    // Symbols: the null entry and the section symbol are local, then every
+    // function in first-mention order.
+    Strings strtab;
+    std::vector<Elf64_Sym> syms(2);
+    syms[1].st_info = ELF64_ST_INFO(STB_LOCAL, STT_SECTION);
+    syms[1].st_shndx = Text;
+    for (auto& s : symbols) {
+        Elf64_Sym e {};
+        e.st_name = strtab.add(s.name);
+        e.st_info = ELF64_ST_INFO(STB_GLOBAL, s.defined ? STT_FUNC : STT_NOTYPE);
+        e.st_shndx = s.defined ? Text : SHN_UNDEF;
+        e.st_value = s.value;
+        e.st_size = s.size;
+        syms.push_back(e);
+    }
+    std::vector<Elf64_Rela> rela;
+    for (auto& r : relocs)
+        rela.push_back({r.offset, ELF64_R_INFO(r.symbol + 2, R_X86_64_PLT32), -4});
+
+    static const char* names[Sections] = {"", ".text", ".rela.text", ".symtab", ".strtab", ".note.GNU-stack", ".shstrtab"};
+    Strings shstr;
+    Elf64_Shdr sh[Sections] {};
+    for (int k = 1; k < Sections; ++k) sh[k].sh_name = shstr.add(names[k]);
+    Buffer f;
+    f.bytes.resize(sizeof(Elf64_Ehdr));
+    auto section = [&](int k, uint32_t type, uint64_t flags, const void* data, size_t n, size_t align) {
+        f.align(align);
+        sh[k].sh_type = type;
+        sh[k].sh_flags = flags;
+        sh[k].sh_offset = f.bytes.size();
+        sh[k].sh_size = n;
+        sh[k].sh_addralign = align;
+        f.put(data, n);
+    };
+    section(Text, SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, text.data(), text.size(), 16);
+    section(RelaText, SHT_RELA, SHF_INFO_LINK, rela.data(), rela.size() * sizeof(Elf64_Rela), 8);
+    sh[RelaText].sh_link = SymTab;
+    sh[RelaText].sh_info = Text;
+    sh[RelaText].sh_entsize = sizeof(Elf64_Rela);
+    section(SymTab, SHT_SYMTAB, 0, syms.data(), syms.size() * sizeof(Elf64_Sym), 8);
+    sh[SymTab].sh_link = StrTab;
+    sh[SymTab].sh_info = 2; // index of the first global
+    sh[SymTab].sh_entsize = sizeof(Elf64_Sym);
+    section(StrTab, SHT_STRTAB, 0, strtab.data.data(), strtab.data.size(), 1);
+    section(Note, SHT_PROGBITS, 0, nullptr, 0, 1); // no executable stack
+    section(ShStrTab, SHT_STRTAB, 0, shstr.data.data(), shstr.data.size(), 1);
+    f.align(8);
+    uint64_t shoff = f.bytes.size();
+    f.put(sh, sizeof sh);
+
+    Elf64_Ehdr eh {};
+    std::memcpy(eh.e_ident, ELFMAG, SELFMAG);
+    eh.e_ident[EI_CLASS] = ELFCLASS64;
+    eh.e_ident[EI_DATA] = ELFDATA2LSB;
+    eh.e_ident[EI_VERSION] = EV_CURRENT;
+    eh.e_ident[EI_OSABI] = ELFOSABI_SYSV;
+    eh.e_type = ET_REL;
+    eh.e_machine = EM_X86_64;
+    eh.e_version = EV_CURRENT;
+    eh.e_shoff = shoff;
+    eh.e_ehsize = sizeof(Elf64_Ehdr);
+    eh.e_shentsize = sizeof(Elf64_Shdr);
+    eh.e_shnum = Sections;
+    eh.e_shstrndx = ShStrTab;
+    std::memcpy(f.bytes.data(), &eh, sizeof eh);
+    out.write(reinterpret_cast<const char*>(f.bytes.data()), f.bytes.size());
+}
+
+} // namespace cmini
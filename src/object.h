@@ -0,0 +1,36 @@
+#pragma once
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "x86.h"
+
+namespace cmini {
+
+class OutSink;
+
+// Writes an ELF64 relocatable object for x86-64 (what `cc -c` produces):
+// one .text section holding every function 16-byte aligned, a global
+// function symbol per definition, undefined symbols for callees defined
+// elsewhere, and an R_X86_64_PLT32 relocation per call so the system linker
+// resolves calls within the object and to other objects alike. When a name
+// is defined twice, the later definition wins, as in Semantic.
+class ObjectWriter {
+public:
+    void add(const x86::MachineCode& code);
+    void write(OutSink& out) const;
+
+    size_t textBytes() const { return text.size(); }
+
+private:
+    struct Symbol { std::string name; uint64_t value {0}, size {0}; bool defined {false}; };
+    struct Reloc { uint64_t offset; uint32_t symbol; };
+
+    uint32_t symbol(SymId name);
+
+    std::vector<uint8_t> text;
+    std::vector<Symbol> symbols;
+    std::unordered_map<SymId, uint32_t> bySym;
+    std::vector<Reloc> relocs;
+};
+
+} // namespace cmini
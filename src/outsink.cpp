@@ -0,0 +1,72 @@
+#include "outsink.h"
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace cmini {
+
+void OutSink::write(const char* p, size_t n) {
+    total += n;
+    while (n) {
+        if (chunks.empty()) chunks.push_back({std::make_unique<char[]>(ChunkSize), 0});
+        Chunk* c = &chunks[active];
+        if (c->used == ChunkSize) {
+            if (++active == chunks.size()) chunks.push_back({std::make_unique<char[]>(ChunkSize), 0});
+            c = &chunks[active];
+        }
+        size_t k = std::min(n, ChunkSize - c->used);
+        std::memcpy(c->data.get() + c->used, p, k);
+        c->used += k; p += k; n -= k;
+    }
+}
+
+void OutSink::append(const OutSink& other) {
+    if (other.chunks.empty()) return;
+    for (size_t i = 0; i <= other.active; ++i) write(other.chunks[i].data.get(), other.chunks[i].used);
+}
+
+void OutSink::flush() {
+    if (fd < 0 || chunks.empty() || failed) return;
+    std::vector<iovec> iov;
+    for (size_t i = 0; i <= active; ++i)
+        if (chunks[i].used) iov.push_back({chunks[i].data.get(), chunks[i].used});
+    size_t first = 0;
+    while (first < iov.size()) {
+        int cnt = (int)std::min(iov.size() - first, (size_t)IOV_MAX);
+        ssize_t w = ::writev(fd, &iov[first], cnt);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            failed = true;
+            break;
+        }
+        // consume the written prefix, which may end inside an iovec
+        size_t left = (size_t)w;
+        while (first < iov.size() && left >= iov[first].iov_len) left -= iov[first++].iov_len;
+        if (left) {
+            iov[first].iov_base = static_cast<char*>(iov[first].iov_base) + left;
+            iov[first].iov_len -= left;
+        }
+    }
+    clear();
+}
+
+void OutSink::clear() {
+    if (chunks.empty()) return;
+    for (size_t i = 0; i <= active; ++i) chunks[i].used = 0;
+    active = 0;
+}
+
+std::string OutSink::str() const {
+    std::string s;
+    if (chunks.empty()) return s;
+    size_t n = 0;
+    for (size_t i = 0; i <= active; ++i) n += chunks[i].used;
+    s.reserve(n);
+    for (size_t i = 0; i <= active; ++i) s.append(chunks[i].data.get(), chunks[i].used);
+    return s;
+}
+
+} // namespace cmini
@@ -0,0 +1,56 @@
+#pragma once
+#include <charconv>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cmini {
+
+// Chunked text sink for generated IR. Bytes are appended into fixed-size
+// chunks; nothing is ever reallocated or copied while formatting. With a
+// file descriptor, flush() writes the pending chunks with writev and keeps
+// them for reuse, so memory stays bounded by what is produced between two
+// flushes (IRGen flushes after every function). Without one, everything is
+// kept in memory and str() returns it.
+class OutSink {
+public:
+    static constexpr size_t ChunkSize = 64 * 1024;
+
+    explicit OutSink(int fd = -1) : fd(fd) {}
+    OutSink(const OutSink&) = delete;
+    OutSink& operator=(const OutSink&) = delete;
+    ~OutSink() { flush(); }
+
+    OutSink& operator<<(std::string_view s) { write(s.data(), s.size()); return *this; }
+    OutSink& operator<<(const char* s) { return *this << std::string_view(s); }
+    OutSink& operator<<(char c) { write(&c, 1); return *this; }
+    OutSink& operator<<(long v) {
+        char buf[24];
+        auto r = std::to_chars(buf, buf + sizeof buf, v);
+        write(buf, (size_t)(r.ptr - buf));
+        return *this;
+    }
+    OutSink& operator<<(int v) { return *this << (long)v; }
+    OutSink& operator<<(size_t v) { return *this << (long)v; }
+
+    void write(const char* p, size_t n);
+    void append(const OutSink& other); // pending bytes of other, in order
+    void flush();
+    void clear(); // drop pending bytes, keep the chunks for reuse
+
+    std::string str() const;         // contents not yet flushed
+    size_t bytes() const { return total; } // everything ever written
+    bool ok() const { return !failed; }
+
+private:
+    struct Chunk { std::unique_ptr<char[]> data; size_t used {0}; };
+
+    int fd;
+    std::vector<Chunk> chunks; // [0, active] hold pending bytes, the rest are spare
+    size_t active {0};
+    size_t total {0};
+    bool failed {false};
+};
+
+} // namespace cmini
@@ -1,4 +1,5 @@
 #include "parser.h"
+#include <array>
 #include <stdexcept>
 
 namespace cmini {
@@ -27,12 +28,7 @@ Type Parser::afterTypeModifiers(Type base) {
     // handle multi-level pointers: int **
     while (accept(TokenKind::Star)) base.pointerLevels++;
     // handle arrays: int a[10][20]
-    while (accept(TokenKind::LBracket)) {
-        Token d = eat();
-        if (d.kind != TokenKind::Integer) throw std::runtime_error("array size integer expected");
-        base.arrayDims.push_back((size_t)d.intVal);
-        expect(TokenKind::RBracket, "]");
-    }
+    parseArraySuffix(base);
     return base;
 }
 
@@ -41,12 +37,12 @@ Param Parser::param() {
     Token id = eat();
     if (id.kind != TokenKind::Identifier) throw std::runtime_error("param name expected");
     parseArraySuffix(t);
-    return {t, id.text};
+    return {t, id.sym};
 }
 
-std::unique_ptr<Block> Parser::block() {
+Block* Parser::block() {
     expect(TokenKind::LBrace, "{");
-    auto blk = std::make_unique<Block>();
+    auto blk = make<Block>();
     while (peek().kind != TokenKind::RBrace && peek().kind != TokenKind::End) {
         blk->items.push_back(statement());
     }
@@ -55,31 +51,34 @@ std::unique_ptr<Block> Parser::block() {
 }
 
 void Parser::parseArraySuffix(Type& t) {
+    if (peek().kind != TokenKind::LBracket) return;
+    std::vector<size_t> dims(t.arrayDims.begin(), t.arrayDims.end());
     while (accept(TokenKind::LBracket)) {
         Token d = eat();
         if (d.kind != TokenKind::Integer) throw std::runtime_error("array size integer expected");
-        t.arrayDims.push_back((size_t)d.intVal);
+        dims.push_back((size_t)d.intVal);
         expect(TokenKind::RBracket, "]");
     }
+    t.arrayDims = {arena->copy(dims.data(), dims.size()), dims.size()};
 }
 
-std::unique_ptr<Stmt> Parser::declOrExprStmt() {
+Stmt* Parser::declOrExprStmt() {
     // Lookahead for a type keyword
     if (peek().kind==TokenKind::KwInt || peek().kind==TokenKind::KwChar || peek().kind==TokenKind::KwFloat || peek().kind==TokenKind::KwVoid) {
         Type t = typeSpec();
         Token id = eat(); if (id.kind!=TokenKind::Identifier) throw std::runtime_error("identifier expected");
         parseArraySuffix(t);
-        auto decl = std::make_unique<Decl>(t, id.text);
-        if (accept(TokenKind::Assign)) { auto e = assign(); decl->init = std::move(e); }
+        auto decl = make<Decl>(t, id.sym);
+        if (accept(TokenKind::Assign)) { auto e = assign(); decl->init = e; }
         expect(TokenKind::Semicolon, ";");
         return decl;
     }
     auto e = expr();
     expect(TokenKind::Semicolon, ";");
-    return std::make_unique<ExprStmt>(std::move(e));
+    return make<ExprStmt>(e);
 }
 
-std::unique_ptr<Stmt> Parser::statement() {
+Stmt* Parser::statement() {
     switch (peek().kind) {
         case TokenKind::LBrace: return block();
         case TokenKind::KwIf: return ifStmt();
@@ -87,33 +86,33 @@ std::unique_ptr<Stmt> Parser::statement() {
         case TokenKind::KwDo: return doWhileStmt();
         case TokenKind::KwFor: return forStmt();
         case TokenKind::KwReturn: return returnStmt();
-        case TokenKind::KwBreak: eat(); expect(TokenKind::Semicolon, ";"); return std::make_unique<BreakStmt>();
-        case TokenKind::KwContinue: eat(); expect(TokenKind::Semicolon, ";"); return std::make_unique<ContinueStmt>();
+        case TokenKind::KwBreak: eat(); expect(TokenKind::Semicolon, ";"); return make<BreakStmt>();
+        case TokenKind::KwContinue: eat(); expect(TokenKind::Semicolon, ";"); return make<ContinueStmt>();
         default: return declOrExprStmt();
     }
 }
 
-std::unique_ptr<Stmt> Parser::ifStmt() {
+Stmt* Parser::ifStmt() {
     expect(TokenKind::KwIf, "if");
     expect(TokenKind::LParen, "(");
     auto c = expr();
     expect(TokenKind::RParen, ")");
     auto t = statement();
-    std::unique_ptr<Stmt> e;
+    Stmt* e = nullptr;
     if (accept(TokenKind::KwElse)) e = statement();
-    auto s = std::make_unique<IfStmt>(); s->cond=std::move(c); s->thenS=std::move(t); s->elseS=std::move(e); return s;
+    auto s = make<IfStmt>(); s->cond=c; s->thenS=t; s->elseS=e; return s;
 }
 
-std::unique_ptr<Stmt> Parser::whileStmt() {
+Stmt* Parser::whileStmt() {
     expect(TokenKind::KwWhile, "while");
     expect(TokenKind::LParen, "(");
     auto c = expr();
     expect(TokenKind::RParen, ")");
     auto b = statement();
-    auto s = std::make_unique<WhileStmt>(); s->cond=std::move(c); s->body=std::move(b); return s;
+    auto s = make<WhileStmt>(); s->cond=c; s->body=b; return s;
 }
 
-std::unique_ptr<Stmt> Parser::doWhileStmt() {
+Stmt* Parser::doWhileStmt() {
     expect(TokenKind::KwDo, "do");
     auto b = statement();
     expect(TokenKind::KwWhile, "while");
@@ -121,152 +120,116 @@ std::unique_ptr<Stmt> Parser::doWhileStmt() {
     auto c = expr();
     expect(TokenKind::RParen, ")");
     expect(TokenKind::Semicolon, ";");
-    auto s = std::make_unique<DoWhileStmt>(); s->body=std::move(b); s->cond=std::move(c); return s;
+    auto s = make<DoWhileStmt>(); s->body=b; s->cond=c; return s;
 }
 
-std::unique_ptr<Stmt> Parser::forStmt() {
+Stmt* Parser::forStmt() {
     expect(TokenKind::KwFor, "for");
     expect(TokenKind::LParen, "(");
-    std::unique_ptr<Stmt> init;
+    Stmt* init = nullptr;
     if (!accept(TokenKind::Semicolon)) {
         if (peek().kind==TokenKind::KwInt || peek().kind==TokenKind::KwChar || peek().kind==TokenKind::KwFloat || peek().kind==TokenKind::KwVoid) init = declOrExprStmt();
-        else { auto e = expr(); expect(TokenKind::Semicolon, ";"); init = std::make_unique<ExprStmt>(std::move(e)); }
+        else { auto e = expr(); expect(TokenKind::Semicolon, ";"); init = make<ExprStmt>(e); }
     }
-    std::unique_ptr<Expr> cond;
+    Expr* cond = nullptr;
     if (!accept(TokenKind::Semicolon)) { cond = expr(); expect(TokenKind::Semicolon, ";"); }
-    std::unique_ptr<Expr> step;
+    Expr* step = nullptr;
     if (!accept(TokenKind::RParen)) { step = expr(); expect(TokenKind::RParen, ")"); }
     auto b = statement();
-    auto s = std::make_unique<ForStmt>(); s->init=std::move(init); s->cond=std::move(cond); s->step=std::move(step); s->body=std::move(b); return s;
+    auto s = make<ForStmt>(); s->init=init; s->cond=cond; s->step=step; s->body=b; return s;
 }
 
-std::unique_ptr<Stmt> Parser::returnStmt() {
+Stmt* Parser::returnStmt() {
     expect(TokenKind::KwReturn, "return");
-    std::unique_ptr<Expr> e;
+    Expr* e = nullptr;
     if (!accept(TokenKind::Semicolon)) { e = expr(); expect(TokenKind::Semicolon, ";"); }
-    auto s = std::make_unique<ReturnStmt>(); s->expr = std::move(e); return s;
+    auto s = make<ReturnStmt>(); s->expr = e; return s;
 }
 
-std::unique_ptr<Expr> Parser::expr() { return assign(); }
+namespace {
+
+// Binding power of the binary operators, lowest first, as in C; 0 for
+// every other token, which ends a binary expression.
+struct BinaryInfo { uint8_t prec; BinaryOp op; };
 
-std::unique_ptr<Expr> Parser::assign() {
-    auto lhs = logicOr();
+constexpr auto binaryOps = [] {
+    std::array<BinaryInfo, (size_t)TokenKind::Shr + 1> t {};
+    auto set = [&](TokenKind k, uint8_t prec, BinaryOp op) { t[(size_t)k] = {prec, op}; };
+    set(TokenKind::OrOr, 1, BinaryOp::Or);
+    set(TokenKind::AndAnd, 2, BinaryOp::And);
+    set(TokenKind::Pipe, 3, BinaryOp::BitOr);
+    set(TokenKind::Caret, 4, BinaryOp::BitXor);
+    set(TokenKind::Amp, 5, BinaryOp::BitAnd);
+    set(TokenKind::EQ, 6, BinaryOp::EQ); set(TokenKind::NE, 6, BinaryOp::NE);
+    set(TokenKind::LT, 7, BinaryOp::LT); set(TokenKind::LE, 7, BinaryOp::LE);
+    set(TokenKind::GT, 7, BinaryOp::GT); set(TokenKind::GE, 7, BinaryOp::GE);
+    set(TokenKind::Shl, 8, BinaryOp::Shl); set(TokenKind::Shr, 8, BinaryOp::Shr);
+    set(TokenKind::Plus, 9, BinaryOp::Add); set(TokenKind::Minus, 9, BinaryOp::Sub);
+    set(TokenKind::Star, 10, BinaryOp::Mul); set(TokenKind::Slash, 10, BinaryOp::Div);
+    set(TokenKind::Percent, 10, BinaryOp::Mod);
+    return t;
+}();
+
+} // namespace
+
+Expr* Parser::expr() { return assign(); }
+
+Expr* Parser::assign() {
+    auto lhs = binary(1);
     if (accept(TokenKind::Assign)) {
         auto rhs = assign();
-        return std::make_unique<AssignExpr>(std::move(lhs), std::move(rhs));
+        return make<AssignExpr>(lhs, rhs);
     }
     return lhs;
 }
 
-std::unique_ptr<Expr> Parser::logicOr() {
-    auto e = logicAnd();
-    while (accept(TokenKind::OrOr)) {
-        auto r = logicAnd();
-        e = std::make_unique<BinaryExpr>(BinaryOp::Or, std::move(e), std::move(r));
+// All binary operators are left-associative: the right operand only takes
+// operators that bind more tightly than the one before it.
+Expr* Parser::binary(int minPrec) {
+    auto e = operand();
+    for (;;) {
+        const BinaryInfo& b = binaryOps[(size_t)peek().kind];
+        if (b.prec < minPrec) return e; // minPrec is at least 1
+        eat();
+        auto r = binary(b.prec + 1);
+        e = make<BinaryExpr>(b.op, e, r);
     }
-    return e;
-}
-
-std::unique_ptr<Expr> Parser::logicAnd() {
-    auto e = bitOr();
-    while (accept(TokenKind::AndAnd)) {
-        auto r = bitOr();
-        e = std::make_unique<BinaryExpr>(BinaryOp::And, std::move(e), std::move(r));
-        }
-    return e;
 }
 
-std::unique_ptr<Expr> Parser::bitOr() {
-    auto e = bitXor();
-    while (accept(TokenKind::Pipe)) { auto r = bitXor(); e = std::make_unique<BinaryExpr>(BinaryOp::BitOr, std::move(e), std::move(r)); }
-    return e;
-}
-std::unique_ptr<Expr> Parser::bitXor() {
-    auto e = bitAnd();
-    while (accept(TokenKind::Caret)) { auto r = bitAnd(); e = std::make_unique<BinaryExpr>(BinaryOp::BitXor, std::move(e), std::move(r)); }
-    return e;
-}
-std::unique_ptr<Expr> Parser::bitAnd() {
-    auto e = equality();
-    while (accept(TokenKind::Amp)) { auto r = equality(); e = std::make_unique<BinaryExpr>(BinaryOp::BitAnd, std::move(e), std::move(r)); }
-    return e;
-}
-std::unique_ptr<Expr> Parser::equality() {
-    auto e = relational();
-    while (true) {
-        if (accept(TokenKind::EQ)) { auto r = relational(); e = std::make_unique<BinaryExpr>(BinaryOp::EQ, std::move(e), std::move(r)); }
-        else if (accept(TokenKind::NE)) { auto r = relational(); e = std::make_unique<BinaryExpr>(BinaryOp::NE, std::move(e), std::move(r)); }
-        else break;
-    }
-    return e;
-}
-std::unique_ptr<Expr> Parser::relational() {
-    auto e = shift();
-    while (true) {
-        if (accept(TokenKind::LT)) { auto r = shift(); e = std::make_unique<BinaryExpr>(BinaryOp::LT, std::move(e), std::move(r)); }
-        else if (accept(TokenKind::LE)) { auto r = shift(); e = std::make_unique<BinaryExpr>(BinaryOp::LE, std::move(e), std::move(r)); }
-        else if (accept(TokenKind::GT)) { auto r = shift(); e = std::make_unique<BinaryExpr>(BinaryOp::GT, std::move(e), std::move(r)); }
-        else if (accept(TokenKind::GE)) { auto r = shift(); e = std::make_unique<BinaryExpr>(BinaryOp::GE, std::move(e), std::move(r)); }
-        else break;
-    }
-    return e;
-}
-std::unique_ptr<Expr> Parser::shift() {
-    auto e = additive();
-    while (true) {
-        if (accept(TokenKind::Shl)) { auto r = additive(); e = std::make_unique<BinaryExpr>(BinaryOp::Shl, std::move(e), std::move(r)); }
-        else if (accept(TokenKind::Shr)) { auto r = additive(); e = std::make_unique<BinaryExpr>(BinaryOp::Shr, std::move(e), std::move(r)); }
-        else break;
-    }
-    return e;
-}
-std::unique_ptr<Expr> Parser::additive() {
-    auto e = mul();
-    while (true) {
-        if (accept(TokenKind::Plus)) { auto r = mul(); e = std::make_unique<BinaryExpr>(BinaryOp::Add, std::move(e), std::move(r)); }
-        else if (accept(TokenKind::Minus)) { auto r = mul(); e = std::make_unique<BinaryExpr>(BinaryOp::Sub, std::move(e), std::move(r)); }
-        else break;
-    }
-    return e;
-}
-std::unique_ptr<Expr> Parser::mul() {
-    auto e = unary();
-    while (true) {
-        if (accept(TokenKind::Star)) { auto r = unary(); e = std::make_unique<BinaryExpr>(BinaryOp::Mul, std::move(e), std::move(r)); }
-        else if (accept(TokenKind::Slash)) { auto r = unary(); e = std::make_unique<BinaryExpr>(BinaryOp::Div, std::move(e), std::move(r)); }
-        else if (accept(TokenKind::Percent)) { auto r = unary(); e = std::make_unique<BinaryExpr>(BinaryOp::Mod, std::move(e), std::move(r)); }
-        else break;
-    }
-    return e;
-}
-std::unique_ptr<Expr> Parser::unary() {
-    if (accept(TokenKind::Plus)) return std::make_unique<UnaryExpr>(UnaryOp::Plus, unary());
-    if (accept(TokenKind::Minus)) return std::make_unique<UnaryExpr>(UnaryOp::Minus, unary());
-    if (accept(TokenKind::Amp)) return std::make_unique<UnaryExpr>(UnaryOp::Addr, unary());
-    if (accept(TokenKind::Star)) return std::make_unique<UnaryExpr>(UnaryOp::Deref, unary());
-    return postfix();
-}
-std::unique_ptr<Expr> Parser::postfix() {
-    auto e = primary();
-    while (true) {
-        if (accept(TokenKind::LBracket)) { auto idx = expr(); expect(TokenKind::RBracket, "]"); e = std::make_unique<ArrayIndex>(std::move(e), std::move(idx)); }
-        else break;
-    }
-    return e;
-}
-std::unique_ptr<Expr> Parser::primary() {
+Expr* Parser::operand() {
     Token t = eat();
+    Expr* e;
     switch (t.kind) {
-        case TokenKind::Identifier: return std::make_unique<VarRef>(t.text);
-        case TokenKind::Integer: return std::make_unique<IntegerLiteral>(t.intVal);
-        case TokenKind::Char: return std::make_unique<CharLiteral>((char)t.intVal);
-        case TokenKind::String: return std::make_unique<StringLiteral>(t.text);
-        case TokenKind::LParen: { auto e = expr(); expect(TokenKind::RParen, ")"); return e; }
+        case TokenKind::Plus: return make<UnaryExpr>(UnaryOp::Plus, operand());
+        case TokenKind::Minus: return make<UnaryExpr>(UnaryOp::Minus, operand());
+        case TokenKind::Amp: return make<UnaryExpr>(UnaryOp::Addr, operand());
+        case TokenKind::Star: return make<UnaryExpr>(UnaryOp::Deref, operand());
+        case TokenKind::Identifier: {
+            if (!accept(TokenKind::LParen)) { e = make<VarRef>(t.sym); break; }
+            auto call = make<CallExpr>(t.sym);
+            if (peek().kind != TokenKind::RParen) {
+                call->args.push_back(assign());
+                while (accept(TokenKind::Comma)) call->args.push_back(assign());
+            }
+            expect(TokenKind::RParen, ")");
+            e = call;
+            break;
+        }
+        case TokenKind::Integer: e = make<IntegerLiteral>(t.intVal); break;
+        case TokenKind::Char: e = make<CharLiteral>((char)t.intVal); break;
+        case TokenKind::String: e = make<StringLiteral>(unescape(t.text)); break;
+        case TokenKind::LParen: e = expr(); expect(TokenKind::RParen, ")"); break;
         default: throw std::runtime_error("expression expected");
     }
+    while (accept(TokenKind::LBracket)) {
+        auto idx = expr();
+        expect(TokenKind::RBracket, "]");
+        e = make<ArrayIndex>(e, idx);
+    }
+    return e;
 }
 
-std::unique_ptr<Function> Parser::function() {
+Function* Parser::function() {
     Type ret = typeSpec();
     Token id = eat(); if (id.kind!=TokenKind::Identifier) throw std::runtime_error("function name");
     expect(TokenKind::LParen, "(");
@@ -276,14 +239,15 @@ std::unique_ptr<Function> Parser::function() {
         while (accept(TokenKind::Comma)) params.push_back(param());
     }
     expect(TokenKind::RParen, ")");
-    auto fun = std::make_unique<Function>();
-    fun->retType = ret; fun->name = id.text; fun->params = std::move(params);
+    auto fun = make<Function>();
+    fun->retType = ret; fun->name = id.sym; fun->params = std::move(params);
     fun->body = block();
     return fun;
 }
 
 std::unique_ptr<Program> Parser::parseProgram() {
     auto p = std::make_unique<Program>();
+    arena = &p->arena;
     while (peek().kind != TokenKind::End) {
         p->functions.push_back(function());
     }
@@ -19,37 +19,34 @@ private:
     void expect(TokenKind k, const char* msg);
 
     // grammar
-    std::unique_ptr<Function> function();
+    Function* function();
     Type typeSpec();
     Type afterTypeModifiers(Type base);
     Param param();
     void parseArraySuffix(Type& t);
-    std::unique_ptr<Block> block();
-    std::unique_ptr<Stmt> statement();
-    std::unique_ptr<Stmt> ifStmt();
-    std::unique_ptr<Stmt> whileStmt();
-    std::unique_ptr<Stmt> doWhileStmt();
-    std::unique_ptr<Stmt> forStmt();
-    std::unique_ptr<Stmt> returnStmt();
-    std::unique_ptr<Stmt> declOrExprStmt();
-
-    std::unique_ptr<Expr> expr();
-    std::unique_ptr<Expr> assign();
-    std::unique_ptr<Expr> logicOr();
-    std::unique_ptr<Expr> logicAnd();
-    std::unique_ptr<Expr> bitOr();
-    std::unique_ptr<Expr> bitXor();
-    std::unique_ptr<Expr> bitAnd();
-    std::unique_ptr<Expr> equality();
-    std::unique_ptr<Expr> relational();
-    std::unique_ptr<Expr> shift();
-    std::unique_ptr<Expr> additive();
-    std::unique_ptr<Expr> mul();
-    std::unique_ptr<Expr> unary();
-    std::unique_ptr<Expr> postfix();
-    std::unique_ptr<Expr> primary();
+    Block* block();
+    Stmt* statement();
+    Stmt* ifStmt();
+    Stmt* whileStmt();
+    Stmt* doWhileStmt();
+    Stmt* forStmt();
+    Stmt* returnStmt();
+    Stmt* declOrExprStmt();
+
+    // Expressions by precedence climbing: binary() parses operands joined
+    // by binary operators that bind at least as tightly as minPrec, looking
+    // each operator up in a table by token kind; operand() parses prefix
+    // operators, a primary expression and its subscripts.
+    Expr* expr();
+    Expr* assign();
+    Expr* binary(int minPrec);
+    Expr* operand();
+
+    template <class T, class... Args>
+    T* make(Args&&... args) { return arena->make<T>(std::forward<Args>(args)...); }
 
     Lexer& lex;
+    Arena* arena {nullptr}; // arena of the Program being parsed
 };
 
 } // namespace cmini
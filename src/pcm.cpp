@@ -0,0 +1,547 @@
+#include "pcm.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+#include "outsink.h"
+
+namespace cmini {
+
+namespace {
+
+constexpr uint32_t None = ~0u;
+constexpr char Magic[8] = {'C', 'M', 'I', 'N', 'I', 'P', 'C', 'M'};
+
+struct Section { uint32_t offset, count; };
+
+struct FunctionRec { uint32_t name, retType, params, paramCount, body; };
+struct ParamRec { uint32_t name, type; };
+struct TypeRec { uint32_t base, pointerLevels, dims, dimCount, namedKind, tag; };
+struct StringRec { uint32_t offset, length; };
+
+// Children and values by kind; nodes with more than two children keep the
+// rest in the list section, at f1:
+//   IntegerLiteral  f0, f1 = low, high half of the value
+//   CharLiteral     f0 = value      StringLiteral  f0 = string
+//   VarRef          f0 = name       ArrayIndex     f0 = base, f1 = index
+//   UnaryExpr       op, f0          BinaryExpr     op, f0, f1
+//   AssignExpr      f0, f1          CallExpr       f0 = callee, f1 = [count, args...]
+//   Decl            type, f0 = name, f1 = init
+//   ExprStmt, ReturnStmt  f0        Block          f0 = count, f1 = [items...]
+//   IfStmt          f0 = cond, f1 = [then, else]
+//   WhileStmt       f0 = cond, f1 = body
+//   DoWhileStmt     f0 = body, f1 = cond
+//   ForStmt         f0 = init, f1 = [cond, step, body]
+// An expression's type is the one Semantic inferred. Children always come
+// before their parent.
+struct NodeRec {
+    uint8_t kind, op;
+    uint16_t pad;
+    uint32_t type;
+    uint32_t f[2];
+};
+
+uint32_t hashName(std::string_view s) {
+    uint32_t h = 2166136261u; // FNV-1a
+    for (unsigned char c : s) h = (h ^ c) * 16777619u;
+    return h;
+}
+
+class Writer {
+public:
+    std::vector<FunctionRec> functions;
+    std::vector<ParamRec> params;
+    std::vector<TypeRec> types;
+    std::vector<uint32_t> dims, lists, index;
+    std::vector<NodeRec> nodes;
+    std::vector<StringRec> strings;
+    std::string chars;
+
+    Writer() {
+        for (auto& row : plainTypes) std::fill(std::begin(row), std::end(row), None);
+        str("");
+    }
+
+    void function(const Function& f) {
+        FunctionRec r {sym(f.name), type(f.retType), (uint32_t)params.size(), (uint32_t)f.params.size(), None};
+        for (auto& p : f.params) params.push_back({sym(p.name), type(p.type)});
+        if (f.body) r.body = stmt(f.body);
+        functions.push_back(r);
+    }
+
+    // Open addressing over twice as many slots as functions; a later
+    // definition takes over its name's slot.
+    void buildIndex() {
+        size_t slots = 1;
+        while (slots < functions.size() * 2) slots *= 2;
+        index.assign(functions.empty() ? 0 : slots, 0);
+        for (uint32_t i = 0; i < functions.size(); ++i) {
+            std::string_view name = text(functions[i].name);
+            for (size_t s = hashName(name) & (slots - 1);; s = (s + 1) & (slots - 1)) {
+                if (index[s] && text(functions[index[s] - 1].name) != name) continue;
+                index[s] = i + 1;
+                break;
+            }
+        }
+    }
+
+private:
+    std::unordered_map<std::string, uint32_t> stringIds, typeIds;
+    std::vector<uint32_t> symStrings; // SymId -> string index, None until used
+    uint32_t plainTypes[4][4]; // [base][pointerLevels]
+
+    std::string_view text(uint32_t s) const { return std::string_view(chars).substr(strings[s].offset, strings[s].length); }
+
+    uint32_t str(std::string_view s) {
+        auto [it, added] = stringIds.try_emplace(std::string(s), (uint32_t)strings.size());
+        if (added) {
+            strings.push_back({(uint32_t)chars.size(), (uint32_t)s.size()});
+            chars += s;
+        }
+        return it->second;
+    }
+    uint32_t sym(SymId s) {
+        if (s >= symStrings.size()) symStrings.resize(s + 1, None);
+        if (symStrings[s] == None) symStrings[s] = str(symName(s));
+        return symStrings[s];
+    }
+
+    uint32_t type(const Type& t) {
+        // nearly every expression has a plain scalar or pointer type
+        bool plain = t.arrayDims.empty() && t.namedKind == NamedKind::None && (unsigned)t.pointerLevels < 4;
+        uint32_t* slot = plain ? &plainTypes[(size_t)t.base][t.pointerLevels] : nullptr;
+        if (slot && *slot != None) return *slot;
+        uint32_t id = lookupType(t);
+        if (slot) *slot = id;
+        return id;
+    }
+
+    uint32_t lookupType(const Type& t) {
+        TypeRec r {(uint32_t)t.base, (uint32_t)t.pointerLevels, (uint32_t)dims.size(), (uint32_t)t.arrayDims.size(),
+                   (uint32_t)t.namedKind, sym(t.namedTag)};
+        std::string key(reinterpret_cast<const char*>(&r.base), 2 * sizeof(uint32_t));
+        key.append(reinterpret_cast<const char*>(&r.namedKind), 2 * sizeof(uint32_t));
+        for (size_t d : t.arrayDims) { uint32_t v = (uint32_t)d; key.append(reinterpret_cast<const char*>(&v), sizeof v); }
+        auto [it, added] = typeIds.try_emplace(key, (uint32_t)types.size());
+        if (added) {
+            for (size_t d : t.arrayDims) dims.push_back((uint32_t)d);
+            types.push_back(r);
+        }
+        return it->second;
+    }
+
+    uint32_t list(const std::vector<uint32_t>& items) {
+        uint32_t start = (uint32_t)lists.size();
+        lists.insert(lists.end(), items.begin(), items.end());
+        return start;
+    }
+
+    uint32_t add(NodeKind k, uint32_t op, uint32_t ty, uint32_t f0 = None, uint32_t f1 = None) {
+        nodes.push_back({(uint8_t)k, (uint8_t)op, 0, ty, {f0, f1}});
+        return (uint32_t)nodes.size() - 1;
+    }
+
+    uint32_t expr(const Expr* e) {
+        if (!e) return None;
+        uint32_t ty = type(e->type);
+        switch (e->kind) {
+        case NodeKind::IntegerLiteral: {
+            uint64_t v = (uint64_t)static_cast<const IntegerLiteral*>(e)->value;
+            return add(e->kind, 0, ty, (uint32_t)v, (uint32_t)(v >> 32));
+        }
+        case NodeKind::CharLiteral:
+            return add(e->kind, 0, ty, (uint32_t)(unsigned char)static_cast<const CharLiteral*>(e)->value);
+        case NodeKind::StringLiteral: return add(e->kind, 0, ty, str(static_cast<const StringLiteral*>(e)->value));
+        case NodeKind::VarRef: return add(e->kind, 0, ty, sym(static_cast<const VarRef*>(e)->name));
+        case NodeKind::ArrayIndex: {
+            auto* a = static_cast<const ArrayIndex*>(e);
+            uint32_t base = expr(a->base), idx = expr(a->index);
+            return add(e->kind, 0, ty, base, idx);
+        }
+        case NodeKind::UnaryExpr: {
+            auto* u = static_cast<const UnaryExpr*>(e);
+            return add(e->kind, (uint32_t)u->op, ty, expr(u->operand));
+        }
+        case NodeKind::BinaryExpr: {
+            auto* b = static_cast<const BinaryExpr*>(e);
+            uint32_t l = expr(b->lhs), r = expr(b->rhs);
+            return add(e->kind, (uint32_t)b->op, ty, l, r);
+        }
+        case NodeKind::AssignExpr: {
+            auto* a = static_cast<const AssignExpr*>(e);
+            uint32_t l = expr(a->lhs), r = expr(a->rhs);
+            return add(e->kind, 0, ty, l, r);
+        }
+        case NodeKind::CallExpr: {
+            auto* c = static_cast<const CallExpr*>(e);
+            std::vector<uint32_t> args {(uint32_t)c->args.size()};
+            for (auto* a : c->args) args.push_back(expr(a));
+            return add(e->kind, 0, ty, sym(c->callee), list(args));
+        }
+        default: throw std::runtime_error("cannot serialize expression");
+        }
+    }
+
+    uint32_t stmt(const Stmt* s) {
+        if (!s) return None;
+        switch (s->kind) {
+        case NodeKind::Decl: {
+            auto* d = static_cast<const Decl*>(s);
+            uint32_t ty = type(d->varType), init = expr(d->init);
+            return add(s->kind, 0, ty, sym(d->name), init);
+        }
+        case NodeKind::ExprStmt: return add(s->kind, 0, None, expr(static_cast<const ExprStmt*>(s)->expr));
+        case NodeKind::ReturnStmt: return add(s->kind, 0, None, expr(static_cast<const ReturnStmt*>(s)->expr));
+        case NodeKind::BreakStmt: case NodeKind::ContinueStmt: return add(s->kind, 0, None);
+        case NodeKind::Block: {
+            std::vector<uint32_t> items;
+            for (auto* it : static_cast<const Block*>(s)->items) items.push_back(stmt(it));
+            return add(s->kind, 0, None, (uint32_t)items.size(), list(items));
+        }
+        case NodeKind::IfStmt: {
+            auto* i = static_cast<const IfStmt*>(s);
+            uint32_t c = expr(i->cond), t = stmt(i->thenS), e = stmt(i->elseS);
+            return add(s->kind, 0, None, c, list({t, e}));
+        }
+        case NodeKind::WhileStmt: {
+            auto* w = static_cast<const WhileStmt*>(s);
+            uint32_t c = expr(w->cond), b = stmt(w->body);
+            return add(s->kind, 0, None, c, b);
+        }
+        case NodeKind::DoWhileStmt: {
+            auto* d = static_cast<const DoWhileStmt*>(s);
+            uint32_t b = stmt(d->body), c = expr(d->cond);
+            return add(s->kind, 0, None, b, c);
+        }
+        case NodeKind::ForStmt: {
+            auto* f = static_cast<const ForStmt*>(s);
+            uint32_t init = stmt(f->init), c = expr(f->cond), step = expr(f->step), body = stmt(f->body);
+            return add(s->kind, 0, None, init, list({c, step, body}));
+        }
+        default: throw std::runtime_error("cannot serialize statement");
+        }
+    }
+};
+
+[[noreturn]] void corrupt() { throw std::runtime_error("corrupt precompiled module"); }
+
+} // namespace
+
+struct ModuleFile::Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t fileSize;
+    uint64_t sourceLo, sourceHi;
+    Section functions, params, types, dims, nodes, lists, index, strings, chars;
+};
+
+void writeModule(const Program& p, std::string_view source, OutSink& sink) {
+    Writer w;
+    for (auto* f : p.functions) w.function(*f);
+    w.buildIndex();
+
+    ModuleFile::Header h {};
+    std::memcpy(h.magic, Magic, sizeof Magic);
+    h.version = PcmVersion;
+    h.headerSize = sizeof h;
+    Hasher::Digest d = Hasher().update(source).digest();
+    h.sourceLo = d.lo;
+    h.sourceHi = d.hi;
+    uint64_t at = sizeof h;
+    auto place = [&](Section& s, size_t count, size_t size) {
+        s = {(uint32_t)at, (uint32_t)count};
+        at += count * size;
+        at = (at + 3) & ~uint64_t(3);
+    };
+    place(h.functions, w.functions.size(), sizeof(FunctionRec));
+    place(h.params, w.params.size(), sizeof(ParamRec));
+    place(h.types, w.types.size(), sizeof(TypeRec));
+    place(h.dims, w.dims.size(), sizeof(uint32_t));
+    place(h.nodes, w.nodes.size(), sizeof(NodeRec));
+    place(h.lists, w.lists.size(), sizeof(uint32_t));
+    place(h.index, w.index.size(), sizeof(uint32_t));
+    place(h.strings, w.strings.size(), sizeof(StringRec));
+    place(h.chars, w.chars.size(), 1);
+    if (at > UINT32_MAX) throw std::runtime_error("module too large");
+    h.fileSize = at;
+
+    sink.write(reinterpret_cast<const char*>(&h), sizeof h);
+    auto put = [&](const void* data, size_t n) {
+        sink.write(static_cast<const char*>(data), n);
+        static const char zeros[4] {};
+        sink.write(zeros, (4 - n % 4) % 4);
+    };
+    put(w.functions.data(), w.functions.size() * sizeof(FunctionRec));
+    put(w.params.data(), w.params.size() * sizeof(ParamRec));
+    put(w.types.data(), w.types.size() * sizeof(TypeRec));
+    put(w.dims.data(), w.dims.size() * sizeof(uint32_t));
+    put(w.nodes.data(), w.nodes.size() * sizeof(NodeRec));
+    put(w.lists.data(), w.lists.size() * sizeof(uint32_t));
+    put(w.index.data(), w.index.size() * sizeof(uint32_t));
+    put(w.strings.data(), w.strings.size() * sizeof(StringRec));
+    put(w.chars.data(), w.chars.size());
+}
+
+bool ModuleFile::open(const std::string& path, std::string& error) {
+    header = nullptr;
+    if (!file.open(path)) { error = "cannot open: " + path; return false; }
+    bytes = file.text();
+    const Header* h = reinterpret_cast<const Header*>(bytes.data());
+    if (bytes.size() < sizeof(Header) || std::memcmp(h->magic, Magic, sizeof Magic) != 0) {
+        error = path + ": not a precompiled module";
+        return false;
+    }
+    if (h->version != PcmVersion || h->headerSize != sizeof(Header)) {
+        error = path + ": precompiled module version " + std::to_string(h->version) + ", expected " +
+                std::to_string(PcmVersion);
+        return false;
+    }
+    auto fits = [&](const Section& s, size_t size) {
+        return s.offset % 4 == 0 && s.offset >= sizeof(Header) && (uint64_t)s.offset + (uint64_t)s.count * size <= bytes.size();
+    };
+    bool ok = reinterpret_cast<uintptr_t>(bytes.data()) % alignof(Header) == 0 && h->fileSize == bytes.size() &&
+              fits(h->functions, sizeof(FunctionRec)) && fits(h->params, sizeof(ParamRec)) &&
+              fits(h->types, sizeof(TypeRec)) && fits(h->dims, 4) && fits(h->nodes, sizeof(NodeRec)) &&
+              fits(h->lists, 4) && fits(h->index, 4) && fits(h->strings, sizeof(StringRec)) && fits(h->chars, 1) &&
+              (h->index.count & (h->index.count - 1)) == 0 && (h->index.count > 0 || h->functions.count == 0) &&
+              h->strings.count > 0;
+    if (!ok) { error = path + ": corrupt precompiled module"; return false; }
+    header = h;
+    digest = {h->sourceLo, h->sourceHi};
+    symbols = std::make_unique<std::atomic<SymId>[]>(h->strings.count);
+    return true;
+}
+
+size_t ModuleFile::functionCount() const { return header ? header->functions.count : 0; }
+
+namespace {
+
+// Bounds-checked access to a mapped module's sections.
+struct View {
+    const char* base;
+    const ModuleFile::Header& h;
+
+    template <class T> const T& at(const Section& s, uint32_t i) const {
+        if (i >= s.count) corrupt();
+        return reinterpret_cast<const T*>(base + s.offset)[i];
+    }
+    std::string_view str(uint32_t i) const {
+        const StringRec& r = at<StringRec>(h.strings, i);
+        if ((uint64_t)r.offset + r.length > h.chars.count) corrupt();
+        return std::string_view(base + h.chars.offset + r.offset, r.length);
+    }
+};
+
+} // namespace
+
+class Materializer {
+public:
+    Materializer(const ModuleFile& m, Program& p) : v {m.bytes.data(), *m.header}, symbols(m.symbols.get()), p(p) {}
+
+    Function* function(uint32_t i) {
+        const FunctionRec& r = v.at<FunctionRec>(v.h.functions, i);
+        Function* f = p.arena.make<Function>();
+        f->name = sym(r.name);
+        f->retType = type(r.retType);
+        for (uint32_t k = 0; k < r.paramCount; ++k) {
+            const ParamRec& pr = v.at<ParamRec>(v.h.params, r.params + k);
+            f->params.push_back({type(pr.type), sym(pr.name)});
+        }
+        if (r.body != None) {
+            below = v.h.nodes.count;
+            Stmt* body = stmt(r.body);
+            if (body->kind != NodeKind::Block) corrupt();
+            f->body = static_cast<Block*>(body);
+        }
+        return f;
+    }
+
+private:
+    View v;
+    std::atomic<SymId>* symbols;
+    Program& p;
+    uint32_t below {0}; // children come before their parent, which rules out cycles
+
+    // 0 doubles as "not interned yet"; it is also the id of "", which is cheap to intern again
+    SymId sym(uint32_t s) {
+        if (s >= v.h.strings.count) corrupt();
+        SymId id = symbols[s].load(std::memory_order_relaxed);
+        if (id) return id;
+        id = intern(v.str(s));
+        symbols[s].store(id, std::memory_order_relaxed);
+        return id;
+    }
+
+    Type type(uint32_t i) {
+        const TypeRec& r = v.at<TypeRec>(v.h.types, i);
+        if (r.base > (uint32_t)BaseType::Float || r.namedKind > (uint32_t)NamedKind::Union) corrupt();
+        Type t;
+        t.base = (BaseType)r.base;
+        t.pointerLevels = (int)r.pointerLevels;
+        if (r.dimCount) {
+            std::vector<size_t> dims;
+            for (uint32_t k = 0; k < r.dimCount; ++k) dims.push_back(v.at<uint32_t>(v.h.dims, r.dims + k));
+            t.arrayDims = {p.arena.copy(dims.data(), dims.size()), dims.size()};
+        }
+        t.namedKind = (NamedKind)r.namedKind;
+        t.namedTag = sym(r.tag);
+        return t;
+    }
+
+    uint32_t item(uint32_t start, uint32_t k) { return v.at<uint32_t>(v.h.lists, start + k); }
+
+    Expr* need(uint32_t i) {
+        Expr* e = expr(i);
+        if (!e) corrupt();
+        return e;
+    }
+
+    Expr* expr(uint32_t i) {
+        if (i == None) return nullptr;
+        if (i >= below) corrupt();
+        uint32_t parent = below;
+        below = i;
+        Expr* e = buildExpr(v.at<NodeRec>(v.h.nodes, i));
+        below = parent;
+        return e;
+    }
+
+    Stmt* stmt(uint32_t i) {
+        if (i == None) return nullptr;
+        if (i >= below) corrupt();
+        uint32_t parent = below;
+        below = i;
+        Stmt* s = buildStmt(v.at<NodeRec>(v.h.nodes, i));
+        below = parent;
+        return s;
+    }
+
+    Expr* buildExpr(const NodeRec& n) {
+        Expr* e;
+        switch ((NodeKind)n.kind) {
+        case NodeKind::IntegerLiteral:
+            e = p.arena.make<IntegerLiteral>((long)((uint64_t)n.f[0] | (uint64_t)n.f[1] << 32));
+            break;
+        case NodeKind::CharLiteral: e = p.arena.make<CharLiteral>((char)n.f[0]); break;
+        case NodeKind::StringLiteral: e = p.arena.make<StringLiteral>(std::string(v.str(n.f[0]))); break;
+        case NodeKind::VarRef: e = p.arena.make<VarRef>(sym(n.f[0])); break;
+        case NodeKind::ArrayIndex: { Expr* b = need(n.f[0]); e = p.arena.make<ArrayIndex>(b, need(n.f[1])); break; }
+        case NodeKind::UnaryExpr:
+            if (n.op > (uint8_t)UnaryOp::Deref) corrupt();
+            e = p.arena.make<UnaryExpr>((UnaryOp)n.op, need(n.f[0]));
+            break;
+        case NodeKind::BinaryExpr: {
+            if (n.op > (uint8_t)BinaryOp::Shr) corrupt();
+            Expr* l = need(n.f[0]);
+            e = p.arena.make<BinaryExpr>((BinaryOp)n.op, l, need(n.f[1]));
+            break;
+        }
+        case NodeKind::AssignExpr: { Expr* l = need(n.f[0]); e = p.arena.make<AssignExpr>(l, need(n.f[1])); break; }
+        case NodeKind::CallExpr: {
+            auto* c = p.arena.make<CallExpr>(sym(n.f[0]));
+            uint32_t count = item(n.f[1], 0);
+            for (uint32_t k = 1; k <= count; ++k) c->args.push_back(need(item(n.f[1], k)));
+            e = c;
+            break;
+        }
+        default: corrupt();
+        }
+        e->type = type(n.type);
+        return e;
+    }
+
+    Stmt* buildStmt(const NodeRec& n) {
+        switch ((NodeKind)n.kind) {
+        case NodeKind::Decl: {
+            auto* d = p.arena.make<Decl>(type(n.type), sym(n.f[0]));
+            d->init = expr(n.f[1]);
+            return d;
+        }
+        case NodeKind::ExprStmt: return p.arena.make<ExprStmt>(expr(n.f[0]));
+        case NodeKind::ReturnStmt: { auto* r = p.arena.make<ReturnStmt>(); r->expr = expr(n.f[0]); return r; }
+        case NodeKind::BreakStmt: return p.arena.make<BreakStmt>();
+        case NodeKind::ContinueStmt: return p.arena.make<ContinueStmt>();
+        case NodeKind::Block: {
+            auto* b = p.arena.make<Block>();
+            for (uint32_t k = 0; k < n.f[0]; ++k) b->items.push_back(body(item(n.f[1], k)));
+            return b;
+        }
+        case NodeKind::IfStmt: {
+            auto* s = p.arena.make<IfStmt>();
+            s->cond = need(n.f[0]); s->thenS = body(item(n.f[1], 0)); s->elseS = stmt(item(n.f[1], 1));
+            return s;
+        }
+        case NodeKind::WhileStmt: {
+            auto* s = p.arena.make<WhileStmt>();
+            s->cond = need(n.f[0]); s->body = body(n.f[1]);
+            return s;
+        }
+        case NodeKind::DoWhileStmt: {
+            auto* s = p.arena.make<DoWhileStmt>();
+            s->body = body(n.f[0]); s->cond = need(n.f[1]);
+            return s;
+        }
+        case NodeKind::ForStmt: {
+            auto* s = p.arena.make<ForStmt>();
+            s->init = stmt(n.f[0]);
+            s->cond = expr(item(n.f[1], 0)); s->step = expr(item(n.f[1], 1)); s->body = body(item(n.f[1], 2));
+            return s;
+        }
+        default: corrupt();
+        }
+    }
+
+    Stmt* body(uint32_t i) {
+        Stmt* s = stmt(i);
+        if (!s) corrupt();
+        return s;
+    }
+};
+
+int ModuleFile::find(std::string_view name) const {
+    if (!header || header->index.count == 0) return -1;
+    View v {bytes.data(), *header};
+    uint32_t mask = header->index.count - 1;
+    for (uint32_t s = hashName(name) & mask, probes = 0; probes <= mask; s = (s + 1) & mask, ++probes) {
+        uint32_t slot = v.at<uint32_t>(header->index, s);
+        if (slot == 0) return -1;
+        if (v.str(v.at<FunctionRec>(header->functions, slot - 1).name) == name) return (int)slot - 1;
+    }
+    return -1;
+}
+
+Function* ModuleFile::materialize(size_t i, Program& p) const {
+    if (!header) return nullptr;
+    return Materializer(*this, p).function((uint32_t)i);
+}
+
+size_t importFunctions(Program& p, const std::vector<const ModuleFile*>& modules) {
+    if (modules.empty()) return 0;
+    std::unordered_set<SymId> known; // defined, imported, or looked up in vain
+    for (auto* f : p.functions) known.insert(f->name);
+    std::vector<SymId> wanted;
+    auto calls = [&](Node* n) {
+        if (auto* c = dyn_cast<CallExpr>(n); c && !known.count(c->callee)) wanted.push_back(c->callee);
+    };
+    for (auto* f : p.functions) walk(f->body, calls);
+    std::vector<Function*> imported;
+    while (!wanted.empty()) {
+        SymId name = wanted.back();
+        wanted.pop_back();
+        if (!known.insert(name).second) continue;
+        for (size_t m = modules.size(); m-- > 0;) {
+            int i = modules[m]->find(symName(name));
+            if (i < 0) continue;
+            Function* f = modules[m]->materialize((size_t)i, p);
+            imported.push_back(f);
+            walk(f->body, calls);
+            break;
+        }
+    }
+    p.functions.insert(p.functions.begin(), imported.begin(), imported.end());
+    return imported.size();
+}
+
+} // namespace cmini
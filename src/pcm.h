@@ -0,0 +1,74 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "ast.h"
+#include "hash.h"
+#include "source.h"
+
+namespace cmini {
+
+class OutSink;
+
+// Precompiled modules (.pcm): the checked AST of one source file in a
+// relocatable binary form. Nodes are fixed-size records that refer to each
+// other by index, names and types are indices into deduplicated tables,
+// and a hash index maps function names to their records, so a module is
+// used straight from an mmap'd file: looking a function up reads a few
+// cache lines, and only the functions a program actually calls are ever
+// turned back into AST nodes. The header carries the format version and
+// the digest of the source the module was built from.
+//
+// Layout, all little-endian and 4-byte aligned: the header, then the
+// sections it lists (functions, params, types, dims, nodes, lists, index,
+// string refs, string bytes).
+
+constexpr uint32_t PcmVersion = 1;
+
+// Serializes p, which has passed Semantic::analyze and not been folded;
+// `source` is the text it was parsed from.
+void writeModule(const Program& p, std::string_view source, OutSink& sink);
+
+class ModuleFile {
+public:
+    ModuleFile() = default;
+    ModuleFile(const ModuleFile&) = delete;
+    ModuleFile& operator=(const ModuleFile&) = delete;
+
+    // Maps the file and validates its header and section bounds; false,
+    // with a message in error, for anything that is not a module of this
+    // version.
+    bool open(const std::string& path, std::string& error);
+
+    const Hasher::Digest& sourceDigest() const { return digest; }
+    size_t functionCount() const;
+    // Index of the function `name` reaches (the last definition), or -1.
+    int find(std::string_view name) const;
+    // Builds function i, types included, in p's arena. It is not added to
+    // p.functions.
+    Function* materialize(size_t i, Program& p) const;
+
+    struct Header;
+
+private:
+    SourceFile file;
+    std::string_view bytes;
+    const Header* header {nullptr};
+    Hasher::Digest digest;
+    // string index -> SymId, filled in as strings are first interned
+    std::unique_ptr<std::atomic<SymId>[]> symbols;
+
+    friend class Materializer;
+};
+
+// Puts the functions that p calls without defining them, and everything
+// those call in turn, ahead of p's own functions, taking each from the
+// last of `modules` that defines it: as if the modules' sources had been
+// included first, except that functions nothing calls are never read.
+// Returns how many functions were added; they are already checked.
+size_t importFunctions(Program& p, const std::vector<const ModuleFile*>& modules);
+
+} // namespace cmini
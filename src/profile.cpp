@@ -0,0 +1,313 @@
+#include "profile.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include "outsink.h"
+
+namespace cmini {
+
+uint64_t FunctionProfile::hottest() const {
+    uint64_t m = 0;
+    for (uint64_t c : counts) m = std::max(m, c);
+    return m;
+}
+
+bool Profile::load(const std::string& path, std::string& error) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) { error = "cannot open profile: " + path; return false; }
+    std::stringstream buf;
+    buf << in.rdbuf();
+    std::string text = buf.str();
+    hash = Hasher().update(text).digest();
+
+    std::istringstream lines(text);
+    std::string line;
+    size_t number = 0;
+    while (std::getline(lines, line)) {
+        ++number;
+        if (line.empty() || line[0] == '#') continue;
+        std::istringstream fields(line);
+        std::string name, sum;
+        FunctionProfile p;
+        bool ok = (bool)(fields >> name >> sum) && sum.size() == 16 && sum.find_first_not_of("0123456789abcdef") == std::string::npos;
+        if (ok) p.checksum = std::stoull(sum, nullptr, 16);
+        for (std::string c; ok && fields >> c;) {
+            ok = c.size() <= 20 && c.find_first_not_of("0123456789") == std::string::npos;
+            if (ok) p.counts.push_back(std::stoull(c));
+        }
+        if (!ok || p.counts.size() % 2 != 1) {
+            error = path + ":" + std::to_string(number) + ": malformed profile line";
+            return false;
+        }
+        // runs of the same build add up; a different checksum is a newer build
+        auto [it, added] = functions.try_emplace(intern(name), std::move(p));
+        FunctionProfile& have = it->second;
+        if (added) continue;
+        if (have.checksum != p.checksum || have.counts.size() != p.counts.size()) { have = std::move(p); continue; }
+        for (size_t k = 0; k < p.counts.size(); ++k)
+            have.counts[k] = have.counts[k] > ~0ull - p.counts[k] ? ~0ull : have.counts[k] + p.counts[k];
+    }
+
+    std::vector<uint64_t> all;
+    long double total = 0;
+    for (auto& [name, p] : functions)
+        for (uint64_t c : p.counts) { all.push_back(c); total += c; }
+    std::sort(all.begin(), all.end(), std::greater<>());
+    long double covered = 0;
+    hot = NoHot;
+    for (uint64_t c : all) {
+        if (c == 0) break;
+        hot = c;
+        covered += c;
+        if (covered >= total * 0.9L) break;
+    }
+    return true;
+}
+
+const FunctionProfile* Profile::find(SymId name) const {
+    auto it = functions.find(name);
+    return it == functions.end() ? nullptr : &it->second;
+}
+
+namespace ir {
+
+namespace {
+
+// Conditional branches of a freshly lowered function, in the order their
+// counters are numbered.
+std::vector<Id> branches(const Function& f) {
+    std::vector<Id> out;
+    for (Id i = 0; i < f.insts.size(); ++i)
+        if (f.insts[i].op == Op::CondBr) out.push_back(i);
+    return out;
+}
+
+size_t firstNonPhi(const Function& f, Id b) {
+    size_t at = 0;
+    auto& list = f.blocks[b].insts;
+    while (at < list.size() && f.insts[list[at]].op == Op::Phi) ++at;
+    return at;
+}
+
+// Executions of the k-th edge out of b (k indexes the terminator's block
+// operands); a conditional branch without weights passes on b's count.
+uint64_t edgeCount(const Function& f, const std::vector<uint64_t>& counts, Id b, uint32_t k) {
+    Id t = f.terminator(b);
+    if (t != None && f.insts[t].op == Op::CondBr && f.insts[t].opCount == 5) return (uint64_t)f.operand(t, 3 + k).num;
+    return counts[b];
+}
+
+uint64_t addCapped(uint64_t a, uint64_t b) { return a > ~0ull - b ? ~0ull : a + b; }
+
+} // namespace
+
+uint64_t cfgChecksum(const Function& f) {
+    Hasher h;
+    h.u64(f.blocks.size()).u64(f.params.size());
+    for (Id i = 0; i < f.insts.size(); ++i) {
+        const Inst& in = f.insts[i];
+        if (!f.isTerminator(i)) continue;
+        h.u64((uint64_t)in.op).u64(in.block);
+        if (in.op == Op::Br) h.u64(f.operand(i, 0).num);
+        if (in.op == Op::CondBr) h.u64(f.operand(i, 1).num).u64(f.operand(i, 2).num);
+    }
+    return h.digest().lo;
+}
+
+size_t instrument(Function& f) {
+    std::vector<Id> list = branches(f);
+    Value total = Value::cst((int64_t)(1 + 2 * list.size()));
+    auto counter = [&](Id b, size_t at, size_t k) {
+        f.insert(b, at, Op::Count, Ty::voidTy(), {Value::cst(f.name), Value::cst((int64_t)k), total});
+    };
+    Id entry = f.layout[0];
+    size_t allocas = 0;
+    while (allocas < f.blocks[entry].insts.size() && f.insts[f.blocks[entry].insts[allocas]].op == Op::Alloca) ++allocas;
+    counter(entry, allocas, 0);
+
+    std::vector<uint32_t> preds(f.blocks.size());
+    for (Id b : f.layout)
+        for (Id s : f.successors(b)) ++preds[s];
+    for (size_t j = 0; j < list.size(); ++j) {
+        Id br = list[j], from = f.insts[br].block;
+        for (uint32_t k = 0; k < 2; ++k) {
+            Id to = f.operand(br, 1 + k).id();
+            if (preds[to] == 1) { counter(to, firstNonPhi(f, to), 1 + 2 * j + k); continue; }
+            // the edge gets a block of its own, which takes over as the
+            // predecessor in the target's phis (the first match: when both
+            // edges lead there, the phis list `from` once per edge)
+            Id edge = f.addBlock("prof.edge");
+            counter(edge, 0, 1 + 2 * j + k);
+            f.append(edge, Op::Br, Ty::voidTy(), {Value::block(to)});
+            f.setOperand(br, 1 + k, Value::block(edge));
+            for (Id i : f.blocks[to].insts) {
+                if (f.insts[i].op != Op::Phi) break;
+                for (uint32_t n = 1; n < f.insts[i].opCount; n += 2)
+                    if (f.operand(i, n) == Value::block(from)) { f.setOperand(i, n, Value::block(edge)); break; }
+            }
+            f.layout.insert(std::find(f.layout.begin(), f.layout.end(), to), edge);
+        }
+    }
+    return 1 + 2 * list.size();
+}
+
+bool annotate(Function& f, const FunctionProfile& p) {
+    std::vector<Id> list = branches(f);
+    if (p.checksum != cfgChecksum(f) || p.counts.size() != 1 + 2 * list.size()) return false;
+    f.entryCount = p.counts[0];
+    std::vector<Value> ops;
+    for (size_t j = 0; j < list.size(); ++j) {
+        ops = {f.operand(list[j], 0), f.operand(list[j], 1), f.operand(list[j], 2),
+               Value::cst((int64_t)p.counts[1 + 2 * j]), Value::cst((int64_t)p.counts[2 + 2 * j])};
+        f.setOperands(list[j], ops);
+    }
+    return true;
+}
+
+std::vector<uint64_t> blockCounts(const Function& f) {
+    if (f.entryCount == NoCount) return {};
+    DomTree dt;
+    dt.build(f);
+    std::vector<uint64_t> counts(f.blocks.size());
+    // In reverse postorder every forward edge is settled within a round;
+    // each cycle contains a counted branch edge unless it never exits, so
+    // a few rounds settle the back edges too.
+    for (int round = 0; round < 32; ++round) {
+        bool changed = false;
+        for (Id b : dt.rpo) {
+            uint64_t c = b == 0 ? f.entryCount : 0;
+            for (size_t n = 0; n < dt.preds[b].size(); ++n) {
+                Id p = dt.preds[b][n];
+                if (std::find(dt.preds[b].begin(), dt.preds[b].begin() + (ptrdiff_t)n, p) != dt.preds[b].begin() + (ptrdiff_t)n)
+                    continue; // listed once per edge; both are summed below
+                std::vector<Id> succ = f.successors(p);
+                for (uint32_t k = 0; k < succ.size(); ++k)
+                    if (succ[k] == b) c = addCapped(c, edgeCount(f, counts, p, k));
+            }
+            if (c != counts[b]) { counts[b] = c; changed = true; }
+        }
+        if (!changed) break;
+    }
+    return counts;
+}
+
+void layoutByProfile(Function& f) {
+    std::vector<uint64_t> counts = blockCounts(f);
+    if (counts.empty()) return;
+    std::vector<char> placed(f.blocks.size());
+    std::vector<Id> order;
+    size_t scan = 0; // next candidate in the old layout when a chain ends
+    for (Id b = f.layout[0]; b != None;) {
+        placed[b] = 1;
+        order.push_back(b);
+        Id best = None;
+        uint64_t bestCount = 0;
+        std::vector<Id> succ = f.successors(b);
+        for (uint32_t k = 0; k < succ.size(); ++k) {
+            Id s = succ[k];
+            uint64_t c = edgeCount(f, counts, b, k);
+            if (placed[s] || counts[s] == 0 || c == 0) continue;
+            if (best == None || c > bestCount) { best = s; bestCount = c; }
+        }
+        while (best == None && scan < f.layout.size()) {
+            Id s = f.layout[scan++];
+            if (!placed[s] && counts[s] > 0) best = s;
+        }
+        b = best;
+    }
+    for (Id b : f.layout) // never ran
+        if (!placed[b]) order.push_back(b);
+    f.layout = std::move(order);
+}
+
+void printProfileRuntime(const std::vector<Counters>& functions, OutSink& out) {
+    auto cstr = [&](const char* name, std::string_view s) {
+        out << name << " = private constant [" << s.size() + 1 << " x i8] c\"";
+        for (char c : s) {
+            if (c == '\n') out << "\\0A";
+            else out << c;
+        }
+        out << "\\00\"\n";
+    };
+    auto ptr = [&](std::string_view global, size_t n, const char* elem) {
+        out << "getelementptr inbounds ([" << n << " x " << elem << "], [" << n << " x " << elem << "]* " << global
+            << ", i64 0, i64 0)";
+    };
+    out << "; profile counters (--instrument), appended to $CMINI_PROFILE or cmini.prof at exit\n";
+    std::vector<std::string> heads;
+    for (auto& c : functions) {
+        char sum[17];
+        std::snprintf(sum, sizeof sum, "%016llx", (unsigned long long)c.checksum);
+        heads.push_back(std::string(symName(c.name)) + " " + sum);
+        out << "@__cmini_prof." << symName(c.name) << " = internal global [" << c.count << " x i64] zeroinitializer\n";
+        std::string g = "@__cmini_prof." + std::string(symName(c.name)) + ".head";
+        cstr(g.c_str(), heads.back());
+    }
+    cstr("@__cmini_prof.env", "CMINI_PROFILE");
+    cstr("@__cmini_prof.path", "cmini.prof");
+    cstr("@__cmini_prof.mode", "a");
+    cstr("@__cmini_prof.fmt", " %llu");
+    cstr("@__cmini_prof.nl", "\n");
+    out << "@llvm.global_dtors = appending global [1 x { i32, void ()*, i8* }] "
+           "[{ i32, void ()*, i8* } { i32 65535, void ()* @__cmini_prof_dump, i8* null }]\n\n";
+    out << "declare i8* @getenv(i8*)\ndeclare i8* @fopen(i8*, i8*)\ndeclare i32 @fclose(i8*)\n"
+           "declare i32 @fputs(i8*, i8*)\ndeclare i32 @fprintf(i8*, i8*, ...)\n\n";
+
+    out << "define internal void @__cmini_prof_write(i8* %fp, i8* %head, i64* %counts, i64 %n) {\n"
+           "entry:\n"
+           "  %h = call i32 @fputs(i8* %head, i8* %fp)\n"
+           "  br label %loop\n\n"
+           "loop:\n"
+           "  %i = phi i64 [ 0, %entry ], [ %next, %body ]\n"
+           "  %more = icmp ult i64 %i, %n\n"
+           "  br i1 %more, label %body, label %done\n\n"
+           "body:\n"
+           "  %p = getelementptr i64, i64* %counts, i64 %i\n"
+           "  %v = load i64, i64* %p\n"
+           "  %w = call i32 (i8*, i8*, ...) @fprintf(i8* %fp, i8* ";
+    ptr("@__cmini_prof.fmt", 6, "i8");
+    out << ", i64 %v)\n"
+           "  %next = add i64 %i, 1\n"
+           "  br label %loop\n\n"
+           "done:\n"
+           "  %e = call i32 @fputs(i8* ";
+    ptr("@__cmini_prof.nl", 2, "i8");
+    out << ", i8* %fp)\n"
+           "  ret void\n"
+           "}\n\n";
+
+    out << "define internal void @__cmini_prof_dump() {\n"
+           "entry:\n"
+           "  %env = call i8* @getenv(i8* ";
+    ptr("@__cmini_prof.env", 14, "i8");
+    out << ")\n"
+           "  %unset = icmp eq i8* %env, null\n"
+           "  %path = select i1 %unset, i8* ";
+    ptr("@__cmini_prof.path", 11, "i8");
+    out << ", i8* %env\n"
+           "  %fp = call i8* @fopen(i8* %path, i8* ";
+    ptr("@__cmini_prof.mode", 2, "i8");
+    out << ")\n"
+           "  %failed = icmp eq i8* %fp, null\n"
+           "  br i1 %failed, label %done, label %write\n\n"
+           "write:\n";
+    for (size_t k = 0; k < functions.size(); ++k) {
+        std::string name(symName(functions[k].name));
+        out << "  call void @__cmini_prof_write(i8* %fp, i8* ";
+        ptr("@__cmini_prof." + name + ".head", heads[k].size() + 1, "i8");
+        out << ", i64* ";
+        ptr("@__cmini_prof." + name, functions[k].count, "i64");
+        out << ", i64 " << functions[k].count << ")\n";
+    }
+    out << "  %c = call i32 @fclose(i8* %fp)\n"
+           "  br label %done\n\n"
+           "done:\n"
+           "  ret void\n"
+           "}\n";
+}
+
+} // namespace ir
+
+} // namespace cmini
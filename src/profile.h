@@ -0,0 +1,90 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "hash.h"
+#include "ir.h"
+
+namespace cmini {
+
+class OutSink;
+
+// Profile-guided optimization. An --instrument build gives every function
+// an array of 64-bit counters: [0] counts calls, then two per conditional
+// branch of the freshly lowered function (taken, not taken), in
+// instruction order. A runtime appended to the module writes the arrays
+// out when the program exits, one line per function:
+//
+//   <name> <checksum> <count>...
+//
+// appended to $CMINI_PROFILE, or cmini.prof in the working directory, so
+// several runs (and programs linked from several modules) add up. The
+// checksum covers the lowered control flow, so --profile-use only applies
+// counts to functions that still lower to the same branches. Constant
+// folding (-O1 and up) can remove branches, so profiles are best recorded
+// at the optimization level they will be used at.
+struct FunctionProfile {
+    uint64_t checksum {0};
+    std::vector<uint64_t> counts;
+    uint64_t hottest() const; // largest count: call or branch edge
+};
+
+class Profile {
+public:
+    // Reads and merges the lines of a profile file. False, with a message
+    // in error, when it cannot be read or a line is malformed.
+    bool load(const std::string& path, std::string& error);
+
+    const FunctionProfile* find(SymId name) const;
+    size_t size() const { return functions.size(); }
+    const Hasher::Digest& digest() const { return hash; }
+
+    // Counts at least this high are hot: together they make up 90% of
+    // everything the profile counted; ~0 when nothing was counted.
+    uint64_t hotCount() const { return hot; }
+
+private:
+    std::unordered_map<SymId, FunctionProfile> functions;
+    Hasher::Digest hash;
+    uint64_t hot {NoHot};
+    static constexpr uint64_t NoHot = ~0ull;
+};
+
+namespace ir {
+
+// Fingerprint of the blocks and branches of a freshly lowered function.
+uint64_t cfgChecksum(const Function& f);
+
+// Adds the counter increments of an --instrument build: one in the entry
+// block and one on each edge of every conditional branch, splitting edges
+// into blocks that have other predecessors. Returns the number of
+// counters. Call it on the freshly lowered function, after cfgChecksum.
+size_t instrument(Function& f);
+
+// Attaches recorded counts to a freshly lowered function: entryCount and
+// weights on each conditional branch. False, leaving f alone, if the
+// profile was recorded from different control flow.
+bool annotate(Function& f, const FunctionProfile& p);
+
+// Estimated executions of each block, from entryCount and the branch
+// weights; empty if f has no profile counts.
+std::vector<uint64_t> blockCounts(const Function& f);
+
+// Reorders f.layout so each block is followed by its most frequent
+// successor, and blocks that never ran go last. Needs profile counts.
+void layoutByProfile(Function& f);
+
+// Counter arrays and the runtime that dumps them at exit, for the module
+// end of an --instrument build.
+struct Counters {
+    SymId name {0};
+    uint64_t checksum {0};
+    size_t count {0};
+};
+void printProfileRuntime(const std::vector<Counters>& functions, OutSink& out);
+
+} // namespace ir
+
+} // namespace cmini
@@ -1,5 +1,6 @@
 #include "semantic.h"
 #include <stdexcept>
+#include "threadpool.h"
 
 namespace cmini {
 
@@ -7,17 +8,34 @@ static bool isIntegerLike(const Type& t) {
     return t.base==BaseType::Int || t.base==BaseType::Char;
 }
 
-void Semantic::analyze(Program& p) {
+void Semantic::analyze(Program& p, ThreadPool* pool, const std::vector<bool>* clean) {
     // predeclare functions
     for (auto& fn : p.functions) {
         Symbol s; s.type = fn->retType; s.isFunction = true; for (auto& prm : fn->params) s.paramTypes.push_back(prm.type);
         global.insert(fn->name, s);
     }
-    for (auto& fn : p.functions) analyze(*fn);
+    if (!pool || pool->size() == 0) {
+        for (size_t i = 0; i < p.functions.size(); ++i)
+            if (!clean || !(*clean)[i]) analyze(*p.functions[i]);
+        return;
+    }
+    // global is read-only from here on; each worker reports into its own Diagnostics
+    std::vector<Diagnostics> perFn(p.functions.size());
+    std::vector<size_t> perFnLookups(p.functions.size());
+    pool->parallelFor(p.functions.size(), [&](size_t i) {
+        if (clean && (*clean)[i]) return;
+        Semantic w; w.globals = &global;
+        w.analyze(*p.functions[i]);
+        perFn[i] = std::move(w.diags);
+        perFnLookups[i] = w.lookups;
+    });
+    for (auto& d : perFn)
+        for (auto& m : d.messages) diags.messages.push_back(std::move(m));
+    for (size_t n : perFnLookups) lookups += n;
 }
 
 void Semantic::analyze(Function& f) {
-    Scope scope{&global};
+    Scope scope{globals};
     for (auto& prm : f.params) { Symbol s; s.type = prm.type; scope.insert(prm.name, s); }
     if (f.body) analyze(*f.body, scope);
 }
@@ -28,20 +46,25 @@ void Semantic::analyze(Block& b, Scope& scope) {
 }
 
 void Semantic::analyze(Stmt& s, Scope& scope, const Type& retTy) {
-    if (auto d = dynamic_cast<Decl*>(&s)) {
-        if (scope.lookupLocal(d->name)) diags.error("redefinition: "+d->name);
+    switch (s.kind) {
+    case NodeKind::Decl: {
+        auto* d = &cast<Decl>(s);
+        ++lookups;
+        if (scope.lookupLocal(d->name)) diags.error("redefinition: "+symStr(d->name));
         Symbol sym; sym.type = d->varType; scope.insert(d->name, sym);
         if (d->init) { auto t = analyze(*d->init, scope); (void)t; }
         return;
     }
-    if (auto r = dynamic_cast<ReturnStmt*>(&s)) {
+    case NodeKind::ReturnStmt: {
+        auto* r = &cast<ReturnStmt>(s);
         if (r->expr) { auto t = analyze(*r->expr, scope); (void)t; }
         return;
     }
-    if (auto e = dynamic_cast<ExprStmt*>(&s)) { analyze(*e->expr, scope); return; }
-    if (auto w = dynamic_cast<WhileStmt*>(&s)) { analyze(*w->cond, scope); analyze(*w->body, scope, retTy); return; }
-    if (auto d = dynamic_cast<DoWhileStmt*>(&s)) { analyze(*d->body, scope, retTy); analyze(*d->cond, scope); return; }
-    if (auto f = dynamic_cast<ForStmt*>(&s)) {
+    case NodeKind::ExprStmt: analyze(*cast<ExprStmt>(s).expr, scope); return;
+    case NodeKind::WhileStmt: { auto* w = &cast<WhileStmt>(s); analyze(*w->cond, scope); analyze(*w->body, scope, retTy); return; }
+    case NodeKind::DoWhileStmt: { auto* d = &cast<DoWhileStmt>(s); analyze(*d->body, scope, retTy); analyze(*d->cond, scope); return; }
+    case NodeKind::ForStmt: {
+        auto* f = &cast<ForStmt>(s);
         Scope inner{&scope};
         if (f->init) analyze(*f->init, inner, retTy);
         if (f->cond) analyze(*f->cond, inner);
@@ -49,39 +72,57 @@ void Semantic::analyze(Stmt& s, Scope& scope, const Type& retTy) {
         analyze(*f->body, inner, retTy);
         return;
     }
-    if (auto i = dynamic_cast<IfStmt*>(&s)) {
+    case NodeKind::IfStmt: {
+        auto* i = &cast<IfStmt>(s);
         analyze(*i->cond, scope);
         analyze(*i->thenS, scope, retTy);
         if (i->elseS) analyze(*i->elseS, scope, retTy);
         return;
     }
-    if (auto b = dynamic_cast<Block*>(&s)) { analyze(*b, scope); return; }
+    case NodeKind::Block: analyze(cast<Block>(s), scope); return;
+    default: return;
+    }
 }
 
 Type Semantic::analyze(Expr& e, Scope& scope) {
-    if (auto v = dynamic_cast<VarRef*>(&e)) {
+    switch (e.kind) {
+    case NodeKind::VarRef: {
+        auto* v = &cast<VarRef>(e);
+        ++lookups;
         auto* sym = scope.lookup(v->name);
-        if (!sym) { diags.error("use of undeclared identifier: "+v->name); e.type = Type::intTy(); return e.type; }
+        if (!sym) { diags.error("use of undeclared identifier: "+symStr(v->name)); e.type = Type::intTy(); return e.type; }
         e.type = sym->type; return e.type;
     }
-    if (auto lit = dynamic_cast<IntegerLiteral*>(&e)) { e.type = Type::intTy(); return e.type; }
-    if (auto litc = dynamic_cast<CharLiteral*>(&e)) { Type t; t.base=BaseType::Char; e.type=t; return e.type; }
-    if (auto str = dynamic_cast<StringLiteral*>(&e)) { Type t; t.base=BaseType::Char; t.pointerLevels=1; e.type=t; (void)str; return e.type; }
-    if (auto a = dynamic_cast<AssignExpr*>(&e)) { auto lt=analyze(*a->lhs, scope); auto rt=analyze(*a->rhs, scope); (void)lt; (void)rt; e.type=lt; return e.type; }
-    if (auto b = dynamic_cast<BinaryExpr*>(&e)) { auto lt=analyze(*b->lhs, scope); auto rt=analyze(*b->rhs, scope); (void)rt; if (isIntegerLike(lt)) e.type=lt; else e.type=rt; return e.type; }
-    if (auto u = dynamic_cast<UnaryExpr*>(&e)) { auto t=analyze(*u->operand, scope); if (u->op==UnaryOp::Addr){ Type p=t; p.pointerLevels++; e.type=p; } else e.type=t; return e.type; }
-    if (auto idx = dynamic_cast<ArrayIndex*>(&e)) {
+    case NodeKind::IntegerLiteral: e.type = Type::intTy(); return e.type;
+    case NodeKind::CharLiteral: { Type t; t.base=BaseType::Char; e.type=t; return e.type; }
+    case NodeKind::StringLiteral: { Type t; t.base=BaseType::Char; t.pointerLevels=1; e.type=t; return e.type; }
+    case NodeKind::AssignExpr: { auto* a = &cast<AssignExpr>(e); auto lt=analyze(*a->lhs, scope); auto rt=analyze(*a->rhs, scope); (void)rt; e.type=lt; return e.type; }
+    case NodeKind::BinaryExpr: { auto* b = &cast<BinaryExpr>(e); auto lt=analyze(*b->lhs, scope); auto rt=analyze(*b->rhs, scope); if (isIntegerLike(lt)) e.type=lt; else e.type=rt; return e.type; }
+    case NodeKind::UnaryExpr: {
+        auto* u = &cast<UnaryExpr>(e); auto t=analyze(*u->operand, scope);
+        if (u->op==UnaryOp::Addr) t.pointerLevels++;
+        else if (u->op==UnaryOp::Deref && t.pointerLevels>0) t.pointerLevels--; // the pointee
+        else if (u->op==UnaryOp::Deref && !t.arrayDims.empty()) t.arrayDims = t.arrayDims.inner();
+        e.type=t; return e.type; }
+    case NodeKind::ArrayIndex: {
+        auto* idx = &cast<ArrayIndex>(e);
         auto bt=analyze(*idx->base, scope); auto it=analyze(*idx->index, scope); (void)it;
         if (bt.pointerLevels>0) { bt.pointerLevels--; e.type=bt; }
-        else if (!bt.arrayDims.empty()) { bt.arrayDims.erase(bt.arrayDims.begin()); e.type=bt; }
+        else if (!bt.arrayDims.empty()) { bt.arrayDims = bt.arrayDims.inner(); e.type=bt; }
         else e.type=bt; return e.type; }
-    if (auto call = dynamic_cast<CallExpr*>(&e)) {
+    case NodeKind::CallExpr: {
+        auto* call = &cast<CallExpr>(e);
+        ++lookups;
         auto* sym = scope.lookup(call->callee);
-        if (!sym || !sym->isFunction) { diags.error("call to undeclared function: "+call->callee); e.type=Type::intTy(); return e.type; }
+        if (!sym || !sym->isFunction) { diags.error("call to undeclared function: "+symStr(call->callee)); e.type=Type::intTy(); return e.type; }
         for (auto& a : call->args) analyze(*a, scope);
+        if (call->args.size() != sym->paramTypes.size())
+            diags.error("wrong number of arguments to " + symStr(call->callee) + ": expected " +
+                        std::to_string(sym->paramTypes.size()) + ", got " + std::to_string(call->args.size()));
         e.type = sym->type; return e.type;
     }
-    e.type = Type::intTy(); return e.type;
+    default: e.type = Type::intTy(); return e.type;
+    }
 }
 
 } // namespace cmini
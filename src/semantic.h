@@ -11,13 +11,22 @@ struct Diagnostics {
     bool ok() const { return messages.empty(); }
 };
 
+class ThreadPool;
+
 struct Semantic {
     Diagnostics diags;
     Scope global;
+    size_t lookups {0}; // symbol-table queries made while checking bodies
 
-    void analyze(Program& p);
+    // With a pool, functions are checked concurrently after the serial
+    // predeclaration pass; diagnostics are merged back in source order.
+    // Functions flagged in `clean` passed an earlier build with the same
+    // fingerprint and are only predeclared, not rechecked.
+    void analyze(Program& p, ThreadPool* pool = nullptr, const std::vector<bool>* clean = nullptr);
 
 private:
+    Scope* globals {&global}; // parent of function scopes; shared by per-function workers
+
     void analyze(Function& f);
     void analyze(Block& b, Scope& scope);
     void analyze(Stmt& s, Scope& scope, const Type& retTy);
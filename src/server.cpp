@@ -0,0 +1,181 @@
+#include "server.h"
+#include <cerrno>
+#include <condition_variable>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <limits.h>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include "driver.h"
+#include "threadpool.h"
+
+namespace cmini {
+
+namespace {
+
+bool sendAll(int fd, const void* p, size_t n) {
+    const char* c = static_cast<const char*>(p);
+    while (n) {
+        ssize_t w = ::send(fd, c, n, MSG_NOSIGNAL);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) return false;
+        c += w; n -= (size_t)w;
+    }
+    return true;
+}
+
+bool recvAll(int fd, void* p, size_t n) {
+    char* c = static_cast<char*>(p);
+    while (n) {
+        ssize_t r = ::recv(fd, c, n, 0);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) return false;
+        c += r; n -= (size_t)r;
+    }
+    return true;
+}
+
+bool sendU32(int fd, uint32_t v) { return sendAll(fd, &v, sizeof v); }
+bool recvU32(int fd, uint32_t& v) { return recvAll(fd, &v, sizeof v); }
+
+bool sendStr(int fd, const std::string& s) {
+    return sendU32(fd, (uint32_t)s.size()) && sendAll(fd, s.data(), s.size());
+}
+
+bool recvStr(int fd, std::string& s) {
+    uint32_t n;
+    if (!recvU32(fd, n) || n > (64u << 20)) return false;
+    s.resize(n);
+    return recvAll(fd, s.data(), n);
+}
+
+bool makeAddr(const std::string& path, sockaddr_un& addr) {
+    if (path.size() >= sizeof addr.sun_path) return false;
+    std::memset(&addr, 0, sizeof addr);
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+int connectTo(const std::string& path) {
+    sockaddr_un addr;
+    if (!makeAddr(path, addr)) return -1;
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof addr) != 0) { ::close(fd); return -1; }
+    return fd;
+}
+
+struct Server {
+    ThreadPool* pool;
+    int listenFd {-1};
+    std::mutex mu;
+    std::condition_variable idle;
+    unsigned active {0};
+    bool stopping {false};
+
+    // Serves one request; returns true if it asked the server to stop.
+    bool serve(int fd) {
+        uint32_t argc;
+        std::string cwd;
+        if (!recvU32(fd, argc) || argc > 65536 || !recvStr(fd, cwd)) return false;
+        std::vector<std::string> args(argc);
+        for (auto& a : args) if (!recvStr(fd, a)) return false;
+
+        if (args.size() == 1 && args[0] == "--shutdown") {
+            sendU32(fd, 0); sendStr(fd, "server stopping\n"); sendStr(fd, "");
+            return true;
+        }
+        std::ostringstream out, err;
+        int rc = runDriver(args, out, err, pool, cwd);
+        (void)(sendU32(fd, (uint32_t)rc) && sendStr(fd, out.str()) && sendStr(fd, err.str()));
+        return false;
+    }
+
+    void handle(int fd) {
+        bool stop = serve(fd);
+        ::close(fd);
+        std::lock_guard lk(mu);
+        if (stop && !stopping) {
+            stopping = true;
+            ::shutdown(listenFd, SHUT_RDWR); // wakes the accept() loop
+        }
+        if (--active == 0) idle.notify_all();
+    }
+};
+
+} // namespace
+
+int runServer(const std::string& socketPath, unsigned jobs, std::ostream& log) {
+    sockaddr_un addr;
+    if (!makeAddr(socketPath, addr)) { log << "socket path too long: " << socketPath << "\n"; return 1; }
+    int probe = connectTo(socketPath);
+    if (probe >= 0) { ::close(probe); log << "a server is already listening on " << socketPath << "\n"; return 1; }
+    ::unlink(socketPath.c_str()); // stale socket from a dead server
+
+    int lfd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (lfd < 0 || ::bind(lfd, reinterpret_cast<sockaddr*>(&addr), sizeof addr) != 0 || ::listen(lfd, 128) != 0) {
+        log << "cannot listen on " << socketPath << ": " << std::strerror(errno) << "\n";
+        if (lfd >= 0) ::close(lfd);
+        return 1;
+    }
+    std::signal(SIGPIPE, SIG_IGN);
+
+    if (jobs == 0) jobs = ThreadPool::defaultWorkers();
+    ThreadPool pool(jobs > 1 ? jobs - 1 : 0);
+    Server srv;
+    srv.pool = &pool;
+    srv.listenFd = lfd;
+    log << "cmini server listening on " << socketPath << " (" << jobs << " threads)" << std::endl;
+
+    for (;;) {
+        int cfd = ::accept4(lfd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (cfd < 0) {
+            if (errno == EINTR) continue;
+            std::lock_guard lk(srv.mu);
+            if (srv.stopping) break;
+            if (errno == ECONNABORTED || errno == EMFILE || errno == ENFILE) continue;
+            log << "accept failed: " << std::strerror(errno) << "\n";
+            break;
+        }
+        {
+            std::lock_guard lk(srv.mu);
+            ++srv.active;
+        }
+        // One thread per connection: requests mostly wait on the shared pool.
+        std::thread([&srv, cfd] { srv.handle(cfd); }).detach();
+    }
+
+    std::unique_lock lk(srv.mu);
+    srv.idle.wait(lk, [&] { return srv.active == 0; });
+    ::close(lfd);
+    ::unlink(socketPath.c_str());
+    log << "cmini server stopped" << std::endl;
+    return 0;
+}
+
+int runClient(const std::string& socketPath, const std::vector<std::string>& args,
+              std::ostream& out, std::ostream& err) {
+    int fd = connectTo(socketPath);
+    if (fd < 0) return -1;
+    char cwd[PATH_MAX];
+    std::string dir = ::getcwd(cwd, sizeof cwd) ? cwd : "";
+    bool ok = sendU32(fd, (uint32_t)args.size()) && sendStr(fd, dir);
+    for (auto& a : args) ok = ok && sendStr(fd, a);
+    uint32_t rc = 1;
+    std::string o, e;
+    ok = ok && recvU32(fd, rc) && recvStr(fd, o) && recvStr(fd, e);
+    ::close(fd);
+    if (!ok) { err << "lost connection to cmini server at " << socketPath << "\n"; return 1; }
+    out << o;
+    err << e;
+    return (int)rc;
+}
+
+} // namespace cmini
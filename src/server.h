@@ -0,0 +1,26 @@
+#pragma once
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+namespace cmini {
+
+// Compile server. A daemon listens on a Unix domain socket and runs each
+// client's command line through runDriver() on its own thread, sharing one
+// warm thread pool; the interner and the arena block cache stay warm too.
+//
+// Wire format (native byte order, local only): every string is a u32
+// length followed by its bytes.
+//   request:  u32 argc, cwd, argv[0..argc)
+//   response: u32 exit code, stdout text, stderr text
+// A request whose only argument is "--shutdown" stops the server once the
+// requests in flight have finished.
+int runServer(const std::string& socketPath, unsigned jobs, std::ostream& log);
+
+// Thin client: forwards args and the working directory to the server and
+// replays its output. Returns the server's exit code, or -1 when no server
+// is listening on socketPath.
+int runClient(const std::string& socketPath, const std::vector<std::string>& args,
+              std::ostream& out, std::ostream& err);
+
+} // namespace cmini
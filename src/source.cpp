@@ -0,0 +1,52 @@
+#include "source.h"
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace cmini {
+
+SourceFile::~SourceFile() { close(); }
+
+void SourceFile::close() {
+    if (map) ::munmap(map, mapSize);
+    map = nullptr; mapSize = 0;
+    owned.clear();
+    view = {};
+}
+
+bool SourceFile::open(const std::string& path, bool useMmap) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    struct stat st;
+    if (::fstat(fd, &st) != 0) { ::close(fd); return false; }
+
+    if (useMmap && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void* p = ::mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+            ::madvise(p, (size_t)st.st_size, MADV_SEQUENTIAL);
+            ::close(fd);
+            map = p; mapSize = (size_t)st.st_size;
+            view = std::string_view(static_cast<const char*>(p), mapSize);
+            return true;
+        }
+    }
+
+    // fallback: read everything into an owned buffer
+    if (S_ISREG(st.st_mode)) owned.reserve((size_t)st.st_size);
+    char buf[1 << 16];
+    for (;;) {
+        ssize_t n = ::read(fd, buf, sizeof buf);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) { ::close(fd); owned.clear(); return false; }
+        if (n == 0) break;
+        owned.append(buf, (size_t)n);
+    }
+    ::close(fd);
+    view = owned;
+    return true;
+}
+
+} // namespace cmini
@@ -0,0 +1,30 @@
+#pragma once
+#include <string>
+#include <string_view>
+
+namespace cmini {
+
+// Read-only contents of one input file. Regular files are mmap'd so the
+// lexer can borrow the bytes straight from the page cache; pipes, empty
+// files, or callers that opt out are read into an owned buffer instead.
+class SourceFile {
+public:
+    SourceFile() = default;
+    SourceFile(const SourceFile&) = delete;
+    SourceFile& operator=(const SourceFile&) = delete;
+    ~SourceFile();
+
+    bool open(const std::string& path, bool useMmap = true);
+    std::string_view text() const { return view; }
+    bool mapped() const { return map != nullptr; }
+
+private:
+    void close();
+
+    void* map {nullptr};
+    size_t mapSize {0};
+    std::string owned;
+    std::string_view view;
+};
+
+} // namespace cmini
@@ -0,0 +1,121 @@
+#include "threadpool.h"
+#include <exception>
+#include "timereport.h"
+
+namespace cmini {
+
+namespace {
+thread_local const ThreadPool* tlPool = nullptr;
+thread_local unsigned tlIndex = 0;
+}
+
+ThreadPool::ThreadPool(unsigned workers) {
+    for (unsigned i = 0; i < workers; ++i) queues.push_back(std::make_unique<Queue>());
+    for (unsigned i = 0; i < workers; ++i) threads.emplace_back([this, i] { workerLoop(i); });
+}
+
+ThreadPool::~ThreadPool() {
+    { std::lock_guard lk(sleepMu); stopping = true; }
+    wake.notify_all();
+    for (auto& t : threads) t.join();
+}
+
+unsigned ThreadPool::defaultWorkers() {
+    unsigned n = std::thread::hardware_concurrency();
+    return n ? n : 1;
+}
+
+void ThreadPool::push(Task t) {
+    unsigned q = tlPool == this ? tlIndex : nextQueue++ % (unsigned)queues.size();
+    {
+        std::lock_guard lk(queues[q]->mu);
+        queues[q]->tasks.push_back(std::move(t));
+    }
+    ++pending;
+    // take the sleep lock so a worker between its predicate check and
+    // wait() cannot miss this notification
+    { std::lock_guard lk(sleepMu); }
+    wake.notify_one();
+}
+
+bool ThreadPool::runOne() {
+    if (pending == 0) return false;
+    size_t n = queues.size();
+    unsigned self = tlPool == this ? tlIndex : 0;
+    Task t;
+    // own queue from the back (most recent, cache-warm), others from the front
+    {
+        std::lock_guard lk(queues[self]->mu);
+        auto& q = queues[self]->tasks;
+        if (!q.empty()) { t = std::move(q.back()); q.pop_back(); }
+    }
+    for (size_t k = 1; !t && k < n; ++k) {
+        auto& victim = *queues[(self + k) % n];
+        std::lock_guard lk(victim.mu);
+        if (!victim.tasks.empty()) { t = std::move(victim.tasks.front()); victim.tasks.pop_front(); }
+    }
+    if (!t) return false;
+    --pending;
+    t();
+    return true;
+}
+
+void ThreadPool::workerLoop(unsigned index) {
+    tlPool = this;
+    tlIndex = index;
+    for (;;) {
+        if (runOne()) continue;
+        std::unique_lock lk(sleepMu);
+        wake.wait(lk, [&] { return stopping || pending > 0; });
+        if (stopping && pending == 0) return;
+    }
+}
+
+void ThreadPool::parallelFor(size_t n, const std::function<void(size_t)>& fn) {
+    if (threads.empty() || n <= 1) {
+        for (size_t i = 0; i < n; ++i) fn(i);
+        return;
+    }
+    struct State {
+        std::atomic<size_t> next {0};
+        std::atomic<size_t> done {0};
+        std::mutex errMu;
+        std::exception_ptr err;
+        TimeReport* report {nullptr};
+    };
+    auto st = std::make_shared<State>();
+    st->report = TimeReport::current(); // items count toward the caller's compilation
+    // Runners claim indices one at a time, so uneven items balance out.
+    // A runner that starts after the loop finished touches only st.
+    auto runner = [this, st, &fn, n] {
+        for (size_t i; (i = st->next++) < n; ) {
+            {
+                // ends before the item counts as done, while the report lives
+                TimeReport::Scope charged(st->report);
+                try { fn(i); }
+                catch (...) {
+                    std::lock_guard lk(st->errMu);
+                    if (!st->err) st->err = std::current_exception();
+                }
+            }
+            if (++st->done == n) {
+                // the caller may sleep on wake below
+                { std::lock_guard lk(sleepMu); }
+                wake.notify_all();
+            }
+        }
+    };
+    size_t helpers = std::min<size_t>(threads.size(), n - 1);
+    for (size_t k = 0; k < helpers; ++k) push(runner);
+    runner();
+    // Run queued tasks while items are still in flight, so nested loops
+    // make progress; sleep once there are none.
+    while (st->done < n) {
+        if (runOne()) continue;
+        std::unique_lock lk(sleepMu);
+        wake.wait(lk, [&] { return st->done == n || pending > 0; });
+    }
+    if (st->err) std::rethrow_exception(st->err);
+}
+
+} // namespace cmini
@@ -0,0 +1,51 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace cmini {
+
+// Work-stealing thread pool. Every worker owns a deque: it pops its own
+// work from the back and steals from the front of the others when idle.
+// Threads that wait in parallelFor() run queued tasks too, so parallel
+// loops may nest (e.g. per-file work that fans out per function), and
+// sleep with the idle workers when there are none.
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned workers);
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    ~ThreadPool();
+
+    unsigned size() const { return (unsigned)threads.size(); }
+
+    // Runs fn(i) for every i in [0, n) and returns once all calls finished.
+    // The first exception thrown by fn is rethrown here.
+    void parallelFor(size_t n, const std::function<void(size_t)>& fn);
+
+    // Worker count for "-j 0": one per hardware thread.
+    static unsigned defaultWorkers();
+
+private:
+    using Task = std::function<void()>;
+    struct Queue { std::mutex mu; std::deque<Task> tasks; };
+
+    void push(Task t);
+    bool runOne();
+    void workerLoop(unsigned index);
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> threads;
+    std::mutex sleepMu;
+    std::condition_variable wake;
+    std::atomic<size_t> pending {0};
+    std::atomic<unsigned> nextQueue {0};
+    bool stopping {false};
+};
+
+} // namespace cmini
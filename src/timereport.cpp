@@ -0,0 +1,172 @@
+#include "timereport.h"
+#include <atomic>
+#include <cstdio>
+#include <ctime>
+#include <iterator>
+#include <ostream>
+#include <sys/resource.h>
+
+namespace cmini {
+
+namespace {
+std::atomic<int> liveReports {0};
+thread_local TimeReport* tlReport = nullptr;
+thread_local double tlSince = 0; // thread CPU seconds when tlReport was set
+
+double threadCpu() {
+    timespec ts {};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+long peakRssKb() {
+    rusage ru {};
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_maxrss; // kilobytes on Linux
+}
+
+void jsonString(std::ostream& os, const std::string& s) {
+    os << '"';
+    for (unsigned char c : s) {
+        if (c == '"' || c == '\\') os << '\\' << (char)c;
+        else if (c < 0x20) {
+            char buf[8];
+            std::snprintf(buf, sizeof buf, "\\u%04x", c);
+            os << buf;
+        } else os << (char)c;
+    }
+    os << '"';
+}
+} // namespace
+
+void TimeReport::noteAllocation(size_t bytes) {
+    if (liveReports.load(std::memory_order_relaxed) == 0) return;
+    if (TimeReport* r = tlReport) {
+        r->allocations.fetch_add(1, std::memory_order_relaxed);
+        r->allocatedBytes.fetch_add(bytes, std::memory_order_relaxed);
+    }
+}
+
+TimeReport::TimeReport() { liveReports.fetch_add(1); }
+
+TimeReport::~TimeReport() { liveReports.fetch_sub(1); }
+
+TimeReport* TimeReport::current() { return tlReport; }
+
+void TimeReport::charge(TimeReport* r, double now) {
+    if (r) r->cpuNs.fetch_add((int64_t)((now - tlSince) * 1e9), std::memory_order_relaxed);
+}
+
+TimeReport::Scope::Scope(TimeReport* report) : prev(tlReport), switched(report != tlReport) {
+    if (!switched) return;
+    double now = threadCpu();
+    charge(tlReport, now);
+    tlReport = report;
+    tlSince = now;
+}
+
+TimeReport::Scope::~Scope() {
+    if (!switched) return;
+    double now = threadCpu();
+    charge(tlReport, now);
+    tlReport = prev;
+    tlSince = now;
+}
+
+// CPU time is what threads charged on leaving a Scope for this report,
+// plus the calling thread's own time since it entered one.
+TimeReport::Sample TimeReport::sample() const {
+    double cpu = cpuNs.load(std::memory_order_relaxed) * 1e-9;
+    if (tlReport == this) cpu += threadCpu() - tlSince;
+    return {std::chrono::steady_clock::now(), cpu, allocations.load(std::memory_order_relaxed),
+            allocatedBytes.load(std::memory_order_relaxed)};
+}
+
+void TimeReport::phase(const char* name) {
+    stop();
+    running = name;
+    start = sample();
+}
+
+void TimeReport::stop() {
+    if (running.empty()) return;
+    Sample end = sample();
+    phases.push_back({std::move(running), std::chrono::duration<double>(end.wall - start.wall).count(),
+                      end.cpu - start.cpu, end.allocations - start.allocations, end.bytes - start.bytes,
+                      peakRssKb()});
+    running.clear();
+}
+
+void TimeReport::counter(const char* name, uint64_t value) { counters.push_back({name, value}); }
+
+void TimeReport::countNodes(const Program& p) {
+    ++nodes[(size_t)NodeKind::Program];
+    for (auto* f : p.functions) {
+        ++nodes[(size_t)NodeKind::Function];
+        walk(f->body, [&](Node* n) { ++nodes[(size_t)n->kind]; });
+    }
+}
+
+void TimeReport::printText(std::ostream& os, const std::string& file) const {
+    char line[160];
+    os << "time report for " << file << ":\n";
+    std::snprintf(line, sizeof line, "  %-10s %10s %10s %10s %12s %10s\n", "phase", "wall ms", "cpu ms", "allocs",
+                  "bytes", "peak RSS");
+    os << line;
+    double wall = 0, cpu = 0;
+    uint64_t allocs = 0, bytes = 0;
+    for (auto& ph : phases) {
+        std::snprintf(line, sizeof line, "  %-10s %10.3f %10.3f %10llu %12llu %7ld KB\n", ph.name.c_str(),
+                      ph.wall * 1e3, ph.cpu * 1e3, (unsigned long long)ph.allocations, (unsigned long long)ph.bytes,
+                      ph.peakRssKb);
+        os << line;
+        wall += ph.wall; cpu += ph.cpu; allocs += ph.allocations; bytes += ph.bytes;
+    }
+    std::snprintf(line, sizeof line, "  %-10s %10.3f %10.3f %10llu %12llu %7ld KB\n", "total", wall * 1e3, cpu * 1e3,
+                  (unsigned long long)allocs, (unsigned long long)bytes, peakRssKb());
+    os << line;
+    for (auto& [name, value] : counters) os << "  " << name << ": " << value << "\n";
+    uint64_t total = 0;
+    for (uint64_t n : nodes) total += n;
+    os << "  nodes: " << total;
+    const char* sep = " (";
+    for (size_t k = 0; k < std::size(nodes); ++k) {
+        if (!nodes[k]) continue;
+        os << sep << kindName((NodeKind)k) << " " << nodes[k];
+        sep = ", ";
+    }
+    os << (total ? ")\n" : "\n");
+}
+
+void TimeReport::printJson(std::ostream& os, const std::string& file) const {
+    char num[32];
+    auto ms = [&](double s) { std::snprintf(num, sizeof num, "%.3f", s * 1e3); return num; };
+    os << "{\"file\":";
+    jsonString(os, file);
+    os << ",\"phases\":[";
+    for (size_t i = 0; i < phases.size(); ++i) {
+        const Phase& ph = phases[i];
+        os << (i ? "," : "") << "{\"name\":";
+        jsonString(os, ph.name);
+        os << ",\"wall_ms\":" << ms(ph.wall);
+        os << ",\"cpu_ms\":" << ms(ph.cpu);
+        os << ",\"allocations\":" << ph.allocations << ",\"bytes\":" << ph.bytes << ",\"peak_rss_kb\":" << ph.peakRssKb
+           << "}";
+    }
+    os << "],\"counters\":{";
+    for (size_t i = 0; i < counters.size(); ++i) {
+        os << (i ? "," : "");
+        jsonString(os, counters[i].first);
+        os << ":" << counters[i].second;
+    }
+    os << "},\"nodes\":{";
+    const char* sep = "";
+    for (size_t k = 0; k < std::size(nodes); ++k) {
+        if (!nodes[k]) continue;
+        os << sep << "\"" << kindName((NodeKind)k) << "\":" << nodes[k];
+        sep = ",";
+    }
+    os << "},\"peak_rss_kb\":" << peakRssKb() << "}\n";
+}
+
+} // namespace cmini
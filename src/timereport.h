@@ -0,0 +1,84 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+#include "ast.h"
+
+namespace cmini {
+
+// --time-report: wall and CPU time, heap allocations and the peak RSS for
+// each phase of one compilation, plus counters (tokens, AST nodes by kind,
+// symbol lookups). Without a live report nothing is measured: clocks are
+// read only at phase boundaries, the counters come from work the phases do
+// anyway or from a walk made for the report, and the allocation hook costs
+// operator new one relaxed load. CPU time and allocations are charged to
+// the report of the compilation a thread is working for (see Scope), so
+// inputs compiled concurrently (-j, the compile server) keep apart.
+// Only the cmini executable replaces operator new (in main.cpp); other
+// programs linking the library see the arena's blocks alone.
+class TimeReport {
+public:
+    TimeReport();
+    ~TimeReport();
+    TimeReport(const TimeReport&) = delete;
+    TimeReport& operator=(const TimeReport&) = delete;
+
+    // Ends the running phase, if any, and starts `name`.
+    void phase(const char* name);
+    void stop(); // ends the running phase
+    void counter(const char* name, uint64_t value);
+    void countNodes(const Program& p); // every node reachable from p, by kind
+
+    void printText(std::ostream& os, const std::string& file) const;
+    void printJson(std::ostream& os, const std::string& file) const; // one line
+
+    // For allocators that go to malloc directly (the arena's blocks).
+    static void noteAllocation(size_t bytes);
+
+    // Until it ends, the calling thread's CPU time and allocations go to
+    // `report`, or to no report when null. compileFile opens one for each
+    // compilation, and parallelFor one around each item, with the report
+    // current where the loop started. Cheap when the report is already
+    // the current one.
+    class Scope {
+    public:
+        explicit Scope(TimeReport* report);
+        ~Scope();
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    private:
+        TimeReport* prev;
+        bool switched;
+    };
+    static TimeReport* current();
+
+private:
+    struct Sample {
+        std::chrono::steady_clock::time_point wall;
+        double cpu;
+        uint64_t allocations, bytes;
+    };
+    struct Phase {
+        std::string name;
+        double wall, cpu;
+        uint64_t allocations, bytes;
+        long peakRssKb; // at the end of the phase
+    };
+
+    Sample sample() const;
+    static void charge(TimeReport* r, double now); // the thread's CPU since it switched
+
+    std::atomic<uint64_t> allocations {0}, allocatedBytes {0};
+    std::atomic<int64_t> cpuNs {0}; // charged by threads that left a Scope
+    std::vector<Phase> phases;
+    std::vector<std::pair<std::string, uint64_t>> counters;
+    uint64_t nodes[(size_t)NodeKind::Program + 1] {};
+    std::string running;
+    Sample start {};
+};
+
+} // namespace cmini
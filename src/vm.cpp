@@ -0,0 +1,282 @@
+#include "vm.h"
+#include <algorithm>
+#include <cstring>
+
+// Direct threading needs the labels-as-values extension; elsewhere the
+// handlers are reached through a switch.
+#if defined(__GNUC__) || defined(__clang__)
+#define CMINI_VM_THREADED 1
+#endif
+
+namespace cmini::bc {
+
+namespace {
+
+struct Threaded {
+    const void* handler;
+    int32_t a, b, c; // jump targets in c are indices into the whole module's code
+    Op op;
+};
+
+struct CallFrame {
+    const Threaded* ret;
+    uint32_t regBase; // the caller's window
+    int64_t fp, sp;   // and frame
+    int32_t dest;     // caller register that receives the result
+};
+
+struct Entry {
+    const Threaded* code {nullptr}; // null for a declaration
+    uint32_t registers {0}, frameBytes {0};
+};
+
+bool isJump(Op op) { return op == Op::Jmp || (op >= Op::Jz && op <= Op::JNeK); }
+
+int32_t wrap(int64_t v) { return (int32_t)(uint32_t)(uint64_t)v; }
+
+int32_t load4(const uint8_t* p) { int32_t v; std::memcpy(&v, p, 4); return v; }
+void store4(uint8_t* p, int32_t v) { std::memcpy(p, &v, 4); }
+
+} // namespace
+
+VM::Result VM::run(const Module& m, size_t fn, const std::vector<int32_t>& args) {
+    Result res;
+    if (fn >= m.functions.size()) { res.error = "no such function"; return res; }
+    if (args.size() != m.functions[fn].params) {
+        res.error = "expected " + std::to_string(m.functions[fn].params) + " arguments";
+        return res;
+    }
+
+#ifdef CMINI_VM_THREADED
+    static const void* const handlers[] = {
+#define CMINI_VM_LABEL(name) &&op_##name,
+        CMINI_BC_OPS(CMINI_VM_LABEL)
+#undef CMINI_VM_LABEL
+    };
+#define DISPATCH() goto *ip->handler
+#else
+#define DISPATCH() goto dispatch
+#endif
+#define NEXT() do { ++ip; DISPATCH(); } while (0)
+#define FAIL(msg) do { res.error = msg; return res; } while (0)
+
+    // thread every function into one array
+    std::vector<Threaded> code;
+    std::vector<size_t> starts(m.functions.size());
+    for (size_t i = 0; i < m.functions.size(); ++i) {
+        starts[i] = code.size();
+        for (const Insn& in : m.functions[i].code) {
+            Threaded t {nullptr, in.a, in.b, in.c, in.op};
+#ifdef CMINI_VM_THREADED
+            t.handler = handlers[(size_t)in.op];
+#endif
+            if (isJump(in.op)) t.c += (int32_t)starts[i];
+            code.push_back(t);
+        }
+    }
+    std::vector<Entry> entries(m.functions.size());
+    for (size_t i = 0; i < m.functions.size(); ++i) {
+        const Function& f = m.functions[i];
+        if (!f.code.empty()) entries[i].code = code.data() + starts[i];
+        entries[i].registers = std::max(f.registers, f.params);
+        entries[i].frameBytes = f.frameBytes;
+    }
+    if (!entries[fn].code) FAIL("call to undefined function");
+
+    std::vector<int32_t> regs(std::max<size_t>(entries[fn].registers, 1024));
+    std::copy(args.begin(), args.end(), regs.begin());
+    std::vector<uint8_t> memory(std::min<size_t>(memoryLimit, 1 << 16));
+    std::vector<CallFrame> frames;
+    frames.reserve(64);
+
+    const Threaded* base = code.data();
+    const Threaded* ip = entries[fn].code;
+    int32_t* r = regs.data();
+    uint32_t regBase = 0;
+    uint8_t* mem = memory.data();
+    int64_t memSize = (int64_t)memory.size();
+    int64_t fp = 8, sp = fp + entries[fn].frameBytes; // address 0 stays unused
+    if (sp > memSize) {
+        if ((size_t)sp > memoryLimit) FAIL("out of memory");
+        memory.resize((size_t)sp);
+        mem = memory.data();
+        memSize = sp;
+    }
+
+#define OUTSIDE(addr, n) ((addr) < 8 || (addr) > memSize - (n))
+    DISPATCH();
+
+#ifndef CMINI_VM_THREADED
+dispatch:
+    switch (ip->op) {
+#define CMINI_VM_CASE(name) case Op::name: goto op_##name;
+        CMINI_BC_OPS(CMINI_VM_CASE)
+#undef CMINI_VM_CASE
+    }
+#endif
+
+op_Const: r[ip->a] = ip->b; NEXT();
+op_Move: r[ip->a] = r[ip->b]; NEXT();
+
+#define ARITH(name, expr)                                                   \
+    op_##name: { int32_t x = r[ip->b], y = r[ip->c]; r[ip->a] = (expr); NEXT(); } \
+    op_##name##K: { int32_t x = r[ip->b], y = ip->c; r[ip->a] = (expr); NEXT(); }
+    ARITH(Add, wrap((int64_t)x + y))
+    ARITH(Sub, wrap((int64_t)x - y))
+    ARITH(Mul, wrap((int64_t)x * y))
+    ARITH(And, x & y)
+    ARITH(Or, x | y)
+    ARITH(Xor, x ^ y)
+    ARITH(Shl, (int32_t)((uint32_t)x << (y & 31)))
+    ARITH(Shr, x >> (y & 31))
+    ARITH(Lt, x < y)
+    ARITH(Le, x <= y)
+    ARITH(Gt, x > y)
+    ARITH(Ge, x >= y)
+    ARITH(Eq, x == y)
+    ARITH(Ne, x != y)
+#undef ARITH
+
+#define DIVIDE(name, y, op)                                                                     \
+    op_##name: {                                                                                \
+        int32_t x = r[ip->b], d = (y);                                                          \
+        if (d == 0 || (x == INT32_MIN && d == -1)) FAIL("division overflow");                   \
+        r[ip->a] = x op d;                                                                      \
+        NEXT();                                                                                 \
+    }
+    DIVIDE(Div, r[ip->c], /)
+    DIVIDE(Mod, r[ip->c], %)
+    DIVIDE(DivK, ip->c, /)
+    DIVIDE(ModK, ip->c, %)
+#undef DIVIDE
+
+op_Neg: r[ip->a] = wrap(-(int64_t)r[ip->b]); NEXT();
+op_Not: r[ip->a] = r[ip->b] == 0; NEXT();
+op_BitNot: r[ip->a] = ~r[ip->b]; NEXT();
+
+op_Jmp: ip = base + ip->c; DISPATCH();
+op_Jz: if (r[ip->a] == 0) { ip = base + ip->c; DISPATCH(); } NEXT();
+op_Jnz: if (r[ip->a] != 0) { ip = base + ip->c; DISPATCH(); } NEXT();
+
+#define BRANCH(name, op)                                                                 \
+    op_J##name: if (r[ip->a] op r[ip->b]) { ip = base + ip->c; DISPATCH(); } NEXT();      \
+    op_J##name##K: if (r[ip->a] op ip->b) { ip = base + ip->c; DISPATCH(); } NEXT();
+    BRANCH(Lt, <)
+    BRANCH(Le, <=)
+    BRANCH(Gt, >)
+    BRANCH(Ge, >=)
+    BRANCH(Eq, ==)
+    BRANCH(Ne, !=)
+#undef BRANCH
+
+op_FrameAddr: r[ip->a] = (int32_t)(fp + ip->b); NEXT();
+op_Lea4: r[ip->a] = wrap((int64_t)r[ip->b] + (int64_t)r[ip->c] * 4); NEXT();
+op_Lea1: r[ip->a] = wrap((int64_t)r[ip->b] + r[ip->c]); NEXT();
+
+op_Load4: { int64_t a = r[ip->b]; if (OUTSIDE(a, 4)) FAIL("load out of bounds"); r[ip->a] = load4(mem + a); NEXT(); }
+op_Load1: { int64_t a = r[ip->b]; if (OUTSIDE(a, 1)) FAIL("load out of bounds"); r[ip->a] = (int8_t)mem[a]; NEXT(); }
+op_Store4: { int64_t a = r[ip->a]; if (OUTSIDE(a, 4)) FAIL("store out of bounds"); store4(mem + a, r[ip->b]); NEXT(); }
+op_Store1: { int64_t a = r[ip->a]; if (OUTSIDE(a, 1)) FAIL("store out of bounds"); mem[a] = (uint8_t)r[ip->b]; NEXT(); }
+op_LoadX4: {
+    int64_t a = (int64_t)r[ip->b] + (int64_t)r[ip->c] * 4;
+    if (OUTSIDE(a, 4)) FAIL("load out of bounds");
+    r[ip->a] = load4(mem + a);
+    NEXT();
+}
+op_LoadX1: {
+    int64_t a = (int64_t)r[ip->b] + r[ip->c];
+    if (OUTSIDE(a, 1)) FAIL("load out of bounds");
+    r[ip->a] = (int8_t)mem[a];
+    NEXT();
+}
+op_StoreX4: {
+    int64_t a = (int64_t)r[ip->a] + (int64_t)r[ip->b] * 4;
+    if (OUTSIDE(a, 4)) FAIL("store out of bounds");
+    store4(mem + a, r[ip->c]);
+    NEXT();
+}
+op_StoreX1: {
+    int64_t a = (int64_t)r[ip->a] + r[ip->b];
+    if (OUTSIDE(a, 1)) FAIL("store out of bounds");
+    mem[a] = (uint8_t)r[ip->c];
+    NEXT();
+}
+op_LoadF4: {
+    int64_t a = fp + ip->b + (int64_t)r[ip->c] * 4;
+    if (OUTSIDE(a, 4)) FAIL("load out of bounds");
+    r[ip->a] = load4(mem + a);
+    NEXT();
+}
+op_LoadF1: {
+    int64_t a = fp + ip->b + r[ip->c];
+    if (OUTSIDE(a, 1)) FAIL("load out of bounds");
+    r[ip->a] = (int8_t)mem[a];
+    NEXT();
+}
+op_StoreF4: {
+    int64_t a = fp + ip->a + (int64_t)r[ip->b] * 4;
+    if (OUTSIDE(a, 4)) FAIL("store out of bounds");
+    store4(mem + a, r[ip->c]);
+    NEXT();
+}
+op_StoreF1: {
+    int64_t a = fp + ip->a + r[ip->b];
+    if (OUTSIDE(a, 1)) FAIL("store out of bounds");
+    mem[a] = (uint8_t)r[ip->c];
+    NEXT();
+}
+// the compiler only emits these for offsets inside the frame
+op_GetF4: r[ip->a] = load4(mem + fp + ip->b); NEXT();
+op_GetF1: r[ip->a] = (int8_t)mem[fp + ip->b]; NEXT();
+op_SetF4: store4(mem + fp + ip->a, r[ip->b]); NEXT();
+op_SetF1: mem[fp + ip->a] = (uint8_t)r[ip->b]; NEXT();
+
+op_Call: {
+    const Entry& e = entries[(size_t)ip->b];
+    if (!e.code) FAIL("call to undefined function");
+    if (frames.size() >= depthLimit) FAIL("call depth limit exceeded");
+    uint32_t window = regBase + (uint32_t)ip->c;
+    if (window + e.registers > regs.size()) {
+        regs.resize(std::max(regs.size() * 2, (size_t)window + e.registers));
+    }
+    int64_t calleeFp = (sp + 7) & ~int64_t(7), calleeSp = calleeFp + e.frameBytes;
+    if (calleeSp > memSize) {
+        if ((size_t)calleeSp > memoryLimit) FAIL("out of memory");
+        memory.resize(std::min(std::max(memory.size() * 2, (size_t)calleeSp), memoryLimit));
+        mem = memory.data();
+        memSize = (int64_t)memory.size();
+    }
+    std::memset(mem + calleeFp, 0, e.frameBytes);
+    frames.push_back({ip + 1, regBase, fp, sp, ip->a});
+    regBase = window;
+    r = regs.data() + regBase;
+    fp = calleeFp;
+    sp = calleeSp;
+    ip = e.code;
+    DISPATCH();
+}
+op_Ret: {
+    int32_t v = r[ip->a];
+    if (frames.empty()) {
+        res.ok = true;
+        res.value = v;
+        return res;
+    }
+    const CallFrame& f = frames.back();
+    regBase = f.regBase;
+    r = regs.data() + regBase;
+    r[f.dest] = v;
+    fp = f.fp;
+    sp = f.sp;
+    ip = f.ret;
+    frames.pop_back();
+    DISPATCH();
+}
+
+#undef OUTSIDE
+#undef DISPATCH
+#undef NEXT
+#undef FAIL
+}
+
+} // namespace cmini::bc
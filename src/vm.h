@@ -0,0 +1,33 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "bytecode.h"
+
+namespace cmini::bc {
+
+// Interpreter for bc::Module. Before running, the code is threaded: every
+// instruction is rewritten to carry the address of its handler, and each
+// handler ends in an indirect jump straight to the next one (computed goto)
+// instead of returning to a central switch. Calls push onto a frame stack
+// of the VM's own rather than recursing on the host's. The register windows
+// of all active calls share one array, a callee's starting at its first
+// argument; their frames share one byte array, which is the whole address
+// space: 0 is never a valid address and every access that is not known to
+// stay inside its frame is bounds-checked.
+class VM {
+public:
+    unsigned depthLimit {100000};          // guards against runaway recursion
+    size_t memoryLimit {size_t(1) << 30}; // bytes for frames
+
+    struct Result {
+        bool ok {false};
+        int32_t value {0};
+        std::string error;
+    };
+
+    // Runs m.functions[fn] with one value per parameter.
+    Result run(const Module& m, size_t fn, const std::vector<int32_t>& args);
+};
+
+} // namespace cmini::bc
@@ -0,0 +1,621 @@
+#include "x86.h"
+#include <algorithm>
+#include <climits>
+#include <initializer_list>
+
+namespace cmini::x86 {
+
+using ir::Id;
+using ir::Op;
+using ir::Value;
+
+namespace {
+
+enum Reg : int { RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8, R9, R10, R11, R12, R13, R14, R15 };
+constexpr int argRegs[] = {RDI, RSI, RDX, RCX, R8, R9};
+constexpr int callerSaved[] = {RSI, RDI, R8, R9, R10};
+constexpr int calleeSaved[] = {RBX, R12, R13, R14, R15};
+
+// Condition codes, as in jcc/setcc.
+enum Cond : uint8_t { E = 0x4, NE = 0x5, L = 0xC, GE = 0xD, LE = 0xE, G = 0xF };
+
+Cond condOf(ir::Pred p) {
+    switch (p) {
+    case ir::Pred::EQ: return E;   case ir::Pred::NE: return NE;
+    case ir::Pred::SLT: return L;  case ir::Pred::SGE: return GE;
+    case ir::Pred::SLE: return LE; case ir::Pred::SGT: return G;
+    }
+    return E;
+}
+
+bool fits8(int64_t v) { return v >= -128 && v <= 127; }
+bool fits32(int64_t v) { return v >= INT32_MIN && v <= INT32_MAX; }
+
+struct Mem { int base; int32_t disp; };
+
+// Where a value is: a register, a stack slot, a constant, or (for allocas)
+// the address of a frame object. Stack and Frame hold an rbp displacement.
+struct Loc {
+    enum Kind : uint8_t { None, Reg, Stack, Imm, Frame } kind {None};
+    int64_t v {0};
+    static Loc reg(int r) { return {Reg, r}; }
+    bool operator==(const Loc&) const = default;
+};
+
+struct Move { Loc dst, src; };
+
+// Instruction encoding: REX prefix, opcode, ModRM (plus SIB and
+// displacement for memory operands).
+struct Asm {
+    std::vector<uint8_t>& code;
+
+    void b(uint8_t x) { code.push_back(x); }
+    void d(int32_t x) { for (int k = 0; k < 4; ++k) b((uint8_t)((uint32_t)x >> (8 * k))); }
+    void rex(bool w, int reg, int rm, bool force) {
+        uint8_t r = (uint8_t)(0x40 | (w ? 8 : 0) | (reg & 8 ? 4 : 0) | (rm & 8 ? 1 : 0));
+        if (r != 0x40 || force) b(r);
+    }
+    // byte operands need a REX prefix to mean sil/dil/spl/bpl rather than dh/bh/ah/ch
+    static bool lowByte(int r) { return r >= 4 && r < 8; }
+
+    // opcode reg, r/m with a register r/m; `reg` may be an opcode extension
+    void rr(std::initializer_list<uint8_t> op, bool w, int reg, int rm, bool bytes = false) {
+        rex(w, reg, rm, bytes && (lowByte(reg) || lowByte(rm)));
+        for (uint8_t x : op) b(x);
+        b((uint8_t)(0xC0 | (reg & 7) << 3 | (rm & 7)));
+    }
+    void rm(std::initializer_list<uint8_t> op, bool w, int reg, Mem m, bool bytes = false) {
+        rex(w, reg, m.base, bytes && lowByte(reg));
+        for (uint8_t x : op) b(x);
+        int base = m.base & 7;
+        int mod = m.disp == 0 && base != RBP ? 0 : fits8(m.disp) ? 1 : 2;
+        b((uint8_t)(mod << 6 | (reg & 7) << 3 | base));
+        if (base == RSP) b(0x24); // rsp and r12 need a SIB byte
+        if (mod == 1) b((uint8_t)(int8_t)m.disp);
+        else if (mod == 2) d(m.disp);
+    }
+
+    void push(int r) { if (r & 8) b(0x41); b((uint8_t)(0x50 | (r & 7))); }
+    void pop(int r) { if (r & 8) b(0x41); b((uint8_t)(0x58 | (r & 7))); }
+    void movImm(int r, int64_t v) {
+        if (v >= 0 && v <= INT32_MAX) { rex(false, 0, r, false); b((uint8_t)(0xB8 | (r & 7))); d((int32_t)v); }
+        else if (fits32(v)) { rr({0xC7}, true, 0, r); d((int32_t)v); }
+        else { rex(true, 0, r, false); b((uint8_t)(0xB8 | (r & 7))); for (int k = 0; k < 8; ++k) b((uint8_t)((uint64_t)v >> (8 * k))); }
+    }
+    // add/or/and/sub/xor/cmp with an immediate: 83 /digit ib or 81 /digit id
+    void aluImm(int digit, bool w, int r, int64_t v) {
+        if (fits8(v)) { rr({0x83}, w, digit, r); b((uint8_t)(int8_t)v); }
+        else { rr({0x81}, w, digit, r); d((int32_t)v); }
+    }
+};
+
+// Opcodes of the two-operand ALU instructions: the "reg, r/m" form and the
+// extension used with immediates.
+struct Alu { uint8_t rm; int digit; };
+constexpr Alu ADD {0x03, 0}, OR {0x0B, 1}, AND {0x23, 4}, SUB {0x2B, 5}, XOR {0x33, 6}, CMP {0x3B, 7};
+
+class FunctionCompiler {
+public:
+    FunctionCompiler(const ir::Function& f, MachineCode& out) : f(f), out(out), a{out.bytes} {}
+
+    void run() {
+        out.name = f.name;
+        out.bytes.clear();
+        out.calls.clear();
+        number();
+        allocate();
+        layoutFrame();
+        emit();
+    }
+
+private:
+    const ir::Function& f;
+    MachineCode& out;
+    Asm a;
+
+    // Values are numbered as vregs: instruction ids, then parameters.
+    size_t nv {0};
+    std::vector<int> pos;           // per instruction; parameters are defined at 0
+    std::vector<int> blockStart, blockEnd;
+    std::vector<char> fused;        // icmps emitted as flags for the condbr after them
+    std::vector<char> hasValue;     // per vreg
+    std::vector<int> callPos;       // positions of calls, ascending
+    std::vector<Loc> where;         // per vreg
+    std::vector<int32_t> frameDisp; // per alloca instruction
+    std::vector<int> spillSlot;     // per vreg, -1 if in a register
+    std::vector<int> usedCallee;
+    int32_t frameSize {0};
+
+    std::vector<int64_t> labels;    // code offset per label; blocks come first
+    std::vector<std::pair<size_t, int>> fixups; // rel32 field, label
+
+    // ---- numbering and liveness ----
+
+    int vreg(Value v) const {
+        if (v.kind == Value::Arg) return (int)(f.insts.size() + v.id());
+        if (v.kind == Value::Inst && hasValue[v.id()]) return (int)v.id();
+        return -1;
+    }
+
+    static bool produces(const ir::Inst& in) {
+        switch (in.op) {
+        case Op::Store: case Op::Br: case Op::CondBr: case Op::Ret: case Op::Count: case Op::Nop: case Op::Alloca: return false;
+        case Op::Call: return !(in.ty == ir::Ty::voidTy());
+        default: return true;
+        }
+    }
+
+    bool onlyUse(Id i, Id user) const {
+        Id u = f.insts[i].firstUse;
+        return u != ir::None && f.uses[u].next == ir::None && f.uses[u].user == user;
+    }
+
+    void number() {
+        nv = f.insts.size() + f.params.size();
+        pos.assign(f.insts.size(), 0);
+        blockStart.assign(f.blocks.size(), 0);
+        blockEnd.assign(f.blocks.size(), 0);
+        fused.assign(f.insts.size(), 0);
+        hasValue.assign(nv, 0);
+        for (size_t k = f.insts.size(); k < nv; ++k) hasValue[k] = 1;
+        int p = 2;
+        for (Id b : f.layout) {
+            const auto& list = f.blocks[b].insts;
+            blockStart[b] = p;
+            for (size_t k = 0; k < list.size(); ++k) {
+                Id i = list[k];
+                const ir::Inst& in = f.insts[i];
+                pos[i] = p;
+                p += 2;
+                if (in.op == Op::Call) callPos.push_back(pos[i]);
+                if (in.op == Op::ICmp && k + 1 < list.size() && f.insts[list[k + 1]].op == Op::CondBr &&
+                    f.operand(list[k + 1], 0) == Value::inst(i) && onlyUse(i, list[k + 1]))
+                    fused[i] = 1;
+                hasValue[i] = produces(in) && !fused[i];
+            }
+            blockEnd[b] = p - 2;
+        }
+    }
+
+    using Bits = std::vector<uint64_t>;
+    static void set(Bits& s, int v) { s[(size_t)v >> 6] |= 1ull << (v & 63); }
+    static bool test(const Bits& s, int v) { return s[(size_t)v >> 6] >> (v & 63) & 1; }
+
+    // Live intervals from block-level liveness: [start, end] spans every
+    // position at which the value is live, in layout order.
+    void allocate() {
+        size_t words = (nv + 63) / 64, nb = f.blocks.size();
+        std::vector<Bits> gen(nb, Bits(words)), kill(nb, Bits(words)), phiOut(nb, Bits(words));
+        std::vector<Bits> liveIn(nb, Bits(words)), liveOut(nb, Bits(words));
+        std::vector<int> start(nv, INT_MAX), end(nv, -1);
+        for (size_t k = f.insts.size(); k < nv; ++k) start[k] = end[k] = 0;
+        for (Id b : f.layout)
+            for (Id i : f.blocks[b].insts) {
+                const ir::Inst& in = f.insts[i];
+                if (in.op == Op::Phi) {
+                    for (uint32_t k = 0; k + 1 < in.opCount; k += 2) {
+                        int v = vreg(f.operand(i, k));
+                        Id from = f.operand(i, k + 1).id();
+                        if (v < 0 || from >= nb) continue;
+                        set(phiOut[from], v);
+                        end[v] = std::max(end[v], blockEnd[from]);
+                    }
+                } else {
+                    for (uint32_t k = 0; k < in.opCount; ++k) {
+                        int v = vreg(f.operand(i, k));
+                        if (v < 0) continue;
+                        if (!test(kill[b], v)) set(gen[b], v);
+                        end[v] = std::max(end[v], pos[i]);
+                    }
+                }
+                if (hasValue[i]) {
+                    // a block's phis are all written together, on the edge
+                    // into it, so they start at the block's first position
+                    set(kill[b], (int)i);
+                    start[i] = std::min(start[i], in.op == Op::Phi ? blockStart[b] : pos[i]);
+                    end[i] = std::max(end[i], pos[i]);
+                }
+            }
+        for (bool changed = true; changed;) {
+            changed = false;
+            for (auto it = f.layout.rbegin(); it != f.layout.rend(); ++it) {
+                Id b = *it;
+                Bits o = phiOut[b];
+                for (Id s : f.successors(b))
+                    for (size_t w = 0; w < words; ++w) o[w] |= liveIn[s][w];
+                for (size_t w = 0; w < words; ++w) {
+                    uint64_t x = gen[b][w] | (o[w] & ~kill[b][w]);
+                    if (x != liveIn[b][w]) { liveIn[b][w] = x; changed = true; }
+                }
+                liveOut[b] = std::move(o);
+            }
+        }
+        for (Id b : f.layout)
+            for (int v = 0; v < (int)nv; ++v) {
+                if (test(liveIn[b], v)) start[v] = std::min(start[v], blockStart[b]);
+                if (test(liveOut[b], v)) end[v] = std::max(end[v], blockEnd[b]);
+            }
+
+        struct Interval { int start, end, v; bool acrossCall; };
+        std::vector<Interval> intervals;
+        for (int v = 0; v < (int)nv; ++v) {
+            if (!hasValue[v] || start[v] == INT_MAX) continue;
+            auto c = std::upper_bound(callPos.begin(), callPos.end(), start[v]);
+            intervals.push_back({start[v], end[v], v, c != callPos.end() && *c < end[v]});
+        }
+        std::sort(intervals.begin(), intervals.end(),
+                  [](const Interval& x, const Interval& y) { return x.start != y.start ? x.start < y.start : x.v < y.v; });
+
+        where.assign(nv, Loc());
+        spillSlot.assign(nv, -1);
+        int spills = 0;
+        std::vector<const Interval*> active; // by increasing end
+        bool busy[16] = {};
+        bool calleeUsed[16] = {};
+        auto spill = [&](int v) { spillSlot[v] = spills++; where[v] = {Loc::Stack, 0}; };
+        for (const Interval& cur : intervals) {
+            while (!active.empty() && active.front()->end < cur.start) {
+                busy[where[active.front()->v].v] = false;
+                active.erase(active.begin());
+            }
+            int r = -1;
+            // parameters keep their incoming register when it is allocatable
+            size_t param = (size_t)cur.v - f.insts.size();
+            if (!cur.acrossCall && cur.v >= (int)f.insts.size() && param < 6 &&
+                std::find(std::begin(callerSaved), std::end(callerSaved), argRegs[param]) != std::end(callerSaved) &&
+                !busy[argRegs[param]])
+                r = argRegs[param];
+            if (r < 0 && !cur.acrossCall)
+                for (int c : callerSaved) if (!busy[c]) { r = c; break; }
+            if (r < 0)
+                for (int c : calleeSaved) if (!busy[c]) { r = c; break; }
+            if (r < 0) {
+                // take the register of the active interval that ends last,
+                // if it ends after this one and its register suits
+                const Interval* victim = nullptr;
+                for (auto* x : active) {
+                    int xr = (int)where[x->v].v;
+                    bool ok = !cur.acrossCall || std::find(std::begin(calleeSaved), std::end(calleeSaved), xr) != std::end(calleeSaved);
+                    if (ok && (!victim || x->end > victim->end)) victim = x;
+                }
+                if (!victim || victim->end <= cur.end) { spill(cur.v); continue; }
+                r = (int)where[victim->v].v;
+                spill(victim->v);
+                active.erase(std::find(active.begin(), active.end(), victim));
+            }
+            busy[r] = true;
+            where[cur.v] = Loc::reg(r);
+            calleeUsed[r] |= std::find(std::begin(calleeSaved), std::end(calleeSaved), r) != std::end(calleeSaved);
+            active.insert(std::upper_bound(active.begin(), active.end(), &cur,
+                                           [](const Interval* x, const Interval* y) { return x->end < y->end; }), &cur);
+        }
+        for (int c : calleeSaved) if (calleeUsed[c]) usedCallee.push_back(c);
+        out.spilled = (size_t)spills;
+    }
+
+    // rbp-relative frame: saved registers, then allocas, then spill slots;
+    // the total is a multiple of 16 so calls see an aligned stack.
+    void layoutFrame() {
+        int32_t cursor = 8 * (int32_t)usedCallee.size();
+        frameDisp.assign(f.insts.size(), 0);
+        for (Id b : f.layout)
+            for (Id i : f.blocks[b].insts)
+                if (f.insts[i].op == Op::Alloca) {
+                    cursor += (int32_t)((f.sizeOf(f.insts[i].ty) + 7) / 8 * 8);
+                    frameDisp[i] = -cursor;
+                }
+        for (size_t v = 0; v < nv; ++v)
+            if (spillSlot[v] >= 0) where[v].v = -(cursor + 8 * (spillSlot[v] + 1));
+        cursor += 8 * (int32_t)out.spilled;
+        int32_t total = (cursor + 15) / 16 * 16;
+        frameSize = total - 8 * (int32_t)usedCallee.size();
+    }
+
+    // ---- operands ----
+
+    Loc loc(Value v) const {
+        switch (v.kind) {
+        case Value::Const: return {Loc::Imm, v.num};
+        case Value::Inst:
+            if (f.insts[v.id()].op == Op::Alloca) return {Loc::Frame, frameDisp[v.id()]};
+            return where[v.id()];
+        case Value::Arg: return where[f.insts.size() + v.id()];
+        default: return {Loc::Imm, 0};
+        }
+    }
+
+    static Mem slot(const Loc& l) { return {RBP, (int32_t)l.v}; }
+
+    // 64-bit copy between any two locations; rax is the go-between.
+    void move(Loc dst, Loc src) {
+        if (dst == src || dst.kind == Loc::None) return;
+        if (dst.kind == Loc::Reg) {
+            int r = (int)dst.v;
+            switch (src.kind) {
+            case Loc::Reg: a.rr({0x89}, true, (int)src.v, r); return;
+            case Loc::Stack: a.rm({0x8B}, true, r, slot(src)); return;
+            case Loc::Frame: a.rm({0x8D}, true, r, slot(src)); return;
+            case Loc::Imm: a.movImm(r, src.v); return;
+            case Loc::None: return;
+            }
+        }
+        if (src.kind == Loc::Imm && fits32(src.v)) { a.rm({0xC7}, true, 0, slot(dst)); a.d((int32_t)src.v); return; }
+        int r = src.kind == Loc::Reg ? (int)src.v : RAX;
+        move(Loc::reg(r), src);
+        a.rm({0x89}, true, r, slot(dst));
+    }
+
+    // Copies that happen at once (phis on an edge, call arguments):
+    // ordered so no source is overwritten before it is read, with r11
+    // breaking cycles.
+    void parallel(std::vector<Move> moves) {
+        std::erase_if(moves, [](const Move& m) { return m.dst == m.src || m.dst.kind == Loc::None; });
+        while (!moves.empty()) {
+            bool progress = false;
+            for (size_t k = 0; k < moves.size(); ++k) {
+                bool read = false;
+                for (size_t j = 0; j < moves.size() && !read; ++j) read = j != k && moves[j].src == moves[k].dst;
+                if (read) continue;
+                move(moves[k].dst, moves[k].src);
+                moves.erase(moves.begin() + (ptrdiff_t)k);
+                progress = true;
+                break;
+            }
+            if (progress) continue;
+            Loc d = moves[0].dst;
+            move(Loc::reg(R11), d);
+            for (auto& m : moves) if (m.src == d) m.src = Loc::reg(R11);
+        }
+    }
+
+    // The value in a register: its own, or `scratch` after loading it.
+    int use(Loc l, int scratch) {
+        if (l.kind == Loc::Reg) return (int)l.v;
+        move(Loc::reg(scratch), l);
+        return scratch;
+    }
+
+    Mem address(Loc ptr, int scratch) {
+        if (ptr.kind == Loc::Frame) return {RBP, (int32_t)ptr.v};
+        return {use(ptr, scratch), 0};
+    }
+
+    // r (op)= y, 32 bits
+    void alu(Alu op, int r, Loc y, bool w = false) {
+        switch (y.kind) {
+        case Loc::Reg: a.rr({op.rm}, w, r, (int)y.v); return;
+        case Loc::Stack: a.rm({op.rm}, w, r, slot(y)); return;
+        case Loc::Imm: a.aluImm(op.digit, w, r, y.v); return;
+        default: a.rr({op.rm}, w, r, use(y, RCX)); return;
+        }
+    }
+
+    // ---- labels ----
+
+    int newLabel() { labels.push_back(-1); return (int)labels.size() - 1; }
+    void bind(int l) { labels[l] = (int64_t)out.bytes.size(); }
+    void jmp(int l) { a.b(0xE9); fixups.push_back({out.bytes.size(), l}); a.d(0); }
+    void jcc(Cond c, int l) { a.b(0x0F); a.b((uint8_t)(0x80 | c)); fixups.push_back({out.bytes.size(), l}); a.d(0); }
+
+    // ---- emission ----
+
+    void emit() {
+        labels.assign(f.blocks.size(), -1);
+        a.push(RBP);
+        a.rr({0x89}, true, RSP, RBP);
+        for (int r : usedCallee) a.push(r);
+        if (frameSize) a.aluImm(SUB.digit, true, RSP, frameSize);
+        std::vector<Move> params;
+        for (size_t k = 0; k < f.params.size(); ++k) {
+            Loc src = k < 6 ? Loc::reg(argRegs[k]) : Loc{Loc::Stack, 16 + 8 * (int64_t)(k - 6)};
+            params.push_back({where[f.insts.size() + k], src});
+        }
+        parallel(params);
+
+        for (size_t k = 0; k < f.layout.size(); ++k) {
+            Id b = f.layout[k];
+            Id next = k + 1 < f.layout.size() ? f.layout[k + 1] : ir::None;
+            bind((int)b);
+            for (Id i : f.blocks[b].insts) inst(i, next);
+        }
+        for (auto& [at, l] : fixups) {
+            int32_t rel = (int32_t)(labels[l] - (int64_t)(at + 4));
+            for (int k = 0; k < 4; ++k) out.bytes[at + k] = (uint8_t)((uint32_t)rel >> (8 * k));
+        }
+    }
+
+    std::vector<Move> phiMoves(Id from, Id to) {
+        std::vector<Move> moves;
+        for (Id i : f.blocks[to].insts) {
+            if (f.insts[i].op != Op::Phi) break;
+            for (uint32_t k = 0; k + 1 < f.insts[i].opCount; k += 2)
+                if (f.operand(i, k + 1) == Value::block(from)) { moves.push_back({where[i], loc(f.operand(i, k))}); break; }
+        }
+        return moves;
+    }
+
+    // Copies for the edge, then the jump unless the target comes next.
+    void edge(Id from, Id to, Id next) {
+        parallel(phiMoves(from, to));
+        if (to != next) jmp((int)to);
+    }
+
+    void epilogue() {
+        a.rm({0x8D}, true, RSP, Mem{RBP, -8 * (int32_t)usedCallee.size()});
+        for (auto r = usedCallee.rbegin(); r != usedCallee.rend(); ++r) a.pop(*r);
+        a.pop(RBP);
+        a.b(0xC3);
+    }
+
+    Cond flags {NE}; // condition left by a fused icmp
+
+    void inst(Id i, Id next) {
+        const ir::Inst& in = f.insts[i];
+        auto op = [&](uint32_t k) { return loc(f.operand(i, k)); };
+        Loc d = hasValue[i] ? where[i] : Loc();
+        // result register: the destination's own unless an operand
+        // still to be read lives there
+        auto target = [&](Loc y) { return d.kind == Loc::Reg && !(y.kind == Loc::Reg && y.v == d.v) ? (int)d.v : RAX; };
+        switch (in.op) {
+        case Op::Add: case Op::Sub: case Op::And: case Op::Or: case Op::Xor: case Op::Mul: {
+            Loc x = op(0), y = op(1);
+            int r = target(y);
+            move(Loc::reg(r), x);
+            if (in.op == Op::Mul) {
+                if (y.kind == Loc::Imm) { a.rr({0x69}, false, r, r); a.d((int32_t)y.v); }
+                else if (y.kind == Loc::Stack) a.rm({0x0F, 0xAF}, false, r, slot(y));
+                else a.rr({0x0F, 0xAF}, false, r, use(y, RCX));
+            } else {
+                static const Alu ops[] = {ADD, SUB, ADD, ADD, ADD, AND, OR, XOR};
+                alu(ops[(int)in.op], r, y);
+            }
+            move(d, Loc::reg(r));
+            return;
+        }
+        case Op::SDiv: case Op::SRem: {
+            Loc y = op(1);
+            move(Loc::reg(RAX), op(0));
+            a.b(0x99); // cdq
+            if (y.kind == Loc::Reg) a.rr({0xF7}, false, 7, (int)y.v);
+            else if (y.kind == Loc::Stack) a.rm({0xF7}, false, 7, slot(y));
+            else { move(Loc::reg(RCX), y); a.rr({0xF7}, false, 7, RCX); }
+            move(d, Loc::reg(in.op == Op::SDiv ? RAX : RDX));
+            return;
+        }
+        case Op::Shl: case Op::AShr: {
+            Loc y = op(1);
+            int r = target(y), digit = in.op == Op::Shl ? 4 : 7;
+            move(Loc::reg(r), op(0));
+            if (y.kind == Loc::Imm) { a.rr({0xC1}, false, digit, r); a.b((uint8_t)(y.v & 31)); }
+            else { move(Loc::reg(RCX), y); a.rr({0xD3}, false, digit, r); }
+            move(d, Loc::reg(r));
+            return;
+        }
+        case Op::ICmp: {
+            bool w = in.ty.ptr != 0;
+            alu(CMP, use(op(0), RAX), op(1), w);
+            flags = condOf(in.pred);
+            if (fused[i]) return;
+            a.rr({0x0F, (uint8_t)(0x90 | flags)}, false, 0, RAX); // setcc al
+            a.rr({0x0F, 0xB6}, false, RAX, RAX);                  // movzx eax, al
+            move(d, Loc::reg(RAX));
+            return;
+        }
+        case Op::ZExt: move(d, op(0)); return;
+        case Op::SExt: move(d, op(0)); return; // byte loads already sign-extend
+        case Op::Trunc:
+            move(Loc::reg(RAX), op(0));
+            a.rr({0x0F, 0xBE}, false, RAX, RAX); // movsx eax, al
+            move(d, Loc::reg(RAX));
+            return;
+        case Op::Phi: case Op::Alloca: case Op::Nop: return;
+        case Op::Count: return; // --instrument builds are LLVM IR only
+        case Op::Load: {
+            Mem m = address(op(0), RAX);
+            int r = d.kind == Loc::Reg ? (int)d.v : RCX;
+            size_t n = f.sizeOf(in.ty);
+            if (n == 8) a.rm({0x8B}, true, r, m);
+            else if (n == 4) a.rm({0x8B}, false, r, m);
+            else a.rm({0x0F, 0xBE}, false, r, m); // movsx from a byte
+            move(d, Loc::reg(r));
+            return;
+        }
+        case Op::Store: {
+            Mem m = address(op(1), RAX);
+            Loc v = op(0);
+            size_t n = f.sizeOf(in.ty);
+            if (v.kind == Loc::Imm && fits32(v.v)) {
+                if (n == 1) { a.rm({0xC6}, false, 0, m); a.b((uint8_t)v.v); }
+                else { a.rm({0xC7}, n == 8, 0, m); a.d((int32_t)v.v); }
+                return;
+            }
+            int r = use(v, RCX);
+            if (n == 1) a.rm({0x88}, false, r, m, true);
+            else a.rm({0x89}, n == 8, r, m);
+            return;
+        }
+        case Op::Gep: {
+            int64_t disp = 0;
+            std::vector<uint32_t> vars;
+            for (uint32_t k = 1; k < in.opCount; ++k) {
+                Loc x = op(k);
+                if (x.kind == Loc::Imm) disp += (int64_t)(int32_t)x.v * (int64_t)f.strideOf(in.ty, k - 1);
+                else vars.push_back(k);
+            }
+            Loc base = op(0);
+            if (base.kind == Loc::Frame && fits32(base.v + disp)) {
+                a.rm({0x8D}, true, RAX, Mem{RBP, (int32_t)(base.v + disp)});
+            } else {
+                move(Loc::reg(RAX), base);
+                if (disp && fits32(disp)) a.aluImm(ADD.digit, true, RAX, disp);
+                else if (disp) { a.movImm(RCX, disp); a.rr({0x03}, true, RAX, RCX); }
+            }
+            for (uint32_t k : vars) {
+                Loc x = op(k);
+                if (x.kind == Loc::Stack) a.rm({0x63}, true, RCX, slot(x)); // movsxd
+                else a.rr({0x63}, true, RCX, use(x, RCX));
+                int64_t stride = (int64_t)f.strideOf(in.ty, k - 1);
+                if (stride != 1) { a.rr({0x69}, true, RCX, RCX); a.d((int32_t)stride); }
+                a.rr({0x03}, true, RAX, RCX);
+            }
+            move(d, Loc::reg(RAX));
+            return;
+        }
+        case Op::Call: {
+            uint32_t n = in.opCount - 1;
+            uint32_t onStack = n > 6 ? n - 6 : 0;
+            int32_t pad = onStack % 2 ? 8 : 0;
+            if (pad) a.aluImm(SUB.digit, true, RSP, pad);
+            for (uint32_t k = n; k > 6; --k) a.push(use(op(k), RAX));
+            std::vector<Move> args;
+            for (uint32_t k = 0; k < n && k < 6; ++k) args.push_back({Loc::reg(argRegs[k]), op(k + 1)});
+            parallel(args);
+            a.b(0xE8);
+            out.calls.push_back({(uint32_t)out.bytes.size(), f.callees[f.operand(i, 0).id()].name});
+            a.d(0);
+            if (onStack || pad) a.aluImm(ADD.digit, true, RSP, 8 * (int32_t)onStack + pad);
+            move(d, Loc::reg(RAX));
+            return;
+        }
+        case Op::Br: edge(in.block, f.operand(i, 0).id(), next); return;
+        case Op::CondBr: {
+            Id b = in.block, t = f.operand(i, 1).id(), e = f.operand(i, 2).id();
+            Loc c = op(0);
+            Cond cc = flags;
+            Value cv = f.operand(i, 0);
+            if (c.kind == Loc::Imm) { edge(b, c.v ? t : e, next); return; }
+            if (!(cv.kind == Value::Inst && fused[cv.id()])) {
+                if (c.kind == Loc::Reg) a.rr({0x85}, false, (int)c.v, (int)c.v);
+                else { a.rm({0x83}, false, CMP.digit, slot(c)); a.b(0); }
+                cc = NE;
+            }
+            auto tm = phiMoves(b, t), em = phiMoves(b, e);
+            Cond inverse = (Cond)(cc ^ 1);
+            if (tm.empty() && !(t == next && em.empty())) {
+                jcc(cc, (int)t);
+                edge(b, e, next);
+            } else if (em.empty()) {
+                jcc(inverse, (int)e);
+                edge(b, t, next);
+            } else {
+                int stub = newLabel();
+                jcc(cc, stub);
+                edge(b, e, ir::None);
+                bind(stub);
+                edge(b, t, next);
+            }
+            return;
+        }
+        case Op::Ret:
+            if (in.opCount) move(Loc::reg(RAX), op(0));
+            epilogue();
+            return;
+        }
+    }
+};
+
+} // namespace
+
+void compile(const ir::Function& f, MachineCode& out) { FunctionCompiler(f, out).run(); }
+
+} // namespace cmini::x86
@@ -0,0 +1,30 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "ir.h"
+
+namespace cmini::x86 {
+
+// Machine code for one function. It is position independent apart from
+// its calls: each call site is the offset of a rel32 field that the object
+// writer relocates against the callee's symbol.
+struct MachineCode {
+    SymId name {0};
+    std::vector<uint8_t> bytes;
+    struct CallSite { uint32_t offset; SymId callee; };
+    std::vector<CallSite> calls;
+    size_t spilled {0}; // values that live in a stack slot instead of a register
+};
+
+// Native backend for the System V x86-64 ABI, working directly on the SSA
+// form IRGen produces (after its passes). Values get registers from a
+// linear-scan allocator over one live interval per value: values that are
+// live across a call may only use callee-saved registers, the others
+// prefer caller-saved ones, and when none is free the interval that ends
+// last goes to a stack slot. rax, rcx, rdx and r11 are never allocated;
+// instruction selection uses them as scratch. Phis become parallel copies
+// on the incoming edges, placed in a stub when the edge is critical.
+void compile(const ir::Function& f, MachineCode& out);
+
+} // namespace cmini::x86
@@ -0,0 +1,25 @@
+#!/usr/bin/env bash
+# The compile cache's tracked byte total must not grow when a store
+# replaces an entry that already exists under the same key.
+set -euo pipefail
+ROOT=$(cd -- "$(dirname -- "$0")"/.. && pwd)
+BIN="$ROOT/${BUILD_DIR:-build}/src/cmini"
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+cp "$ROOT/examples/hello.cmini" "$TMP/t.cmini"
+"$BIN" --cache-dir "$TMP/cache" "$TMP/t.cmini" -o "$TMP/a.ll" >/dev/null
+# A dangling symlink makes the fetch miss (it cannot open the output)
+# while the --incremental build, which renames its output into place,
+# still succeeds: the same key is stored a second time.
+ln -s "$TMP/missing/b.ll" "$TMP/b.ll"
+"$BIN" --cache-dir "$TMP/cache" --incremental "$TMP/t.cmini" -o "$TMP/b.ll" >/dev/null
+
+entries=$(find "$TMP/cache/objects" -type f | wc -l)
+size=$(find "$TMP/cache/objects" -type f -printf '%s\n')
+tracked=$(cut -d' ' -f3 "$TMP/cache/stats")
+if [[ $entries -ne 1 || $tracked -ne $size ]]; then
+  echo "FAIL cache: $entries entries of $size bytes, $tracked bytes tracked" >&2
+  exit 1
+fi
+echo "cache checks passed"
@@ -0,0 +1,34 @@
+#!/usr/bin/env bash
+# --incremental must never splice text from an output that something else
+# wrote after the <out>.fncache index: a plain build or a cache fetch.
+set -euo pipefail
+ROOT=$(cd -- "$(dirname -- "$0")"/.. && pwd)
+BIN="$ROOT/${BUILD_DIR:-build}/src/cmini"
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+fail=0
+version() { # writes a program whose main returns $1, always the same size
+  printf 'int f() { return %s; }\nint main() { return f(); }\n' "$1" > "$TMP/t.cmini"
+}
+expect() { # what, value
+  if ! grep -q "ret i32 $2" "$TMP/t.ll"; then
+    echo "FAIL $1: expected ret i32 $2 in" >&2
+    cat "$TMP/t.ll" >&2
+    fail=1
+  fi
+}
+
+version 2; "$BIN" --incremental "$TMP/t.cmini" -o "$TMP/t.ll" >/dev/null
+version 1; "$BIN" "$TMP/t.cmini" -o "$TMP/t.ll" >/dev/null
+version 2; "$BIN" --incremental "$TMP/t.cmini" -o "$TMP/t.ll" >/dev/null
+expect "incremental after a plain build" 2
+
+version 1; "$BIN" --cache-dir "$TMP/cache" "$TMP/t.cmini" -o "$TMP/t.ll" >/dev/null
+version 2; "$BIN" --incremental "$TMP/t.cmini" -o "$TMP/t.ll" >/dev/null
+version 1; "$BIN" --cache-dir "$TMP/cache" "$TMP/t.cmini" -o "$TMP/t.ll" >/dev/null # a hit
+version 2; "$BIN" --incremental "$TMP/t.cmini" -o "$TMP/t.ll" >/dev/null
+expect "incremental after a cache fetch" 2
+
+[[ $fail -eq 0 ]] && echo "incremental checks passed"
+exit $fail
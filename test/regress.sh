@@ -0,0 +1,38 @@
+#!/usr/bin/env bash
+# Runs each test/cases/*.cmini through every backend and checks the value
+# main returns against the "// expect: N" line of the file: the JIT, the
+# bytecode VM, --emit=obj, and the LLVM IR through llc when it is installed.
+set -euo pipefail
+ROOT=$(cd -- "$(dirname -- "$0")"/.. && pwd)
+BIN="$ROOT/${BUILD_DIR:-build}/src/cmini"
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+fail=0
+check() { # name backend got expected
+  if [[ "$3" != "$4" ]]; then
+    echo "FAIL $1 ($2): got $3, expected $4" >&2
+    fail=1
+  fi
+}
+run() { set +e; "$@" >/dev/null 2>&1; echo $?; set -e; }
+
+for f in "$ROOT"/test/cases/*.cmini; do
+  name=$(basename "$f" .cmini)
+  want=$(sed -n 's|^// expect: \([0-9]*\)$|\1|p' "$f")
+  for o in -O0 -O2; do
+    check "$name" "--run $o" "$(run "$BIN" --run $o "$f")" "$want"
+    check "$name" "--run --vm $o" "$(run "$BIN" --run --vm $o "$f")" "$want"
+    "$BIN" --emit=obj $o "$f" -o "$TMP/$name.o" >/dev/null
+    cc "$TMP/$name.o" -o "$TMP/$name"
+    check "$name" "--emit=obj $o" "$(run "$TMP/$name")" "$want"
+    "$BIN" $o "$f" -o "$TMP/$name.ll" >/dev/null
+    if command -v llc >/dev/null 2>&1; then
+      llc -relocation-model=pic -filetype=obj "$TMP/$name.ll" -o "$TMP/$name.o"
+      cc "$TMP/$name.o" -o "$TMP/$name"
+      check "$name" "llc $o" "$(run "$TMP/$name")" "$want"
+    fi
+  done
+done
+[[ $fail -eq 0 ]] && echo "regression cases passed"
+exit $fail
@@ -2,3 +2,7 @@
 set -euo pipefail
 ROOT=$(cd -- "$(dirname -- "$0")"/.. && pwd)
 "$ROOT/run.sh" "$ROOT/examples"/*.cmini
+"$ROOT/test/regress.sh"
+"$ROOT/test/incremental.sh"
+"$ROOT/test/cache.sh"
+"$ROOT/test/server.sh"
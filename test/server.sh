@@ -0,0 +1,27 @@
+#!/usr/bin/env bash
+# Argument parsing of cmini --server: -j takes its count attached or
+# separate, and anything else is an error rather than silently ignored.
+set -euo pipefail
+ROOT=$(cd -- "$(dirname -- "$0")"/.. && pwd)
+BIN="$ROOT/${BUILD_DIR:-build}/src/cmini"
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+fail=0
+for jobs in "-j3" "-j 3"; do
+  "$BIN" --server "$TMP/sock" $jobs 2>"$TMP/log" &
+  pid=$!
+  for _ in $(seq 50); do [[ -S "$TMP/sock" ]] && break; sleep 0.1; done
+  "$BIN" --connect "$TMP/sock" --shutdown >/dev/null
+  wait $pid
+  if ! grep -q "(3 threads)" "$TMP/log"; then
+    echo "FAIL server $jobs:" >&2; cat "$TMP/log" >&2; fail=1
+  fi
+done
+for bad in "-x" "-jx" "-j"; do
+  if "$BIN" --server "$TMP/sock" $bad 2>/dev/null; then
+    echo "FAIL server: accepted $bad" >&2; fail=1
+  fi
+done
+[[ $fail -eq 0 ]] && echo "server checks passed"
+exit $fail